@@ -50,6 +50,6 @@ export default {
 
     // --- Binary Chunk Counter ---
     getChunkCounter: () => binaryChunkCounter,
-    incrementChunkCounter: () => { binaryChunkCounter++; },
+    incrementChunkCounter: (count = 1) => { binaryChunkCounter += count; },
     resetChunkCounter: () => { binaryChunkCounter = 0; }
 };
\ No newline at end of file
@@ -7,14 +7,25 @@
 
 import appState from './appState.js';
 import wsService from './websocketService.js';
+import streamClient from './streamClient.js';
+import streamPlot from './streamPlot.js';
+import nodeAggregator from './nodeAggregator.js';
 import * as ui from './uiUpdater.js'; // Using namespace import for UI functions
 
+// Stream view selector value -> "decimation" option of start_stream (null: raw frames)
+const STREAM_VIEWS = {
+    raw: null,
+    average: { mode: 'average', rateHz: 30 },
+    minmax: { mode: 'minmax', rateHz: 30 }
+};
+
 // --- WebSocket Event Handlers (delegated from websocketService) ---
 
 wsService.setOnOpen(() => {
     ui.updateConnectionStatus('Connected to ESP32', 'green');
     ui.loadVarsConfigBtnEl.disabled = false;
     sendLoadVarsConfigRequest(); // Automatically load config on successful connection
+    wsService.sendPayload({ action: 'get_stream_schema' }); // In case another client already started the stream
     ui.updateStreamControlUI(appState.isStreaming(), wsService.isConnected(), appState.getChunkCounter());
 });
 
@@ -38,7 +49,9 @@ wsService.setOnConfigList((varsArray) => {
     varsArray.forEach(varConfig => {
         currentValues[varConfig.name] = varConfig.value;
         fullConfig[varConfig.name] = { 
+            index: varConfig.index,
             type: varConfig.type,
+            count: varConfig.count, // Arrays only
             hasLimits: varConfig.hasLimits,
             min: varConfig.min,
             max: varConfig.max
@@ -71,9 +84,45 @@ wsService.setOnVariableUpdate((message) => {
     );
 });
 
-wsService.setOnBinaryData((arrayBuffer) => {
-    appState.incrementChunkCounter();
-    ui.processAndLogBinaryData(arrayBuffer, appState.getChunkCounter());
+wsService.setOnVariablesUpdate((values, errors) => {
+    Object.keys(values).forEach(varName => appState.setConfigurableVariableValue(varName, values[varName]));
+    Object.keys(errors).forEach(varName => console.warn(`Variable '${varName}': ${errors[varName]}`));
+    ui.renderVariablesTable(
+        appState.getAllConfigurableVariablesData(), 
+        appState.getAllVariablesConfiguration(),
+        sendGetVariableRequest,
+        sendSetVariableRequest
+    );
+});
+
+wsService.setOnBinaryReply((reply) => {
+    if (reply.status !== 0) {
+        console.warn(`Binary command #${reply.tag} for index ${reply.index} failed: ${reply.statusText}`);
+        return;
+    }
+    const allConfig = appState.getAllVariablesConfiguration();
+    const varName = Object.keys(allConfig).find(name => allConfig[name].index === reply.index);
+    if (varName === undefined) return;
+    appState.setConfigurableVariableValue(varName, reply.value);
+    ui.renderVariablesTable(
+        appState.getAllConfigurableVariablesData(), 
+        appState.getAllVariablesConfiguration(),
+        sendGetVariableRequest,
+        sendSetVariableRequest
+    );
+});
+
+wsService.setOnStreamSchema((streams) => {
+    streamClient.setStreamSchema(streams);
+    streamPlot.setStream(streams.length > 0 ? streams[0] : null); // Plots the first stream
+});
+
+// Frames are decoded in streamWorker.js; the page only sees a summary per batch
+wsService.setOnBinaryData((arrayBuffer) => streamClient.postFrame(arrayBuffer));
+
+streamClient.setOnFrames((summary) => {
+    appState.incrementChunkCounter(summary.frames);
+    ui.logStreamFrame(summary.latest, summary.lostFrames, appState.getChunkCounter());
     // Stream status text is updated inside updateStreamControlUI based on appState
     ui.updateStreamControlUI(appState.isStreaming(), wsService.isConnected(), appState.getChunkCounter());
 });
@@ -101,6 +150,13 @@ wsService.setOnServerStatus((message) => {
 });
 
 
+// --- Node Aggregator Handlers ---
+
+nodeAggregator.setOnNodesChanged((stats) => ui.renderNodesTable(stats));
+
+nodeAggregator.setOnFrame((item) => ui.logMergedFrame(item));
+
+
 // --- Action Functions (that send commands via WebSocket) ---
 
 /**
@@ -111,7 +167,7 @@ function sendLoadVarsConfigRequest() {
     ui.renderVariablesTable({}, {}, sendGetVariableRequest, sendSetVariableRequest); // Clear table with placeholder
     const tableBody = document.getElementById('variablesTableBody');
     if(tableBody) tableBody.innerHTML = '<tr><td colspan="4" style="text-align: center; color: grey;">Loading variable configuration from ESP32...</td></tr>';
-    wsService.sendPayload({ action: 'get_all_vars_config' });
+    wsService.requestVariables();
 }
 
 /**
@@ -122,6 +178,46 @@ function sendGetVariableRequest(variableName) {
     wsService.sendPayload({ action: 'get', variable: variableName }); 
 }
 
+/**
+ * Parses and checks one value of a numeric variable (or one element of an array variable).
+ * BOOL accepts true/false/1/0; INT and UINT need whole numbers (UINT also non-negative).
+ * @returns {number|boolean|null} The value to send, or null after telling the user why it is invalid.
+ */
+function parseNumericValue(variableName, text, varConfig) {
+    const espVarType = varConfig.type;
+    if (espVarType === "BOOL") {
+        const lowered = text.toLowerCase();
+        if (lowered === 'true' || lowered === '1') return true;
+        if (lowered === 'false' || lowered === '0') return false;
+        alert(`Invalid value ('${text}') for boolean variable '${variableName}'. Please enter true or false.`);
+        return null;
+    }
+    const numericValue = text === '' ? NaN : Number(text);
+    if (isNaN(numericValue)) {
+        alert(`Invalid value ('${text}') for numeric variable '${variableName}'. Please enter a valid number.`); 
+        return null; 
+    }
+    if ((espVarType === "INT" || espVarType === "UINT") && !Number.isInteger(numericValue)) {
+        alert(`Value ${numericValue} for '${variableName}' must be a whole number.`);
+        return null;
+    }
+    if (espVarType === "UINT" && numericValue < 0) {
+        alert(`Value ${numericValue} for '${variableName}' must not be negative.`);
+        return null;
+    }
+    if (varConfig.hasLimits) { 
+        if (varConfig.min !== undefined && numericValue < varConfig.min) {
+            alert(`Value ${numericValue} for '${variableName}' is less than the minimum allowed (${varConfig.min}).`); 
+            return null;
+        }
+        if (varConfig.max !== undefined && numericValue > varConfig.max) {
+            alert(`Value ${numericValue} for '${variableName}' is greater than the maximum allowed (${varConfig.max}).`); 
+            return null;
+        }
+    }
+    return numericValue;
+}
+
 /**
  * Sends a "set" request for a specific variable.
  * Performs client-side validation based on the variable's configuration.
@@ -138,32 +234,32 @@ function sendSetVariableRequest(variableName, rawValue, varConfig) {
     const espVarType = varConfig.type;
     let valueToSend = rawValue;
 
-    if (espVarType === "INT" || espVarType === "FLOAT") {
-        const numericValue = Number(rawValue);
-        if (isNaN(numericValue)) {
-            alert(`Invalid value ('${rawValue}') for numeric variable '${variableName}'. Please enter a valid number.`); 
-            return; 
+    if (espVarType && espVarType !== "STRING") {
+        // Arrays are entered as comma-separated elements; every element is checked like a scalar
+        const parts = varConfig.count ? String(rawValue).split(',') : [rawValue];
+        if (varConfig.count && parts.length !== varConfig.count) {
+            alert(`'${variableName}' needs exactly ${varConfig.count} comma-separated values (got ${parts.length}).`);
+            return;
         }
-        if (varConfig.hasLimits) { 
-            if (varConfig.min !== undefined && numericValue < varConfig.min) {
-                alert(`Value ${numericValue} for '${variableName}' is less than the minimum allowed (${varConfig.min}).`); 
-                return;
-            }
-            if (varConfig.max !== undefined && numericValue > varConfig.max) {
-                alert(`Value ${numericValue} for '${variableName}' is greater than the maximum allowed (${varConfig.max}).`); 
-                return;
-            }
+        const values = [];
+        for (const part of parts) {
+            const value = parseNumericValue(variableName, part.trim(), varConfig);
+            if (value === null) return;
+            values.push(value);
         }
-        valueToSend = numericValue; 
+        valueToSend = varConfig.count ? values : values[0];
     }
-    wsService.sendPayload({ action: 'set', variable: variableName, value: valueToSend });
+        wsService.queueSet(variableName, valueToSend); // Coalesced with other sets of this frame
 }
 
 /**
  * Sends the "start_stream" command and updates UI optimistically.
  */
 function sendStartStreamRequest() { 
-    wsService.sendPayload({ action: 'start_stream' }); 
+    const payload = { action: 'start_stream' };
+    const view = ui.streamViewSelectEl ? STREAM_VIEWS[ui.streamViewSelectEl.value] : null;
+    if (view) payload.decimation = view; // Decimated on the ESP32; the matching schema arrives first
+    wsService.sendPayload(payload); 
     appState.setStreaming(true); 
     appState.resetChunkCounter(); 
     if (ui.binaryDataLogAreaEl) ui.binaryDataLogAreaEl.textContent = "(Waiting for stream data...)\n"; 
@@ -179,6 +275,15 @@ function sendStopStreamRequest() {
     ui.updateStreamControlUI(appState.isStreaming(), wsService.isConnected(), appState.getChunkCounter());
 }
 
+/**
+ * Connects the aggregator to the hosts listed in the node input, with the selected stream view.
+ */
+function connectNodesFromInput() {
+    const hosts = ui.nodeHostsInputEl.value.split(/[\s,]+/);
+    const view = ui.streamViewSelectEl ? STREAM_VIEWS[ui.streamViewSelectEl.value] : null;
+    nodeAggregator.connectNodes(hosts, view ? { decimation: view } : null);
+}
+
 // --- Application Initialization ---
 
 // This function runs once the DOM is fully loaded.
@@ -189,6 +294,13 @@ function initializeApp() {
     ui.loadVarsConfigBtnEl.addEventListener('click', sendLoadVarsConfigRequest);
     ui.startStreamBtnEl.addEventListener('click', sendStartStreamRequest);
     ui.stopStreamBtnEl.addEventListener('click', sendStopStreamRequest);
+    ui.connectNodesBtnEl.addEventListener('click', connectNodesFromInput);
+    ui.disconnectNodesBtnEl.addEventListener('click', () => nodeAggregator.disconnectAll());
+    if (ui.plotSpanSelectEl) {
+        ui.plotSpanSelectEl.addEventListener('change', () => streamPlot.setSpanSeconds(Number(ui.plotSpanSelectEl.value)));
+        streamPlot.setSpanSeconds(Number(ui.plotSpanSelectEl.value));
+    }
+    streamPlot.init(ui.streamPlotCanvasEl);
     
     // Set initial UI state for controls (mostly disabled until connected)
     ui.updateStreamControlUI(false, false, 0); 
@@ -196,6 +308,13 @@ function initializeApp() {
 
     // Attempt to connect to the WebSocket server
     wsService.connect(); 
+
+    // "?nodes=a.local,b.local" (as printed by scripts/discover_nodes.py) connects the aggregator right away
+    const nodeList = new URLSearchParams(location.search).get('nodes');
+    if (nodeList) {
+        ui.nodeHostsInputEl.value = nodeList;
+        connectNodesFromInput();
+    }
 }
 
 // Start the application initialization when the DOM is ready.
@@ -0,0 +1,226 @@
+// js/nodeAggregator.js
+
+/**
+ * Connects to several ESP32 nodes at once and merges their streams on one timeline.
+ * Each node gets its own WebSocket and stream decoder. Frame timestamps count microseconds since
+ * that node's stream started, so every (node, stream) pair gets a clock offset to page time
+ * (performance.now()): the lower envelope of "arrival time - device time of the frame's last sample".
+ * The least-delayed frames bound the true offset, and the envelope only rises by DRIFT_ALLOWANCE_PPM
+ * between frames, so queueing delay and jitter do not shift the timeline while crystal drift is tracked.
+ * Frames are released to the frame handler in timeline order, playoutDelayMs behind real time.
+ */
+
+import streamDecoder from './streamDecoder.js';
+
+const RECONNECT_DELAY_MS = 3000;
+const DRIFT_ALLOWANCE_PPM = 100;  // Above the combined tolerance of two crystals
+const DEFAULT_PLAYOUT_DELAY_MS = 250;
+const PLAYOUT_INTERVAL_MS = 50;
+
+let nodes = new Map();      // host -> NodeConnection
+let startOptions = null;    // Extra start_stream fields (e.g. { decimation: {...} }), same for every node
+let playoutDelayMs = DEFAULT_PLAYOUT_DELAY_MS;
+let pending = [];           // Frames waiting for playout, sorted by startMs
+let playoutTimer = null;
+
+// Callback handlers to be set by other modules (e.g., main.js)
+let onFrameHandler = () => {};        // ({ host, frame, startMs }) in timeline order
+let onNodesChangedHandler = () => {}; // (stats[]) after a connection state change
+
+/**
+ * One node: its WebSocket, decoder, per-stream clocks and counters.
+ */
+class NodeConnection {
+    constructor(host) {
+        this.host = host;
+        this.ws = null;
+        this.decoder = streamDecoder.createStreamDecoder();
+        this.clocks = {}; // streamId -> { offsetMs, lastArrivalMs, lastBaseUs }
+        this.state = 'idle';
+        this.frames = 0;
+        this.lostFrames = 0;
+        this.closing = false;
+        this.reconnectTimer = null;
+        this.lastSequence = {};  // streamId -> sequence of the last frame received
+        this.streamFrames = {};  // streamId -> frames received
+        this.replaying = false;  // A replay_since was sent on this connection
+    }
+
+    /**
+     * After a reconnect: asks the node to replay what its recorder kept of the busiest stream since
+     * its last frame here (one replay per connection). Sent before start_stream, so the node holds
+     * that stream's live frames until the gap is filled.
+     */
+    replayRequest() {
+        let streamId = null;
+        for (const id of Object.keys(this.streamFrames)) {
+            if (streamId === null || this.streamFrames[id] > this.streamFrames[streamId]) streamId = id;
+        }
+        if (streamId === null) return null;
+        return { action: 'replay_since', stream: Number(streamId), sequence: this.lastSequence[streamId] };
+    }
+
+    connect() {
+        this.closing = false;
+        this.state = 'connecting';
+        this.ws = new WebSocket(`ws://${this.host}/ws`);
+        this.ws.binaryType = 'arraybuffer';
+        this.ws.onopen = () => {
+            this.state = 'open';
+            const replay = this.replayRequest();
+            this.replaying = replay !== null;
+            if (replay) this.send(replay);
+            this.send({ ...(startOptions || {}), action: 'start_stream' }); // The schema arrives before the first frame
+            onNodesChangedHandler(getNodeStats());
+        };
+        this.ws.onclose = () => {
+            this.ws = null;
+            this.state = this.closing ? 'closed' : 'reconnecting';
+            if (!this.closing) this.reconnectTimer = setTimeout(() => this.connect(), RECONNECT_DELAY_MS);
+            onNodesChangedHandler(getNodeStats());
+        };
+        this.ws.onerror = () => {}; // onclose follows and handles the retry
+        this.ws.onmessage = (event) => this.handleMessage(event.data);
+    }
+
+    close() {
+        this.closing = true;
+        clearTimeout(this.reconnectTimer);
+        if (this.ws) {
+            this.send({ action: 'stop_stream' });
+            this.ws.close();
+        }
+    }
+
+    send(payload) {
+        if (this.ws && this.ws.readyState === WebSocket.OPEN) this.ws.send(JSON.stringify(payload));
+    }
+
+    handleMessage(data) {
+        if (typeof data === 'string') {
+            let message;
+            try {
+                message = JSON.parse(data);
+            } catch (e) {
+                return;
+            }
+            if (message.status === 'stream_schema' && message.streams) {
+                this.decoder.setStreamSchema(message.streams);
+                if (!this.replaying) this.clocks = {}; // A replayed stream continues on its old clock
+            } else if (message.status === 'replay_done' || (message.status === 'error' && this.replaying)) {
+                this.replaying = false; // Recorder off or no slot: the gap stays a gap
+            }
+            return;
+        }
+        if (!this.decoder.isStreamFrame(data)) return;
+        const frame = this.decoder.decodeStreamFrame(data);
+        if (!frame) return;
+        this.frames++;
+        this.lostFrames += frame.lostFrames;
+        this.lastSequence[frame.streamId] = frame.sequence;
+        this.streamFrames[frame.streamId] = (this.streamFrames[frame.streamId] || 0) + 1;
+        queueFrame({ host: this.host, frame, startMs: this.toPageTime(frame) });
+    }
+
+    /**
+     * Maps the frame's first sample to page time, updating the stream's offset estimate.
+     */
+    toPageTime(frame) {
+        const arrivalMs = performance.now();
+        const lastSampleMs = (frame.baseTimeUs + Math.max(frame.sampleCount - 1, 0) * frame.periodUs) / 1000;
+        let clock = this.clocks[frame.streamId];
+        if (!clock || frame.baseTimeUs < clock.lastBaseUs) { // First frame, or the stream restarted
+            clock = { offsetMs: Infinity, lastArrivalMs: arrivalMs, lastBaseUs: 0 };
+            this.clocks[frame.streamId] = clock;
+        }
+        const allowanceMs = (arrivalMs - clock.lastArrivalMs) * DRIFT_ALLOWANCE_PPM / 1e6;
+        clock.offsetMs = Math.min(clock.offsetMs + allowanceMs, arrivalMs - lastSampleMs);
+        clock.lastArrivalMs = arrivalMs;
+        clock.lastBaseUs = frame.baseTimeUs;
+        return frame.baseTimeUs / 1000 + clock.offsetMs;
+    }
+}
+
+/**
+ * Inserts a frame into the playout queue, keeping it sorted by start time.
+ */
+function queueFrame(item) {
+    let i = pending.length;
+    while (i > 0 && pending[i - 1].startMs > item.startMs) i--;
+    pending.splice(i, 0, item);
+}
+
+/**
+ * Releases the frames whose start time is at least playoutDelayMs in the past.
+ */
+function drainPlayout() {
+    const horizonMs = performance.now() - playoutDelayMs;
+    let released = 0;
+    while (released < pending.length && pending[released].startMs <= horizonMs) {
+        onFrameHandler(pending[released]);
+        released++;
+    }
+    if (released > 0) pending.splice(0, released);
+}
+
+/**
+ * Connects to the given nodes (host names or addresses, e.g. "esp32ws-a1b2c3.local") and starts
+ * their streams. Nodes no longer listed are disconnected; listed ones stay connected.
+ * @param {string[]} hosts Node hosts.
+ * @param {object} options (Optional) Extra start_stream fields, e.g. { decimation: { mode: 'average', rateHz: 30 } }.
+ */
+function connectNodes(hosts, options = null) {
+    startOptions = options;
+    const wanted = new Set(hosts.map(h => h.trim()).filter(h => h.length > 0));
+    nodes.forEach((node, host) => {
+        if (!wanted.has(host)) {
+            node.close();
+            nodes.delete(host);
+        }
+    });
+    wanted.forEach(host => {
+        if (!nodes.has(host)) {
+            const node = new NodeConnection(host);
+            nodes.set(host, node);
+            node.connect();
+        }
+    });
+    if (!playoutTimer) playoutTimer = setInterval(drainPlayout, PLAYOUT_INTERVAL_MS);
+    onNodesChangedHandler(getNodeStats());
+}
+
+/**
+ * Stops the streams and closes every node connection.
+ */
+function disconnectAll() {
+    nodes.forEach(node => node.close());
+    nodes.clear();
+    pending = [];
+    clearInterval(playoutTimer);
+    playoutTimer = null;
+    onNodesChangedHandler(getNodeStats());
+}
+
+/**
+ * Returns one entry per node: { host, state, frames, lostFrames, offsetsMs }, where offsetsMs maps
+ * each stream id to its current device-to-page clock offset.
+ * @returns {object[]}
+ */
+function getNodeStats() {
+    return Array.from(nodes.values()).map(node => ({
+        host: node.host,
+        state: node.state,
+        frames: node.frames,
+        lostFrames: node.lostFrames,
+        offsetsMs: Object.fromEntries(Object.entries(node.clocks).map(([id, clock]) => [id, clock.offsetMs]))
+    }));
+}
+
+export default {
+    connectNodes,
+    disconnectAll,
+    getNodeStats,
+    setPlayoutDelay: (ms) => { playoutDelayMs = ms; },
+    setOnFrame: (handler) => { onFrameHandler = handler; },
+    setOnNodesChanged: (handler) => { onNodesChangedHandler = handler; }
+};
@@ -0,0 +1,105 @@
+// js/streamClient.js
+
+/**
+ * Page-side handle on the stream decoding worker (streamWorker.js). Frames are handed over without
+ * copying (the ArrayBuffer is transferred), so the UI thread never decodes: it gets a summary of the
+ * frames received at most every 100 ms and asks for windows of recent samples when it draws.
+ * Where module workers are unavailable the same store runs on the page instead.
+ */
+
+import { createStreamStore } from './streamWorker.js';
+
+let worker = null;
+let localStore = null;       // In-page fallback (no module worker support)
+let streamSchema = null;     // Last schema, replayed into the fallback store if the worker fails
+let nextRequestId = 1;
+const pendingRequests = new Map(); // Request id -> resolve function (window and envelope requests)
+let onFramesHandler = () => {};
+
+/**
+ * Switches to decoding on the page. Frames already posted to a failed worker are lost.
+ */
+function useLocalStore() {
+    if (localStore) return;
+    if (worker) worker.terminate();
+    worker = null;
+    localStore = createStreamStore();
+    localStore.onSummary(summary => onFramesHandler(summary));
+    if (streamSchema) localStore.setStreamSchema(streamSchema);
+    pendingRequests.forEach(resolve => resolve(null));
+    pendingRequests.clear();
+}
+
+function handleWorkerMessage(event) {
+    const message = event.data;
+    if (message.type === 'frames') {
+        onFramesHandler(message.summary);
+    } else if (message.type === 'window' || message.type === 'envelope') {
+        const resolve = pendingRequests.get(message.id);
+        pendingRequests.delete(message.id);
+        if (resolve) resolve(message.type === 'window' ? message.window : message.envelope);
+    }
+}
+
+function startWorker() {
+    try {
+        worker = new Worker(new URL('./streamWorker.js', import.meta.url), { type: 'module' });
+        worker.onmessage = handleWorkerMessage;
+        worker.onerror = (event) => {
+            console.warn('Stream Client: Decoding worker failed, decoding on the page.', event.message);
+            useLocalStore();
+        };
+    } catch (e) {
+        console.warn('Stream Client: Module workers unavailable, decoding on the page.', e);
+        useLocalStore();
+    }
+}
+
+startWorker();
+
+export default {
+    /** Installs the stream layouts of a "stream_schema" message (resets the rings). */
+    setStreamSchema: (streams) => {
+        streamSchema = streams;
+        if (worker) worker.postMessage({ type: 'schema', streams });
+        else localStore.setStreamSchema(streams);
+    },
+
+    /** Decodes a received stream frame. The buffer is transferred: do not use it afterwards. */
+    postFrame: (buffer) => {
+        if (worker) worker.postMessage({ type: 'frame', buffer }, [buffer]);
+        else localStore.pushFrame(buffer);
+    },
+
+    /**
+     * Requests the last 'samples' samples of a stream.
+     * @returns {Promise<object|null>} The window (see readWindow in streamWorker.js), or null if the
+     *          stream is unknown.
+     */
+    requestWindow: (streamId, samples) => {
+        if (!worker) return Promise.resolve(localStore.readWindow(streamId, samples));
+        const id = nextRequestId++;
+        return new Promise(resolve => {
+            pendingRequests.set(id, resolve);
+            worker.postMessage({ type: 'window', id, streamId, samples });
+        });
+    },
+
+    /**
+     * Requests the min/max envelope of the last 'samples' samples of a stream in 'buckets' slices.
+     * With sinceTotal (the "total" of the previous envelope) nothing is computed if no sample came in.
+     * @returns {Promise<object|null>} The envelope (see readEnvelope in streamWorker.js), or null if the
+     *          stream is unknown.
+     */
+    requestEnvelope: (streamId, samples, buckets, sinceTotal = -1) => {
+        if (!worker) return Promise.resolve(localStore.readEnvelope(streamId, samples, buckets, sinceTotal));
+        const id = nextRequestId++;
+        return new Promise(resolve => {
+            pendingRequests.set(id, resolve);
+            worker.postMessage({ type: 'envelope', id, streamId, samples, buckets, sinceTotal });
+        });
+    },
+
+    /** Sets the handler of the batched frame summaries ({ frames, lostFrames, latest }). */
+    setOnFrames: (handler) => { onFramesHandler = handler; }
+};
@@ -0,0 +1,272 @@
+// js/streamDecoder.js
+
+/**
+ * Decodes the self-describing binary stream frames (see ESP32WebSocketStream.h).
+ * Stream layouts come from the "stream_schema" message; each frame starts with a 16-byte header:
+ *   u8 type (0xD1) | u8 streamId | u16 sampleCount | u32 sequence | u64 baseTimeUs   (little-endian)
+ * followed by sampleCount samples, each holding every channel value in schema order, or by
+ * the payload of the stream's "encoding" ("pack12" or "delta", see StreamEncoding in the header).
+ */
+
+const STREAM_FRAME_TYPE = 0xD1; // ESP32WS_BIN_STREAM_FRAME
+const STREAM_HEADER_BYTES = 16;
+
+// Schema type name -> [byte size, DataView getter, typed array constructor]
+const VALUE_TYPES = {
+    u8:  [1, 'getUint8',   Uint8Array],
+    i8:  [1, 'getInt8',    Int8Array],
+    u16: [2, 'getUint16',  Uint16Array],
+    i16: [2, 'getInt16',   Int16Array],
+    u32: [4, 'getUint32',  Uint32Array],
+    i32: [4, 'getInt32',   Int32Array],
+    f32: [4, 'getFloat32', Float32Array]
+};
+
+/**
+ * Reads fields of up to 24 bits, LSB-first, from a byte array (matches BitWriter on the ESP32).
+ */
+class BitReader {
+    constructor(bytes, position) {
+        this.bytes = bytes;
+        this.position = position;
+        this.acc = 0;
+        this.bits = 0;
+    }
+    read(width) {
+        while (this.bits < width) {
+            this.acc |= this.bytes[this.position++] << this.bits;
+            this.bits += 8;
+        }
+        const value = this.acc & ((1 << width) - 1);
+        this.acc >>>= width;
+        this.bits -= width;
+        return value;
+    }
+    /** Drops the padding bits of the current byte; returns the next byte position. */
+    align() {
+        this.acc = 0;
+        this.bits = 0;
+        return this.position;
+    }
+}
+
+// Typed arrays use the platform's byte order; the frames are little-endian
+const LITTLE_ENDIAN = new Uint8Array(new Uint16Array([1]).buffer)[0] === 1;
+
+// The decoders below write sample i of column c to out[c][(start + i) & mask]: into fresh arrays
+// (start 0, mask -1) or straight into the power-of-two ring buffers of streamWorker.js.
+
+/**
+ * Decodes a "pack12" payload: every value as 12 bits, sample-major.
+ */
+function decodePack12(bytes, sampleCount, out, start, mask) {
+    const reader = new BitReader(bytes, STREAM_HEADER_BYTES);
+    for (let i = 0; i < sampleCount; i++) {
+        const slot = (start + i) & mask;
+        for (let c = 0; c < out.length; c++) {
+            out[c][slot] = reader.read(12);
+        }
+    }
+}
+
+/**
+ * Decodes a "delta" payload: per column [first:u16][width:u8][zigzag deltas], byte-aligned.
+ */
+function decodeDelta(bytes, sampleCount, out, start, mask) {
+    if (sampleCount === 0) return;
+    let position = STREAM_HEADER_BYTES;
+    out.forEach(values => {
+        const first = start & mask;
+        values[first] = bytes[position] | (bytes[position + 1] << 8); // Int16Array sign-extends it
+        const width = bytes[position + 2];
+        position += 3;
+        let previous = values[first];
+        if (width === 0) {
+            for (let i = 1; i < sampleCount; i++) values[(start + i) & mask] = previous;
+            return;
+        }
+        const reader = new BitReader(bytes, position);
+        for (let i = 1; i < sampleCount; i++) {
+            const zigzag = reader.read(width);
+            previous += (zigzag >>> 1) ^ -(zigzag & 1);
+            values[(start + i) & mask] = previous;
+        }
+        position = reader.align();
+    });
+}
+
+/**
+ * Decodes raw samples. When every value has the same type, one typed-array view over the frame
+ * reads them directly (the header keeps the samples aligned); otherwise a DataView is used.
+ */
+function decodeRaw(buffer, stream, sampleCount, out, start, mask) {
+    const columnCount = out.length;
+    if (stream.uniformArrayType && LITTLE_ENDIAN) {
+        const words = new stream.uniformArrayType(buffer, STREAM_HEADER_BYTES, sampleCount * columnCount);
+        for (let c = 0; c < columnCount; c++) {
+            const values = out[c];
+            for (let i = 0, k = c; i < sampleCount; i++, k += columnCount) {
+                values[(start + i) & mask] = words[k];
+            }
+        }
+        return;
+    }
+    const view = new DataView(buffer);
+    const sampleBytes = stream.schema.sampleBytes;
+    stream.columns.forEach((column, c) => {
+        const values = out[c];
+        let position = STREAM_HEADER_BYTES + column.byteOffset;
+        for (let i = 0; i < sampleCount; i++, position += sampleBytes) {
+            values[(start + i) & mask] = view[column.getter](position, true);
+        }
+    });
+}
+
+/**
+ * Builds the stream table of a decoder from a "stream_schema" message.
+ * @param {object[]} streamList The "streams" array of the message.
+ * @returns {object} streamId -> { schema, columns, encoding, expectedSequence }
+ */
+function buildStreamTable(streamList) {
+    const streams = {};
+    streamList.forEach(schema => {
+        const columns = []; // One entry per scalar value in a sample
+        let offset = 0;
+        schema.channels.forEach(channel => {
+            const typeInfo = VALUE_TYPES[channel.type];
+            if (!typeInfo) {
+                console.warn(`Stream Decoder: Unknown type '${channel.type}' in stream '${schema.name}'.`);
+                return;
+            }
+            for (let j = 0; j < channel.count; j++) {
+                columns.push({
+                    name: channel.count > 1 ? `${channel.name}[${j}]` : channel.name,
+                    unit: channel.unit,
+                    scale: channel.scale,
+                    offset: channel.offset,
+                    byteOffset: offset,
+                    getter: typeInfo[1],
+                    ArrayType: typeInfo[2]
+                });
+                offset += typeInfo[0];
+            }
+        });
+        // Set when a sample is just a packed row of one type, so raw frames can be read through a typed view
+        const ArrayType = columns.length > 0 ? columns[0].ArrayType : null;
+        const uniform = ArrayType && columns.every(column => column.ArrayType === ArrayType) &&
+            schema.sampleBytes === columns.length * ArrayType.BYTES_PER_ELEMENT;
+        streams[schema.id] = {
+            schema, columns, encoding: schema.encoding || 'raw', expectedSequence: null,
+            uniformArrayType: uniform ? ArrayType : null
+        };
+    });
+    return streams;
+}
+
+/**
+ * Checks whether a binary message is a stream frame.
+ * @param {ArrayBuffer} buffer The received binary message.
+ * @returns {boolean}
+ */
+function isStreamFrame(buffer) {
+    return buffer.byteLength >= STREAM_HEADER_BYTES && new Uint8Array(buffer, 0, 1)[0] === STREAM_FRAME_TYPE;
+}
+
+/**
+ * Decodes one stream frame into caller-provided arrays: sample i of column c goes to
+ * out[c][(start + i) & mask]. The arrays must hold the column's values (see column.ArrayType).
+ * @param {object} streams Stream table of the decoder (see buildStreamTable).
+ * @param {ArrayBuffer} buffer The received frame.
+ * @returns {object|null} { streamId, stream, sequence, lostFrames, sampleCount, baseTimeUs }, or null if
+ *          the stream's schema is unknown or the frame is malformed (out may then be partly written).
+ */
+function decodeStreamFrameInto(streams, buffer, out, start, mask) {
+    const view = new DataView(buffer);
+    const streamId = view.getUint8(1);
+    const stream = streams[streamId];
+    if (!stream) return null; // Schema not received yet
+
+    const sampleCount = view.getUint16(2, true);
+    const sequence = view.getUint32(4, true);
+    const baseTimeUs = Number(view.getBigUint64(8, true));
+    if (stream.encoding === 'raw' && STREAM_HEADER_BYTES + sampleCount * stream.schema.sampleBytes > buffer.byteLength) {
+        console.warn(`Stream Decoder: Frame of stream ${streamId} is shorter than its ${sampleCount} samples.`);
+        return null;
+    }
+
+    // Sequence numbers restart with the stream; anything below the expected value is a restart
+    let lostFrames = 0;
+    if (stream.expectedSequence !== null && sequence > stream.expectedSequence) {
+        lostFrames = sequence - stream.expectedSequence;
+    }
+    stream.expectedSequence = sequence + 1;
+
+    try {
+        if (stream.encoding === 'pack12') {
+            decodePack12(new Uint8Array(buffer), sampleCount, out, start, mask);
+        } else if (stream.encoding === 'delta') {
+            decodeDelta(new Uint8Array(buffer), sampleCount, out, start, mask);
+        } else {
+            decodeRaw(buffer, stream, sampleCount, out, start, mask);
+        }
+    } catch (e) {
+        console.warn(`Stream Decoder: Malformed '${stream.encoding}' frame of stream ${streamId}.`, e);
+        return null;
+    }
+    return { streamId, stream, sequence, lostFrames, sampleCount, baseTimeUs };
+}
+
+/**
+ * Decodes one stream frame into per-channel raw value arrays.
+ * @param {object} streams Stream table of the decoder (see buildStreamTable).
+ * @param {ArrayBuffer} buffer The received frame.
+ * @returns {object|null} { streamId, name, sequence, lostFrames, sampleCount, baseTimeUs, periodUs, channels }
+ *          where channels is [{ name, unit, scale, offset, values }], or null if the stream's schema is
+ *          unknown or the frame is malformed.
+ */
+function decodeStreamFrame(streams, buffer) {
+    const stream = buffer.byteLength >= 2 ? streams[new Uint8Array(buffer, 1, 1)[0]] : null;
+    if (!stream) return null;
+    const sampleCount = new DataView(buffer).getUint16(2, true);
+    const arrays = stream.columns.map(column => new column.ArrayType(sampleCount));
+    const header = decodeStreamFrameInto(streams, buffer, arrays, 0, -1);
+    if (!header) return null;
+    const channels = stream.columns.map((column, c) => (
+        { name: column.name, unit: column.unit, scale: column.scale, offset: column.offset, values: arrays[c] }
+    ));
+
+    return {
+        streamId: header.streamId,
+        name: stream.schema.name,
+        sequence: header.sequence,
+        lostFrames: header.lostFrames,
+        sampleCount,
+        baseTimeUs: header.baseTimeUs,
+        periodUs: stream.schema.periodUs,
+        channels
+    };
+}
+
+/**
+ * Creates an independent decoder. Stream ids and sequence numbers are per device, so a page talking
+ * to several nodes needs one decoder per connection.
+ * @returns {object} { setStreamSchema(streamList), isStreamFrame(buffer), decodeStreamFrame(buffer) }
+ */
+function createStreamDecoder() {
+    let streams = {}; // streamId -> { schema, columns, encoding, expectedSequence }
+    return {
+        /** Installs the stream layouts from a "stream_schema" message. Resets sequence tracking. */
+        setStreamSchema: (streamList) => { streams = buildStreamTable(streamList); },
+        isStreamFrame,
+        decodeStreamFrame: (buffer) => decodeStreamFrame(streams, buffer)
+    };
+}
+
+// The default decoder serves code on the page's thread; the page's own connection is decoded off it
+// by streamWorker.js (see streamClient.js), which builds its rings on buildStreamTable/decodeStreamFrameInto
+export default {
+    ...createStreamDecoder(),
+    createStreamDecoder,
+    buildStreamTable,
+    decodeStreamFrameInto
+};
@@ -0,0 +1,145 @@
+// js/streamPlot.js
+
+/**
+ * Real-time plot of one stream, drawn on a canvas at the display's frame rate (requestAnimationFrame),
+ * independently of how often frames arrive. Each animation frame asks the decoding worker for the
+ * min/max envelope of the visible span with one bucket per pixel column (streamClient.requestEnvelope),
+ * so drawing costs the same at 100 Hz as at full rate, and nothing is drawn while no new sample came in.
+ * Each channel gets its own lane, autoscaled to what is visible. When drawing takes more than
+ * FRAME_BUDGET_MS the buckets are widened (2, then 4 pixels) until it fits again.
+ */
+
+import streamClient from './streamClient.js';
+
+const FRAME_BUDGET_MS = 6;          // Drawing time allowed per animation frame
+const MAX_PIXELS_PER_BUCKET = 4;
+const LANE_COLORS = ['#1e88e5', '#e53935', '#43a047', '#fb8c00', '#8e24aa', '#00897b', '#6d4c41', '#546e7a'];
+
+let canvas = null;
+let context = null;
+let streamId = null;
+let periodUs = 0;
+let spanSeconds = 5;
+let pixelsPerBucket = 1;
+let requestPending = false;  // One envelope request in flight at a time
+let drawnTotal = -1;         // Sample total of the last drawn envelope (-1: redraw)
+
+/**
+ * Matches the canvas' backing store to its displayed size. Returns true if it changed.
+ */
+function resizeCanvasInternal() {
+    const ratio = window.devicePixelRatio || 1;
+    const width = Math.max(1, Math.round(canvas.clientWidth * ratio));
+    const height = Math.max(1, Math.round(canvas.clientHeight * ratio));
+    if (canvas.width === width && canvas.height === height) return false;
+    canvas.width = width;
+    canvas.height = height;
+    return true;
+}
+
+function formatValue(value) {
+    if (!Number.isFinite(value)) return '-';
+    const magnitude = Math.abs(value);
+    return magnitude >= 1000 || magnitude === 0 ? value.toFixed(0) : value.toPrecision(4);
+}
+
+/**
+ * Draws an envelope: the span's last 'count' samples end at the right edge, one zigzag path per lane.
+ */
+function drawEnvelopeInternal(envelope, spanSamples) {
+    const { width, height } = canvas;
+    const ratio = window.devicePixelRatio || 1;
+    context.clearRect(0, 0, width, height);
+    const channels = envelope.channels;
+    if (channels.length === 0 || envelope.count === 0) return;
+
+    const laneHeight = height / channels.length;
+    const buckets = channels[0].min.length;
+    const plotWidth = width * Math.min(1, envelope.count / spanSamples);
+    const bucketWidth = plotWidth / buckets;
+    const left = width - plotWidth;
+    context.lineWidth = Math.max(1, ratio);
+    context.font = `${Math.round(11 * ratio)}px monospace`;
+    context.textBaseline = 'top';
+
+    channels.forEach((channel, c) => {
+        const top = c * laneHeight;
+        let low = Infinity;
+        let high = -Infinity;
+        for (let b = 0; b < buckets; b++) {
+            if (channel.min[b] < low) low = channel.min[b];
+            if (channel.max[b] > high) high = channel.max[b];
+        }
+        const pad = high > low ? (high - low) * 0.05 : Math.abs(high) * 0.05 + 1;
+        low -= pad;
+        high += pad;
+        const yScale = laneHeight / (high - low);
+        const y = (value) => top + (high - value) * yScale;
+
+        const color = LANE_COLORS[c % LANE_COLORS.length];
+        context.strokeStyle = color;
+        context.beginPath();
+        for (let b = 0; b < buckets; b++) {
+            const x = left + (b + 0.5) * bucketWidth;
+            context.lineTo(x, y(channel.max[b]));
+            context.lineTo(x, y(channel.min[b]));
+        }
+        context.stroke();
+
+        context.fillStyle = color;
+        context.fillText(`${channel.name} ${formatValue(channel.last)} ${channel.unit || ''}`, 4 * ratio, top + 3 * ratio);
+        if (c > 0) {
+            context.fillStyle = 'rgba(0, 0, 0, 0.12)';
+            context.fillRect(0, Math.round(top), width, 1);
+        }
+    });
+}
+
+function onAnimationFrame() {
+    requestAnimationFrame(onAnimationFrame);
+    if (requestPending || streamId === null || periodUs <= 0 || !canvas.clientWidth) return;
+    if (resizeCanvasInternal()) drawnTotal = -1;
+    const spanSamples = Math.ceil(spanSeconds * 1e6 / periodUs);
+    const buckets = Math.max(1, Math.floor(canvas.width / pixelsPerBucket));
+    const requestedStream = streamId;
+    requestPending = true;
+    streamClient.requestEnvelope(requestedStream, spanSamples, buckets, drawnTotal).then(envelope => {
+        requestPending = false;
+        if (!envelope || !envelope.channels || requestedStream !== streamId) return; // Unknown or unchanged
+        const started = performance.now();
+        drawEnvelopeInternal(envelope, spanSamples);
+        drawnTotal = envelope.total;
+        const elapsed = performance.now() - started;
+        if (elapsed > FRAME_BUDGET_MS && pixelsPerBucket < MAX_PIXELS_PER_BUCKET) {
+            pixelsPerBucket *= 2;
+        } else if (elapsed < FRAME_BUDGET_MS / 4 && pixelsPerBucket > 1) {
+            pixelsPerBucket /= 2;
+        }
+    });
+}
+
+export default {
+    /** Starts drawing on the canvas (once; call before selecting a stream). */
+    init: (canvasElement) => {
+        if (canvas || !canvasElement) return;
+        canvas = canvasElement;
+        context = canvas.getContext('2d');
+        requestAnimationFrame(onAnimationFrame);
+    },
+
+    /**
+     * Selects the stream to plot (an entry of the "stream_schema" message), or clears the plot (null).
+     */
+    setStream: (schema) => {
+        streamId = schema ? schema.id : null;
+        periodUs = schema ? schema.periodUs : 0;
+        drawnTotal = -1;
+        if (!schema && context) context.clearRect(0, 0, canvas.width, canvas.height);
+    },
+
+    /** Sets the visible time span (at most the worker's 10 s of history). */
+    setSpanSeconds: (seconds) => {
+        spanSeconds = seconds;
+        drawnTotal = -1;
+    }
+};
@@ -0,0 +1,216 @@
+// js/streamWorker.js
+
+/**
+ * Decodes the page's stream frames off the main thread. Each frame arrives as a transferred
+ * ArrayBuffer and is decoded straight into the stream's preallocated typed-array ring (one array of
+ * the channel's own type per column, a power of two long), so decoding allocates nothing per frame.
+ * The UI thread only receives what it renders: a summary of the frames received (at most every
+ * SUMMARY_INTERVAL_MS) and the windows of recent samples it asks for.
+ *
+ * Runs as a module Worker created by streamClient.js, which also uses createStreamStore() directly
+ * when the browser cannot run module workers.
+ *   in:  { type: 'schema', streams }             "streams" of a stream_schema message
+ *        { type: 'frame', buffer }               a binary stream frame (transferred)
+ *        { type: 'window', id, streamId, samples }
+ *        { type: 'envelope', id, streamId, samples, buckets, sinceTotal }
+ *   out: { type: 'frames', summary }             see createStreamStore().onSummary
+ *        { type: 'window', id, window }          window channels transferred; window null if unknown
+ *        { type: 'envelope', id, envelope }      envelope channels transferred; envelope null if unknown
+ */
+
+import streamDecoder from './streamDecoder.js';
+
+const RING_SECONDS = 10;            // History kept per stream
+const MIN_RING_SAMPLES = 1024;
+const MAX_RING_SAMPLES = 1 << 20;
+const SUMMARY_INTERVAL_MS = 100;
+
+/**
+ * Smallest power of two holding RING_SECONDS of the stream (within the bounds above).
+ */
+function ringCapacity(periodUs) {
+    const wanted = periodUs > 0 ? Math.ceil(RING_SECONDS * 1e6 / periodUs) : MIN_RING_SAMPLES;
+    let capacity = MIN_RING_SAMPLES;
+    while (capacity < wanted && capacity < MAX_RING_SAMPLES) capacity <<= 1;
+    return capacity;
+}
+
+/**
+ * The recent samples of one stream. Sample n (counted since the schema arrived) of column c is
+ * columns[c][n & mask]; 'total' samples were written, the last one taken at lastTimeUs.
+ */
+class SampleRing {
+    constructor(stream) {
+        this.capacity = ringCapacity(stream.schema.periodUs);
+        this.mask = this.capacity - 1;
+        this.columns = stream.columns.map(column => new column.ArrayType(this.capacity));
+        this.total = 0;
+        this.lastTimeUs = 0;
+    }
+
+    /** Scaled values of sample n (still in the ring). */
+    sampleAt(stream, n) {
+        const slot = n & this.mask;
+        return stream.columns.map((column, c) => this.columns[c][slot] * column.scale + column.offset);
+    }
+}
+
+/**
+ * Creates the decoder state: stream table, rings and the batched frame summary.
+ * @returns {object} { setStreamSchema, pushFrame, readWindow, readEnvelope, onSummary }
+ */
+function createStreamStore() {
+    let streams = {};       // streamId -> decoder table entry (streamDecoder.buildStreamTable)
+    let rings = {};         // streamId -> SampleRing
+    let summaryHandler = () => {};
+    let summary = null;     // Frames since the last summary
+    let summaryTimer = null;
+
+    const flushSummary = () => {
+        summaryTimer = null;
+        if (summary) summaryHandler(summary);
+        summary = null;
+    };
+
+    return {
+        /** Installs the stream layouts and allocates their rings. Resets the history. */
+        setStreamSchema(streamList) {
+            streams = streamDecoder.buildStreamTable(streamList);
+            rings = {};
+            Object.keys(streams).forEach(id => { rings[id] = new SampleRing(streams[id]); });
+        },
+
+        /** Decodes a frame into its stream's ring. Returns false if it is not a decodable stream frame. */
+        pushFrame(buffer) {
+            if (!streamDecoder.isStreamFrame(buffer)) return false;
+            const ring = rings[new Uint8Array(buffer, 1, 1)[0]];
+            if (!ring) return false; // Schema not received yet
+            const header = streamDecoder.decodeStreamFrameInto(streams, buffer, ring.columns, ring.total, ring.mask);
+            if (!header) return false;
+            const { stream, sampleCount } = header;
+            const first = ring.total;
+            ring.total += sampleCount;
+            ring.lastTimeUs = header.baseTimeUs + Math.max(sampleCount - 1, 0) * stream.schema.periodUs;
+
+            if (!summary) summary = { frames: 0, lostFrames: 0, latest: null };
+            summary.frames++;
+            summary.lostFrames += header.lostFrames;
+            summary.latest = { // The most recent frame, for the UI's log
+                streamId: header.streamId,
+                name: stream.schema.name,
+                sequence: header.sequence,
+                sampleCount,
+                baseTimeUs: header.baseTimeUs,
+                periodUs: stream.schema.periodUs,
+                first: sampleCount > 0 ? ring.sampleAt(stream, first) : [],
+                last: sampleCount > 0 ? ring.sampleAt(stream, ring.total - 1) : []
+            };
+            if (!summaryTimer) summaryTimer = setTimeout(flushSummary, SUMMARY_INTERVAL_MS);
+            return true;
+        },
+
+        /**
+         * Copies the last 'samples' samples of a stream (fewer if the ring holds fewer), scaled.
+         * @returns {object|null} { streamId, name, periodUs, endTimeUs, total, channels: [{ name, unit, values }] }
+         *          where values is a Float32Array (oldest first), or null if the stream is unknown.
+         */
+        readWindow(streamId, samples) {
+            const stream = streams[streamId];
+            const ring = rings[streamId];
+            if (!stream || !ring) return null;
+            const count = Math.max(0, Math.min(samples, ring.total, ring.capacity));
+            const start = ring.total - count;
+            const channels = stream.columns.map((column, c) => {
+                const source = ring.columns[c];
+                const values = new Float32Array(count);
+                for (let i = 0; i < count; i++) {
+                    values[i] = source[(start + i) & ring.mask] * column.scale + column.offset;
+                }
+                return { name: column.name, unit: column.unit, values };
+            });
+            return {
+                streamId, name: stream.schema.name, periodUs: stream.schema.periodUs,
+                endTimeUs: ring.lastTimeUs, total: ring.total, channels
+            };
+        },
+
+        /**
+         * Min/max envelope of the last 'samples' samples, in 'buckets' equal slices (fewer buckets if
+         * fewer samples are held: then each bucket is one sample). This is what a plot draws per pixel
+         * column, so its cost does not depend on the sample rate on the UI side.
+         * @param {number} sinceTotal Sample total of the caller's last envelope: if no sample came in since,
+         *        only { streamId, total, channels: null } is returned. -1 always computes the envelope.
+         * @returns {object|null} { streamId, name, periodUs, endTimeUs, total, count,
+         *          channels: [{ name, unit, min, max, last }] } where min/max are scaled Float32Arrays
+         *          (oldest first), or null if the stream is unknown.
+         */
+        readEnvelope(streamId, samples, buckets, sinceTotal = -1) {
+            const stream = streams[streamId];
+            const ring = rings[streamId];
+            if (!stream || !ring) return null;
+            if (ring.total === sinceTotal) return { streamId, total: ring.total, channels: null };
+            const count = Math.max(0, Math.min(samples, ring.total, ring.capacity));
+            const bucketCount = Math.max(0, Math.min(buckets, count));
+            const start = ring.total - count;
+            const channels = stream.columns.map((column, c) => {
+                const source = ring.columns[c];
+                const min = new Float32Array(bucketCount);
+                const max = new Float32Array(bucketCount);
+                let from = start;
+                for (let b = 0; b < bucketCount; b++) {
+                    const to = start + Math.floor((b + 1) * count / bucketCount);
+                    let low = source[from & ring.mask];
+                    let high = low;
+                    for (let n = from + 1; n < to; n++) {
+                        const value = source[n & ring.mask];
+                        if (value < low) low = value;
+                        else if (value > high) high = value;
+                    }
+                    // Scaling is linear, so it maps the raw extremes (swapped for a negative scale)
+                    const a = low * column.scale + column.offset;
+                    const z = high * column.scale + column.offset;
+                    min[b] = a < z ? a : z;
+                    max[b] = a < z ? z : a;
+                    from = to;
+                }
+                const last = count > 0 ? source[(ring.total - 1) & ring.mask] * column.scale + column.offset : NaN;
+                return { name: column.name, unit: column.unit, min, max, last };
+            });
+            return {
+                streamId, name: stream.schema.name, periodUs: stream.schema.periodUs,
+                endTimeUs: ring.lastTimeUs, total: ring.total, count, channels
+            };
+        },
+
+        /**
+         * Sets the summary handler: ({ frames, lostFrames, latest }) with latest =
+         * { streamId, name, sequence, sampleCount, baseTimeUs, periodUs, first: [...], last: [...] }.
+         */
+        onSummary(handler) { summaryHandler = handler; }
+    };
+}
+
+// --- Worker Entry Point ---
+
+if (typeof WorkerGlobalScope !== 'undefined' && self instanceof WorkerGlobalScope) {
+    const store = createStreamStore();
+    store.onSummary(summary => self.postMessage({ type: 'frames', summary }));
+    self.onmessage = (event) => {
+        const message = event.data;
+        if (message.type === 'frame') {
+            store.pushFrame(message.buffer);
+        } else if (message.type === 'schema') {
+            store.setStreamSchema(message.streams);
+        } else if (message.type === 'window') {
+            const window = store.readWindow(message.streamId, message.samples);
+            const transfer = window ? window.channels.map(channel => channel.values.buffer) : [];
+            self.postMessage({ type: 'window', id: message.id, window }, transfer);
+        } else if (message.type === 'envelope') {
+            const envelope = store.readEnvelope(message.streamId, message.samples, message.buckets, message.sinceTotal);
+            const transfer = envelope && envelope.channels ? envelope.channels.flatMap(channel => [channel.min.buffer, channel.max.buffer]) : [];
+            self.postMessage({ type: 'envelope', id: message.id, envelope }, transfer);
+        }
+    };
+}
+
+export { createStreamStore };
@@ -6,9 +6,17 @@ const connectionStatusEl = document.getElementById('connectionStatus');
 const variablesTableBodyEl = document.getElementById('variablesTableBody');
 const startStreamBtnEl = document.getElementById('startStreamButton');
 const stopStreamBtnEl = document.getElementById('stopStreamButton');
+const streamViewSelectEl = document.getElementById('streamViewSelect');
 const streamStatusDisplayEl = document.getElementById('streamStatusDisplay');
 const binaryDataLogAreaEl = document.getElementById('binaryDataLogArea');
+const streamPlotCanvasEl = document.getElementById('streamPlotCanvas');
+const plotSpanSelectEl = document.getElementById('plotSpanSelect');
 const loadVarsConfigBtnEl = document.getElementById('loadVarsConfigButton');
+const nodeHostsInputEl = document.getElementById('nodeHostsInput');
+const connectNodesBtnEl = document.getElementById('connectNodesButton');
+const disconnectNodesBtnEl = document.getElementById('disconnectNodesButton');
+const nodesTableBodyEl = document.getElementById('nodesTableBody');
+const mergedDataLogAreaEl = document.getElementById('mergedDataLogArea');
 
 /**
  * Updates the connection status display element.
@@ -33,7 +41,7 @@ function updateConnectionStatus(text, color = 'grey') {
 /**
  * Renders the table of configurable variables.
  * @param {object} currentValuesData - Object postaci { varName: value }
- * @param {object} configurationData - Object postaci { varName: {type, min, max, hasLimits} }
+ * @param {object} configurationData - Object postaci { varName: {type, count, min, max, hasLimits} }
  * @param {function} getRequestHandler - Function to call when 'Get' is clicked (sends WS request).
  * @param {function} setRequestHandler - Function to call when 'Set' is clicked (sends WS request).
  */
@@ -60,20 +68,22 @@ function renderVariablesTable(currentValuesData, configurationData, getRequestHa
         
         const valueCell = row.insertCell(); 
         valueCell.setAttribute('data-label', 'Value: ');
-        valueCell.textContent = (espVarType === 'STRING') ? `"${varValue}"` : varValue; 
+        const isArray = Array.isArray(varValue);
+        valueCell.textContent = (espVarType === 'STRING') ? `"${varValue}"` : (isArray ? `[${varValue.join(', ')}]` : varValue); 
         valueCell.style.wordBreak = 'break-all';
         
         const typeCell = row.insertCell();
         typeCell.setAttribute('data-label', 'Type: ');
-        typeCell.textContent = espVarType; 
+        typeCell.textContent = varConfig.count ? `${espVarType}[${varConfig.count}]` : espVarType; 
 
         const actionsCell = row.insertCell();
         actionsCell.setAttribute('data-label', 'Actions: ');
         actionsCell.classList.add('variable-actions'); 
 
         const input = document.createElement('input');
-        if (espVarType === "INT" || espVarType === "FLOAT") {
+        if (!varConfig.count && (espVarType === "INT" || espVarType === "UINT" || espVarType === "FLOAT")) {
             input.type = 'number';
+            if (espVarType === "UINT") input.min = 0;
             if (espVarType === "FLOAT") input.step = 'any'; 
             if (varConfig.hasLimits) { 
                 if (varConfig.min !== undefined) input.min = varConfig.min;
@@ -83,8 +93,8 @@ function renderVariablesTable(currentValuesData, configurationData, getRequestHa
             input.type = 'text';
         }
         input.id = `input-${varName}`; 
-        input.placeholder = `New value`; 
-        input.value = varValue; 
+        input.placeholder = varConfig.count ? `${varConfig.count} values, comma-separated` : `New value`; 
+        input.value = isArray ? varValue.join(', ') : varValue; 
 
         const buttonWrapper = document.createElement('div');
         buttonWrapper.classList.add('action-buttons');
@@ -124,6 +134,7 @@ function updateStreamControlUI(isStreaming, isConnected, chunkCounter) {
     
     startStreamBtnEl.disabled = isStreaming || !isConnected;
     stopStreamBtnEl.disabled = !isStreaming || !isConnected;
+    if (streamViewSelectEl) streamViewSelectEl.disabled = isStreaming || !isConnected; // The view is chosen at start
     
     startStreamBtnEl.setAttribute('aria-busy', isConnected && isStreaming ? 'true' : 'false'); 
     stopStreamBtnEl.setAttribute('aria-busy', isConnected && !isStreaming ? 'true' : 'false'); 
@@ -144,40 +155,60 @@ function logToBinaryArea(text) {
 }
 
 /**
- * Processes received binary data (ArrayBuffer) for display.
- * @param {ArrayBuffer} arrayBuffer Raw binary data.
+ * Logs the latest stream frame of a batch (its first and last sample, plus lost-chunk warnings).
+ * @param {object} frame "latest" of a streamClient frame summary (first/last hold scaled readings).
+ * @param {number} lostFrames Frames lost during the batch.
  * @param {number} currentChunkCounter The current global chunk counter.
  */
-function processAndLogBinaryData(arrayBuffer, currentChunkCounter) {
-    // Constants for Binary Data Processing (must match C++ struct)
-    const SENSOR_PACKET_BYTES = 16; 
-    const SENSORS_PER_PACKET = 6;   
-
-    if (arrayBuffer.byteLength === 0 || arrayBuffer.byteLength % SENSOR_PACKET_BYTES !== 0) {
-        console.error(`Binary Error: Buffer size (${arrayBuffer.byteLength}) invalid or not a multiple of ${SENSOR_PACKET_BYTES}.`);
-        logToBinaryArea(`[Error: Invalid binary buffer received! Size: ${arrayBuffer.byteLength}]\n`);
-        return;
+function logStreamFrame(frame, lostFrames, currentChunkCounter) {
+    if (!frame) return;
+    let chunkLogContent = "";
+    if (lostFrames > 0) {
+        chunkLogContent += ` [${frame.name}] ${lostFrames} chunk(s) lost before #${frame.sequence}\n`;
     }
-    const numPacketsInChunk = arrayBuffer.byteLength / SENSOR_PACKET_BYTES;
-    const dataView = new DataView(arrayBuffer);
-    let chunkLogContent = ""; 
-
-    for (let i = 0; i < numPacketsInChunk; i++) {
-        const offset = i * SENSOR_PACKET_BYTES; 
-        const sensorReadings = []; 
-        for(let s = 0; s < SENSORS_PER_PACKET; s++) {
-            sensorReadings.push(dataView.getUint16(offset + (s * 2), true)); 
-        }
-        const timeMs = dataView.getUint32(offset + (SENSORS_PER_PACKET * 2), true); 
-
-        if (i === 0 || i === numPacketsInChunk - 1) { 
-           chunkLogContent += ` C${currentChunkCounter} P${i}: [${sensorReadings.join(', ')}] @ ${timeMs}ms\n`;
-        } else if (i === 1 && numPacketsInChunk > 2) { 
-            chunkLogContent += ` C${currentChunkCounter} P${i}: ... (${numPacketsInChunk - 2} samples omitted) ...\n`;
-        }
-        // TODO: Add actual data processing here (e.g., plotting to a chart)
+    const describeSample = (readings, i) => {
+        const timeMs = (frame.baseTimeUs + i * frame.periodUs) / 1000;
+        return ` C${currentChunkCounter} ${frame.name}#${frame.sequence} P${i}: [${readings.join(', ')}] @ ${timeMs.toFixed(2)}ms\n`;
+    };
+    if (frame.sampleCount > 0) {
+        chunkLogContent += describeSample(frame.first, 0);
+    }
+    if (frame.sampleCount > 2) {
+        chunkLogContent += ` C${currentChunkCounter} ${frame.name}#${frame.sequence} ... (${frame.sampleCount - 2} samples omitted) ...\n`;
     }
-    logToBinaryArea(chunkLogContent); 
+    if (frame.sampleCount > 1) {
+        chunkLogContent += describeSample(frame.last, frame.sampleCount - 1);
+    }
+    // The samples themselves are drawn by streamPlot.js
+    logToBinaryArea(chunkLogContent);
+}
+
+/**
+ * Renders the node table of the aggregator and the state of its buttons.
+ * @param {object[]} stats Entries returned by nodeAggregator.getNodeStats().
+ */
+function renderNodesTable(stats) {
+    if (!nodesTableBodyEl) return;
+    nodesTableBodyEl.innerHTML = '';
+    stats.forEach(node => {
+        const row = nodesTableBodyEl.insertRow();
+        [node.host, node.state, node.frames, node.lostFrames].forEach(text => {
+            row.insertCell().textContent = text;
+        });
+    });
+    if (disconnectNodesBtnEl) disconnectNodesBtnEl.disabled = stats.length === 0;
+}
+
+/**
+ * Logs a frame released by the aggregator, on the merged timeline (seconds of page time).
+ * @param {object} item { host, frame, startMs } from nodeAggregator.
+ */
+function logMergedFrame(item) {
+    if (!mergedDataLogAreaEl) return;
+    const { host, frame, startMs } = item;
+    const first = frame.channels.map(channel => channel.values[0] * channel.scale + channel.offset);
+    const line = ` t=${(startMs / 1000).toFixed(3)}s ${host} ${frame.name}#${frame.sequence} (${frame.sampleCount} samples): [${first.join(', ')}]\n`;
+    mergedDataLogAreaEl.textContent = line + mergedDataLogAreaEl.textContent.substring(0, 4000);
 }
 
 /**
@@ -198,9 +229,17 @@ export {
     renderVariablesTable,
     updateStreamControlUI,
     logToBinaryArea,
-    processAndLogBinaryData,
+    logStreamFrame,
+    renderNodesTable,
+    logMergedFrame,
     handleServerStatusMessageForUI,
     loadVarsConfigBtnEl, // Exporting for main.js to enable/disable
     startStreamBtnEl,    // Exporting for main.js to enable/disable
-    stopStreamBtnEl      // Exporting for main.js to enable/disable
+    stopStreamBtnEl,     // Exporting for main.js to enable/disable
+    streamViewSelectEl,  // Exporting for main.js to read the selected stream view
+    streamPlotCanvasEl,  // Exporting for main.js to attach the stream plot
+    plotSpanSelectEl,    // Exporting for main.js to read the plot's time span
+    nodeHostsInputEl,    // Exporting for main.js to read the aggregator's node list
+    connectNodesBtnEl,
+    disconnectNodesBtnEl
 };
\ No newline at end of file
@@ -4,10 +4,31 @@
  * Manages the WebSocket connection, message sending, and routing received messages.
  */
 
-const ESP32_STATIC_IP = "192.168.5.1"; // Should match ESP32's static IP
-const WEBSOCKET_URL = `ws://${ESP32_STATIC_IP}/ws`;
+const ESP32_STATIC_IP = "192.168.5.1"; // Should match ESP32's static IP (used when the page is opened from disk)
+// Served by the ESP32 itself (AP address, station address or <hostname>.local): talk to that same host
+const ESP32_HOST = (location.protocol === 'http:' && location.host) ? location.host : ESP32_STATIC_IP;
+const WEBSOCKET_URL = `ws://${ESP32_HOST}/ws`;
+const SCHEMA_URL = `http://${ESP32_HOST}/schema.json`; // Same document as "get_schema", ETag-cached
+
+// Binary command protocol (must match "Binary Command Protocol" in ESP32WebSocket.h)
+const BIN_CMD_GET = 0x01;
+const BIN_CMD_SET = 0x02;
+const BIN_CMD_UPLOAD = 0x03;
+const BIN_REPLY_MAGIC = 0xC5;
+const BIN_REPLY_FLAG = 0x80;
+const BIN_TYPE = { INT: 0x01, FLOAT: 0x02, STRING: 0x03, UINT: 0x04 };
+const BIN_STATUS_TEXT = ["ok", "unknown variable", "type mismatch", "out of limits", "malformed", "unknown opcode", "rejected"];
 
 let ws; // The WebSocket instance
+let binaryCommandTag = 0; // Incremented per binary command, echoed back in the reply
+let variableSchema = null; // "variables" array of the last var_schema (names, types, limits by index)
+
+// Coalesced sets (see queueSet): latest value per variable, sent as one batch per flush
+const SET_FLUSH_MAX_BUFFERED = 1024; // Bytes still queued on the socket above which a flush waits
+let pendingSets = new Map();         // varName -> value
+let setFlushIntervalMs = 0;          // Minimum time between batches (0: one batch per animation frame)
+let setFlushScheduled = false;
+let lastSetFlushMs = -Infinity;
 
 // Callback handlers to be set by other modules (e.g., main.js)
 let onOpenHandler = () => {};
@@ -15,8 +36,12 @@ let onCloseHandler = () => {};
 let onErrorHandler = () => {};
 let onConfigListHandler = () => {};    // For the "var_config_list" message
 let onVariableUpdateHandler = () => {}; // For individual variable updates
-let onBinaryDataHandler = () => {};     // For binary stream data
+let onVariablesUpdateHandler = () => {}; // For batched "var_values" updates
+let onBinaryDataHandler = () => {};     // For binary stream frames (see streamDecoder.js)
+let onStreamSchemaHandler = () => {};   // For the "stream_schema" message
 let onServerStatusHandler = () => {};   // For general status messages
+let onBinaryReplyHandler = () => {};    // For binary command replies
+let onClientStatsHandler = (message) => { console.log("WebSocket Service: Client stats:", message.clients); }; // For "client_stats"
 
 /**
  * Initializes and attempts to establish the WebSocket connection.
@@ -51,7 +76,11 @@ function connect() {
     ws.onmessage = (event) => {
         if (event.data instanceof ArrayBuffer) {
             // console.log("WebSocket Service: Binary data received.");
-            onBinaryDataHandler(event.data);
+            if (isBinaryCommandReply(event.data)) {
+                onBinaryReplyHandler(decodeBinaryCommandReply(event.data));
+            } else {
+                onBinaryDataHandler(event.data);
+            }
         } else if (typeof event.data === 'string') {
             // console.log("WebSocket Service: Text data received:", event.data);
             try {
@@ -73,6 +102,20 @@ function connect() {
 function routeIncomingMessage(message) {
     if (message.status === "var_config_list" && message.variables) {
         onConfigListHandler(message.variables);
+    } else if (message.status === "var_schema" && message.variables) {
+        variableSchema = message.variables;
+        sendPayload({ action: 'get_values' });
+    } else if (message.status === "var_snapshot" && message.values) {
+        if (variableSchema) {
+            // Same shape as var_config_list: schema entry + current value
+            onConfigListHandler(variableSchema.map(v => ({ ...v, value: message.values[v.index] })));
+        }
+    } else if (message.status === "stream_schema" && message.streams) {
+        onStreamSchemaHandler(message.streams);
+    } else if (message.status === "var_values" && message.values) {
+        onVariablesUpdateHandler(message.values, message.errors || {});
+    } else if (message.status === "client_stats" && message.clients) {
+        onClientStatsHandler(message);
     } else if (message.status) { // General server status/error message
         onServerStatusHandler(message);
     } else if (message.variable !== undefined && message.value !== undefined) { // Single variable update
@@ -88,9 +131,7 @@ function routeIncomingMessage(message) {
  */
 function sendPayload(payload) {
     if (ws && ws.readyState === WebSocket.OPEN) {
-        const jsonPayload = JSON.stringify(payload);
-        console.log("WebSocket Service: Sending payload:", jsonPayload);
-        ws.send(jsonPayload);
+        ws.send(JSON.stringify(payload)); // No logging here: this runs for every command sent
     } else {
         console.warn("WebSocket Service: Connection not open. Cannot send payload.", payload);
         // Optionally, trigger an error or UI update here
@@ -98,6 +139,225 @@ function sendPayload(payload) {
     }
 }
 
+/**
+ * Loads the variable configuration: the schema from /schema.json (the browser revalidates it
+ * with its ETag, so reloads usually get a 304) and the current values with "get_values".
+ * Falls back to "get_schema" over the WebSocket if the HTTP request fails.
+ * The merged result is delivered to the config list handler.
+ */
+function requestVariables() {
+    fetch(SCHEMA_URL, { cache: 'no-cache' })
+        .then(response => {
+            if (!response.ok) throw new Error(`HTTP ${response.status}`);
+            return response.json();
+        })
+        .then(schema => {
+            variableSchema = schema.variables;
+            sendPayload({ action: 'get_values' });
+        })
+        .catch(error => {
+            console.warn("WebSocket Service: Schema fetch failed, asking over WebSocket.", error);
+            sendPayload({ action: 'get_schema' });
+        });
+}
+
+/**
+ * Requests several variables in one message ("get_many"); the reply arrives as "var_values".
+ * @param {string[]} variableNames Names of the variables to get.
+ */
+function sendGetMany(variableNames) {
+    sendPayload({ action: 'get_many', variables: variableNames });
+}
+
+/**
+ * Sets several variables in one message ("set_many"); the reply arrives as "var_values".
+ * @param {object} values Object of the form { varName: value }.
+ */
+function sendSetMany(values) {
+    sendPayload({ action: 'set_many', values: values });
+}
+
+/**
+ * Queues a "set" for the next batch. Calls for the same variable before the batch is sent replace
+ * each other (the latest value wins), so an input that fires on every movement (e.g. a slider)
+ * sends at most one batch per animation frame, or per interval (see setCoalesceInterval), however
+ * fast it fires. A batch of one numeric variable whose index is known goes out as a binary set
+ * (reply via the binary reply handler), a single other one as "set", and several as one "set_many"
+ * (reply as "var_values"). While the socket still has SET_FLUSH_MAX_BUFFERED bytes queued, the
+ * batch keeps gathering instead. Sets still pending when the connection drops are discarded.
+ * @param {string} variableName Name of the variable.
+ * @param {number|string} value The value to set.
+ */
+function queueSet(variableName, value) {
+    pendingSets.set(variableName, value);
+    scheduleSetFlush();
+}
+
+/**
+ * Sets the minimum time between two batches of queued sets.
+ * @param {number} intervalMs Interval in milliseconds; 0 sends one batch per animation frame.
+ */
+function setCoalesceInterval(intervalMs) {
+    setFlushIntervalMs = Math.max(0, intervalMs);
+}
+
+function scheduleSetFlush() {
+    if (setFlushScheduled) return;
+    setFlushScheduled = true;
+    // Animation frames stop in background tabs, so a hidden page falls back to a timer
+    if (setFlushIntervalMs === 0 && typeof requestAnimationFrame === 'function' && !document.hidden) {
+        requestAnimationFrame(flushPendingSets);
+    } else {
+        setTimeout(flushPendingSets, Math.max(0, lastSetFlushMs + setFlushIntervalMs - performance.now()));
+    }
+}
+
+/**
+ * Sends the queued sets as one batch (see queueSet).
+ */
+function flushPendingSets() {
+    setFlushScheduled = false;
+    if (pendingSets.size === 0) return;
+    if (!isConnected()) {
+        console.warn(`WebSocket Service: Connection not open. Discarding ${pendingSets.size} pending set(s).`);
+        pendingSets.clear();
+        return;
+    }
+    if (ws.bufferedAmount > SET_FLUSH_MAX_BUFFERED) { // The link has not drained the last batch yet
+        scheduleSetFlush();
+        return;
+    }
+    lastSetFlushMs = performance.now();
+    const batch = pendingSets;
+    pendingSets = new Map();
+    if (batch.size > 1) {
+        sendSetMany(Object.fromEntries(batch));
+        return;
+    }
+    const [variableName, value] = batch.entries().next().value;
+    const entry = variableSchema ? variableSchema.find(v => v.name === variableName) : null;
+    // Scalars go as binary sets; strings and arrays (no binary encoding) as JSON
+    if (entry && entry.type !== "STRING" && !entry.count && (typeof value === 'number' || typeof value === 'boolean')) {
+        sendBinarySet(entry.index, entry.type, Number(value));
+    } else {
+        sendPayload({ action: 'set', variable: variableName, value: value });
+    }
+}
+
+/**
+ * Checks whether a binary frame is a command reply rather than stream data.
+ * @param {ArrayBuffer} buffer The received binary frame.
+ * @returns {boolean} True for a command reply.
+ */
+function isBinaryCommandReply(buffer) {
+    if (buffer.byteLength < 6) return false;
+    const bytes = new Uint8Array(buffer, 0, 2);
+    return bytes[0] === BIN_REPLY_MAGIC && (bytes[1] & BIN_REPLY_FLAG) !== 0;
+}
+
+/**
+ * Decodes a binary command reply.
+ * @param {ArrayBuffer} buffer The received reply frame.
+ * @returns {object} { opcode, tag, status, statusText, index, value }
+ */
+function decodeBinaryCommandReply(buffer) {
+    const view = new DataView(buffer);
+    const reply = {
+        opcode: view.getUint8(1) & ~BIN_REPLY_FLAG,
+        tag: view.getUint8(2),
+        status: view.getUint8(3),
+        index: view.getUint16(4, true),
+        value: undefined
+    };
+    reply.statusText = BIN_STATUS_TEXT[reply.status] || "unknown status";
+    if (reply.status === 0 && buffer.byteLength > 6) {
+        const type = view.getUint8(6);
+        if (type === BIN_TYPE.INT) reply.value = view.getInt32(7, true);
+        else if (type === BIN_TYPE.UINT) reply.value = view.getUint32(7, true);
+        else if (type === BIN_TYPE.FLOAT) reply.value = view.getFloat32(7, true);
+        else if (type === BIN_TYPE.STRING) reply.value = new TextDecoder().decode(new Uint8Array(buffer, 8, view.getUint8(7)));
+    }
+    return reply;
+}
+
+/**
+ * Sends a binary "get" command for the variable at the given index.
+ * @param {number} index Variable index (from the "index" field of var_config_list).
+ * @returns {number|null} The tag echoed in the reply, or null if not connected.
+ */
+function sendBinaryGet(index) {
+    const frame = new Uint8Array(4);
+    return sendBinaryCommand(frame, BIN_CMD_GET, index);
+}
+
+/**
+ * Sends a binary "set" command for the variable at the given index.
+ * @param {number} index Variable index (from the "index" field of var_config_list).
+ * @param {string} espVarType ESP32 type name ("INT", "UINT", "FLOAT", "BOOL" or "STRING"; not arrays).
+ * @param {number|string} value The value to set.
+ * @returns {number|null} The tag echoed in the reply, or null if not connected.
+ */
+function sendBinarySet(index, espVarType, value) {
+    let frame;
+    if (espVarType === "STRING") {
+        const text = new TextEncoder().encode(String(value)).subarray(0, 255);
+        frame = new Uint8Array(6 + text.length);
+        frame[4] = BIN_TYPE.STRING;
+        frame[5] = text.length;
+        frame.set(text, 6);
+    } else {
+        frame = new Uint8Array(9);
+        const view = new DataView(frame.buffer);
+        if (espVarType === "FLOAT") {
+            frame[4] = BIN_TYPE.FLOAT;
+            view.setFloat32(5, value, true);
+        } else if (espVarType === "UINT") {
+            frame[4] = BIN_TYPE.UINT;
+            view.setUint32(5, value, true);
+        } else { // INT, and BOOL as 0/1
+            frame[4] = BIN_TYPE.INT;
+            view.setInt32(5, value, true);
+        }
+    }
+    return sendBinaryCommand(frame, BIN_CMD_SET, index);
+}
+
+/**
+ * Sends a block of bytes (e.g. a lookup table) to the ESP32's upload callback ("UPLOAD" command).
+ * Up to ESP32WS_RX_ARENA_BYTES - 4 bytes (4 KB by default) are accepted in one message.
+ * @param uploadId Application-defined id of the data, passed to the callback.
+ * @param bytes The data (Uint8Array, or any ArrayBuffer view / ArrayBuffer).
+ * @returns {number|null} The tag echoed in the reply, or null if not connected.
+ */
+function sendBinaryUpload(uploadId, bytes) {
+    const data = bytes instanceof ArrayBuffer ? new Uint8Array(bytes) : new Uint8Array(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+    const frame = new Uint8Array(4 + data.length);
+    frame.set(data, 4);
+    return sendBinaryCommand(frame, BIN_CMD_UPLOAD, uploadId);
+}
+
+/**
+ * Fills in the command header and sends the frame.
+ * @param {Uint8Array} frame Frame with room for the 4-byte header.
+ * @param {number} opcode BIN_CMD_GET, BIN_CMD_SET or BIN_CMD_UPLOAD.
+ * @param {number} index Variable index.
+ * @returns {number|null} The tag, or null if not connected.
+ */
+function sendBinaryCommand(frame, opcode, index) {
+    if (!(ws && ws.readyState === WebSocket.OPEN)) {
+        console.warn("WebSocket Service: Connection not open. Cannot send binary command.");
+        return null;
+    }
+    const tag = binaryCommandTag;
+    binaryCommandTag = (binaryCommandTag + 1) & 0xFF;
+    frame[0] = opcode;
+    frame[1] = tag;
+    frame[2] = index & 0xFF;
+    frame[3] = (index >> 8) & 0xFF;
+    ws.send(frame);
+    return tag;
+}
+
 /**
  * Checks if the WebSocket connection is currently open.
  * @returns {boolean} True if connected, false otherwise.
@@ -110,12 +370,24 @@ function isConnected() {
 export default {
     connect,
     sendPayload,
+    requestVariables,
+    sendGetMany,
+    sendSetMany,
+    queueSet,
+    setCoalesceInterval,
+    sendBinaryGet,
+    sendBinarySet,
+    sendBinaryUpload,
     isConnected,
     setOnOpen: (handler) => { onOpenHandler = handler; },
     setOnClose: (handler) => { onCloseHandler = handler; },
     setOnError: (handler) => { onErrorHandler = handler; },
     setOnConfigList: (handler) => { onConfigListHandler = handler; },
     setOnVariableUpdate: (handler) => { onVariableUpdateHandler = handler; },
+    setOnVariablesUpdate: (handler) => { onVariablesUpdateHandler = handler; },
     setOnBinaryData: (handler) => { onBinaryDataHandler = handler; },
-    setOnServerStatus: (handler) => { onServerStatusHandler = handler; }
+    setOnStreamSchema: (handler) => { onStreamSchemaHandler = handler; },
+    setOnServerStatus: (handler) => { onServerStatusHandler = handler; },
+    setOnClientStats: (handler) => { onClientStatsHandler = handler; },
+    setOnBinaryReply: (handler) => { onBinaryReplyHandler = handler; }
 };
\ No newline at end of file
@@ -4,14 +4,50 @@
  *        Handles WebSocket communication for ESP32 variable control and data streaming.
  */
 #include "ESP32WebSocket.h"
+#include "ESP32WebSocketStream.h"
+#include "ESP32WebSocketMetrics.h"
+#include "ESP32WebSocketLog.h"
+#include "ESP32WebSocketVarStore.h"
+#include "ESP32WebSocketPersist.h"
+#include "ESP32WebSocketNetwork.h"
+#include "ESP32WebSocketRecorder.h"
+#include "ESP32WebSocketCapture.h"
 #include <LittleFS.h> // FILESYSTEM to serve web page through html and js files
-
-// --- Debug Configuration ---
-// Uncomment the line below to enable verbose debug output from this library to the Serial monitor.
-#define DEBUG_ESP32_WEBSOCKET_LIB
+#include <new>        // std::nothrow for the frame and text buffer pools
+#include <esp_heap_caps.h> // Receive arenas in PSRAM when available
+#include <freertos/semphr.h> // Mutex guarding the shared reply document
 
 // --- Library-Internal Definitions ---
 
+// Capacity of the JSON document used to parse incoming commands (get_many/set_many need more than single get/set).
+#ifndef ESP32WS_JSON_COMMAND_CAPACITY
+#define ESP32WS_JSON_COMMAND_CAPACITY 1024
+#endif
+
+// Extra bytes reserved in the shared reply document and the large text buffer beyond what is
+// measured at init (error entries, longer status strings).
+#ifndef ESP32WS_JSON_STRING_RESERVE
+#define ESP32WS_JSON_STRING_RESERVE 512
+#endif
+
+// Cache-Control for a static asset requested through a versioned URL ("?v=<ETag>", written into
+// index.html by scripts/gzip_data.py) whose version matches the file served. Every other request,
+// including the page itself and the JS modules it imports, is sent "no-cache" and revalidated by ETag.
+#ifndef ESP32WS_VERSIONED_CACHE_CONTROL
+#define ESP32WS_VERSIONED_CACHE_CONTROL "public, max-age=31536000, immutable"
+#endif
+
+// Number of set_many entries committed as one snapshot; larger requests are committed in several groups.
+#ifndef ESP32WS_SET_MANY_BATCH
+#define ESP32WS_SET_MANY_BATCH 16
+#endif
+
+// Maximum number of distinct decimation pipelines (source stream, mode, factor) active at once.
+// Clients asking for the same reduction share one pipeline, so the work is done once per rate.
+#ifndef ESP32WS_MAX_PIPELINES
+#define ESP32WS_MAX_PIPELINES 4
+#endif
+
 /**
  * @struct StaticFileConfig
  * @brief Defines the configuration for a single static file to be served by the HTTP server.
@@ -38,6 +74,11 @@ static const StaticFileConfig libraryStaticFilesToServe[] = {
   { "/js/websocketService.js",          "application/javascript" },
   { "/js/uiUpdater.js",                 "application/javascript" },
   { "/js/appState.js",                  "application/javascript" },
+  { "/js/streamDecoder.js",             "application/javascript" },
+  { "/js/nodeAggregator.js",            "application/javascript" },
+  { "/js/streamWorker.js",              "application/javascript" },
+  { "/js/streamClient.js",              "application/javascript" },
+  { "/js/streamPlot.js",                "application/javascript" },
   
   // CSS files
   { "/css/pico.min.css",                "text/css" },                 // If serving Pico.css locally
@@ -55,6 +96,30 @@ static const StaticFileConfig libraryStaticFilesToServe[] = {
 // Calculate the number of static files to serve
 static const size_t numLibraryStaticFilesToServe = sizeof(libraryStaticFilesToServe) / sizeof(libraryStaticFilesToServe[0]);
 
+/**
+ * @struct StaticAssetState
+ * @brief What was found in LittleFS for one entry of libraryStaticFilesToServe, resolved once at init.
+ */
+struct StaticAssetState {
+  String fsPath;    ///< File actually served ("/js/main.js.gz" when the gzipped variant exists).
+  bool present;     ///< File exists in LittleFS.
+  bool gzipped;     ///< Served with "Content-Encoding: gzip" to clients that accept it.
+  bool plainPresent; ///< The uncompressed file exists too (served to clients without gzip).
+  bool etagValid;   ///< etag has been computed (lazily, on the first request).
+  char etag[11];    ///< Quoted FNV-1a hash of the served bytes.
+};
+static StaticAssetState _staticAssets[numLibraryStaticFilesToServe];
+
+// LittleFS is mounted by a task on the other core while WiFi comes up; the static handler answers
+// 503 until the assets are resolved. Written once by that task, read by the AsyncTCP task.
+enum FilesystemState : uint8_t { FS_STATE_PENDING, FS_STATE_READY, FS_STATE_FAILED };
+static uint8_t _fsState = FS_STATE_PENDING; // Release store after _staticAssets is filled in
+
+// Format LittleFS when mounting fails (erases uploaded data on a transient error, so off by default).
+#ifndef ESP32WS_FS_FORMAT_ON_FAIL
+#define ESP32WS_FS_FORMAT_ON_FAIL 0
+#endif
+
 
 // --- Library-Internal Objects and State ---
 
@@ -63,15 +128,171 @@ static AsyncWebServer server(80);
 // Async WebSocket object handling connections on the "/ws" endpoint
 static AsyncWebSocket ws("/ws");   
 
-// Pointers to the application's variable array and its size (provided during init)
-static VariableConfig* _variables = nullptr; 
+// The application's variable table and its size (provided during init)
+static const WsVarDesc* _variables = nullptr; 
 static int _numVariables = 0;
 
+// Converted elements of the array values of one set or set_many, until they are committed.
+// Only touched on the AsyncTCP task; commitClientValuesInternal() empties it.
+static uint32_t _arrayStaging[ESP32WS_ARRAY_STAGING_BYTES / sizeof(uint32_t)];
+static size_t _arrayStagingUsed = 0;
+
+// Open-addressing hash index over the variable names (built once by initWiFiWebSocketServer()).
+// Each bucket holds a variable index, or VAR_INDEX_EMPTY. The table has a power-of-two size of
+// at least twice the number of variables, so probe sequences stay short.
+static const uint16_t VAR_INDEX_EMPTY = 0xFFFF;
+static uint16_t* _varIndexTable = nullptr;
+static uint32_t _varIndexMask = 0;
+
+// "Dirty set": one bit per variable marked by markVariableChanged(), drained by flushVariableUpdates().
+static uint32_t* _dirtyBits = nullptr;
+static portMUX_TYPE _dirtyMux = portMUX_INITIALIZER_UNLOCKED;
+// Copy of the dirty set being serialized by a flush; only used while the reply document is locked.
+static uint32_t* _dirtySnapshot = nullptr;
+
+// One bit per variable committed by the current set_many. Its change callbacks run once the reply
+// lock is released, so they may use the reply buffer themselves. Only touched on the AsyncTCP task.
+static uint32_t* _setManyChangedBits = nullptr;
+
 // Pointers to the application's stream control callback functions
 static StreamControlCallback _onStreamStartCallback = nullptr;
 static StreamControlCallback _onStreamStopCallback = nullptr;
-// Internal flag to track if data streaming is currently active
-static bool _isStreaming = false; 
+// Clients with an active subscription (ClientState::streamMask != 0). The start callback runs when the
+// first one subscribes and the stop callback when the last one leaves, by stop_stream or by disconnecting.
+static uint8_t _numSubscribers = 0;
+
+// Per-stream start/stop callbacks (setStreamCallbacks(streamId, ...)), driven by the number of
+// subscribers whose streamMask includes the stream. Indexed by stream id.
+struct StreamSubscription {
+  StreamControlCallback onStart;
+  StreamControlCallback onStop;
+  uint8_t subscribers;
+};
+static StreamSubscription _streamSubscriptions[ESP32WS_MAX_STREAMS];
+static bool _hasStreamCallbacks = false;
+// Guards the subscriber counts, which the replay task also updates when a lingering subscription expires
+static SemaphoreHandle_t _subscriptionMutex = nullptr;
+
+// Application function receiving BIN_CMD_UPLOAD payloads (setUploadCallback())
+static UploadCallback _uploadCallback = nullptr;
+static void* _uploadContext = nullptr;
+
+// With the recorder active, a subscriber that disconnects keeps its streams running (and counted as a
+// subscriber) for ESP32WS_RECORDER_LINGER_MS, so a client reconnecting within that time continues
+// the same frame sequence and can replay the gap. Released by the replay task.
+struct LingeringSubscription {
+  uint8_t streamMask;         ///< Streams held; 0 = free entry.
+  uint32_t untilMs;
+};
+static LingeringSubscription _lingering[ESP32WS_MAX_CLIENTS];
+
+// Replay task (created on the first replay_since or lingering subscription) and its frame buffer
+static TaskHandle_t _replayTask = nullptr;
+static uint8_t* _replayBuffer = nullptr;
+// Message buffers of each replay slot. A replay frame is copied into a free one and queued to a single
+// client (one reference, see _framePool), so the buffers with a non-zero count() are exactly the
+// replay's frames still queued: the replay paces itself on them, not on the library's queue depth.
+static BinaryFrame* _replayFrames[ESP32WS_RECORDER_MAX_REPLAYS][ESP32WS_RECORDER_REPLAY_QUEUE];
+
+// Pool of preallocated binary frames. Each frame is created directly (not through ws.makeBuffer())
+// so the WebSocket library never frees it; a frame is in flight while its reference count is
+// non-zero and free again once the count drops to 0. That count is a plain integer, incremented by
+// the task that queues the frame and decremented by the AsyncTCP task once the message is gone, so
+// a frame is queued to at most one client: its only increment happens while no message holds it
+// and can never overlap a decrement. Further clients get a copy in another pooled frame.
+static BinaryFrame* _framePool[ESP32WS_BINARY_FRAME_POOL_SIZE];
+static bool _frameAcquired[ESP32WS_BINARY_FRAME_POOL_SIZE];
+static uint32_t _frameOwner[ESP32WS_BINARY_FRAME_POOL_SIZE]; // Client the frame was last queued to
+static uint8_t _framePoolCount = 0;
+static size_t _frameSize = 0;
+static portMUX_TYPE _framePoolMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Pool of preallocated text buffers for JSON replies, in increasing size classes plus one
+// "large" buffer sized at init for the variable config list. Like the binary frames, they are
+// created directly so the WebSocket library only reference-counts them. A text message always
+// spans its whole buffer, so serialization pads the tail with spaces (valid trailing JSON whitespace);
+// the classes grow by about 1.5x to keep that padding small.
+// Their reference count is a plain integer that the AsyncTCP task decrements as messages complete, so
+// a buffer is only queued by reference from that task (_asyncTcpTask); replies and broadcasts from
+// any other task (loop(): flushVariableUpdates()) are serialized into a pooled buffer as scratch and
+// queued as an exact-length copy.
+struct TextBufferClass {
+  uint16_t size;
+  uint8_t count;
+};
+static const TextBufferClass TEXT_BUFFER_CLASSES[] = {
+  { 48, 4 }, { 64, 4 }, { 96, 4 }, { 128, 4 }, { 192, 3 }, { 256, 3 }, { 384, 2 }, { 512, 2 }, { 1024, 2 }
+};
+static const uint8_t MAX_TEXT_BUFFERS = 4 + 4 + 4 + 4 + 3 + 3 + 2 + 2 + 2 + 1;
+static AsyncWebSocketMessageBuffer* _textBuffers[MAX_TEXT_BUFFERS];
+static bool _textBufferAcquired[MAX_TEXT_BUFFERS];
+static uint8_t _numTextBuffers = 0;
+static portMUX_TYPE _textBufferMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t _asyncTcpTask = nullptr; // Task running the WebSocket events, recorded by onWebSocketEvent()
+
+// Shared document for the variable-sized replies (config list, get_many/set_many, flush),
+// allocated once at init. Used from both the async_tcp task and the loop task, hence the mutex.
+static DynamicJsonDocument* _replyDoc = nullptr;
+static SemaphoreHandle_t _replyDocMutex = nullptr;
+
+// Receive arenas for messages that arrive in pieces (see "Large and Fragmented Messages" in the
+// header), and the document that parses the large text commands. Allocated once at init and only
+// used by the async_tcp task, which handles every WebSocket event, so no lock is needed.
+static uint8_t* _rxArenas[ESP32WS_RX_ARENAS] = {};
+static bool _rxArenaTaken[ESP32WS_RX_ARENAS] = {};
+static DynamicJsonDocument* _largeCommandDoc = nullptr;
+
+// Serialized variable schema (names, types, limits), built once at init. It never changes afterwards,
+// so "get_schema" queues this buffer by reference and /schema.json serves it with a strong ETag.
+static AsyncWebSocketMessageBuffer* _schemaBuffer = nullptr;
+static size_t _schemaLen = 0;         // JSON length (the buffer carries one trailing space)
+static char _schemaEtag[11] = "";     // Quoted 32-bit FNV-1a hash of the schema bytes
+
+/**
+ * @struct ClientState
+ * @brief Library-side bookkeeping for one connected WebSocket client.
+ */
+struct ClientState {
+  uint32_t id;                ///< AsyncWebSocket client id (valid while 'used').
+  bool used;                  ///< Slot in use.
+  bool hasOwnPolicy;          ///< Client chose its policy via "set_flow_policy".
+  FlowPolicy policy;          ///< Policy when hasOwnPolicy is set.
+  uint32_t chunksSent;        ///< Binary chunks queued to this client.
+  uint32_t chunksDropped;     ///< Binary chunks skipped because the client was congested.
+  uint32_t congestedRun;      ///< Consecutive chunks for which the client was congested.
+  uint32_t decimationCounter; ///< Position within the decimation cycle while congested.
+  uint8_t streamMask;         ///< Bit s: subscribed to stream s. 0 = not subscribed (receives no binary data).
+  uint8_t pipeline;           ///< 1 + slot in _pipelines of the client's decimated view; 0 for raw frames.
+  uint32_t route;             ///< streamMask and pipeline as read by other tasks (see publishRouteInternal()).
+  uint8_t rxArena;            ///< 1 + slot in _rxArenas holding the message being reassembled; 0 if none.
+  uint8_t rxOpcode;           ///< WS_TEXT or WS_BINARY: opcode of that message.
+  bool rxOverflow;            ///< The message does not fit an arena (or none was free): it is being discarded.
+  uint32_t rxLen;             ///< Bytes reassembled so far.
+};
+
+// Stream masks (ClientState, LingeringSubscription and the low byte of the route word) hold one bit per stream.
+static_assert(ESP32WS_MAX_STREAMS <= 8, "Subscription stream masks are 8 bits wide: ESP32WS_MAX_STREAMS must be <= 8");
+
+// Per-client state, indexed by slot (not by client id). Slots are claimed on connect and released on disconnect.
+// The mutex also guards the flow fields (policy and counters), which every task that sends binary data updates.
+static ClientState _clientStates[ESP32WS_MAX_CLIENTS];
+static portMUX_TYPE _clientStatesMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Decimation pipelines, shared by every client with the same view and fed by processStreamPipelines().
+// The mutex keeps begin()/end() (WebSocket task) away from process() (the application's sender task).
+struct PipelineSlot {
+  StreamDecimator decimator;
+  uint8_t users;              ///< Clients whose ClientState::pipeline refers to this slot.
+};
+static PipelineSlot _pipelines[ESP32WS_MAX_PIPELINES];
+static volatile uint8_t _activePipelines = 0;
+static SemaphoreHandle_t _pipelineMutex = nullptr;
+
+// Default flow control settings (see setDefaultFlowControl())
+static FlowPolicy _defaultFlowPolicy = FLOW_DROP;
+static uint8_t _flowMaxQueued = 8;
+static uint8_t _flowDecimation = 4;
+static uint16_t _flowDisconnectAfter = 200;
 
 // --- Internal Helper Function Prototypes ---
 static int findVariableIndexInternal(const char* name);
@@ -79,18 +300,80 @@ static bool setVariableValueInternal(int index, JsonVariant newValueVariant);
 static void sendVariableValueInternal(uint32_t clientId, int variableIndex);
 static void sendStatusInternal(uint32_t clientId, const char* status, const char* message);
 static const char* varTypeToCharString(VarType type); // Converts VarType enum to string
+static ClientState* findClientStateInternal(uint32_t clientId);
+static void releasePipelineInternal(uint8_t pipeline);
+static bool unsubscribeClientInternal(ClientState* state);
+static bool shouldSendChunkInternal(AsyncWebSocketClient* client, size_t pooledLen = 0);
 static void onWebSocketEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len);
 
 
 // --- Internal Helper Function Implementations ---
 
 /**
- * @brief Finds the index of a variable in the _variables array by its name.
+ * @brief FNV-1a hash of a null-terminated string.
+ */
+static uint32_t hashVariableNameInternal(const char* name) {
+  uint32_t hash = 2166136261u;
+  while (*name) {
+    hash ^= (uint8_t)*name++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * @brief Builds the name hash index for the _variables table.
+ *        Falls back to linear search (empty index) if the allocation fails.
+ */
+static void buildVariableIndexInternal() {
+  free(_varIndexTable);
+  _varIndexTable = nullptr;
+  _varIndexMask = 0;
+  if (!_variables || _numVariables <= 0 || _numVariables >= VAR_INDEX_EMPTY) return;
+
+  uint32_t tableSize = 4;
+  while (tableSize < (uint32_t)_numVariables * 2) tableSize <<= 1;
+  _varIndexTable = (uint16_t*)malloc(tableSize * sizeof(uint16_t));
+  if (!_varIndexTable) {
+    ESP32WS_LOGW("Could not allocate variable index; using linear lookup.");
+    return;
+  }
+  for (uint32_t b = 0; b < tableSize; b++) _varIndexTable[b] = VAR_INDEX_EMPTY;
+  _varIndexMask = tableSize - 1;
+
+  for (int i = 0; i < _numVariables; i++) {
+    uint32_t bucket = hashVariableNameInternal(_variables[i].name) & _varIndexMask;
+    while (_varIndexTable[bucket] != VAR_INDEX_EMPTY) {
+      if (strcmp(_variables[_varIndexTable[bucket]].name, _variables[i].name) == 0) {
+        ESP32WS_LOGW("Duplicate variable name '%s'; only the first is reachable.", _variables[i].name);
+        break;
+      }
+      bucket = (bucket + 1) & _varIndexMask;
+    }
+    if (_varIndexTable[bucket] == VAR_INDEX_EMPTY) _varIndexTable[bucket] = (uint16_t)i;
+  }
+  ESP32WS_LOGI("Variable hash index built: %d variables, %lu buckets.", _numVariables, (unsigned long)tableSize);
+}
+
+/**
+ * @brief Finds the index of a variable in the _variables table by its name.
+ *        Uses the hash index (one string comparison in the common case).
  * @param name The name of the variable to find.
- * @return The index in the _variables array, or -1 if not found or not initialized.
+ * @return The index in the _variables table, or -1 if not found or not initialized.
  */
 static int findVariableIndexInternal(const char* name) {
   if (!_variables || _numVariables <= 0 || !name) return -1; 
+  if (_varIndexTable) {
+    uint32_t bucket = hashVariableNameInternal(name) & _varIndexMask;
+    while (_varIndexTable[bucket] != VAR_INDEX_EMPTY) {
+      uint16_t i = _varIndexTable[bucket];
+      if (strcmp(name, _variables[i].name) == 0) {
+        return i;
+      }
+      bucket = (bucket + 1) & _varIndexMask;
+    }
+    return -1;
+  }
   for (int i = 0; i < _numVariables; i++) {
     if (strcmp(name, _variables[i].name) == 0) {
       return i; 
@@ -100,105 +383,335 @@ static int findVariableIndexInternal(const char* name) {
 }
 
 /**
- * @brief Attempts to set a variable's value, performing type and range checks.
- * @param index The index of the variable in the _variables array.
+ * @brief True for a numeric variable with more than one element (sent as a JSON array).
+ *        A one-element array behaves as a scalar.
+ */
+static bool isArrayVariableInternal(const WsVarDesc& var) {
+  return var.type != TYPE_STRING && var.count > 1;
+}
+
+/**
+ * @brief Checks one JSON number (or, for a TYPE_BOOL variable, a JSON bool) for a numeric
+ *        variable and converts it to the bits of one element (see convertVariableNumber()).
+ * @return True if the value is acceptable.
+ */
+static bool stageNumberInternal(int index, JsonVariant newValueVariant, uint32_t* bits) {
+  const WsVarDesc& var = _variables[index];
+  double value;
+  if (var.type == TYPE_BOOL && newValueVariant.is<bool>()) {
+    value = newValueVariant.as<bool>() ? 1.0 : 0.0;
+  } else if (newValueVariant.is<double>() && !newValueVariant.is<bool>()) {
+    value = newValueVariant.as<double>();
+  } else {
+    ESP32WS_LOGD("Set Error: Value for '%s' is not a number.", var.name);
+    return false;
+  }
+  uint8_t status = convertVariableNumber(index, value, bits);
+  if (status == BIN_STATUS_OUT_OF_LIMITS) {
+    ESP32WS_LOGD("Set Error: Value %.3f for '%s' is outside limits [%.2f, %.2f].", value, var.name, var.minVal, var.maxVal);
+  } else if (status != BIN_STATUS_OK) {
+    ESP32WS_LOGD("Set Error: Value %.3f for '%s' does not fit its type %s.", value, var.name, varTypeToCharString(var.type));
+  }
+  return status == BIN_STATUS_OK;
+}
+
+/**
+ * @brief True if variable 'index' is not an array, or the array staging buffer still has room for it.
+ */
+static bool hasArrayStagingRoomInternal(int index) {
+  return !isArrayVariableInternal(_variables[index]) ||
+         variableValueBytes(index) <= sizeof(_arrayStaging) - _arrayStagingUsed;
+}
+
+/**
+ * @brief Checks a client value against a variable's type and limits and stages it in out.
+ * @param index The index of the variable in the _variables table.
  * @param newValueVariant A JsonVariant containing the value received from the client.
- * @return True if the value was set successfully, false otherwise.
+ * @param out Receives the converted value; string values point into the JSON document, array
+ *            values into _arrayStaging (valid until commitClientValuesInternal()).
+ * @return True if the value can be committed, false otherwise.
  */
-static bool setVariableValueInternal(int index, JsonVariant newValueVariant) {
+static bool stageVariableValueInternal(int index, JsonVariant newValueVariant, StagedValue& out) {
   if (!_variables || index < 0 || index >= _numVariables) {
-    #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-    Serial.println(F("[ESP32WS] setVariableValueInternal: Invalid index or uninitialized variables."));
-    #endif
+    ESP32WS_LOGD("stageVariableValueInternal: Invalid index or uninitialized variables.");
     return false; 
   }
-  VariableConfig& var = _variables[index]; 
+  const WsVarDesc& var = _variables[index];
+  out = {(int16_t)index, 0, nullptr};
+
+  if (var.type == TYPE_STRING) {
+    if (!newValueVariant.is<const char*>()) {
+      ESP32WS_LOGD("Set Error: Value for '%s' is not a string.", var.name);
+      return false;
+    }
+    const char* text = newValueVariant.as<const char*>();
+    if (strlen(text) >= var.count) {
+      ESP32WS_LOGD("Set Error: Value for '%s' is longer than %u characters.", var.name, (unsigned)(var.count - 1));
+      return false;
+    }
+    out.data = text;
+    return true;
+  }
+  if (!isArrayVariableInternal(var)) return stageNumberInternal(index, newValueVariant, &out.bits);
+
+  JsonArray elements = newValueVariant.as<JsonArray>();
+  if (elements.isNull() || elements.size() != var.count) {
+    ESP32WS_LOGD("Set Error: Value for '%s' is not an array of %u elements.", var.name, (unsigned)var.count);
+    return false;
+  }
+  if (!hasArrayStagingRoomInternal(index)) {
+    ESP32WS_LOGD("Set Error: No staging room for array '%s' (ESP32WS_ARRAY_STAGING_BYTES).", var.name);
+    return false;
+  }
+  uint8_t* staging = (uint8_t*)_arrayStaging + _arrayStagingUsed;
+  uint16_t i = 0;
+  for (JsonVariant element : elements) {
+    uint32_t bits;
+    if (!stageNumberInternal(index, element, &bits)) return false;
+    stageVariableElement(index, staging, i++, bits);
+  }
+  _arrayStagingUsed += (variableValueBytes(index) + 3) & ~(size_t)3; // Next array stays word-aligned
+  out.data = staging;
+  return true;
+}
+
+/**
+ * @brief Commits staged client values as one snapshot, then logs them and calls the change callback.
+ */
+static void commitClientValuesInternal(const StagedValue* values, uint8_t count) {
+  commitVariableValues(values, count);
+  _arrayStagingUsed = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    ESP32WS_LOGD("Set OK: Variable '%s' updated.", _variables[values[i].index].name);
+    notifyVariableChanged(values[i].index);
+  }
+}
+
+/**
+ * @brief Checks and commits a single client value (JSON "set").
+ * @return True if the value was stored.
+ */
+static bool setVariableValueInternal(int index, JsonVariant newValueVariant) {
+  StagedValue staged;
+  if (!stageVariableValueInternal(index, newValueVariant, staged)) return false;
+  commitClientValuesInternal(&staged, 1);
+  return true;
+}
+
+/**
+ * @brief Stores element i of a numeric variable into a JSON slot (one atomic load).
+ */
+template <typename TSlot>
+static void storeElementValueInternal(TSlot dst, const WsVarDesc& var, uint16_t i) {
   switch (var.type) {
-    case TYPE_INT:
-      if (!newValueVariant.is<int>() && !(newValueVariant.is<float>() && newValueVariant.as<float>() == (int)newValueVariant.as<float>() ) ) {
-        #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-        Serial.printf("[ESP32WS] Set Error: Value for '%s' is not a compatible integer.\n", var.name);
-        #endif
-        return false;
-      }
-      { 
-        int newValue = newValueVariant.as<int>();
-        if (var.hasLimits && (static_cast<double>(newValue) < var.minVal || static_cast<double>(newValue) > var.maxVal)) {
-          #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-          Serial.printf("[ESP32WS] Set Error: Value %d for '%s' is outside limits [%.2f, %.2f].\n", newValue, var.name, var.minVal, var.maxVal);
-          #endif
-          return false;
-        }
-        var.intValue = newValue;
-        #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-        Serial.printf("[ESP32WS] Set OK: Variable '%s' (int) updated to %d.\n", var.name, var.intValue);
-        #endif
-      }
-      break; 
-    case TYPE_FLOAT:
-      if (!newValueVariant.is<float>() && !newValueVariant.is<int>()) {
-        #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-        Serial.printf("[ESP32WS] Set Error: Value for '%s' is not a float/number.\n", var.name);
-        #endif
-        return false;
-      }
-      { 
-        float newValue = newValueVariant.as<float>();
-        if (var.hasLimits && (static_cast<double>(newValue) < var.minVal || static_cast<double>(newValue) > var.maxVal)) {
-           #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-           Serial.printf("[ESP32WS] Set Error: Value %.3f for '%s' is outside limits [%.2f, %.2f].\n", newValue, var.name, var.minVal, var.maxVal);
-           #endif
-           return false;
-        }
-        var.floatValue = newValue;
-        #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-        Serial.printf("[ESP32WS] Set OK: Variable '%s' (float) updated to %.3f.\n", var.name, var.floatValue);
-        #endif
-      }
-      break; 
-    case TYPE_STRING:
-      if (!newValueVariant.is<const char*>() && !newValueVariant.is<String>()) { 
-        #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-        Serial.printf("[ESP32WS] Set Error: Value for '%s' is not a string.\n", var.name);
-        #endif
-        return false;
+    case TYPE_INT:   dst.set(wsRead(((const int*)var.value)[i]));      break;
+    case TYPE_UINT:  dst.set(wsRead(((const uint32_t*)var.value)[i])); break;
+    case TYPE_FLOAT: dst.set(wsRead(((const float*)var.value)[i]));    break;
+    case TYPE_BOOL:  dst.set(wsRead(((const bool*)var.value)[i]));     break;
+    default:         dst.set(nullptr);                                 break;
+  }
+}
+
+/**
+ * @brief Stores a variable's current value into a JSON slot; an array becomes a JSON array read
+ *        as one snapshot.
+ *        Templated so it accepts ArduinoJson member/element proxies (e.g. doc["value"]) directly.
+ * @return False if the document ran out of memory for an array.
+ */
+template <typename TSlot>
+static bool storeVariableValueInternal(TSlot dst, const WsVarDesc& var) {
+  if (var.type == TYPE_STRING) {
+    char text[ESP32WS_STRING_CAPACITY_MAX]; // Non-const char*: ArduinoJson copies it into the document
+    readFixedString((const WsStringHeader*)var.value, var.count, text, sizeof(text));
+    dst.set(text);
+    return true;
+  }
+  if (!isArrayVariableInternal(var)) {
+    storeElementValueInternal(dst, var, 0);
+    return true;
+  }
+  JsonArray elements = dst.template to<JsonArray>();
+  for (uint16_t i = 0; i < var.count; i++) {
+    if (!elements.add(0)) return false;
+  }
+  uint32_t token;
+  do { // Retries overwrite the same elements, so they cost no document memory
+    token = beginVariableSnapshot();
+    uint16_t i = 0;
+    for (JsonVariant element : elements) storeElementValueInternal(element, var, i++);
+  } while (retryVariableSnapshot(token));
+  return true;
+}
+
+/**
+ * @brief Takes the smallest free text buffer that can hold len bytes of JSON plus the terminator.
+ * @return The buffer, or nullptr if none is free or large enough.
+ */
+static AsyncWebSocketMessageBuffer* acquireTextBufferInternal(size_t len) {
+  AsyncWebSocketMessageBuffer* result = nullptr;
+  portENTER_CRITICAL(&_textBufferMux);
+  for (uint8_t i = 0; i < _numTextBuffers; i++) { // Ordered by size
+    if (_textBuffers[i]->length() > len && !_textBufferAcquired[i] && _textBuffers[i]->count() == 0) {
+      _textBufferAcquired[i] = true;
+      result = _textBuffers[i];
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&_textBufferMux);
+  return result;
+}
+
+static void releaseTextBufferInternal(AsyncWebSocketMessageBuffer* buffer) {
+  portENTER_CRITICAL(&_textBufferMux);
+  for (uint8_t i = 0; i < _numTextBuffers; i++) {
+    if (_textBuffers[i] == buffer) {
+      _textBufferAcquired[i] = false;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&_textBufferMux);
+}
+
+static bool addTextBufferInternal(size_t size) {
+  if (_numTextBuffers >= MAX_TEXT_BUFFERS) return false;
+  AsyncWebSocketMessageBuffer* buffer = new (std::nothrow) AsyncWebSocketMessageBuffer(size);
+  if (!buffer || buffer->get() == nullptr) {
+    delete buffer;
+    return false;
+  }
+  _textBuffers[_numTextBuffers] = buffer;
+  _textBufferAcquired[_numTextBuffers] = false;
+  _numTextBuffers++;
+  return true;
+}
+
+/**
+ * @brief Serializes a document into a pooled text buffer sized with measureJson().
+ * @param jsonLen Receives the JSON length (the rest of the buffer is padding).
+ * @return The acquired buffer (to be released after queueing), or nullptr if none fits.
+ */
+template <typename TDoc>
+static AsyncWebSocketMessageBuffer* serializeToTextBufferInternal(const TDoc& doc, size_t* jsonLen) {
+  size_t len = measureJson(doc);
+  *jsonLen = len;
+  AsyncWebSocketMessageBuffer* buffer = acquireTextBufferInternal(len);
+  if (!buffer) return nullptr;
+  char* out = (char*)buffer->get();
+  serializeJson(doc, out, buffer->length());
+  memset(out + len, ' ', buffer->length() - len); // Overwrites the terminator too
+  return buffer;
+}
+
+/**
+ * @brief True on the task that runs the WebSocket events, the only one that may queue a pooled
+ *        text buffer by reference (see _textBuffers).
+ */
+static bool onAsyncTcpTaskInternal() {
+  return _asyncTcpTask != nullptr && xTaskGetCurrentTaskHandle() == _asyncTcpTask;
+}
+
+/**
+ * @brief Sends a JSON document to one client through the text buffer pool.
+ *        Falls back to a temporary String (counted) if no pooled buffer is available.
+ */
+template <typename TDoc>
+static void sendJsonInternal(uint32_t clientId, const TDoc& doc) {
+  AsyncWebSocketClient* client = ws.client(clientId);
+  if (!client) return;
+  size_t len;
+  AsyncWebSocketMessageBuffer* buffer = serializeToTextBufferInternal(doc, &len);
+  if (buffer) {
+    if (onAsyncTcpTaskInternal()) {
+      client->text(buffer); // Queued by reference; count() drops back to 0 once sent
+      len = buffer->length();
+    } else {
+      client->text((const char*)buffer->get(), len); // Copied: see _textBuffers
+    }
+    metricCount(METRIC_TEXT_OUT);
+    metricCount(METRIC_TEXT_BYTES_OUT, len);
+    releaseTextBufferInternal(buffer);
+    return;
+  }
+  metricCount(METRIC_TEXT_FALLBACKS);
+  String response;
+  serializeJson(doc, response);
+  client->text(response);
+  metricCount(METRIC_TEXT_OUT);
+  metricCount(METRIC_TEXT_BYTES_OUT, response.length());
+}
+
+/**
+ * @brief Sends a JSON document to every connected client, sharing one pooled buffer
+ *        (on the AsyncTCP task) or one exact-length copy (on any other task).
+ */
+template <typename TDoc>
+static void broadcastJsonInternal(const TDoc& doc) {
+  if (ws.count() == 0) return;
+  size_t len;
+  AsyncWebSocketMessageBuffer* buffer = serializeToTextBufferInternal(doc, &len);
+  if (buffer) {
+    if (onAsyncTcpTaskInternal()) {
+      for (AsyncWebSocketClient* c : ws.getClients()) {
+        if (c->status() != WS_CONNECTED) continue;
+        c->text(buffer);
+        metricCount(METRIC_TEXT_OUT);
+        metricCount(METRIC_TEXT_BYTES_OUT, buffer->length());
       }
-      var.stringValue = newValueVariant.as<String>(); 
-      #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-      Serial.printf("[ESP32WS] Set OK: Variable '%s' (string) updated to '%s'.\n", var.name, var.stringValue.c_str());
-      #endif
-      break; 
-    default:
-      #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-      Serial.printf("[ESP32WS] Set Error: Unknown internal type for variable '%s'.\n", var.name);
-      #endif
-      return false; 
+    } else {
+      ws.textAll((const char*)buffer->get(), len); // Copied once, shared by the recipients: see _textBuffers
+      metricCount(METRIC_TEXT_OUT, ws.count());
+      metricCount(METRIC_TEXT_BYTES_OUT, len * ws.count());
+    }
+    releaseTextBufferInternal(buffer);
+    return;
   }
-  return true; 
+  metricCount(METRIC_TEXT_FALLBACKS);
+  String response;
+  serializeJson(doc, response);
+  ws.textAll(response);
+  metricCount(METRIC_TEXT_OUT, ws.count());
+  metricCount(METRIC_TEXT_BYTES_OUT, response.length() * ws.count());
 }
 
+/**
+ * @class ReplyDocLock
+ * @brief Scoped ownership of the shared reply document; clears it on entry.
+ */
+class ReplyDocLock {
+public:
+  ReplyDocLock() : _locked(_replyDoc && _replyDocMutex && xSemaphoreTake(_replyDocMutex, portMAX_DELAY) == pdTRUE) {
+    if (_locked) _replyDoc->clear();
+  }
+  ~ReplyDocLock() {
+    if (_locked) xSemaphoreGive(_replyDocMutex);
+  }
+  bool locked() const { return _locked; }
+  ReplyDocLock(const ReplyDocLock&) = delete;
+  ReplyDocLock& operator=(const ReplyDocLock&) = delete;
+private:
+  bool _locked;
+};
+
 /**
  * @brief Sends the current value of a variable as JSON to a specific client.
  * @param clientId The ID of the target WebSocket client.
- * @param variableIndex The index of the variable in the _variables array.
+ * @param variableIndex The index of the variable in the _variables table.
  */
 static void sendVariableValueInternal(uint32_t clientId, int variableIndex) {
    if (!_variables || variableIndex < 0 || variableIndex >= _numVariables) return;
+    const WsVarDesc& var = _variables[variableIndex];
+    if (isArrayVariableInternal(var) || var.count > 128) { // Too large for the stack document
+      ReplyDocLock lock;
+      if (!lock.locked()) return;
+      (*_replyDoc)["variable"] = var.name;
+      if (!storeVariableValueInternal((*_replyDoc)["value"], var)) (*_replyDoc)["error"] = "Value too large";
+      sendJsonInternal(clientId, *_replyDoc);
+      return;
+    }
     StaticJsonDocument<256> jsonDoc; // Adjust size if needed for long names/strings
-    VariableConfig& var = _variables[variableIndex];
     jsonDoc["variable"] = var.name;
-    switch (var.type) {
-      case TYPE_INT:    jsonDoc["value"] = var.intValue;    break;
-      case TYPE_FLOAT:  jsonDoc["value"] = var.floatValue;  break;
-      case TYPE_STRING: jsonDoc["value"] = var.stringValue; break;
-      default:          jsonDoc["value"] = nullptr; jsonDoc["error"] = "Unknown internal type"; break; 
-    }
-    String response;
-    serializeJson(jsonDoc, response);
-    ws.text(clientId, response);
-    #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-    // Serial.printf("[ESP32WS] Sent Value to #%u: %s\n", clientId, response.c_str()); 
-    #endif
+    storeVariableValueInternal(jsonDoc["value"], var);
+    sendJsonInternal(clientId, jsonDoc);
 }
 
 /**
@@ -211,427 +724,1777 @@ static void sendStatusInternal(uint32_t clientId, const char* status, const char
     StaticJsonDocument<192> jsonDoc; // Adjusted size, ensure it's enough for status + message
     jsonDoc["status"] = status;
     jsonDoc["message"] = message;
-    String response;
-    serializeJson(jsonDoc, response);
-    ws.text(clientId, response);
-    #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-    Serial.printf("[ESP32WS] Sent Status to #%u: %s\n", clientId, response.c_str()); 
-    #endif
+    sendJsonInternal(clientId, jsonDoc);
+    ESP32WS_LOGD("Sent Status to #%u: %s - %s", clientId, status, message); 
 }
 
 /**
  * @brief Converts VarType enum to its string representation.
  * @param type The VarType enum value.
- * @return A const char* string (e.g., "INT", "FLOAT", "STRING").
+ * @return A const char* string (e.g., "INT", "FLOAT", "STRING", "BOOL", "UINT").
  */
 static const char* varTypeToCharString(VarType type) {
     switch (type) {
         case TYPE_INT:    return "INT";
         case TYPE_FLOAT:  return "FLOAT";
         case TYPE_STRING: return "STRING";
+        case TYPE_BOOL:   return "BOOL";
+        case TYPE_UINT:   return "UINT";
         default:          return "UNKNOWN";
     }
 }
 
-// --- Main WebSocket Event Handler ---
-
 /**
- * @brief Callback function invoked by the AsyncWebSocket library for various events.
+ * @brief Converts FlowPolicy enum to its JSON string representation.
  */
-static void onWebSocketEvent(AsyncWebSocket *serverArg, AsyncWebSocketClient *client, AwsEventType type,
-                             void *arg, uint8_t *data, size_t len) {
-  
-  switch (type) {
-    case WS_EVT_CONNECT:
-      #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-      Serial.printf("[ESP32WS] WebSocket Client #%u connected from %s\n", client->id(), client->remoteIP().toString().c_str());
-      #endif
-      break;
-
-    case WS_EVT_DISCONNECT:
-      #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-      Serial.printf("[ESP32WS] WebSocket Client #%u disconnected\n", client->id());
-      #endif
-      if (_isStreaming && ws.count() == 0 && _onStreamStopCallback != nullptr) { // ws.count() is now 0 AFTER this client is removed
-           #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-           Serial.println(F("[ESP32WS] Last client disconnected. Auto-stopping stream."));
-           #endif
-           _onStreamStopCallback(); 
-           _isStreaming = false;    
-      }
-      break;
-
-    case WS_EVT_DATA:
-      { 
-        AwsFrameInfo *info = (AwsFrameInfo*)arg;
-        
-        if (info->opcode == WS_TEXT && info->final && info->index == 0 && info->len == len) {
-          // data[len] = 0; // Risky, can cause buffer overflow. Use deserializeJson with length.
-          #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-          // Print raw data carefully, ensuring it's null-terminated for printing if needed
-          // Or print byte by byte if not guaranteed to be text.
-          // For JSON, deserializeJson will handle it.
-          // char tempBuf[len + 1];
-          // memcpy(tempBuf, data, len);
-          // tempBuf[len] = '\0';
-          // Serial.printf("[ESP32WS] Received Text from #%u: %s\n", client->id(), tempBuf);
-          Serial.printf("[ESP32WS] Received Text from #%u (%d bytes)\n", client->id(), len);
-          #endif
-
-          StaticJsonDocument<256> jsonDoc; // Adjust size for expected command complexity
-          DeserializationError error = deserializeJson(jsonDoc, (const char*)data, len); // Use (const char*) and len
-
-          if (error) {
-            Serial.printf("[ESP32WS] JSON Parse Error: %s\n", error.c_str()); // Always log parse errors
-            sendStatusInternal(client->id(), "error", "Invalid JSON format received.");
-            return; 
-          }
+static const char* flowPolicyToCharString(FlowPolicy policy) {
+    switch (policy) {
+        case FLOW_DROP:       return "drop";
+        case FLOW_DECIMATE:   return "decimate";
+        case FLOW_DISCONNECT: return "disconnect";
+        default:              return "unknown";
+    }
+}
 
-          const char* action = jsonDoc["action"];
-          if (!action) {
-             #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-             Serial.println(F("[ESP32WS] JSON missing 'action' field."));
-             #endif
-             sendStatusInternal(client->id(), "error", "JSON missing 'action' field."); return;
-          }
+/**
+ * @brief Parses a flow policy name ("drop", "decimate", "disconnect").
+ * @return True and sets 'policy' if the name is valid.
+ */
+static bool flowPolicyFromCharString(const char* name, FlowPolicy& policy) {
+    if (!name) return false;
+    if (strcmp(name, "drop") == 0)       { policy = FLOW_DROP;       return true; }
+    if (strcmp(name, "decimate") == 0)   { policy = FLOW_DECIMATE;   return true; }
+    if (strcmp(name, "disconnect") == 0) { policy = FLOW_DISCONNECT; return true; }
+    return false;
+}
 
-          if (strcmp(action, "get") == 0 || strcmp(action, "set") == 0) {
-              const char* variableName = jsonDoc["variable"];
-              if (!variableName) { 
-                #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-                Serial.println(F("[ESP32WS] Missing 'variable' field for get/set action."));
-                #endif
-                sendStatusInternal(client->id(), "error", "Missing 'variable' field for get/set action."); return; 
-              }
-              int varIndex = findVariableIndexInternal(variableName);
-              if (varIndex == -1) { 
-                #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-                Serial.printf("[ESP32WS] Variable name '%s' not found.\n", variableName);
-                #endif
-                sendStatusInternal(client->id(), "error", "Variable name not found."); return; 
-              }
-
-              if (strcmp(action, "get") == 0) {
-                  sendVariableValueInternal(client->id(), varIndex); 
-              } else { // action == "set"
-                  if (!jsonDoc.containsKey("value") || jsonDoc["value"].isNull()) { 
-                    #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-                    Serial.println(F("[ESP32WS] Missing or null 'value' field for set action."));
-                    #endif
-                    sendStatusInternal(client->id(), "error", "Missing or null 'value' field for set action."); return; 
-                  }
-                  JsonVariant newValueVariant = jsonDoc["value"];
-                  if (setVariableValueInternal(varIndex, newValueVariant)) {
-                      sendVariableValueInternal(client->id(), varIndex); // Send back the updated value
-                      // Optionally, broadcast to all clients if variable was set by one client
-                      // broadcastVariableUpdate(variableName); 
-                  } else {
-                      // Error message already printed by setVariableValueInternal if DEBUG is on
-                      sendStatusInternal(client->id(), "error", "Failed to set value (invalid type or out of limits).");
-                  }
-              }
-          } 
-          else if (strcmp(action, "start_stream") == 0) {
-              if (_onStreamStartCallback != nullptr) {
-                  if (!_isStreaming) {
-                      #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-                      Serial.println(F("[ESP32WS] Action: start_stream - Calling app callback."));
-                      #endif
-                      _onStreamStartCallback(); 
-                      _isStreaming = true;      
-                      sendStatusInternal(client->id(), "ok", "Stream started.");
-                  } else { 
-                    #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-                    Serial.println(F("[ESP32WS] Info: Stream was already active."));
-                    #endif
-                    sendStatusInternal(client->id(), "info", "Stream was already active."); 
-                  }
-              } else {
-                  #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-                  Serial.println(F("[ESP32WS] Action: start_stream - No callback registered."));
-                  #endif
-                  sendStatusInternal(client->id(), "error", "Streaming feature not implemented/configured.");
-              }
-          } 
-          else if (strcmp(action, "stop_stream") == 0) {
-               if (_onStreamStopCallback != nullptr) {
-                  if (_isStreaming) {
-                      #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-                      Serial.println(F("[ESP32WS] Action: stop_stream - Calling app callback."));
-                      #endif
-                      _onStreamStopCallback(); 
-                      _isStreaming = false;     
-                      sendStatusInternal(client->id(), "ok", "Stream stopped.");
-                  } else { 
-                    #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-                    Serial.println(F("[ESP32WS] Info: Stream was already stopped."));
-                    #endif
-                    sendStatusInternal(client->id(), "info", "Stream was already stopped."); 
-                  }
-              } else {
-                  #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-                  Serial.println(F("[ESP32WS] Action: stop_stream - No callback registered."));
-                  #endif
-                  sendStatusInternal(client->id(), "error", "Streaming feature not implemented/configured.");
-              }
-          }
-          else if (strcmp(action, "get_all_vars_config") == 0) {
-              #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-              Serial.printf("[ESP32WS] Action: get_all_vars_config received from #%u\n", client->id());
-              #endif
-              if (!_variables || _numVariables <= 0) {
-                  sendStatusInternal(client->id(), "error", "No variables configured on server.");
-                  return;
-              }
-              
-              const int avgBytesPerVar = 100; // Conservative estimate
-              DynamicJsonDocument responseDoc(_numVariables * avgBytesPerVar + 128); 
-
-              responseDoc["status"] = "var_config_list";
-              JsonArray varsArray = responseDoc.createNestedArray("variables");
-
-              for (int i = 0; i < _numVariables; i++) {
-                  JsonObject varObj = varsArray.createNestedObject();
-                  varObj["name"] = _variables[i].name;
-                  varObj["type"] = varTypeToCharString(_variables[i].type);
-                  
-                  switch (_variables[i].type) {
-                      case TYPE_INT:    varObj["value"] = _variables[i].intValue;    break;
-                      case TYPE_FLOAT:  varObj["value"] = _variables[i].floatValue;  break;
-                      case TYPE_STRING: varObj["value"] = _variables[i].stringValue; break;
-                  }
-                  varObj["hasLimits"] = _variables[i].hasLimits;
-                  if (_variables[i].hasLimits) {
-                      varObj["min"] = _variables[i].minVal;
-                      varObj["max"] = _variables[i].maxVal;
-                  }
-              }
-              String response;
-              serializeJson(responseDoc, response);
-              ws.text(client->id(), response);
-              #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-              Serial.println(F("[ESP32WS] Sent var_config_list to client."));
-              #endif
-          }
-          else {
-              #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-              Serial.printf("[ESP32WS] Unknown action received: %s\n", action);
-              #endif
-              sendStatusInternal(client->id(), "error", "Unknown 'action' command.");
-          }
-        } 
-        else if (info->opcode == WS_BINARY) {
-            #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-            Serial.printf("[ESP32WS] Received Binary from #%u: %u bytes (ignored by library)\n", client->id(), len);
-            #endif
+/**
+ * @brief Claims a client state slot for a newly connected client.
+ * @return The slot, or nullptr if all ESP32WS_MAX_CLIENTS slots are in use.
+ */
+static ClientState* addClientStateInternal(uint32_t clientId) {
+    ClientState* result = nullptr;
+    portENTER_CRITICAL(&_clientStatesMux);
+    for (int i = 0; i < ESP32WS_MAX_CLIENTS; i++) {
+        if (!_clientStates[i].used) {
+            _clientStates[i] = ClientState();
+            _clientStates[i].id = clientId;
+            _clientStates[i].used = true;
+            result = &_clientStates[i];
+            break;
         }
-      } 
-      break;
+    }
+    portEXIT_CRITICAL(&_clientStatesMux);
+    return result;
+}
 
-    case WS_EVT_PONG: 
-      #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-      // Serial.printf("[ESP32WS] WebSocket Pong received from #%u\n", client->id()); 
-      #endif
-      break;
+/**
+ * @brief Releases the state slot of a disconnected client.
+ */
+static void removeClientStateInternal(uint32_t clientId) {
+    uint8_t pipeline = 0;
+    portENTER_CRITICAL(&_clientStatesMux);
+    for (int i = 0; i < ESP32WS_MAX_CLIENTS; i++) {
+        if (_clientStates[i].used && _clientStates[i].id == clientId) {
+            __atomic_store_n(&_clientStates[i].route, 0u, __ATOMIC_RELEASE);
+            _clientStates[i].used = false;
+            pipeline = _clientStates[i].pipeline;
+            _clientStates[i].pipeline = 0;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&_clientStatesMux);
+    releasePipelineInternal(pipeline); // Takes a mutex, so outside the critical section
+}
 
-    case WS_EVT_ERROR: // This event gives limited info, usually just an error code
-      // arg is a uint16_t* (error code), data is a char* (error message)
-      Serial.printf("[ESP32WS] WebSocket Client #%u error #%u: %s\n", client->id(), *((uint16_t*)arg), (char*)data);
-      break;
-  } 
+/**
+ * @brief Finds the state slot of a connected client.
+ * @return The slot, or nullptr if the client is not tracked.
+ */
+static ClientState* findClientStateInternal(uint32_t clientId) {
+    for (int i = 0; i < ESP32WS_MAX_CLIENTS; i++) {
+        if (_clientStates[i].used && _clientStates[i].id == clientId) {
+            return &_clientStates[i];
+        }
+    }
+    return nullptr;
 }
 
-// --- Public Function Implementations ---
+/**
+ * @brief Publishes a client's streamMask and pipeline for the sender and replay tasks as one word:
+ *        streamMask | pipeline << 8 | (source stream of the pipeline + 1) << 16. Those tasks read it
+ *        with one atomic load (loadRouteInternal()) and never index _pipelines, whose slots the
+ *        WebSocket task releases. Called by the WebSocket task after every change of the fields,
+ *        before a pipeline the client dropped is released.
+ */
+static void publishRouteInternal(ClientState* state) {
+    uint32_t source = state->pipeline ? (uint32_t)(_pipelines[state->pipeline - 1].decimator.sourceStreamId() + 1) : 0;
+    uint32_t route = state->streamMask | ((uint32_t)state->pipeline << 8) | ((source & 0xFF) << 16);
+    __atomic_store_n(&state->route, route, __ATOMIC_RELEASE);
+}
 
-void initWiFiWebSocketServer(const char *ssid, const char *password,
-                              const uint8_t staticIpParam[4],
-                              VariableConfig *appVariables, int appNumVariables,
-                              ArRequestHandlerFunction customNotFoundHandler) { // Renamed for clarity
+/**
+ * @brief Reads the published route of a client (0: not tracked or not subscribed). Any task.
+ */
+static uint32_t loadRouteInternal(uint32_t clientId) {
+    ClientState* state = findClientStateInternal(clientId);
+    return state ? __atomic_load_n(&state->route, __ATOMIC_ACQUIRE) : 0;
+}
 
-  _variables = appVariables;
-  _numVariables = appNumVariables;
+static uint8_t routeStreamMaskInternal(uint32_t route) { return (uint8_t)route; }
+static uint8_t routePipelineInternal(uint32_t route) { return (uint8_t)(route >> 8); }
+static int routePipelineSourceInternal(uint32_t route) { return (int)((route >> 16) & 0xFF) - 1; }
 
-  Serial.println(F("\n--- [ESP32WS] initWiFiWebSocketServer: START ---")); 
+// Queue depth of a client. Forks of ESPAsyncWebServer that expose queueLen() give the exact depth;
+// otherwise only queueIsFull() is available and the depth is reported as 0 or WS_MAX_QUEUED_MESSAGES.
+template <typename C>
+static auto clientQueueDepthImpl(C* client, int) -> decltype(client->queueLen(), size_t()) {
+    return client->queueLen();
+}
+template <typename C>
+static size_t clientQueueDepthImpl(C* client, long) {
+    return client->queueIsFull() ? WS_MAX_QUEUED_MESSAGES : 0;
+}
+static size_t clientQueueDepthInternal(AsyncWebSocketClient* client) {
+    return clientQueueDepthImpl(client, 0);
+}
 
-  // Validate variable configuration
-  if (appNumVariables < 0) {
-      Serial.println(F("[ESP32WS] CRITICAL ERROR: appNumVariables cannot be negative."));
-      return;
-  }
-  if (appNumVariables > 0 && !appVariables) { 
-      Serial.println(F("[ESP32WS] CRITICAL ERROR: appVariables is NULL but appNumVariables is greater than 0."));
-      return; 
-  }
-  if (appNumVariables == 0) {
-      #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-      Serial.println(F("[ESP32WS] Info: Initializing without application variables (appNumVariables is 0)."));
-      #endif
-  } else {
-      #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-      Serial.println(F("[ESP32WS] Variable array parameters check OK."));
-      #endif
-  }
+/**
+ * @brief Checks whether a client already holds its share of the pooled frames of length len: the
+ *        frames of that length, less one for the producer, split between the subscribed clients.
+ *        Every queued message pins its frame, so without this a slow client whose queue is still
+ *        below maxQueued could hold every frame and make the producer drop chunks for all clients.
+ */
+static bool holdsFrameShareInternal(uint32_t clientId, size_t len) {
+    uint8_t subscribers = 0;
+    for (int i = 0; i < ESP32WS_MAX_CLIENTS; i++) {
+        if (_clientStates[i].used && __atomic_load_n(&_clientStates[i].route, __ATOMIC_ACQUIRE) != 0) subscribers++;
+    }
+    uint8_t frames = 0;
+    uint8_t held = 0;
+    portENTER_CRITICAL(&_framePoolMux);
+    for (uint8_t i = 0; i < _framePoolCount; i++) {
+        if (_framePool[i]->length() != len) continue;
+        frames++;
+        if (_frameOwner[i] == clientId && _framePool[i]->count() != 0) held++;
+    }
+    portEXIT_CRITICAL(&_framePoolMux);
+    uint8_t share = subscribers > 0 && frames > 1 ? (frames - 1) / subscribers : 1;
+    return held >= (share > 0 ? share : 1);
+}
 
+/**
+ * @brief Applies the client's flow policy to the next binary chunk and updates its statistics.
+ *        Runs on the sender task, the replay task and the AsyncTCP task (pipelines, application
+ *        streams), so the per-client counters are only touched under _clientStatesMux; the queue
+ *        is inspected and the client closed outside of it. May close the client under FLOW_DISCONNECT.
+ * @param pooledLen Length of the pooled frame the chunk goes out in, 0 if it is not pooled: a client
+ *                  that holds its share of those frames (holdsFrameShareInternal()) counts as congested.
+ * @return True if the chunk should be queued to this client.
+ */
+static bool shouldSendChunkInternal(AsyncWebSocketClient* client, size_t pooledLen) {
+    if (client->status() != WS_CONNECTED) return false;
+    uint32_t clientId = client->id();
+    ClientState* state = findClientStateInternal(clientId);
+    if (!state) return !client->queueIsFull(); // Untracked (slots exhausted): never overfill its queue
 
-  // --- Initialize LittleFS ---
-  #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-  Serial.println(F("[ESP32WS] Initializing LittleFS..."));
-  #endif
-  if (!LittleFS.begin(true)) { // true = format if mount failed
-      Serial.println(F("[ESP32WS] CRITICAL ERROR: LittleFS Mount Failed! Unable to proceed."));
-      Serial.println(F("[ESP32WS] --> Please ensure LittleFS is correctly formatted and data uploaded."));
-      return; 
-  }
-  #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-  Serial.println(F("[ESP32WS] LittleFS mounted successfully."));
-  #endif
-
-  // Reset WiFi state for a cleaner start
-  #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-  Serial.println(F("[ESP32WS] Attempting to reset WiFi state..."));
-  #endif
-  WiFi.persistent(false); 
-  WiFi.disconnect(true);  
-  WiFi.mode(WIFI_OFF);    
-  delay(100);             
-  WiFi.mode(WIFI_AP);     
-  #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-  Serial.println(F("[ESP32WS] WiFi state reset, AP mode set."));
-  #endif
-  
-  // Configure Static IP for the Access Point if provided
-  if (staticIpParam != nullptr) {
-    IPAddress apIP(staticIpParam[0], staticIpParam[1], staticIpParam[2], staticIpParam[3]);
-    IPAddress gatewayIP(staticIpParam[0], staticIpParam[1], staticIpParam[2], staticIpParam[3]);
-    IPAddress subnetMask(255, 255, 255, 0); 
-
-    #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-    Serial.printf("[ESP32WS] Attempting to configure static AP IP: %s\n", apIP.toString().c_str());
-    #endif
-    if (!WiFi.softAPConfig(apIP, gatewayIP, subnetMask)) {
-      Serial.println(F("[ESP32WS] ERROR: Failed to configure static AP IP address! Will use default."));
+    // Saturated: no room at all (full queue, or frame share used up), so not even a decimated chunk goes out
+    bool saturated = client->queueIsFull() || (pooledLen > 0 && holdsFrameShareInternal(clientId, pooledLen));
+    bool congested = saturated || clientQueueDepthInternal(client) >= _flowMaxQueued;
+    bool send = !congested;
+    bool disconnect = false;
+    uint32_t congestedRun = 0;
+    portENTER_CRITICAL(&_clientStatesMux);
+    if (!state->used || state->id != clientId) { // Slot released meanwhile
+        portEXIT_CRITICAL(&_clientStatesMux);
+        return false;
+    }
+    if (!congested) {
+        state->congestedRun = 0;
+        state->decimationCounter = 0;
     } else {
-      #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-      Serial.println(F("[ESP32WS] Static AP IP configuration successful."));
-      #endif
+        congestedRun = ++state->congestedRun;
+        FlowPolicy policy = state->hasOwnPolicy ? state->policy : _defaultFlowPolicy;
+        if (policy == FLOW_DECIMATE && !saturated) {
+            send = (state->decimationCounter++ % _flowDecimation) == 0;
+        } else if (policy == FLOW_DISCONNECT && congestedRun >= _flowDisconnectAfter) {
+            disconnect = congestedRun == _flowDisconnectAfter; // Closed once, by whichever task got there
+        }
     }
-  } else {
-    #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-    Serial.println(F("[ESP32WS] Info: No static IP provided. Using default AP IP (typically 192.168.4.1)."));
-    #endif
-  }
-
-  // Start the WiFi Access Point
-  #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-  Serial.printf("[ESP32WS] Starting WiFi Access Point (SSID: %s)...\n", ssid);
-  #endif
-  bool apStarted = WiFi.softAP(ssid, password); 
-
-  if (apStarted) {
-      Serial.print(F("[ESP32WS] Access Point started. IP Address: ")); 
-      Serial.println(WiFi.softAPIP()); 
-      // Additional check if static IP was intended but not achieved
-      if (staticIpParam != nullptr && WiFi.softAPIP() != IPAddress(staticIpParam[0], staticIpParam[1], staticIpParam[2], staticIpParam[3])) {
-          if (WiFi.softAPIP() == IPAddress(0,0,0,0)) {
-             Serial.println(F("[ESP32WS] WARNING: AP IP is 0.0.0.0! AP may not be fully functional."));
-          } else if (WiFi.softAPIP() == IPAddress(192,168,4,1) && (staticIpParam[0]!=192 || staticIpParam[1]!=168 || staticIpParam[2]!=4 || staticIpParam[3]!=1)) {
-             Serial.println(F("[ESP32WS] WARNING: Actual AP IP is the default (192.168.4.1), not the configured static IP. softAPConfig might have failed silently or been overridden."));
-          } else {
-             Serial.println(F("[ESP32WS] WARNING: Actual AP IP does not match configured static IP. Check for conflicts."));
-          }
-      }
-  } else {
-      Serial.println(F("[ESP32WS] CRITICAL ERROR: Failed to start Access Point!"));
-      return; 
-  }
+    if (send) {
+        state->chunksSent++;
+    } else {
+        state->chunksDropped++;
+    }
+    portEXIT_CRITICAL(&_clientStatesMux);
+
+    if (disconnect) {
+        ESP32WS_LOGW("Flow control: closing client #%u (congested for %lu chunks).",
+                     clientId, (unsigned long)congestedRun);
+        client->close();
+    }
+    metricCount(send ? METRIC_BINARY_OUT : METRIC_BINARY_DROPPED);
+    return send;
+}
+
+/**
+ * @brief Checks whether a binary message goes to this client. Only subscribed clients get binary data;
+ *        a raw stream frame also needs the stream in the client's subscription, and is withheld when
+ *        the client receives that stream through a pipeline instead, or while a replay of that stream
+ *        to the client is still behind it (replayMask, from recordStreamFrame()).
+ */
+static bool wantsBinaryDataInternal(AsyncWebSocketClient* client, const uint8_t* data, uint32_t replayMask) {
+    uint32_t route = loadRouteInternal(client->id()); // Runs on the sender tasks: one consistent snapshot
+    uint8_t streamMask = routeStreamMaskInternal(route);
+    if (streamMask == 0) return false;
+    if (data[0] != ESP32WS_BIN_STREAM_FRAME) return true;
+    if (replayMask && replayWithholdsFrame(replayMask, client->id())) return false; // The replay delivers it
+    uint8_t streamId = data[1];
+    if (streamId >= 8 || !(streamMask & (1u << streamId))) return false;
+    return routePipelineInternal(route) == 0 || routePipelineSourceInternal(route) != streamId;
+}
+
+// --- Decimation Pipelines ---
+
+/**
+ * @brief Finds a pipeline with the same reduction or starts one in a free slot.
+ * @return 1 + the slot (the ClientState::pipeline value), or 0 if no slot is free or the stream is unsupported.
+ */
+static uint8_t acquirePipelineInternal(int sourceStreamId, DecimationMode mode, uint16_t factor, uint8_t channelMask) {
+    if (!_pipelineMutex) return 0;
+    uint8_t result = 0;
+    xSemaphoreTake(_pipelineMutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < ESP32WS_MAX_PIPELINES && !result; i++) {
+        if (_pipelines[i].users > 0 && _pipelines[i].decimator.matches(sourceStreamId, mode, factor, channelMask)) {
+            _pipelines[i].users++;
+            result = i + 1;
+        }
+    }
+    for (uint8_t i = 0; i < ESP32WS_MAX_PIPELINES && !result; i++) {
+        if (_pipelines[i].users == 0) {
+            if (_pipelines[i].decimator.begin(sourceStreamId, ESP32WS_MAX_STREAMS + i, mode, factor, channelMask)) {
+                _pipelines[i].users = 1;
+                _activePipelines++;
+                result = i + 1;
+            }
+            break; // Any other free slot would fail the same way
+        }
+    }
+    xSemaphoreGive(_pipelineMutex);
+    if (result) {
+        ESP32WS_LOGD("Pipeline #%u: stream %d, %s /%u, channels 0x%02X, %u client(s).", result - 1,
+                     sourceStreamId, mode == DECIMATE_MINMAX ? "minmax" : (mode == DECIMATE_AVERAGE ? "average" : "none"),
+                     factor, channelMask, _pipelines[result - 1].users);
+    }
+    return result;
+}
+
+/**
+ * @brief Drops one user of a pipeline (a ClientState::pipeline value); the last user stops it.
+ */
+static void releasePipelineInternal(uint8_t pipeline) {
+    if (pipeline == 0 || pipeline > ESP32WS_MAX_PIPELINES || !_pipelineMutex) return;
+    PipelineSlot& slot = _pipelines[pipeline - 1];
+    xSemaphoreTake(_pipelineMutex, portMAX_DELAY);
+    if (slot.users > 0 && --slot.users == 0) {
+        slot.decimator.end();
+        _activePipelines--;
+    }
+    xSemaphoreGive(_pipelineMutex);
+}
+
+/**
+ * @brief DecimatedFrameCallback: queues a decimated frame to the clients on that pipeline.
+ */
+static void sendPipelineFrameInternal(const uint8_t* frame, size_t len, void* context) {
+    uint8_t pipeline = (uint8_t)(uintptr_t)context;
+    for (AsyncWebSocketClient* c : ws.getClients()) {
+        if (routePipelineInternal(loadRouteInternal(c->id())) == pipeline && shouldSendChunkInternal(c)) {
+            c->binary(frame, len);
+            metricCount(METRIC_BINARY_BYTES_OUT, len);
+        }
+    }
+}
+
+/**
+ * @brief Sends the stream_schema matching the client's view: the cached message for raw frames,
+ *        or one that adds the client's decimated stream.
+ */
+static void sendStreamSchemaInternal(AsyncWebSocketClient* client) {
+    if (client->status() != WS_CONNECTED) return;
+    ClientState* state = findClientStateInternal(client->id());
+    uint8_t pipeline = state ? state->pipeline : 0;
+    if (pipeline == 0) {
+        if (getStreamSchemaMessage()) client->text(getStreamSchemaMessage());
+        return;
+    }
+    const StreamDecimator& decimator = _pipelines[pipeline - 1].decimator; // Kept alive by this client's reference
+    DynamicJsonDocument doc(getStreamSchemaCapacity() + decimator.schemaCapacity());
+    doc["status"] = "stream_schema";
+    JsonArray streamsArray = doc.createNestedArray("streams");
+    describeStreams(streamsArray);
+    decimator.describe(streamsArray.createNestedObject());
+    if (doc.overflowed()) {
+        ESP32WS_LOGE("Pipeline Error: Stream schema document overflowed.");
+        return;
+    }
+    sendJsonInternal(client->id(), doc);
+}
+
+/**
+ * @brief Applies the options of a start_stream request to the client's subscription:
+ *          "streams":  [ids] to receive (default: all streams),
+ *          "channels": [names] of the view's stream to keep (default: all channels),
+ *          "decimation": {"mode":"average"|"minmax"|"none", "factor":N | "rateHz":R,
+ *                         "stream":id (default: the first subscribed stream)}.
+ *        The view's stream is delivered through a shared pipeline when channels are dropped or the
+ *        rate is reduced; every other subscribed stream arrives as raw frames. On error the
+ *        previous subscription is left unchanged.
+ * @return False (after replying with an error) if the options are invalid or no pipeline is free.
+ */
+static bool applySubscriptionInternal(AsyncWebSocketClient* client, ClientState* state, JsonVariantConst request) {
+    uint8_t streamMask = 0xFF; // Also covers applications that stream without registering a schema
+    JsonArrayConst streamIds = request["streams"];
+    if (!streamIds.isNull()) {
+        streamMask = 0;
+        for (JsonVariantConst id : streamIds) {
+            int streamId = id | -1;
+            if (streamId < 0 || streamId >= getStreamCount()) {
+                sendStatusInternal(client->id(), "error", "Unknown stream id in 'streams'.");
+                return false;
+            }
+            streamMask |= (uint8_t)(1u << streamId);
+        }
+        if (streamMask == 0) {
+            sendStatusInternal(client->id(), "error", "'streams' selects no stream.");
+            return false;
+        }
+    }
+
+    JsonVariantConst options = request["decimation"];
+    DecimationMode mode = DECIMATE_NONE;
+    const char* modeName = options["mode"] | "none";
+    if (strcmp(modeName, "average") == 0) {
+        mode = DECIMATE_AVERAGE;
+    } else if (strcmp(modeName, "minmax") == 0) {
+        mode = DECIMATE_MINMAX;
+    } else if (strcmp(modeName, "none") != 0) {
+        sendStatusInternal(client->id(), "error", "Unknown decimation mode (use average, minmax or none).");
+        return false;
+    }
+    int firstStream = 0;
+    while (firstStream < 7 && !(streamMask & (1u << firstStream))) firstStream++;
+    int sourceStreamId = options["stream"].isNull() ? firstStream : (options["stream"] | -1);
+    if (sourceStreamId != firstStream && (sourceStreamId < 0 || sourceStreamId >= getStreamCount())) {
+        sendStatusInternal(client->id(), "error", "Unknown stream id in 'decimation'.");
+        return false;
+    }
+    uint32_t periodUs = getStreamPeriodUs(sourceStreamId);
+    uint32_t factor = options["factor"] | 0;
+    float rateHz = options["rateHz"] | 0.0f;
+    if (factor == 0 && rateHz > 0 && periodUs > 0) {
+        factor = (uint32_t)(1000000.0f / (rateHz * periodUs) + 0.5f);
+    }
+    if (factor > UINT16_MAX) factor = UINT16_MAX;
+    if (factor < 2) {
+        mode = DECIMATE_NONE; // At or above the source rate
+        factor = 1;
+    }
+
+    uint8_t channelMask = 0xFF;
+    JsonArrayConst channelNames = request["channels"];
+    if (!channelNames.isNull()) {
+        channelMask = 0;
+        for (JsonVariantConst name : channelNames) {
+            int channel = findStreamChannel(sourceStreamId, name.as<const char*>());
+            if (channel < 0) {
+                sendStatusInternal(client->id(), "error", "Unknown channel in 'channels'.");
+                return false;
+            }
+            channelMask |= (uint8_t)(1u << channel);
+        }
+        if (channelMask == 0) {
+            sendStatusInternal(client->id(), "error", "'channels' selects no channel.");
+            return false;
+        }
+    }
+    uint8_t allChannels = (uint8_t)((1u << getStreamChannelCount(sourceStreamId)) - 1);
+    channelMask &= allChannels;
+
+    uint8_t pipeline = 0;
+    if (mode != DECIMATE_NONE || channelMask != allChannels) {
+        if (periodUs == 0 || !(streamMask & (1u << sourceStreamId))) {
+            sendStatusInternal(client->id(), "error", "Decimation/channel selection needs a subscribed stream.");
+            return false;
+        }
+        pipeline = acquirePipelineInternal(sourceStreamId, mode, (uint16_t)factor, channelMask);
+        if (pipeline == 0) {
+            sendStatusInternal(client->id(), "error", "Decimation not available (no free pipeline or unsupported stream).");
+            return false;
+        }
+    }
+    uint8_t previous = state->pipeline; // Released after acquiring, so an unchanged view keeps its pipeline
+    state->pipeline = pipeline;
+    state->streamMask = streamMask;
+    publishRouteInternal(state);
+    releasePipelineInternal(previous);
+    return true;
+}
+
+/**
+ * @brief Moves a client's subscription from one stream mask to another and runs the per-stream
+ *        callbacks of every stream that gains its first or loses its last subscriber.
+ */
+static void updateStreamSubscribersInternal(uint8_t previousMask, uint8_t newMask) {
+    for (uint8_t s = 0; s < getStreamCount(); s++) {
+        bool was = previousMask & (1u << s);
+        bool is = newMask & (1u << s);
+        StreamSubscription& stream = _streamSubscriptions[s];
+        if (!was && is && stream.subscribers++ == 0 && stream.onStart) {
+            ESP32WS_LOGD("Stream #%u: first subscriber, starting.", s);
+            stream.onStart();
+        } else if (was && !is && stream.subscribers > 0 && --stream.subscribers == 0 && stream.onStop) {
+            ESP32WS_LOGD("Stream #%u: last subscriber left, stopping.", s);
+            stream.onStop();
+        }
+    }
+}
+
+/**
+ * @class SubscriptionLock
+ * @brief Scoped ownership of the subscriber counts (a no-op before initWiFiWebSocketServer()).
+ */
+class SubscriptionLock {
+public:
+  SubscriptionLock() : _locked(_subscriptionMutex && xSemaphoreTake(_subscriptionMutex, portMAX_DELAY) == pdTRUE) {}
+  ~SubscriptionLock() {
+    if (_locked) xSemaphoreGive(_subscriptionMutex);
+  }
+  SubscriptionLock(const SubscriptionLock&) = delete;
+  SubscriptionLock& operator=(const SubscriptionLock&) = delete;
+private:
+  bool _locked;
+};
+
+/**
+ * @brief Drops one subscriber holding the given streams. The last subscriber leaving stops acquisition.
+ */
+static void releaseStreamsInternal(uint8_t streamMask) {
+    updateStreamSubscribersInternal(streamMask, 0);
+    if (_numSubscribers > 0 && --_numSubscribers == 0 && _onStreamStopCallback != nullptr) {
+        ESP32WS_LOGD("Last subscriber left. Stopping stream.");
+        _onStreamStopCallback();
+    }
+}
+
+/**
+ * @brief Detaches the subscription from a client: clears its stream mask and releases its pipeline.
+ * @return The streams the client was subscribed to.
+ */
+static uint8_t detachSubscriptionInternal(ClientState* state) {
+    uint8_t previousMask = state->streamMask;
+    state->streamMask = 0;
+    uint8_t pipeline = state->pipeline;
+    state->pipeline = 0;
+    publishRouteInternal(state);
+    releasePipelineInternal(pipeline);
+    return previousMask;
+}
+
+/**
+ * @brief Ends a client's subscription. The last subscriber leaving stops acquisition.
+ *        Call with the SubscriptionLock held.
+ * @return True if the client was subscribed.
+ */
+static bool unsubscribeClientInternal(ClientState* state) {
+    if (!state || state->streamMask == 0) return false;
+    releaseStreamsInternal(detachSubscriptionInternal(state));
+    return true;
+}
+
+/**
+ * @brief Sends the per-client flow statistics (response to "get_client_stats").
+ */
+static void sendClientStatsInternal(uint32_t clientId) {
+    StaticJsonDocument<128 + ESP32WS_MAX_CLIENTS * 192> jsonDoc;
+    jsonDoc["status"] = "client_stats";
+    jsonDoc["defaultPolicy"] = flowPolicyToCharString(_defaultFlowPolicy);
+    JsonArray clientsArray = jsonDoc.createNestedArray("clients");
+    for (int i = 0; i < ESP32WS_MAX_CLIENTS; i++) {
+        const ClientState& state = _clientStates[i];
+        if (!state.used) continue;
+        AsyncWebSocketClient* wsClient = ws.client(state.id);
+        JsonObject clientObj = clientsArray.createNestedObject();
+        clientObj["id"] = state.id;
+        clientObj["policy"] = flowPolicyToCharString(state.hasOwnPolicy ? state.policy : _defaultFlowPolicy);
+        clientObj["sent"] = state.chunksSent;
+        clientObj["dropped"] = state.chunksDropped;
+        clientObj["congestedRun"] = state.congestedRun;
+        clientObj["streams"] = state.streamMask;
+        clientObj["pipeline"] = state.pipeline ? state.pipeline - 1 : -1;
+        clientObj["queue"] = wsClient ? clientQueueDepthInternal(wsClient) : 0;
+    }
+    sendJsonInternal(clientId, jsonDoc);
+}
+
+// --- Stream Recorder Replay ---
+
+static void startReplayTaskInternal();
+
+/**
+ * @brief Keeps the streams of a disconnecting subscriber running for ESP32WS_RECORDER_LINGER_MS
+ *        (recorder active), or ends the subscription at once. Call with the SubscriptionLock held.
+ */
+static void lingerSubscriptionInternal(ClientState* state) {
+    if (!state || state->streamMask == 0) return;
+    if (isStreamRecorderActive()) {
+        startReplayTaskInternal();
+        for (int i = 0; i < ESP32WS_MAX_CLIENTS && _replayTask; i++) {
+            if (_lingering[i].streamMask != 0) continue;
+            _lingering[i].untilMs = millis() + ESP32WS_RECORDER_LINGER_MS;
+            _lingering[i].streamMask = detachSubscriptionInternal(state);
+            ESP32WS_LOGD("Client #%u: streams 0x%02X kept for %u ms.", state->id, _lingering[i].streamMask,
+                         (unsigned)ESP32WS_RECORDER_LINGER_MS);
+            return;
+        }
+    }
+    unsubscribeClientInternal(state);
+}
+
+/**
+ * @brief Releases the lingering subscriptions that ran out (replay task).
+ */
+static void expireLingeringInternal() {
+    uint32_t now = millis();
+    SubscriptionLock lock;
+    for (int i = 0; i < ESP32WS_MAX_CLIENTS; i++) {
+        if (_lingering[i].streamMask != 0 && (int32_t)(now - _lingering[i].untilMs) >= 0) {
+            ESP32WS_LOGD("Lingering streams 0x%02X released.", _lingering[i].streamMask);
+            releaseStreamsInternal(_lingering[i].streamMask);
+            _lingering[i].streamMask = 0;
+        }
+    }
+}
+
+/**
+ * @brief Sends {"status":"replay_done","stream","frames","firstSequence","lastSequence"}: the
+ *        client's live frames of the stream follow.
+ */
+static void sendReplayDoneInternal(const ReplaySummary& summary) {
+    StaticJsonDocument<JSON_OBJECT_SIZE(5)> jsonDoc;
+    jsonDoc["status"] = "replay_done";
+    jsonDoc["stream"] = summary.streamId;
+    jsonDoc["frames"] = summary.frames;
+    if (summary.frames > 0) {
+        jsonDoc["firstSequence"] = summary.firstSequence;
+        jsonDoc["lastSequence"] = summary.lastSequence;
+    }
+    sendJsonInternal(summary.clientId, jsonDoc);
+}
+
+/**
+ * @brief Returns a message buffer of a replay slot that is not queued, or nullptr if all are in flight.
+ */
+static BinaryFrame* freeReplayFrameInternal(int slot) {
+    for (int i = 0; i < ESP32WS_RECORDER_REPLAY_QUEUE; i++) {
+        BinaryFrame* frame = _replayFrames[slot][i];
+        if (frame && frame->count() == 0) return frame;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Replay task: keeps the send queue of each replaying client topped up with recorded frames
+ *        (at most ESP32WS_RECORDER_REPLAY_QUEUE of the replay's own frames in flight, whether or not
+ *        the library reports the queue depth), so a replay runs at whatever rate the link drains
+ *        without crowding out the client's other messages. Also expires lingering subscriptions.
+ */
+static void replayTask(void* param) {
+    for (;;) {
+        bool pending = false;
+        for (int i = 0; i < ESP32WS_RECORDER_MAX_REPLAYS; i++) {
+            uint32_t clientId;
+            uint8_t streamId;
+            if (!getReplayClient(i, &clientId, &streamId)) continue;
+            AsyncWebSocketClient* client = ws.client(clientId);
+            if (!client || client->status() != WS_CONNECTED) {
+                cancelClientReplays(clientId);
+                nextReplayFrame(i, _replayBuffer, 0, nullptr); // Releases the slot
+                continue;
+            }
+            // Hold the replay (and with it the stream's live frames) until the client subscribes, so
+            // replay_since followed by start_stream leaves neither a gap nor duplicates
+            if (!(routeStreamMaskInternal(loadRouteInternal(clientId)) & (1u << streamId))) continue;
+            pending = true;
+            BinaryFrame* frame;
+            while (!client->queueIsFull() && (frame = freeReplayFrameInternal(i)) != nullptr) {
+                ReplaySummary summary = {};
+                size_t len = nextReplayFrame(i, _replayBuffer, ESP32WS_RECORDER_MAX_FRAME, &summary);
+                if (len == 0) {
+                    if (summary.completed) sendReplayDoneInternal(summary);
+                    break;
+                }
+                if (frame->length() == len || (frame->reserve(len) && frame->get() != nullptr)) {
+                    memcpy(frame->get(), _replayBuffer, len);
+                    client->binary(frame);
+                } else {
+                    client->binary(_replayBuffer, len); // Out of memory for the buffer: untracked copy
+                }
+                metricCount(METRIC_BINARY_OUT);
+                metricCount(METRIC_BINARY_BYTES_OUT, len);
+            }
+        }
+        expireLingeringInternal();
+        // Poll the queues while a replay runs; otherwise sleep until woken (replay_since, start_stream)
+        // or a lingering subscription may have expired
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(pending ? 2 : 1000));
+    }
+}
+
+/**
+ * @brief Creates the replay task and its buffer on first use.
+ */
+static void startReplayTaskInternal() {
+    if (_replayTask) return;
+    if (!_replayBuffer) _replayBuffer = (uint8_t*)malloc(ESP32WS_RECORDER_MAX_FRAME);
+    bool framesReady = true;
+    for (int slot = 0; slot < ESP32WS_RECORDER_MAX_REPLAYS; slot++) {
+        for (int i = 0; i < ESP32WS_RECORDER_REPLAY_QUEUE; i++) {
+            // Empty until the first frame sizes it; frames of one stream mostly share their length
+            if (!_replayFrames[slot][i]) _replayFrames[slot][i] = new (std::nothrow) AsyncWebSocketMessageBuffer();
+            framesReady &= _replayFrames[slot][i] != nullptr;
+        }
+    }
+    if (!_replayBuffer || !framesReady ||
+        xTaskCreate(replayTask, "esp32ws_replay", 4096, nullptr, 2, &_replayTask) != pdPASS) {
+        ESP32WS_LOGE("Replay task could not be started.");
+        _replayTask = nullptr;
+    }
+}
+
+/**
+ * @brief Handles {"action":"replay_since","stream":id,"sequence":n}: queues the recorded frames of
+ *        the stream after sequence n, then switches the client to the live frames. A reconnecting
+ *        client sends it right before start_stream: the replay starts once the client is subscribed
+ *        and withholds the stream's live frames until it has caught up.
+ */
+static void handleReplaySinceInternal(AsyncWebSocketClient* client, JsonVariantConst request) {
+    if (!isStreamRecorderActive()) {
+        sendStatusInternal(client->id(), "error", "Stream recorder not enabled.");
+        return;
+    }
+    int streamId = request["stream"] | 0;
+    if (streamId < 0 || streamId >= getStreamCount()) {
+        sendStatusInternal(client->id(), "error", "Unknown stream id in 'stream'.");
+        return;
+    }
+    if (request["sequence"].isNull()) {
+        sendStatusInternal(client->id(), "error", "Missing 'sequence' field for replay_since.");
+        return;
+    }
+    startReplayTaskInternal();
+    if (!_replayTask) {
+        sendStatusInternal(client->id(), "error", "Replay unavailable.");
+        return;
+    }
+    if (!findClientStateInternal(client->id())) {
+        sendStatusInternal(client->id(), "error", "Too many clients to track a replay.");
+        return;
+    }
+    if (beginStreamReplay(client->id(), (uint8_t)streamId, request["sequence"] | 0u) < 0) {
+        sendStatusInternal(client->id(), "error", "All replay slots busy.");
+        return;
+    }
+    sendStatusInternal(client->id(), "ok", "Replay started.");
+    xTaskNotifyGive(_replayTask);
+}
+
+// --- Metrics ---
+
+// Gauges registered with the metrics module (read when a report is built)
+static uint32_t clientCountGaugeInternal() { return ws.count(); }
+static uint32_t subscriberGaugeInternal() { return _numSubscribers; }
+static uint32_t pipelineGaugeInternal() { return _activePipelines; }
+static uint32_t maxQueueGaugeInternal() {
+    size_t deepest = 0;
+    for (AsyncWebSocketClient* c : ws.getClients()) {
+        size_t depth = clientQueueDepthInternal(c);
+        if (depth > deepest) deepest = depth;
+    }
+    return deepest;
+}
+static uint32_t freeFramesGaugeInternal() {
+    uint32_t free = 0;
+    portENTER_CRITICAL(&_framePoolMux);
+    for (uint8_t i = 0; i < _framePoolCount; i++) {
+        if (!_frameAcquired[i] && _framePool[i]->count() == 0) free++;
+    }
+    portEXIT_CRITICAL(&_framePoolMux);
+    return free;
+}
+static uint32_t freeTextBuffersGaugeInternal() {
+    uint32_t free = 0;
+    portENTER_CRITICAL(&_textBufferMux);
+    for (uint8_t i = 0; i < _numTextBuffers; i++) {
+        if (!_textBufferAcquired[i] && _textBuffers[i]->count() == 0) free++;
+    }
+    portEXIT_CRITICAL(&_textBufferMux);
+    return free;
+}
+
+/**
+ * @brief Sends the metrics report (response to "get_stats"): {"status":"stats", ...writeMetricsJson()}.
+ * @param resetTimers Clear the timing statistics after reporting them (windowed maxima).
+ */
+static void sendStatsInternal(uint32_t clientId, bool resetTimers) {
+    DynamicJsonDocument doc(getMetricsJsonCapacity() + JSON_OBJECT_SIZE(1));
+    doc["status"] = "stats";
+    writeMetricsJson(doc.as<JsonObject>());
+    if (resetTimers) resetMetricTimers();
+    sendJsonInternal(clientId, doc);
+}
+
+/**
+ * @brief Appends [type][value] for a scalar or string variable to a binary reply buffer.
+ * @return Number of bytes written.
+ */
+static size_t writeBinaryValueInternal(uint8_t* out, int index) {
+  VariableHandle handle;
+  handle.index = (int16_t)index;
+  switch (_variables[index].type) {
+    case TYPE_INT:
+    case TYPE_BOOL: {
+      int32_t v = getVariableInt(handle);
+      out[0] = BIN_TYPE_INT;
+      memcpy(out + 1, &v, sizeof(v));
+      return 1 + sizeof(v);
+    }
+    case TYPE_UINT: {
+      uint32_t v = getVariableUInt(handle);
+      out[0] = BIN_TYPE_UINT;
+      memcpy(out + 1, &v, sizeof(v));
+      return 1 + sizeof(v);
+    }
+    case TYPE_FLOAT: {
+      float v = getVariableFloat(handle);
+      out[0] = BIN_TYPE_FLOAT;
+      memcpy(out + 1, &v, sizeof(v));
+      return 1 + sizeof(v);
+    }
+    case TYPE_STRING: {
+      char text[ESP32WS_STRING_CAPACITY_MAX];
+      size_t n = readVariableString(index, text, sizeof(text));
+      if (n > 255) n = 255;
+      out[0] = BIN_TYPE_STRING;
+      out[1] = (uint8_t)n;
+      memcpy(out + 2, text, n);
+      return 2 + n;
+    }
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Applies the [type][value] payload of a BIN_CMD_SET to a variable.
+ *        Numbers convert to any numeric scalar they fit exactly (see convertVariableNumber()).
+ * @return A BinaryCommandStatus code.
+ */
+static uint8_t applyBinarySetInternal(int index, const uint8_t* payload, size_t len) {
+  if (len < 1) return BIN_STATUS_MALFORMED;
+  const WsVarDesc& var = _variables[index];
+  if (isArrayVariableInternal(var)) return BIN_STATUS_TYPE_MISMATCH;
+  uint8_t type = payload[0];
+  StagedValue staged = {(int16_t)index, 0, nullptr};
+  char text[256];
+  switch (type) {
+    case BIN_TYPE_INT:
+    case BIN_TYPE_UINT:
+    case BIN_TYPE_FLOAT: {
+      uint32_t raw;
+      if (len < 1 + sizeof(raw)) return BIN_STATUS_MALFORMED;
+      memcpy(&raw, payload + 1, sizeof(raw));
+      double value;
+      if (type == BIN_TYPE_INT) {
+        value = (double)(int32_t)raw;
+      } else if (type == BIN_TYPE_UINT) {
+        value = (double)raw;
+      } else {
+        float v;
+        memcpy(&v, &raw, sizeof(v));
+        value = (double)v;
+      }
+      uint8_t status = convertVariableNumber(index, value, &staged.bits);
+      if (status != BIN_STATUS_OK) return status;
+      break;
+    }
+    case BIN_TYPE_STRING: {
+      if (len < 2 || len < 2 + (size_t)payload[1]) return BIN_STATUS_MALFORMED;
+      if (var.type != TYPE_STRING) return BIN_STATUS_TYPE_MISMATCH;
+      if (payload[1] >= var.count) return BIN_STATUS_OUT_OF_LIMITS;
+      memcpy(text, payload + 2, payload[1]);
+      text[payload[1]] = '\0';
+      staged.data = text;
+      break;
+    }
+    default:
+      return BIN_STATUS_TYPE_MISMATCH;
+  }
+  commitClientValuesInternal(&staged, 1);
+  return BIN_STATUS_OK;
+}
+
+/**
+ * @brief Handles one binary command frame (see "Binary Command Protocol" in ESP32WebSocket.h)
+ *        and sends the binary reply to the originating client.
+ */
+static void handleBinaryCommandInternal(AsyncWebSocketClient* client, const uint8_t* data, size_t len) {
+  uint8_t reply[6 + 2 + 255];
+  reply[0] = ESP32WS_BIN_REPLY_MAGIC;
+  reply[1] = (len > 0 ? data[0] : 0) | ESP32WS_BIN_REPLY_FLAG;
+  reply[2] = len > 1 ? data[1] : 0;
+  reply[4] = len > 2 ? data[2] : 0;
+  reply[5] = len > 3 ? data[3] : 0;
+  size_t replyLen = 6;
+
+  uint8_t status;
+  uint16_t index = (uint16_t)(reply[4] | (reply[5] << 8));
+  if (len < 4) {
+    status = BIN_STATUS_MALFORMED;
+  } else if (data[0] == BIN_CMD_UPLOAD) { // 'index' is the upload id
+    if (!_uploadCallback) {
+      status = BIN_STATUS_UNKNOWN_OPCODE;
+    } else {
+      status = _uploadCallback(client->id(), index, data + 4, len - 4, _uploadContext) ? BIN_STATUS_OK : BIN_STATUS_REJECTED;
+    }
+  } else if (!_variables || index >= _numVariables) {
+    status = BIN_STATUS_UNKNOWN_VARIABLE;
+  } else if (data[0] == BIN_CMD_GET) {
+    status = isArrayVariableInternal(_variables[index]) ? BIN_STATUS_TYPE_MISMATCH : BIN_STATUS_OK;
+  } else if (data[0] == BIN_CMD_SET) {
+    status = applyBinarySetInternal(index, data + 4, len - 4);
+  } else {
+    status = BIN_STATUS_UNKNOWN_OPCODE;
+  }
+  if (status == BIN_STATUS_OK && data[0] != BIN_CMD_UPLOAD) {
+    replyLen += writeBinaryValueInternal(reply + replyLen, index);
+  }
+  reply[3] = status;
+  client->binary(reply, replyLen);
+}
+
+/**
+ * @brief Fills doc with the "var_config_list" reply (metadata and current value of every variable).
+ */
+static void buildVarConfigListInternal(JsonDocument& doc) {
+  doc["status"] = "var_config_list";
+  JsonArray varsArray = doc.createNestedArray("variables");
+  for (int i = 0; i < _numVariables; i++) {
+    JsonObject varObj = varsArray.createNestedObject();
+    varObj["name"] = _variables[i].name;
+    varObj["index"] = i; // Address used by the binary command protocol
+    varObj["type"] = varTypeToCharString(_variables[i].type);
+    if (isArrayVariableInternal(_variables[i])) varObj["count"] = _variables[i].count;
+    storeVariableValueInternal(varObj["value"], _variables[i]);
+    varObj["hasLimits"] = _variables[i].hasLimits;
+    if (_variables[i].hasLimits) {
+      varObj["min"] = _variables[i].minVal;
+      varObj["max"] = _variables[i].maxVal;
+    }
+  }
+}
+
+/**
+ * @brief Serializes the variable schema once into _schemaBuffer and derives its ETag.
+ *        Reply format: {"status":"var_schema","variables":[{"name","index","type","count","hasLimits","min","max"},...]}
+ *        ("count" only for arrays)
+ * @return True if the cached schema is available.
+ */
+static bool buildSchemaInternal() {
+  if (_schemaBuffer) return true;
+  ReplyDocLock lock;
+  if (!lock.locked()) return false;
+  JsonDocument& doc = *_replyDoc;
+  doc["status"] = "var_schema";
+  JsonArray varsArray = doc.createNestedArray("variables");
+  for (int i = 0; i < _numVariables; i++) {
+    JsonObject varObj = varsArray.createNestedObject();
+    varObj["name"] = _variables[i].name;
+    varObj["index"] = i;
+    varObj["type"] = varTypeToCharString(_variables[i].type);
+    if (isArrayVariableInternal(_variables[i])) varObj["count"] = _variables[i].count;
+    varObj["hasLimits"] = _variables[i].hasLimits;
+    if (_variables[i].hasLimits) {
+      varObj["min"] = _variables[i].minVal;
+      varObj["max"] = _variables[i].maxVal;
+    }
+  }
+  if (doc.overflowed()) return false;
+  size_t len = measureJson(doc);
+  AsyncWebSocketMessageBuffer* buffer = new (std::nothrow) AsyncWebSocketMessageBuffer(len + 1);
+  if (!buffer || buffer->get() == nullptr) {
+    ESP32WS_LOGE("Schema Error: Allocation of the schema buffer failed.");
+    delete buffer;
+    return false;
+  }
+  char* out = (char*)buffer->get();
+  serializeJson(doc, out, len + 1);
+  out[len] = ' '; // Whole buffer is sent as the text message
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (uint8_t)out[i];
+    hash *= 16777619UL;
+  }
+  snprintf(_schemaEtag, sizeof(_schemaEtag), "\"%08lx\"", (unsigned long)hash);
+  _schemaBuffer = buffer;
+  _schemaLen = len;
+  ESP32WS_LOGI("Variable schema cached: %u bytes, ETag %s", (unsigned)len, _schemaEtag);
+  return true;
+}
+
+/**
+ * @brief Handles "get_values": replies {"status":"var_snapshot","values":[v0,v1,...]} with the
+ *        current value of every variable in index order (names and metadata come from the schema).
+ */
+static void handleGetValuesInternal(AsyncWebSocketClient* client) {
+  ReplyDocLock lock;
+  if (!lock.locked()) {
+    sendStatusInternal(client->id(), "error", "Reply buffer unavailable.");
+    return;
+  }
+  JsonDocument& responseDoc = *_replyDoc;
+  responseDoc["status"] = "var_snapshot";
+  JsonArray values = responseDoc.createNestedArray("values");
+  for (int i = 0; i < _numVariables; i++) {
+    storeVariableValueInternal(values.add(), _variables[i]);
+  }
+  if (responseDoc.overflowed()) {
+    sendStatusInternal(client->id(), "error", "Value snapshot exceeds the reply buffer.");
+    return;
+  }
+  sendJsonInternal(client->id(), responseDoc);
+}
+
+/**
+ * @brief Allocates the shared reply document and the text buffer pool (once, at init).
+ *        The document is sized for the config list (the largest reply) and the large
+ *        text buffer for its measured serialization, both plus ESP32WS_JSON_STRING_RESERVE.
+ * @return True if every buffer could be allocated.
+ */
+static bool initReplyBuffersInternal() {
+  if (_replyDoc) return true;
+  size_t valueBytes = 0;
+  for (int i = 0; i < _numVariables; i++) {
+    if (_variables[i].type == TYPE_STRING) {
+      valueBytes += _variables[i].count; // Longest value the FixedString holds
+    } else if (isArrayVariableInternal(_variables[i])) {
+      valueBytes += JSON_ARRAY_SIZE(_variables[i].count);
+    }
+  }
+  size_t capacity = JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(_numVariables) + _numVariables * JSON_OBJECT_SIZE(8) +
+                    valueBytes + ESP32WS_JSON_STRING_RESERVE;
+  _replyDoc = new (std::nothrow) DynamicJsonDocument(capacity);
+  _replyDocMutex = xSemaphoreCreateMutex();
+  if (!_replyDoc || _replyDoc->capacity() == 0 || !_replyDocMutex) {
+    ESP32WS_LOGE("Reply Buffer Error: Allocation of the reply document failed.");
+    delete _replyDoc;
+    _replyDoc = nullptr;
+    return false;
+  }
+
+  bool ok = true;
+  size_t largest = 0;
+  for (const TextBufferClass& sizeClass : TEXT_BUFFER_CLASSES) {
+    for (uint8_t i = 0; i < sizeClass.count; i++) ok &= addTextBufferInternal(sizeClass.size);
+    largest = sizeClass.size;
+  }
+  buildVarConfigListInternal(*_replyDoc);
+  size_t configLen = measureJson(*_replyDoc);
+  _replyDoc->clear();
+  if (configLen + 1 > largest) ok &= addTextBufferInternal(configLen + 1 + ESP32WS_JSON_STRING_RESERVE);
+  if (!ok) ESP32WS_LOGW("Reply Buffer: Some text buffers could not be allocated.");
+  ESP32WS_LOGI("Reply buffers ready: doc %u bytes, %u text buffers (config list %u bytes).",
+               (unsigned)capacity, _numTextBuffers, (unsigned)configLen);
+  return ok;
+}
+
+/**
+ * @brief Handles "get_many": {"action":"get_many","variables":["a","b",...]}.
+ *        Replies with one {"status":"var_values","values":{...},"errors":{...}} document.
+ */
+static void handleGetManyInternal(AsyncWebSocketClient* client, JsonArray names) {
+  if (names.isNull()) {
+    sendStatusInternal(client->id(), "error", "Missing 'variables' array for get_many action.");
+    return;
+  }
+  ReplyDocLock lock;
+  if (!lock.locked()) {
+    sendStatusInternal(client->id(), "error", "Reply buffer unavailable.");
+    return;
+  }
+  JsonDocument& responseDoc = *_replyDoc;
+  responseDoc["status"] = "var_values";
+  JsonObject values = responseDoc.createNestedObject("values");
+  JsonObject errors = responseDoc.createNestedObject("errors");
+  for (JsonVariant nameVariant : names) {
+    const char* name = nameVariant.as<const char*>();
+    int index = findVariableIndexInternal(name);
+    if (index < 0) {
+      if (name) errors[name] = "Variable name not found.";
+      continue;
+    }
+    storeVariableValueInternal(values[_variables[index].name], _variables[index]);
+  }
+  if (responseDoc.overflowed()) {
+    sendStatusInternal(client->id(), "error", "get_many reply too large; request fewer variables.");
+    return;
+  }
+  sendJsonInternal(client->id(), responseDoc);
+}
+
+/**
+ * @brief Commits a group of staged set_many entries, echoes their stored values into values and
+ *        marks them in _setManyChangedBits (their callbacks run after the reply is sent).
+ */
+static void commitSetManyBatchInternal(JsonObject values, const StagedValue* staged, uint8_t count) {
+  commitVariableValues(staged, count);
+  _arrayStagingUsed = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    int index = staged[i].index;
+    const WsVarDesc& var = _variables[index];
+    ESP32WS_LOGD("Set OK: Variable '%s' updated.", var.name);
+    if (_setManyChangedBits) _setManyChangedBits[index >> 5] |= (1UL << (index & 31));
+    storeVariableValueInternal(values[var.name], var);
+  }
+}
+
+/**
+ * @brief Calls the change callback for the variables of the finished set_many and clears the set.
+ */
+static void notifySetManyChangesInternal() {
+  if (!_setManyChangedBits) return;
+  for (int w = 0; w < (_numVariables + 31) / 32; w++) {
+    uint32_t bits = _setManyChangedBits[w];
+    _setManyChangedBits[w] = 0;
+    while (bits) {
+      int bit = __builtin_ctz(bits);
+      bits &= bits - 1;
+      notifyVariableChanged(w * 32 + bit);
+    }
+  }
+}
+
+/**
+ * @brief Applies "set_many": {"action":"set_many","values":{"a":1,"b":"text",...}}.
+ *        Each entry is validated independently; the valid ones are committed together (in groups
+ *        of ESP32WS_SET_MANY_BATCH, or fewer when their arrays fill ESP32WS_ARRAY_STAGING_BYTES), so a
+ *        snapshot reader sees them change at once. The single reply
+ *        carries the stored values of the successful entries and an error per failed entry.
+ */
+static void applySetManyInternal(AsyncWebSocketClient* client, JsonObject newValues) {
+  ReplyDocLock lock;
+  if (!lock.locked()) {
+    sendStatusInternal(client->id(), "error", "Reply buffer unavailable.");
+    return;
+  }
+  JsonDocument& responseDoc = *_replyDoc;
+  responseDoc["status"] = "var_values";
+  JsonObject values = responseDoc.createNestedObject("values");
+  JsonObject errors = responseDoc.createNestedObject("errors");
+  StagedValue staged[ESP32WS_SET_MANY_BATCH];
+  uint8_t numStaged = 0;
+  for (JsonPair kv : newValues) {
+    int index = findVariableIndexInternal(kv.key().c_str());
+    if (index < 0) {
+      errors[kv.key().c_str()] = "Variable name not found.";
+      continue;
+    }
+    if (numStaged > 0 && !hasArrayStagingRoomInternal(index)) { // Arrays of the batch fill the staging buffer
+      commitSetManyBatchInternal(values, staged, numStaged);
+      numStaged = 0;
+    }
+    if (!stageVariableValueInternal(index, kv.value(), staged[numStaged])) {
+      errors[_variables[index].name] = "Failed to set value (invalid type or out of limits).";
+    } else if (++numStaged == ESP32WS_SET_MANY_BATCH) {
+      commitSetManyBatchInternal(values, staged, numStaged);
+      numStaged = 0;
+    }
+  }
+  commitSetManyBatchInternal(values, staged, numStaged);
+  if (responseDoc.overflowed()) { // Values are already applied; only the echo is lost
+    sendStatusInternal(client->id(), "error", "set_many reply too large; values applied.");
+    return;
+  }
+  sendJsonInternal(client->id(), responseDoc);
+}
+
+/**
+ * @brief Handles "set_many" (see applySetManyInternal()). The change callbacks run after the reply
+ *        lock is released, so a callback that broadcasts cannot deadlock on it.
+ */
+static void handleSetManyInternal(AsyncWebSocketClient* client, JsonObject newValues) {
+  if (newValues.isNull()) {
+    sendStatusInternal(client->id(), "error", "Missing 'values' object for set_many action.");
+    return;
+  }
+  applySetManyInternal(client, newValues);
+  notifySetManyChangesInternal();
+}
+
+// --- Static Asset Handler ---
+
+/**
+ * @brief Computes the ETag of a static asset from the bytes that are actually served.
+ */
+static bool computeStaticAssetEtagInternal(StaticAssetState& asset) {
+  File file = LittleFS.open(asset.fsPath, FILE_READ);
+  if (!file) return false;
+  uint8_t chunk[512];
+  uint32_t hash = 2166136261UL;
+  size_t n;
+  while ((n = file.read(chunk, sizeof(chunk))) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      hash ^= chunk[i];
+      hash *= 16777619UL;
+    }
+  }
+  file.close();
+  snprintf(asset.etag, sizeof(asset.etag), "\"%08lx\"", (unsigned long)hash);
+  asset.etagValid = true;
+  return true;
+}
+
+/**
+ * @class StaticAssetHandler
+ * @brief Single HTTP handler for every entry of libraryStaticFilesToServe. The LittleFS lookups
+ *        (including the ".gz" variant produced at build time by scripts/gzip_data.py) happen once
+ *        in resolveStaticAssetsInternal(); a request only opens the file, or answers 304 when the
+ *        browser already holds the current ETag. The ".gz" file is only sent to clients that accept
+ *        gzip; others get the plain file, or 406 when only the ".gz" one is stored.
+ */
+class StaticAssetHandler : public AsyncWebHandler {
+public:
+  bool canHandle(AsyncWebServerRequest *request) override {
+    if (request->method() != HTTP_GET || findAsset(request->url().c_str()) < 0) return false;
+    // Headers not declared here are dropped by the server before handleRequest()
+    request->addInterestingHeader("If-None-Match");
+    request->addInterestingHeader("Accept-Encoding");
+    return true;
+  }
+
+  void handleRequest(AsyncWebServerRequest *request) override {
+    int index = findAsset(request->url().c_str());
+    if (index < 0) return; // canHandle() already matched
+    uint8_t fsState = __atomic_load_n(&_fsState, __ATOMIC_ACQUIRE);
+    if (fsState != FS_STATE_READY) { // Still mounting (the browser retries), or no filesystem
+      AsyncWebServerResponse* response = request->beginResponse(503, "text/plain",
+          fsState == FS_STATE_PENDING ? "Starting up, retry shortly" : "Filesystem unavailable");
+      response->addHeader("Retry-After", "1");
+      request->send(response);
+      return;
+    }
+    StaticAssetState& asset = _staticAssets[index];
+    const char* contentType = libraryStaticFilesToServe[index].contentType;
+    if (!asset.present) {
+      ESP32WS_LOGW("HTTP GET: %s, File %s NOT FOUND in LittleFS", request->url().c_str(), asset.fsPath.c_str());
+      request->send(404, "text/plain", "File Not Found in LittleFS");
+      return;
+    }
+    bool sendGzip = asset.gzipped && acceptsGzip(request);
+    if (asset.gzipped && !sendGzip && !asset.plainPresent) {
+      request->send(406, "text/plain", "Only a gzip-encoded version of this file is available");
+      return;
+    }
+    // The ETag hashes the stored file, which is the .gz one whenever it exists
+    if (!asset.etagValid) computeStaticAssetEtagInternal(asset);
+    bool hasEtag = asset.etagValid && (sendGzip || !asset.gzipped);
+    AsyncWebServerResponse* response;
+    if (hasEtag && request->hasHeader("If-None-Match") &&
+        request->getHeader("If-None-Match")->value() == asset.etag) {
+      response = request->beginResponse(304);
+    } else {
+      String path = asset.fsPath;
+      if (asset.gzipped && !sendGzip) path.remove(path.length() - 3); // Plain file next to the .gz one
+      File file = LittleFS.open(path, FILE_READ);
+      if (!file) {
+        request->send(500, "text/plain", "Failed to open file");
+        return;
+      }
+      // Serving path is the stored file's name so the response neither renames nor re-encodes it
+      response = request->beginResponse(file, path, contentType);
+      if (sendGzip) response->addHeader("Content-Encoding", "gzip");
+      ESP32WS_LOGD("HTTP GET: %s, serving %s as %s", request->url().c_str(), path.c_str(), contentType);
+    }
+    if (hasEtag) response->addHeader("ETag", asset.etag);
+    if (asset.gzipped) response->addHeader("Vary", "Accept-Encoding");
+    response->addHeader("Cache-Control", hasEtag && isCurrentVersion(request, asset) ?
+                                         ESP32WS_VERSIONED_CACHE_CONTROL : "no-cache");
+    request->send(response);
+  }
+
+private:
+  static bool acceptsGzip(AsyncWebServerRequest *request) {
+    return request->hasHeader("Accept-Encoding") && request->getHeader("Accept-Encoding")->value().indexOf("gzip") >= 0;
+  }
+
+  /**
+   * @brief True if the URL carries "?v=" with the served file's ETag (without quotes), so the
+   *        response can never change and may be cached as immutable.
+   */
+  static bool isCurrentVersion(AsyncWebServerRequest *request, const StaticAssetState& asset) {
+    if (!request->hasParam("v")) return false;
+    const String& version = request->getParam("v")->value();
+    return version.length() == 8 && strncmp(version.c_str(), asset.etag + 1, 8) == 0;
+  }
+
+  static int findAsset(const char* url) {
+    for (size_t i = 0; i < numLibraryStaticFilesToServe; i++) {
+      if (strcmp(url, libraryStaticFilesToServe[i].path) == 0) return (int)i;
+    }
+    return -1;
+  }
+};
+
+static StaticAssetHandler _staticAssetHandler;
+
+/**
+ * @brief Resolves each static file entry to its LittleFS file (preferring "<path>.gz"). Requires LittleFS mounted.
+ */
+static void resolveStaticAssetsInternal() {
+  for (size_t i = 0; i < numLibraryStaticFilesToServe; i++) {
+    StaticAssetState& asset = _staticAssets[i];
+    const char* path = libraryStaticFilesToServe[i].path;
+    String plainPath = strcmp(path, "/") == 0 ? String("/index.html") : String(path);
+    String gzPath = plainPath + ".gz";
+    asset.gzipped = LittleFS.exists(gzPath);
+    asset.fsPath = asset.gzipped ? gzPath : plainPath;
+    asset.plainPresent = LittleFS.exists(plainPath);
+    asset.present = asset.gzipped || asset.plainPresent;
+    asset.etagValid = false;
+    ESP32WS_LOGI("Static file %s -> %s%s", path, asset.fsPath.c_str(), asset.present ? "" : " (MISSING)");
+  }
+}
+
+/**
+ * @brief Mounts LittleFS, resolves the static assets and precomputes their ETags, then publishes
+ *        _fsState (READY or FAILED). Runs in mountFilesystemTask(), or inline if that task could
+ *        not be created.
+ */
+static void mountFilesystemInternal() {
+  ESP32WS_LOGI("Initializing LittleFS...");
+  if (!LittleFS.begin(ESP32WS_FS_FORMAT_ON_FAIL)) {
+    ESP32WS_LOGE("CRITICAL ERROR: LittleFS Mount Failed! Static files will not be served.");
+    ESP32WS_LOGE("--> Please ensure LittleFS is correctly formatted and data uploaded.");
+    __atomic_store_n(&_fsState, (uint8_t)FS_STATE_FAILED, __ATOMIC_RELEASE);
+    return;
+  }
+  metricBootPhase(BOOT_FS_MOUNTED);
+  resolveStaticAssetsInternal();
+  for (size_t i = 0; i < numLibraryStaticFilesToServe; i++) {
+    if (_staticAssets[i].present) computeStaticAssetEtagInternal(_staticAssets[i]);
+  }
+  __atomic_store_n(&_fsState, (uint8_t)FS_STATE_READY, __ATOMIC_RELEASE);
+  metricBootPhase(BOOT_ASSETS_READY);
+}
+
+/**
+ * @brief Runs mountFilesystemInternal() and deletes itself. Runs on the core not running
+ *        initWiFiWebSocketServer(), in parallel with the WiFi bring-up; the WebSocket accepts
+ *        connections meanwhile.
+ */
+static void mountFilesystemTask(void* param) {
+  mountFilesystemInternal();
+  vTaskDelete(nullptr);
+}
+
+// --- Command Dispatch ---
+
+/**
+ * @brief Runs the action of a parsed JSON command and replies to the sending client.
+ */
+static void dispatchTextCommandInternal(AsyncWebSocketClient* client, JsonDocument& jsonDoc) {
+  const char* action = jsonDoc["action"];
+  if (!action) {
+     ESP32WS_LOGD("JSON missing 'action' field.");
+     sendStatusInternal(client->id(), "error", "JSON missing 'action' field."); return;
+  }
+
+  if (strcmp(action, "get") == 0 || strcmp(action, "set") == 0) {
+      const char* variableName = jsonDoc["variable"];
+      if (!variableName) { 
+        ESP32WS_LOGD("Missing 'variable' field for get/set action.");
+        sendStatusInternal(client->id(), "error", "Missing 'variable' field for get/set action."); return; 
+      }
+      int varIndex = findVariableIndexInternal(variableName);
+      if (varIndex == -1) { 
+        ESP32WS_LOGD("Variable name '%s' not found.", variableName);
+        sendStatusInternal(client->id(), "error", "Variable name not found."); return; 
+      }
+
+      if (strcmp(action, "get") == 0) {
+          sendVariableValueInternal(client->id(), varIndex); 
+      } else { // action == "set"
+          if (!jsonDoc.containsKey("value") || jsonDoc["value"].isNull()) { 
+            ESP32WS_LOGD("Missing or null 'value' field for set action.");
+            sendStatusInternal(client->id(), "error", "Missing or null 'value' field for set action."); return; 
+          }
+          JsonVariant newValueVariant = jsonDoc["value"];
+          if (setVariableValueInternal(varIndex, newValueVariant)) {
+              sendVariableValueInternal(client->id(), varIndex); // Send back the updated value
+              // Optionally, broadcast to all clients if variable was set by one client
+              // broadcastVariableUpdate(variableName); 
+          } else {
+              // Error message already printed by setVariableValueInternal if DEBUG is on
+              sendStatusInternal(client->id(), "error", "Failed to set value (invalid type or out of limits).");
+          }
+      }
+  } 
+  else if (strcmp(action, "start_stream") == 0) {
+      if (_onStreamStartCallback == nullptr && !_hasStreamCallbacks) {
+          ESP32WS_LOGD("Action: start_stream - No callback registered.");
+          sendStatusInternal(client->id(), "error", "Streaming feature not implemented/configured.");
+          return;
+      }
+      ClientState* state = findClientStateInternal(client->id());
+      if (!state) {
+          sendStatusInternal(client->id(), "error", "Too many clients to track a subscription.");
+          return;
+      }
+      SubscriptionLock lock;
+      uint8_t previousMask = state->streamMask;
+      if (!applySubscriptionInternal(client, state, jsonDoc.as<JsonVariantConst>())) return;
+      if (_replayTask) xTaskNotifyGive(_replayTask); // A held replay may start now
+      sendStreamSchemaInternal(client); // Before the first frame, and again whenever the view changes
+      updateStreamSubscribersInternal(previousMask, state->streamMask);
+      if (previousMask != 0) {
+          sendStatusInternal(client->id(), "ok", "Subscription updated.");
+      } else if (_numSubscribers++ == 0) {
+          ESP32WS_LOGD("Action: start_stream - First subscriber, calling app callback.");
+          if (_onStreamStartCallback) _onStreamStartCallback();
+          sendStatusInternal(client->id(), "ok", "Stream started.");
+      } else {
+          ESP32WS_LOGD("Client #%u subscribed (%u subscribers).", client->id(), _numSubscribers);
+          sendStatusInternal(client->id(), "info", "Stream was already active.");
+      }
+  } 
+  else if (strcmp(action, "stop_stream") == 0) {
+      if (_onStreamStopCallback == nullptr && !_hasStreamCallbacks) {
+          ESP32WS_LOGD("Action: stop_stream - No callback registered.");
+          sendStatusInternal(client->id(), "error", "Streaming feature not implemented/configured.");
+          return;
+      }
+      // Only this client's subscription ends; the stream keeps running for the others
+      SubscriptionLock lock;
+      cancelClientReplays(client->id());
+      if (unsubscribeClientInternal(findClientStateInternal(client->id()))) {
+          sendStatusInternal(client->id(), "ok", "Stream stopped.");
+      } else {
+          ESP32WS_LOGD("Stream was already stopped.");
+          sendStatusInternal(client->id(), "info", "Stream was already stopped.");
+      }
+  }
+  else if (strcmp(action, "replay_since") == 0) {
+      handleReplaySinceInternal(client, jsonDoc.as<JsonVariantConst>());
+  }
+  else if (strcmp(action, "get_all_vars_config") == 0) {
+      ESP32WS_LOGD("Action: get_all_vars_config received from #%u", client->id());
+      if (!_variables || _numVariables <= 0) {
+          sendStatusInternal(client->id(), "error", "No variables configured on server.");
+          return;
+      }
+      
+      ReplyDocLock lock;
+      if (!lock.locked()) {
+          sendStatusInternal(client->id(), "error", "Reply buffer unavailable.");
+          return;
+      }
+      buildVarConfigListInternal(*_replyDoc);
+      if (_replyDoc->overflowed()) {
+          sendStatusInternal(client->id(), "error", "Variable config list exceeds the reply buffer.");
+          return;
+      }
+      sendJsonInternal(client->id(), *_replyDoc);
+      ESP32WS_LOGD("Sent var_config_list to client.");
+  }
+  else if (strcmp(action, "get_schema") == 0) {
+      if (!_schemaBuffer) {
+          sendStatusInternal(client->id(), "error", "Variable schema unavailable.");
+          return;
+      }
+      client->text(_schemaBuffer); // Shared, read-only: each queued message just holds a reference
+  }
+  else if (strcmp(action, "get_stream_schema") == 0) {
+      if (!getStreamSchemaMessage()) {
+          sendStatusInternal(client->id(), "error", "No streams registered.");
+          return;
+      }
+      sendStreamSchemaInternal(client); // Raw views share the cached, read-only message
+  }
+  else if (strcmp(action, "get_values") == 0) {
+      handleGetValuesInternal(client);
+  }
+  else if (strcmp(action, "get_many") == 0) {
+      handleGetManyInternal(client, jsonDoc["variables"]);
+  }
+  else if (strcmp(action, "set_many") == 0) {
+      handleSetManyInternal(client, jsonDoc["values"]);
+  }
+  else if (strcmp(action, "get_client_stats") == 0) {
+      sendClientStatsInternal(client->id());
+  }
+  else if (strcmp(action, "get_stats") == 0) {
+      sendStatsInternal(client->id(), jsonDoc["reset"] | false);
+  }
+  else if (strcmp(action, "set_flow_policy") == 0) {
+      FlowPolicy policy;
+      if (!flowPolicyFromCharString(jsonDoc["policy"], policy)) {
+          sendStatusInternal(client->id(), "error", "Invalid or missing 'policy' (drop, decimate, disconnect).");
+      } else if (setClientFlowPolicy(client->id(), policy)) {
+          sendStatusInternal(client->id(), "ok", "Flow policy updated.");
+      } else {
+          sendStatusInternal(client->id(), "error", "Client not tracked; flow policy unchanged.");
+      }
+  }
+  else {
+      ESP32WS_LOGD("Unknown action received: %s", action);
+      sendStatusInternal(client->id(), "error", "Unknown 'action' command.");
+  }
+}
+
+/**
+ * @brief Parses a complete text message and dispatches it. Commands that do not fit the regular
+ *        document are parsed into the large command document instead (see "Large and Fragmented
+ *        Messages" in the header); a reassembled message is parsed in place from its arena.
+ * @param inArena True if data is a receive arena (writable, and parsed without copying its strings).
+ */
+static void handleTextMessageInternal(AsyncWebSocketClient* client, uint8_t* data, size_t len, bool inArena) {
+  MetricScope timing(METRIC_TIMER_WS_TEXT); // Parse, dispatch and reply
+  ESP32WS_LOGD("Received Text from #%u (%u bytes)", client->id(), (unsigned)len);
+
+  StaticJsonDocument<ESP32WS_JSON_COMMAND_CAPACITY> commandDoc; // Sized for batched commands
+  JsonDocument* jsonDoc = &commandDoc;
+  DeserializationError error = DeserializationError::NoMemory;
+  if (!inArena || !_largeCommandDoc) error = deserializeJson(commandDoc, (const char*)data, len);
+  if (error == DeserializationError::NoMemory && _largeCommandDoc) {
+    jsonDoc = _largeCommandDoc;
+    error = inArena ? deserializeJson(*jsonDoc, (char*)data, len) // Zero-copy: strings stay in the arena
+                    : deserializeJson(*jsonDoc, (const char*)data, len);
+  }
+  if (error) {
+    metricCount(METRIC_JSON_ERRORS);
+    ESP32WS_LOGE("JSON Parse Error: %s", error.c_str()); // Always log parse errors
+    sendStatusInternal(client->id(), "error", error == DeserializationError::NoMemory
+                                              ? "JSON command too large." : "Invalid JSON format received.");
+    return;
+  }
+  dispatchTextCommandInternal(client, *jsonDoc);
+}
+
+/**
+ * @brief Returns the client's receive arena to the pool and resets its reassembly state.
+ */
+static void releaseRxArenaInternal(ClientState* state) {
+  if (!state) return;
+  if (state->rxArena) _rxArenaTaken[state->rxArena - 1] = false;
+  state->rxArena = 0;
+  state->rxOverflow = false;
+  state->rxLen = 0;
+}
+
+/**
+ * @brief Collects a message that arrives in pieces: fragmented into several frames, or a frame split
+ *        over several data events (longer than a TCP segment). The pieces are copied into a receive
+ *        arena, so nothing is allocated per piece, and the complete message is handled like a
+ *        single-frame one. Oversized messages are skipped to their end and answered with an error.
+ */
+static void reassembleMessageInternal(AsyncWebSocketClient* client, AwsFrameInfo* info, uint8_t* data, size_t len) {
+  ClientState* state = findClientStateInternal(client->id());
+  bool first = info->num == 0 && info->index == 0;
+  bool last = info->final && info->index + len == info->len;
+  if (!state) {
+    if (last) sendStatusInternal(client->id(), "error", "Message in several parts from an untracked client ignored.");
+    return;
+  }
+  if (first) {
+    releaseRxArenaInternal(state); // An earlier message that never completed
+    state->rxOpcode = info->message_opcode;
+    state->rxOverflow = true;
+    if (info->len <= ESP32WS_RX_ARENA_BYTES) {
+      for (int i = 0; i < ESP32WS_RX_ARENAS; i++) {
+        if (_rxArenas[i] && !_rxArenaTaken[i]) {
+          _rxArenaTaken[i] = true;
+          state->rxArena = i + 1;
+          state->rxOverflow = false;
+          break;
+        }
+      }
+    }
+  } else if (!state->rxArena && !state->rxOverflow) {
+    return; // Continuation of a message whose start was not seen
+  }
+  if (!state->rxOverflow) {
+    if (state->rxLen + len > ESP32WS_RX_ARENA_BYTES) {
+      state->rxOverflow = true;
+    } else {
+      memcpy(_rxArenas[state->rxArena - 1] + state->rxLen, data, len);
+      state->rxLen += len;
+    }
+  }
+  if (!last) return;
+
+  metricCount(METRIC_WS_MESSAGES_IN);
+  metricCount(METRIC_WS_REASSEMBLED);
+  if (state->rxOverflow) {
+    metricCount(METRIC_WS_OVERSIZED);
+    ESP32WS_LOGW("Message from #%u discarded: larger than %u bytes or no receive arena free.",
+                 client->id(), (unsigned)ESP32WS_RX_ARENA_BYTES);
+    sendStatusInternal(client->id(), "error", "Message too large or receive buffers busy.");
+  } else if (state->rxOpcode == WS_TEXT) {
+    handleTextMessageInternal(client, _rxArenas[state->rxArena - 1], state->rxLen, true);
+  } else if (state->rxOpcode == WS_BINARY) {
+    MetricScope timing(METRIC_TIMER_WS_BINARY);
+    handleBinaryCommandInternal(client, _rxArenas[state->rxArena - 1], state->rxLen);
+  }
+  releaseRxArenaInternal(state);
+}
+
+/**
+ * @brief Allocates the receive arenas and the large command document (once, at init).
+ *        The arenas go to PSRAM when there is some. Large messages are refused without them.
+ */
+static void initReceiveBuffersInternal() {
+  for (int i = 0; i < ESP32WS_RX_ARENAS; i++) {
+    if (_rxArenas[i]) continue;
+    _rxArenas[i] = (uint8_t*)heap_caps_malloc(ESP32WS_RX_ARENA_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!_rxArenas[i]) _rxArenas[i] = (uint8_t*)malloc(ESP32WS_RX_ARENA_BYTES);
+    if (!_rxArenas[i]) ESP32WS_LOGW("Receive arena %d of %u bytes could not be allocated.", i, (unsigned)ESP32WS_RX_ARENA_BYTES);
+  }
+  if (ESP32WS_JSON_LARGE_COMMAND_CAPACITY > 0 && !_largeCommandDoc) {
+    _largeCommandDoc = new (std::nothrow) DynamicJsonDocument(ESP32WS_JSON_LARGE_COMMAND_CAPACITY);
+    if (_largeCommandDoc && _largeCommandDoc->capacity() == 0) {
+      delete _largeCommandDoc;
+      _largeCommandDoc = nullptr;
+    }
+    if (!_largeCommandDoc) ESP32WS_LOGW("Large command document could not be allocated; JSON commands limited to %u bytes of document.",
+                                        (unsigned)ESP32WS_JSON_COMMAND_CAPACITY);
+  }
+}
+
+// --- Main WebSocket Event Handler ---
+
+/**
+ * @brief Callback function invoked by the AsyncWebSocket library for various events.
+ */
+static void onWebSocketEvent(AsyncWebSocket *serverArg, AsyncWebSocketClient *client, AwsEventType type,
+                             void *arg, uint8_t *data, size_t len) {
+  _asyncTcpTask = xTaskGetCurrentTaskHandle(); // Always the same task; see _textBuffers
+  switch (type) {
+    case WS_EVT_CONNECT:
+      metricCount(METRIC_CLIENT_CONNECTS);
+      ESP32WS_LOGI("WebSocket Client #%u connected from %s", client->id(), client->remoteIP().toString().c_str());
+      if (!addClientStateInternal(client->id())) {
+          ESP32WS_LOGW("Client #%u not tracked (more than %d clients). Flow control limited.", client->id(), ESP32WS_MAX_CLIENTS);
+      }
+      break;
+
+    case WS_EVT_DISCONNECT:
+      metricCount(METRIC_CLIENT_DISCONNECTS);
+      ESP32WS_LOGI("WebSocket Client #%u disconnected", client->id());
+      cancelClientReplays(client->id());
+      {
+          SubscriptionLock lock;
+          // Stops the stream if it was the last subscriber (after a linger period with the recorder active)
+          lingerSubscriptionInternal(findClientStateInternal(client->id()));
+      }
+      releaseRxArenaInternal(findClientStateInternal(client->id())); // A message cut off by the disconnect
+      removeClientStateInternal(client->id());
+      break;
+
+    case WS_EVT_DATA:
+      { 
+        AwsFrameInfo *info = (AwsFrameInfo*)arg;
+        metricCount(METRIC_WS_BYTES_IN, len);
+        bool whole = info->final && info->num == 0 && info->index == 0 && info->len == len;
+        if (!whole) {
+          reassembleMessageInternal(client, info, data, len);
+        } else if (info->opcode == WS_TEXT) {
+          metricCount(METRIC_WS_MESSAGES_IN);
+          handleTextMessageInternal(client, data, len, false);
+        } else if (info->opcode == WS_BINARY) {
+          metricCount(METRIC_WS_MESSAGES_IN);
+          MetricScope timing(METRIC_TIMER_WS_BINARY);
+          handleBinaryCommandInternal(client, data, len);
+        }
+      } 
+      break;
+
+    case WS_EVT_PONG: 
+      // ESP32WS_LOGD("WebSocket Pong received from #%u", client->id()); 
+      break;
+
+    case WS_EVT_ERROR: // This event gives limited info, usually just an error code
+      // arg is a uint16_t* (error code), data is a char* (error message)
+      ESP32WS_LOGW("WebSocket Client #%u error #%u: %s", client->id(), *((uint16_t*)arg), (char*)data);
+      break;
+  } 
+}
+
+// --- Public Function Implementations ---
+
+void initWiFiWebSocketServer(const char *ssid, const char *password,
+                              const uint8_t staticIpParam[4],
+                              const WsVarDesc *appVariables, int appNumVariables,
+                              ArRequestHandlerFunction customNotFoundHandler) { // Renamed for clarity
+
+  metricBootPhase(BOOT_INIT_START);
+  _variables = appVariables;
+  _numVariables = appNumVariables;
+
+  ESP32WS_LOGI("--- initWiFiWebSocketServer: START ---");
+
+  // Validate variable configuration
+  if (appNumVariables < 0) {
+      ESP32WS_LOGE("CRITICAL ERROR: appNumVariables cannot be negative.");
+      return;
+  }
+  if (appNumVariables > 0 && !appVariables) { 
+      ESP32WS_LOGE("CRITICAL ERROR: appVariables is NULL but appNumVariables is greater than 0.");
+      return; 
+  }
+  if (appNumVariables == 0) {
+      ESP32WS_LOGI("Initializing without application variables (appNumVariables is 0).");
+  } else {
+      ESP32WS_LOGI("Variable array parameters check OK.");
+  }
+  buildVariableIndexInternal();
+  if (!initVariableStore(appVariables, appNumVariables)) {
+      ESP32WS_LOGE("Variable table is malformed; variables will read as 0 and reject sets.");
+  }
+  initVariablePersistence(appVariables, appNumVariables); // Restores the persistent() variables before clients connect
+  free(_dirtyBits);
+  _dirtyBits = appNumVariables > 0 ? (uint32_t*)calloc((appNumVariables + 31) / 32, sizeof(uint32_t)) : nullptr;
+  free(_dirtySnapshot);
+  _dirtySnapshot = appNumVariables > 0 ? (uint32_t*)calloc((appNumVariables + 31) / 32, sizeof(uint32_t)) : nullptr;
+  free(_setManyChangedBits);
+  _setManyChangedBits = appNumVariables > 0 ? (uint32_t*)calloc((appNumVariables + 31) / 32, sizeof(uint32_t)) : nullptr;
+  if (appNumVariables > 0 && (!_dirtyBits || !_dirtySnapshot || !_setManyChangedBits)) {
+      ESP32WS_LOGE("Out of memory for the dirty sets; markVariableChanged() or set_many callbacks are inactive.");
+  }
+  initReplyBuffersInternal(); // Replies fall back to heap Strings for whatever could not be allocated
+  initReceiveBuffersInternal(); // Without them, only commands of a single frame and TCP segment are accepted
+  if (!_pipelineMutex) _pipelineMutex = xSemaphoreCreateMutex(); // Without it decimation requests are refused
+  if (!_subscriptionMutex) _subscriptionMutex = xSemaphoreCreateMutex();
+  registerMetricGauge("ws_clients", clientCountGaugeInternal);
+  registerMetricGauge("ws_max_queue_depth", maxQueueGaugeInternal);
+  registerMetricGauge("stream_subscribers", subscriberGaugeInternal);
+  registerMetricGauge("stream_pipelines", pipelineGaugeInternal);
+  registerMetricGauge("frame_pool_free", freeFramesGaugeInternal);
+  registerMetricGauge("text_buffers_free", freeTextBuffersGaugeInternal);
+  registerMetricGauge("log_lines_dropped", getDroppedLogLines);
+  buildSchemaInternal();
+
+
+  // --- Mount LittleFS on the other core, in parallel with the WiFi bring-up ---
+  if (numLibraryStaticFilesToServe > 0 && __atomic_load_n(&_fsState, __ATOMIC_ACQUIRE) != FS_STATE_READY) {
+      __atomic_store_n(&_fsState, (uint8_t)FS_STATE_PENDING, __ATOMIC_RELEASE);
+      if (xTaskCreatePinnedToCore(mountFilesystemTask, "esp32ws_fs", 4096, nullptr, 1, nullptr,
+                                  xPortGetCoreID() ^ 1) != pdPASS) {
+          ESP32WS_LOGW("Filesystem task not created; mounting LittleFS inline.");
+          mountFilesystemInternal();
+      }
+  }
+
+  // Bring WiFi up: own access point (default), station on an existing network, or both
+  if (!startNetwork(ssid, password, staticIpParam)) {
+      ESP32WS_LOGE("CRITICAL ERROR: No WiFi interface could be started!");
+      return; 
+  }
+  metricBootPhase(BOOT_NETWORK_STARTED);
 
   // Configure WebSocket Server
-  #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-  Serial.println(F("[ESP32WS] Configuring WebSocket server..."));
-  #endif
+  ESP32WS_LOGI("Configuring WebSocket server...");
   ws.onEvent(onWebSocketEvent); 
   server.addHandler(&ws);
-  #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-  Serial.println(F("[ESP32WS] WebSocket handler attached to /ws endpoint.")); 
-  #endif
+  ESP32WS_LOGI("WebSocket handler attached to /ws endpoint."); 
 
   // Configure HTTP Server to Serve Static Files from LittleFS using the internal list
-  #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-  Serial.println(F("[ESP32WS] Configuring HTTP server for static files from internal library list..."));
-  #endif
+  ESP32WS_LOGI("Configuring HTTP server for static files from internal library list...");
   if (numLibraryStaticFilesToServe > 0) {
-    for (size_t i = 0; i < numLibraryStaticFilesToServe; i++) {
-      const char* path_capture = libraryStaticFilesToServe[i].path;
-      const char* contentType_capture = libraryStaticFilesToServe[i].contentType;
-
-      if (strcmp(path_capture, "/") == 0) {
-          server.on("/", HTTP_GET, [contentType_capture](AsyncWebServerRequest *request){ 
-              String fsPath = "/index.html"; 
-              if (LittleFS.exists(fsPath)) {
-                  #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-                  Serial.printf("[ESP32WS] HTTP GET: /, serving %s as %s\n", fsPath.c_str(), contentType_capture);
-                  #endif
-                  request->send(LittleFS, fsPath, contentType_capture);
-              } else {
-                  Serial.printf("[ESP32WS] HTTP GET: /, File %s NOT FOUND in LittleFS\n", fsPath.c_str());
-                  request->send(404, "text/plain", "/index.html Not Found in LittleFS");
-              }
-          });
-          #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-          Serial.printf("[ESP32WS] Registered handler for: / (serving /index.html, Content-Type: %s)\n", contentType_capture);
-          #endif
-      } else {
-          server.on(path_capture, HTTP_GET, [path_capture, contentType_capture](AsyncWebServerRequest *request){
-              String fsPath = String(path_capture); 
-              if (LittleFS.exists(fsPath)) {
-                  #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-                  Serial.printf("[ESP32WS] HTTP GET: %s, serving %s as %s\n", request->url().c_str(), fsPath.c_str(), contentType_capture);
-                  #endif
-                  request->send(LittleFS, fsPath, contentType_capture);
-              } else {
-                  Serial.printf("[ESP32WS] HTTP GET: %s, File %s NOT FOUND in LittleFS\n", request->url().c_str(), fsPath.c_str());
-                  request->send(404, "text/plain", "File Not Found in LittleFS");
-              }
-          });
-          #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-          Serial.printf("[ESP32WS] Registered handler for: %s (Content-Type: %s)\n", path_capture, contentType_capture);
-          #endif
-      }
-    }
+    server.addHandler(&_staticAssetHandler); // Assets are resolved by mountFilesystemTask()
+    ESP32WS_LOGI("Registered static file handler for %u files.", (unsigned)numLibraryStaticFilesToServe);
   } else {
-    #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-    Serial.println(F("[ESP32WS] No static files defined in libraryStaticFilesToServe array. Serving default root message."));
-    #endif
+    ESP32WS_LOGI("No static files defined in libraryStaticFilesToServe array. Serving default root message.");
     server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
         request->send(200, "text/plain", "ESP32 Server Active. No index.html configured in library's file list.");
     });
   }
 
+  // Cached variable schema over HTTP, revalidated by the browser with If-None-Match
+  server.on("/schema.json", HTTP_GET, [](AsyncWebServerRequest *request){
+      if (!_schemaBuffer) {
+          request->send(503, "text/plain", "Variable schema unavailable");
+          return;
+      }
+      AsyncWebServerResponse* response;
+      if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == _schemaEtag) {
+          response = request->beginResponse(304);
+      } else {
+          response = request->beginResponse_P(200, "application/json", _schemaBuffer->get(), _schemaLen);
+      }
+      response->addHeader("ETag", _schemaEtag);
+      response->addHeader("Cache-Control", "no-cache"); // Always revalidate: a reflash may change the schema
+      response->addHeader("Access-Control-Allow-Origin", "*"); // Readable by a dashboard served by another node
+      request->send(response);
+  });
+
+  // Cached stream schema (the "stream_schema" message) for scanners and multi-node dashboards
+  server.on("/streams.json", HTTP_GET, [](AsyncWebServerRequest *request){
+      AsyncWebSocketMessageBuffer* schema = getStreamSchemaMessage();
+      if (!schema) {
+          request->send(404, "text/plain", "No stream registered");
+          return;
+      }
+      AsyncWebServerResponse* response = request->beginResponse_P(200, "application/json", (const uint8_t*)schema->get(), schema->length());
+      response->addHeader("Cache-Control", "no-cache");
+      response->addHeader("Access-Control-Allow-Origin", "*");
+      request->send(response);
+  });
+
+  // Recorded capture files (the recorder's spill file), with Range support for resumed downloads
+  addCaptureRoutes(server);
+
+  // Metrics in the Prometheus text format (the same data as the "get_stats" action)
+  server.on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request){
+      AsyncResponseStream* response = request->beginResponseStream("text/plain; version=0.0.4");
+      writeMetricsText(*response);
+      response->addHeader("Cache-Control", "no-store");
+      request->send(response);
+  });
+
   // Configure Not Found Handler
   if (customNotFoundHandler) {
-      #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-      Serial.println(F("[ESP32WS] Registering custom Not Found handler."));
-      #endif
+      ESP32WS_LOGI("Registering custom Not Found handler.");
       server.onNotFound(customNotFoundHandler);
   } else {
-      #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-      Serial.println(F("[ESP32WS] Registering library's default Not Found handler."));
-      #endif
+      ESP32WS_LOGI("Registering library's default Not Found handler.");
       server.onNotFound([](AsyncWebServerRequest *request){
-          #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-          Serial.printf("[ESP32WS] Not Found: HTTP %s: %s\n", request->methodToString(), request->url().c_str());
-          #endif
+          ESP32WS_LOGD("Not Found: HTTP %s: %s", request->methodToString(), request->url().c_str());
           request->send(404, "text/plain", "Error 404: Resource Not Found");
       });
   }
 
   // Start the Web Server
-  #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-  Serial.println(F("[ESP32WS] Starting HTTP server (server.begin())..."));
-  #endif
+  ESP32WS_LOGI("Starting HTTP server (server.begin())...");
   server.begin();
-  Serial.println(F("[ESP32WS] HTTP & WebSocket Server started."));
-  Serial.println(F("--- [ESP32WS] initWiFiWebSocketServer: COMPLETE ---")); 
+  metricBootPhase(BOOT_SERVER_LISTENING);
+  ESP32WS_LOGI("HTTP & WebSocket Server started.");
+  advertiseNetworkServices(); // After the streams are registered, so their TXT records are complete
+  ESP32WS_LOGI("--- initWiFiWebSocketServer: COMPLETE ---");
+}
+
+void setUploadCallback(UploadCallback callback, void* context) {
+  _uploadContext = context;
+  _uploadCallback = callback;
 }
 
 /**
@@ -640,57 +2503,399 @@ void initWiFiWebSocketServer(const char *ssid, const char *password,
 void setStreamCallbacks(StreamControlCallback onStart, StreamControlCallback onStop) {
     _onStreamStartCallback = onStart;
     _onStreamStopCallback = onStop;
-    #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-    Serial.println(F("[ESP32WS] Stream control callbacks registered."));
-    #endif
+    ESP32WS_LOGI("Stream control callbacks registered.");
+}
+
+/**
+ * @brief Registers the start/stop callbacks of one stream.
+ */
+bool setStreamCallbacks(int streamId, StreamControlCallback onStart, StreamControlCallback onStop) {
+    if (streamId < 0 || streamId >= getStreamCount()) {
+        ESP32WS_LOGE("Stream Error: Callbacks for unknown stream #%d.", streamId);
+        return false;
+    }
+    _streamSubscriptions[streamId].onStart = onStart;
+    _streamSubscriptions[streamId].onStop = onStop;
+    _hasStreamCallbacks = true;
+    ESP32WS_LOGI("Stream #%d control callbacks registered.", streamId);
+    return true;
+}
+
+uint8_t getStreamSubscriberCount() {
+    return _numSubscribers;
+}
+
+uint8_t getStreamSubscriberCount(int streamId) {
+    if (streamId < 0 || streamId >= getStreamCount()) return 0;
+    return _streamSubscriptions[streamId].subscribers;
 }
 
 /**
  * @brief Broadcasts a variable update (JSON) to all connected clients.
  */
 void broadcastVariableUpdate(const char* variableName) {
+    if (ws.count() == 0) return; 
+    VariableHandle handle = getVariableHandle(variableName);
+    if (!handle.isValid()) {
+        ESP32WS_LOGD("Broadcast Error: Variable '%s' not found.", variableName);
+        return;
+    }
+    broadcastVariableUpdate(handle);
+}
+
+/**
+ * @brief Broadcasts a variable update (JSON) to all connected clients, by handle.
+ */
+void broadcastVariableUpdate(VariableHandle handle) {
     if (ws.count() == 0) return; 
     if (!_variables || _numVariables <= 0) { // Ensure variables are configured
-        #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-        Serial.println(F("[ESP32WS] Broadcast Error: No variables configured to broadcast."));
-        #endif
+        ESP32WS_LOGD("Broadcast Error: No variables configured to broadcast.");
         return;
     }
-    int index = findVariableIndexInternal(variableName);
-    if (index < 0) {
-        #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-        Serial.printf("[ESP32WS] Broadcast Error: Variable '%s' not found.\n", variableName);
-        #endif
+    if (!handle.isValid() || handle.index >= _numVariables) {
+        ESP32WS_LOGD("Broadcast Error: Invalid variable handle %d.", handle.index);
+        return;
+    }
+    const WsVarDesc& var = _variables[handle.index];
+    if (isArrayVariableInternal(var) || var.count > 128) { // Too large for the stack document
+        ReplyDocLock lock;
+        if (!lock.locked()) return;
+        (*_replyDoc)["variable"] = var.name;
+        if (!storeVariableValueInternal((*_replyDoc)["value"], var)) {
+            ESP32WS_LOGD("Broadcast Error: Value of '%s' exceeds the reply buffer.", var.name);
+            return;
+        }
+        broadcastJsonInternal(*_replyDoc);
         return;
     }
     StaticJsonDocument<256> jsonDoc; // Ensure size is adequate
-    VariableConfig& var = _variables[index];
     jsonDoc["variable"] = var.name;
-    switch (var.type) {
-        case TYPE_INT:    jsonDoc["value"] = var.intValue;    break;
-        case TYPE_FLOAT:  jsonDoc["value"] = var.floatValue;  break;
-        case TYPE_STRING: jsonDoc["value"] = var.stringValue; break;
-        default: 
-            #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-            Serial.printf("[ESP32WS] Broadcast Error: Unknown type for var '%s'\n", variableName);
-            #endif
-            return; 
+    storeVariableValueInternal(jsonDoc["value"], var);
+    broadcastJsonInternal(jsonDoc);
+}
+
+/**
+ * @brief Adds a variable to the dirty set.
+ */
+void markVariableChanged(VariableHandle handle) {
+    if (!_dirtyBits || !handle.isValid() || handle.index >= _numVariables) return;
+    portENTER_CRITICAL(&_dirtyMux);
+    _dirtyBits[handle.index >> 5] |= (1UL << (handle.index & 31));
+    portEXIT_CRITICAL(&_dirtyMux);
+}
+
+void markVariableChanged(const char* variableName) {
+    markVariableChanged(getVariableHandle(variableName));
+}
+
+/**
+ * @brief Broadcasts every dirty variable in one "var_values" message and clears the set.
+ */
+void flushVariableUpdates() {
+    if (!_dirtyBits || !_dirtySnapshot) return;
+    int words = (_numVariables + 31) / 32;
+    size_t count = 0;
+    portENTER_CRITICAL(&_dirtyMux);
+    for (int w = 0; w < words; w++) {
+        count += __builtin_popcount(_dirtyBits[w]);
+    }
+    portEXIT_CRITICAL(&_dirtyMux);
+    if (count == 0) return;
+    if (ws.count() == 0) { // Nobody to tell: just drop the marks
+        portENTER_CRITICAL(&_dirtyMux);
+        memset(_dirtyBits, 0, words * sizeof(uint32_t));
+        portEXIT_CRITICAL(&_dirtyMux);
+        return;
+    }
+
+    ReplyDocLock lock; // Also serializes concurrent flushes over _dirtySnapshot
+    if (!lock.locked()) return;
+
+    // Take a snapshot of the set so marks made while serializing go into the next flush
+    uint32_t* snapshot = _dirtySnapshot;
+    portENTER_CRITICAL(&_dirtyMux);
+    memcpy(snapshot, _dirtyBits, words * sizeof(uint32_t));
+    memset(_dirtyBits, 0, words * sizeof(uint32_t));
+    portEXIT_CRITICAL(&_dirtyMux);
+
+    JsonDocument& responseDoc = *_replyDoc;
+    responseDoc["status"] = "var_values";
+    JsonObject values = responseDoc.createNestedObject("values");
+    for (int i = 0; i < _numVariables; i++) {
+        if (snapshot[i >> 5] & (1UL << (i & 31))) {
+            storeVariableValueInternal(values[_variables[i].name], _variables[i]);
+        }
+    }
+    if (responseDoc.overflowed()) {
+        ESP32WS_LOGD("Flush Error: var_values reply exceeds the reply buffer.");
+        return;
+    }
+    broadcastJsonInternal(responseDoc);
+}
+
+/**
+ * @brief Resolves a variable name to a handle through the hash index.
+ */
+VariableHandle getVariableHandle(const char* variableName) {
+    VariableHandle handle;
+    handle.index = (int16_t)findVariableIndexInternal(variableName);
+    return handle;
+}
+
+/**
+ * @brief Records the client a pooled frame is queued to (see holdsFrameShareInternal()).
+ */
+static void setBinaryFrameOwnerInternal(BinaryFrame* frame, uint32_t clientId) {
+    portENTER_CRITICAL(&_framePoolMux);
+    for (uint8_t i = 0; i < _framePoolCount; i++) {
+        if (_framePool[i] == frame) {
+            _frameOwner[i] = clientId;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&_framePoolMux);
+}
+
+/**
+ * @brief Queues a pooled frame to the subscribed clients, then releases it. The first accepting client
+ *        gets the frame itself; every other one a copy in a free frame of the same length (or, with
+ *        none free, a copy made by the WebSocket library), so each pooled frame has a single reference.
+ *        The frame stays acquired until the loop ends, so it cannot be refilled while it is copied.
+ * @param replayMask recordStreamFrame() result for the frame.
+ */
+static void queueBinaryFrameInternal(BinaryFrame* frame, uint32_t replayMask) {
+    const uint8_t* data = frame->get();
+    size_t len = frame->length();
+    bool frameQueued = false;
+    if (ws.count() > 0) {
+        for (AsyncWebSocketClient* c : ws.getClients()) {
+            if (!wantsBinaryDataInternal(c, data, replayMask) || !shouldSendChunkInternal(c, len)) continue;
+            BinaryFrame* copy = frameQueued ? acquireBinaryFrame(len) : nullptr;
+            if (!frameQueued) {
+                setBinaryFrameOwnerInternal(frame, c->id());
+                c->binary(frame);
+                frameQueued = true;
+            } else if (copy) {
+                memcpy(copy->get(), data, len);
+                setBinaryFrameOwnerInternal(copy, c->id());
+                c->binary(copy);
+                releaseBinaryFrame(copy); // Held by the queued message from here on
+            } else {
+                c->binary(data, len);
+            }
+            metricCount(METRIC_BINARY_BYTES_OUT, len);
+        }
     }
-    String response;
-    serializeJson(jsonDoc, response);
-    ws.textAll(response);
-    #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-    // Serial.printf("[ESP32WS] Broadcast Sent: %s\n", response.c_str());
-    #endif
+    releaseBinaryFrame(frame); // Stays in flight until the queued message is gone
 }
 
 /**
- * @brief Broadcasts binary data to all connected clients.
+ * @brief Broadcasts binary data to the subscribed clients, subject to per-client flow control.
+ *        If a free pooled frame has exactly this length, the data is copied once into it and queued
+ *        by reference; otherwise each accepting client gets its own copy.
  */
 void broadcastBinaryData(const uint8_t* data, size_t len) {
-    if (ws.count() > 0 && data != nullptr && len > 0) {
-        ws.binaryAll(const_cast<uint8_t*>(data), len);
-    } 
+    if (data == nullptr || len == 0) return;
+    uint32_t replayMask = recordStreamFrame(data, len); // Recorded even while no client is connected
+    if (ws.count() == 0) return;
+    BinaryFrame* frame = acquireBinaryFrame(len); // Only when a frame class has exactly this length
+    if (frame) {
+        memcpy(frame->get(), data, len);
+        queueBinaryFrameInternal(frame, replayMask);
+        return;
+    }
+    for (AsyncWebSocketClient* c : ws.getClients()) {
+        if (wantsBinaryDataInternal(c, data, replayMask) && shouldSendChunkInternal(c)) {
+            c->binary(data, len);
+            metricCount(METRIC_BINARY_BYTES_OUT, len);
+        }
+    }
+}
+
+/**
+ * @brief Runs the active decimation pipelines over one raw stream frame.
+ */
+void processStreamPipelines(const uint8_t* rawFrame) {
+    if (_activePipelines == 0 || rawFrame == nullptr || rawFrame[0] != ESP32WS_BIN_STREAM_FRAME) return;
+    xSemaphoreTake(_pipelineMutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < ESP32WS_MAX_PIPELINES; i++) {
+        if (_pipelines[i].users > 0 && _pipelines[i].decimator.sourceStreamId() == rawFrame[1]) {
+            _pipelines[i].decimator.process(rawFrame, sendPipelineFrameInternal, (void*)(uintptr_t)(i + 1));
+        }
+    }
+    xSemaphoreGive(_pipelineMutex);
+}
+
+/**
+ * @brief Sends a raw frame of an application-produced stream to its subscribers and pipelines.
+ */
+void broadcastStreamFrame(const uint8_t* frame, size_t len) {
+    if (frame == nullptr || len < sizeof(StreamFrameHeader)) return;
+    MetricScope timing(METRIC_TIMER_SEND);
+    processStreamPipelines(frame);
+    broadcastBinaryData(frame, len);
+}
+
+/**
+ * @brief Allocates the binary frame pool with a single frame length.
+ */
+bool initBinaryFramePool(size_t frameSize, uint8_t numFrames) {
+    return initBinaryFramePool(&frameSize, &numFrames, 1);
+}
+
+/**
+ * @brief Allocates the binary frame pool in fixed length classes.
+ */
+bool initBinaryFramePool(const size_t* frameSizes, const uint8_t* frameCounts, uint8_t numSizes) {
+    size_t total = 0;
+    bool valid = frameSizes != nullptr && frameCounts != nullptr && numSizes > 0;
+    for (uint8_t s = 0; valid && s < numSizes; s++) {
+        valid = frameSizes[s] > 0;
+        total += frameCounts[s];
+    }
+    if (_framePoolCount > 0 || !valid || total == 0 || total > ESP32WS_BINARY_FRAME_POOL_SIZE) {
+        ESP32WS_LOGE("Frame Pool Error: Already initialized or invalid size/count.");
+        return false;
+    }
+    for (uint8_t s = 0; s < numSizes; s++) {
+        for (uint8_t i = 0; i < frameCounts[s]; i++) {
+            BinaryFrame* frame = new (std::nothrow) AsyncWebSocketMessageBuffer(frameSizes[s]);
+            if (!frame || frame->get() == nullptr) {
+                ESP32WS_LOGE("Frame Pool Error: Allocation failed.");
+                delete frame;
+                return false; // Frames created so far remain usable
+            }
+            _framePool[_framePoolCount] = frame;
+            _frameAcquired[_framePoolCount] = false;
+            _framePoolCount++;
+            if (frameSizes[s] > _frameSize) _frameSize = frameSizes[s];
+        }
+    }
+    ESP32WS_LOGI("Binary frame pool ready: %u frames in %u sizes, up to %u bytes.",
+                 _framePoolCount, numSizes, (unsigned)_frameSize);
+    return true;
+}
+
+/**
+ * @brief Deletes every pooled frame once none is acquired or queued.
+ */
+bool endBinaryFramePool() {
+    BinaryFrame* frames[ESP32WS_BINARY_FRAME_POOL_SIZE];
+    uint8_t count = 0;
+    portENTER_CRITICAL(&_framePoolMux);
+    bool idle = true;
+    for (uint8_t i = 0; i < _framePoolCount; i++) {
+        if (_frameAcquired[i] || _framePool[i]->count() != 0) idle = false;
+    }
+    if (idle) {
+        count = _framePoolCount;
+        memcpy(frames, _framePool, count * sizeof(BinaryFrame*));
+        _framePoolCount = 0;
+        _frameSize = 0;
+    }
+    portEXIT_CRITICAL(&_framePoolMux);
+    for (uint8_t i = 0; i < count; i++) delete frames[i]; // Unreachable from the pool now
+    return idle;
+}
+
+/**
+ * @brief Takes a frame that is neither acquired nor referenced by a client send queue and has
+ *        exactly length len. Frames are never reallocated, so this is safe from the sampler task.
+ */
+BinaryFrame* acquireBinaryFrame(size_t len) {
+    if (len == 0) len = _frameSize;
+    BinaryFrame* frame = nullptr;
+    portENTER_CRITICAL(&_framePoolMux);
+    for (uint8_t i = 0; i < _framePoolCount; i++) {
+        if (!_frameAcquired[i] && _framePool[i]->count() == 0 && _framePool[i]->length() == len) {
+            _frameAcquired[i] = true;
+            frame = _framePool[i];
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&_framePoolMux);
+    return frame;
+}
+
+uint8_t* getBinaryFrameData(BinaryFrame* frame) {
+    return frame ? frame->get() : nullptr;
+}
+
+size_t getBinaryFrameSize() {
+    return _frameSize;
+}
+
+void releaseBinaryFrame(BinaryFrame* frame) {
+    portENTER_CRITICAL(&_framePoolMux);
+    for (uint8_t i = 0; i < _framePoolCount; i++) {
+        if (_framePool[i] == frame) {
+            _frameAcquired[i] = false;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&_framePoolMux);
+}
+
+/**
+ * @brief Queues a pooled frame to the subscribed clients (see queueBinaryFrameInternal()).
+ *        The queued message holds the frame's only reference and drops it once sent
+ *        (or discarded), which is what makes the frame available to acquireBinaryFrame() again.
+ */
+void broadcastBinaryFrame(BinaryFrame* frame) {
+    if (!frame) return;
+    queueBinaryFrameInternal(frame, recordStreamFrame(frame->get(), frame->length()));
+}
+
+/**
+ * @brief Sets the flow control defaults used for clients without their own policy.
+ */
+void setDefaultFlowControl(FlowPolicy policy, uint8_t maxQueued, uint8_t decimation, uint16_t disconnectAfter) {
+    _defaultFlowPolicy = policy;
+    _flowMaxQueued = maxQueued > 0 ? maxQueued : 1;
+    _flowDecimation = decimation > 0 ? decimation : 1;
+    _flowDisconnectAfter = disconnectAfter > 0 ? disconnectAfter : 1;
+    ESP32WS_LOGI("Flow control: policy=%s, maxQueued=%u, decimation=%u, disconnectAfter=%u",
+                 flowPolicyToCharString(policy), _flowMaxQueued, _flowDecimation, _flowDisconnectAfter);
+}
+
+/**
+ * @brief Overrides the flow policy of a single client.
+ */
+bool setClientFlowPolicy(uint32_t clientId, FlowPolicy policy) {
+    ClientState* state = findClientStateInternal(clientId);
+    if (!state) return false;
+    portENTER_CRITICAL(&_clientStatesMux); // Read with the flow counters by shouldSendChunkInternal()
+    state->policy = policy;
+    state->hasOwnPolicy = true;
+    portEXIT_CRITICAL(&_clientStatesMux);
+    return true;
+}
+
+/**
+ * @brief Returns the deepest send queue among the stream subscribers.
+ */
+size_t getSubscriberQueueDepth() {
+    size_t deepest = 0;
+    for (AsyncWebSocketClient* c : ws.getClients()) {
+        if (routeStreamMaskInternal(loadRouteInternal(c->id())) == 0) continue; // Called from the sender task
+        size_t depth = clientQueueDepthInternal(c);
+        if (depth > deepest) deepest = depth;
+    }
+    return deepest;
+}
+
+/**
+ * @brief Polls the mount state published by mountFilesystemInternal() until it is decided or the
+ *        timeout expires.
+ */
+bool waitForFilesystem(uint32_t timeoutMs) {
+    uint32_t startMs = millis();
+    for (;;) {
+        uint8_t fsState = __atomic_load_n(&_fsState, __ATOMIC_ACQUIRE);
+        if (fsState != FS_STATE_PENDING) return fsState == FS_STATE_READY;
+        if (timeoutMs != portMAX_DELAY && millis() - startMs >= timeoutMs) return false;
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
 }
 
 /**
@@ -699,7 +2904,5 @@ void broadcastBinaryData(const uint8_t* data, size_t len) {
  */
 void cleanupWebSocketClients() {
     ws.cleanupClients();
-    #ifdef DEBUG_ESP32_WEBSOCKET_LIB
-    // Serial.println(F("[ESP32WS] WebSocket clients cleanup requested."));
-    #endif
+    // ESP32WS_LOGD("WebSocket clients cleanup requested.");
 }
\ No newline at end of file
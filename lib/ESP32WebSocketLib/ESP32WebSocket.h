@@ -13,60 +13,156 @@
 #include <ESPAsyncWebServer.h>  // Async Web Server and WebSocket types (requires AsyncTCP dependency)
 #include <ArduinoJson.h>        // JSON handling library
 
-// --- Supported Variable Types ---
+// --- Variables ---
+// The application's variables and their descriptor table (WsVar<T>, FixedString<N>, wsRead()).
+#include "ESP32WebSocketVars.h"
+
+// --- Variable Handle ---
 
 /**
- * @enum VarType
- * @brief Defines the supported data types for variables managed via WebSocket.
+ * @struct VariableHandle
+ * @brief Precomputed reference to a variable, obtained once with getVariableHandle()
+ *        so that repeated calls (e.g. broadcastVariableUpdate()) skip the name lookup.
  */
-enum VarType {
-  TYPE_INT,    ///< Integer type
-  TYPE_FLOAT,  ///< Floating-point type (ESP32 typically uses 32-bit float)
-  TYPE_STRING  ///< String type (using Arduino String class)
+struct VariableHandle {
+  int16_t index;  ///< Index in the application's WsVarDesc table, or -1 if invalid.
+  bool isValid() const { return index >= 0; }
 };
 
-// --- Variable Configuration Structure ---
+// --- Stream Control Callback Type ---
 
 /**
- * @struct VariableConfig
- * @brief Defines the structure for a single configurable variable.
- *        The application (.ino file) will create an array of these.
+ * @typedef StreamControlCallback
+ * @brief Defines the function pointer type for stream start/stop callbacks.
+ *        These functions (defined in the application .ino) take no arguments.
  */
-struct VariableConfig {
-  const char* name;     ///< Unique name used in JSON communication (e.g., "led_intensity").
-  VarType type;         ///< Data type of the variable (TYPE_INT, TYPE_FLOAT, TYPE_STRING).
+typedef void (*StreamControlCallback)();
+
+// --- Binary Command Protocol ---
+//
+// Compact alternative to the JSON get/set actions, carried in WS_BINARY frames from the client.
+// Variables are addressed by their index in the application's WsVarDesc table
+// (reported as "index" in the "var_config_list" response). All fields are little-endian.
+//
+//   Request:  [opcode:u8][tag:u8][index:u16]                      (GET)
+//             [opcode:u8][tag:u8][index:u16][type:u8][value]      (SET)
+//             [opcode:u8][tag:u8][uploadId:u16][bytes...]         (UPLOAD, see setUploadCallback())
+//   Reply:    [0xC5][opcode|0x80][tag:u8][status:u8][index:u16]   (followed by [type:u8][value] if status is OK)
+//
+//   value:    BIN_TYPE_INT -> int32, BIN_TYPE_FLOAT -> float32, BIN_TYPE_STRING -> [len:u8][bytes],
+//             BIN_TYPE_UINT -> uint32 (TYPE_BOOL variables are read and written as BIN_TYPE_INT 0/1)
+//
+// Array variables have no binary encoding: GET and SET on them answer BIN_STATUS_TYPE_MISMATCH.
+//
+// 'tag' is chosen by the client and echoed back so replies can be matched to requests.
+// An UPLOAD reply carries the uploadId in the index field and no value.
+// Stream frames start with ESP32WS_BIN_STREAM_FRAME (ESP32WebSocketStream.h), so the first byte
+// alone tells a reply (0xC5) from stream data.
 
-  // --- Value Storage ---
-  // Note: Only one of these fields will hold the active value, based on 'type'.
-  int intValue;         ///< Storage for integer values.
-  float floatValue;       ///< Storage for float values.
-  String stringValue;     ///< Storage for string values.
+#define ESP32WS_BIN_REPLY_MAGIC 0xC5  ///< First byte of every binary command reply.
+#define ESP32WS_BIN_REPLY_FLAG  0x80  ///< OR-ed into the opcode of a reply.
 
-  // --- Optional Validation Limits (for numeric types) ---
-  double minVal;        ///< Minimum allowed value (use double for flexibility).
-  double maxVal;        ///< Maximum allowed value (use double for flexibility).
-  bool hasLimits;       ///< True if minVal/maxVal validation should be applied.
+/**
+ * @enum BinaryCommandOpcode
+ * @brief Opcodes of the binary command protocol.
+ */
+enum BinaryCommandOpcode : uint8_t {
+  BIN_CMD_GET = 0x01,  ///< Read a variable.
+  BIN_CMD_SET = 0x02,  ///< Write a variable; the reply carries the value now stored.
+  BIN_CMD_UPLOAD = 0x03 ///< Hand a block of bytes (e.g. a lookup table) to the application's upload callback.
 };
 
-// --- Stream Control Callback Type ---
+/**
+ * @enum BinaryValueType
+ * @brief Type tags used for values in binary commands and replies.
+ */
+enum BinaryValueType : uint8_t {
+  BIN_TYPE_INT = 0x01,     ///< int32, little-endian
+  BIN_TYPE_FLOAT = 0x02,   ///< IEEE-754 float32, little-endian
+  BIN_TYPE_STRING = 0x03,  ///< Length byte followed by that many bytes (no terminator)
+  BIN_TYPE_UINT = 0x04     ///< uint32, little-endian
+};
 
 /**
- * @typedef StreamControlCallback
- * @brief Defines the function pointer type for stream start/stop callbacks.
- *        These functions (defined in the application .ino) take no arguments.
+ * @enum BinaryCommandStatus
+ * @brief Status byte of a binary command reply.
  */
-typedef void (*StreamControlCallback)();
+enum BinaryCommandStatus : uint8_t {
+  BIN_STATUS_OK = 0x00,             ///< Success; reply includes the current value.
+  BIN_STATUS_UNKNOWN_VARIABLE = 0x01, ///< Index out of range.
+  BIN_STATUS_TYPE_MISMATCH = 0x02,  ///< Value type not compatible with the variable.
+  BIN_STATUS_OUT_OF_LIMITS = 0x03,  ///< Value outside [min, max], or a string longer than the store accepts.
+  BIN_STATUS_MALFORMED = 0x04,      ///< Frame too short or inconsistent.
+  BIN_STATUS_UNKNOWN_OPCODE = 0x05, ///< Opcode not supported (or UPLOAD without an upload callback).
+  BIN_STATUS_REJECTED = 0x06        ///< The upload callback refused the data.
+};
+
+/**
+ * @typedef UploadCallback
+ * @brief Receives the payload of a BIN_CMD_UPLOAD command, on the WebSocket task.
+ *        data is only valid during the call: copy what must be kept.
+ * @return True to accept the data (BIN_STATUS_OK), false to refuse it (BIN_STATUS_REJECTED).
+ */
+typedef bool (*UploadCallback)(uint32_t clientId, uint16_t uploadId, const uint8_t* data, size_t len, void* context);
+
+// --- Large and Fragmented Messages ---
+//
+// Commands that fit one WebSocket frame and one TCP segment are handled in place. Anything else
+// (fragmented messages, or frames split over several data events) is reassembled into a receive
+// arena taken from a pool allocated at init, then handled the same way; a client holds an arena
+// only while such a message is in flight. Messages longer than ESP32WS_RX_ARENA_BYTES, or arriving
+// while every arena is taken, are discarded with an error status. Text commands that do not fit the
+// regular JSON document are parsed into a shared document of ESP32WS_JSON_LARGE_COMMAND_CAPACITY,
+// without copying their strings out of the arena.
+
+/// Size of each receive arena, i.e. the largest message accepted.
+#ifndef ESP32WS_RX_ARENA_BYTES
+#define ESP32WS_RX_ARENA_BYTES 4096
+#endif
+/// Number of receive arenas (clients that can send a large message at the same time).
+#ifndef ESP32WS_RX_ARENAS
+#define ESP32WS_RX_ARENAS 2
+#endif
+/// Capacity of the JSON document for large text commands (0 disables it: the regular document only).
+#ifndef ESP32WS_JSON_LARGE_COMMAND_CAPACITY
+#define ESP32WS_JSON_LARGE_COMMAND_CAPACITY 8192
+#endif
+
+// --- Per-Client Flow Control ---
+
+/**
+ * @enum FlowPolicy
+ * @brief What the binary broadcast does for a client whose send queue is congested.
+ *        AsyncWebSocket does not allow removing already queued messages, so "dropping"
+ *        always means not queueing the newest chunk for that client.
+ */
+enum FlowPolicy {
+  FLOW_DROP,       ///< Skip chunks for the congested client until its queue drains.
+  FLOW_DECIMATE,   ///< While congested, send only one of every 'decimation' chunks.
+  FLOW_DISCONNECT  ///< Skip chunks and close the client if it stays congested too long.
+};
+
+/// Maximum number of simultaneously tracked WebSocket clients (matches AsyncWebSocket's default client limit).
+#ifndef ESP32WS_MAX_CLIENTS
+#define ESP32WS_MAX_CLIENTS 8
+#endif
 
 // --- Public Library Functions ---
 
 /**
  * @brief Initializes WiFi in Access Point mode with a static IP, 
  *        starts the AsyncWebServer, and sets up the WebSocket endpoint ("/ws").
+ *        Call setNetworkMode() first to join an existing network instead, or as well
+ *        (see ESP32WebSocketNetwork.h); the node is then advertised over mDNS.
+ *        Returns without waiting for the station's address or the filesystem: LittleFS is mounted
+ *        on the other core while WiFi comes up, "/ws" accepts clients meanwhile, and static files
+ *        answer 503 (Retry-After) until they are ready. get_stats reports the boot phase times.
  * 
  * @param ssid The desired network name (SSID) for the Access Point.
  * @param password The password for the Access Point (8+ characters recommended, or nullptr for an open network).
  * @param staticIp Desired static IP as 4 octets (e.g., {192, 168, 5, 1})
- * @param appVariables Pointer to the application's array of VariableConfig structs.
+ * @param appVariables The application's variable table (see ESP32WebSocketVars.h); kept by pointer,
+ *                     so it must outlive the server (a global const array).
  * @param appNumVariables The total number of elements in the appVariables array.
  * @param defaultRouteHandler (Optional) A callback function (of type ArRequestHandlerFunction) 
  *                            to handle HTTP GET requests to the root "/" path. 
@@ -77,38 +173,238 @@ void initWiFiWebSocketServer(
     const char *ssid, 
     const char *password, 
     const uint8_t staticIp[4],
-    VariableConfig *appVariables,
+    const WsVarDesc *appVariables,
     int appNumVariables,
     ArRequestHandlerFunction defaultRouteHandler = nullptr
 );
 
 /**
- * @brief Registers the application-defined functions to be called when 
- *        "start_stream" or "stop_stream" commands are received via WebSocket.
+ * @brief Waits for the LittleFS mount started by initWiFiWebSocketServer(), for application tasks
+ *        that use the filesystem (e.g. the stream recorder's spill file).
+ *
+ * @param timeoutMs Maximum wait in milliseconds (portMAX_DELAY: no limit).
+ * @return True once LittleFS is mounted; false if mounting failed or the timeout expired.
+ */
+bool waitForFilesystem(uint32_t timeoutMs);
+
+/**
+ * @brief Registers the application-defined functions that start and stop data acquisition.
+ *        Streaming is per client: "start_stream" subscribes the sending client (optionally to some
+ *        streams, channels and a decimated rate) and "stop_stream" ends only its subscription.
+ *        onStart runs when the first client subscribes; onStop when the last subscriber leaves,
+ *        whether by "stop_stream" or by disconnecting. Binary data only goes to subscribers.
+ *        With the stream recorder active (see ESP32WebSocketRecorder.h), a disconnected subscriber
+ *        keeps its streams running for ESP32WS_RECORDER_LINGER_MS, and onStop runs from the library's
+ *        replay task once that time has passed.
  * 
  * @param onStart Pointer to the function in the .ino file to call when streaming should start.
  * @param onStop Pointer to the function in the .ino file to call when streaming should stop.
  */
 void setStreamCallbacks(StreamControlCallback onStart, StreamControlCallback onStop);
 
+/**
+ * @brief Registers the start/stop functions of one stream (an id returned by registerStream()).
+ *        Clients choose their streams with the "streams" option of "start_stream" (all streams by
+ *        default); onStart runs when the stream gets its first subscriber and onStop when its last
+ *        subscriber leaves, so each stream's producer runs only while someone is listening.
+ *        Independent of the global pair above, which follows the subscriptions to any stream.
+ * 
+ * @return False if the stream id is not registered.
+ */
+bool setStreamCallbacks(int streamId, StreamControlCallback onStart, StreamControlCallback onStop);
+
+/**
+ * @brief Registers the function receiving BIN_CMD_UPLOAD payloads (see "Binary Command Protocol").
+ *        Uploads up to ESP32WS_RX_ARENA_BYTES - 4 bytes are accepted (see "Large and Fragmented Messages").
+ * @param callback The function, or nullptr to answer uploads with BIN_STATUS_UNKNOWN_OPCODE.
+ * @param context Passed back to each call.
+ */
+void setUploadCallback(UploadCallback callback, void* context = nullptr);
+
+/**
+ * @brief Returns the number of clients currently subscribed with "start_stream".
+ */
+uint8_t getStreamSubscriberCount();
+
+/**
+ * @brief Returns the number of clients currently subscribed to one stream.
+ */
+uint8_t getStreamSubscriberCount(int streamId);
+
 /**
  * @brief Sends the current value of a specified variable as a JSON message
  *        to ALL currently connected WebSocket clients.
  *        Useful for notifying clients of changes initiated by the ESP32 itself (e.g., sensor readings).
  * 
- * @param variableName The 'name' field of the VariableConfig whose value should be broadcast.
+ * @param variableName The name of the variable whose value should be broadcast.
  */
 void broadcastVariableUpdate(const char* variableName);
 
 /**
- * @brief Sends a block of raw binary data to ALL currently connected WebSocket clients.
- *        This is intended for high-frequency data streaming.
+ * @brief Same as broadcastVariableUpdate(const char*), using a precomputed handle.
+ * @param handle A handle returned by getVariableHandle().
+ */
+void broadcastVariableUpdate(VariableHandle handle);
+
+/**
+ * @brief Marks a variable as changed. Marked variables are sent together by the next
+ *        flushVariableUpdates() call, so many changes cost a single WebSocket message.
+ *        Safe to call from any task.
+ * @param handle A handle returned by getVariableHandle().
+ */
+void markVariableChanged(VariableHandle handle);
+
+/**
+ * @brief Same as markVariableChanged(VariableHandle), by variable name.
+ */
+void markVariableChanged(const char* variableName);
+
+/**
+ * @brief Broadcasts all variables marked with markVariableChanged() since the last call
+ *        as one {"status":"var_values","values":{name: value, ...}} message, then clears the marks.
+ *        Call it once per application "tick" (e.g. from loop()).
+ */
+void flushVariableUpdates();
+
+/**
+ * @brief Resolves a variable name to a handle. Lookup is O(1) through the hash index
+ *        built by initWiFiWebSocketServer(); resolve handles after that call.
+ * @param variableName The name given in the variable's WsVar entry.
+ * @return A handle; isValid() is false if the name is unknown.
+ */
+VariableHandle getVariableHandle(const char* variableName);
+
+/**
+ * @brief Sends a block of raw binary data to every subscribed WebSocket client (see setStreamCallbacks()).
+ *        This is intended for high-frequency data streaming. Stream frames (first byte 0xD1) only go
+ *        to the clients subscribed to that stream.
  * 
  * @param data Pointer to the buffer containing the binary data to send.
  * @param len The size of the data buffer in bytes.
  */
 void broadcastBinaryData(const uint8_t* data, size_t len);
 
+/**
+ * @brief Feeds one raw stream frame (see ESP32WebSocketStream.h) to the decimation pipelines that
+ *        clients selected with the "decimation" option of start_stream. Each pipeline's output is
+ *        sent, under the usual flow control, only to the clients sharing it; those clients no longer
+ *        receive the raw stream frames. Call it from the sending task for every raw frame, before
+ *        any encoding. Does nothing while no client uses a pipeline.
+ */
+void processStreamPipelines(const uint8_t* rawFrame);
+
+/**
+ * @brief Sends one raw frame of an application-produced stream (header written with
+ *        writeStreamFrameHeader()): runs processStreamPipelines() on it, then broadcastBinaryData().
+ *        Frames of every stream share the single "/ws" socket; the header's stream id tells them apart.
+ */
+void broadcastStreamFrame(const uint8_t* frame, size_t len);
+
+// --- Pooled Zero-Copy Binary Frames ---
+
+/// Default number of frames in the binary frame pool (override with a build flag).
+#ifndef ESP32WS_BINARY_FRAME_POOL_SIZE
+#define ESP32WS_BINARY_FRAME_POOL_SIZE 16
+#endif
+
+/**
+ * @typedef BinaryFrame
+ * @brief A preallocated outgoing WebSocket message buffer owned by the library's frame pool.
+ *        Fill it in place through getBinaryFrameData() and hand it to broadcastBinaryFrame().
+ */
+typedef AsyncWebSocketMessageBuffer BinaryFrame;
+
+/**
+ * @brief Preallocates the pool of binary frames. Call once at startup; after this, acquiring and
+ *        broadcasting frames performs no copy of the payload for the first client (its send queue
+ *        references the pooled buffer directly) and no heap allocation while free frames remain:
+ *        pooled frames are never reallocated.
+ *
+ * @param frameSize Size in bytes of every frame.
+ * @param numFrames Number of frames in the pool (1..ESP32WS_BINARY_FRAME_POOL_SIZE).
+ * @return True on success, false if already initialized, on invalid arguments or allocation failure.
+ */
+bool initBinaryFramePool(size_t frameSize, uint8_t numFrames = ESP32WS_BINARY_FRAME_POOL_SIZE);
+
+/**
+ * @brief Preallocates the pool of binary frames in several fixed length classes, for producers whose
+ *        frame length varies (e.g. adaptive chunk sizing) and that round it to one of the classes.
+ *
+ * @param frameSizes Length in bytes of the frames of each class.
+ * @param frameCounts Number of frames of each class (1..ESP32WS_BINARY_FRAME_POOL_SIZE frames in total).
+ * @param numSizes Number of classes.
+ * @return True on success, false if already initialized, on invalid arguments or allocation failure.
+ */
+bool initBinaryFramePool(const size_t* frameSizes, const uint8_t* frameCounts, uint8_t numSizes);
+
+/**
+ * @brief Frees the binary frame pool so it can be created again with other sizes.
+ * @return True if the pool is gone (or never existed), false if a frame is acquired or still queued.
+ */
+bool endBinaryFramePool();
+
+/**
+ * @brief Takes a free frame of exactly len bytes from the pool. A frame becomes free again
+ *        automatically once every client it was queued to has finished sending it.
+ *        A frame always goes out whole, so len must be one of the pool's frame sizes.
+ *        Never allocates, so it is safe from time-critical tasks.
+ * @param len Wire length, one of the pool's frame sizes; 0 means getBinaryFrameSize().
+ * @return A frame ready to be filled, or nullptr if no free frame has that length or no pool exists.
+ */
+BinaryFrame* acquireBinaryFrame(size_t len = 0);
+
+/**
+ * @brief Returns a pointer to the payload of a frame (frame->length() bytes, as acquired).
+ */
+uint8_t* getBinaryFrameData(BinaryFrame* frame);
+
+/**
+ * @brief Returns the longest frame length of the pool, or 0 if no pool exists.
+ */
+size_t getBinaryFrameSize();
+
+/**
+ * @brief Queues a filled frame to every subscribed client (same routing as broadcastBinaryData()). The first
+ *        client gets the frame without a copy; each further one a copy in another free pooled frame, so a
+ *        frame is never referenced by two queued messages (the library's reference count is not atomic).
+ *        Ownership passes back to the pool; do not touch the frame after this call.
+ */
+void broadcastBinaryFrame(BinaryFrame* frame);
+
+/**
+ * @brief Returns an acquired frame to the pool without sending it.
+ */
+void releaseBinaryFrame(BinaryFrame* frame);
+
+// --- Per-Client Flow Control Functions ---
+
+/**
+ * @brief Configures the flow control applied by broadcastBinaryData() and broadcastBinaryFrame()
+ *        to every client that has not chosen its own policy (see the "set_flow_policy" action).
+ *
+ * @param policy Policy for congested clients.
+ * @param maxQueued Queue depth at which a client counts as congested. Only honoured when the
+ *                  WebSocket library exposes the queue length; otherwise congestion means a full queue.
+ *                  Pooled frames add a limit of their own: a client holding its share of the frames of
+ *                  one length (the frames less one, split between the subscribers) is congested too.
+ * @param decimation For FLOW_DECIMATE: one of every 'decimation' chunks is sent while congested.
+ * @param disconnectAfter For FLOW_DISCONNECT: consecutive congested chunks before the client is closed.
+ */
+void setDefaultFlowControl(FlowPolicy policy, uint8_t maxQueued = 8, uint8_t decimation = 4, uint16_t disconnectAfter = 200);
+
+/**
+ * @brief Overrides the flow policy for one connected client.
+ * @return True if the client is connected and tracked, false otherwise.
+ */
+bool setClientFlowPolicy(uint32_t clientId, FlowPolicy policy);
+
+/**
+ * @brief Returns the deepest send queue (in messages) among the clients subscribed to a stream.
+ *        Link congestion signal of the adaptive chunk sizing (see setAcquisitionChunking()); exact only
+ *        when the WebSocket library exposes the queue length, otherwise 0 or the full queue size.
+ */
+size_t getSubscriberQueueDepth();
+
 /**
  * @brief Performs cleanup of disconnected WebSocket clients.
  *        Generally managed automatically by the underlying library, but can be called
@@ -0,0 +1,568 @@
+/**
+ * @file ESP32WebSocketAcquisition.cpp
+ * @brief Implementation of the hardware-timed ADC acquisition engine.
+ *        The timer ISR only notifies the sampler task; all ADC access happens in task
+ *        context because the ADC1 driver takes a lock that cannot be used from an ISR.
+ *        Full chunks are passed through a lock-free SPSC ring to a sender task on core 0;
+ *        by default they are pooled BinaryFrames filled in place and broadcast without a copy.
+ *        The sender can also adapt the chunk size to the link (setAcquisitionChunking()).
+ *        Each chunk is a frame of the "adc" stream (see ESP32WebSocketStream.h): header + samples.
+ */
+#include "ESP32WebSocketAcquisition.h"
+#include "ESP32WebSocket.h"
+#include "ESP32WebSocketRingBuffer.h"
+#include "ESP32WebSocketStream.h"
+#include "ESP32WebSocketMetrics.h"
+#include "ESP32WebSocketLog.h"
+#include <driver/adc.h>
+
+// --- Task Configuration ---
+static const uint32_t SAMPLER_TASK_STACK_SIZE = 4096;
+static const UBaseType_t SAMPLER_TASK_PRIORITY = configMAX_PRIORITIES - 2; // Above loop() and AsyncTCP
+static const BaseType_t SAMPLER_TASK_CORE = 1;                             // WiFi/TCP stack lives on core 0
+static const uint32_t SENDER_TASK_STACK_SIZE = 4096;
+static const UBaseType_t SENDER_TASK_PRIORITY = 3;                         // Below the WiFi/lwIP tasks
+static const BaseType_t SENDER_TASK_CORE = 0;                              // Next to the AsyncTCP/WiFi stack
+static const uint8_t ACQ_TIMER_NUMBER = 0;
+
+// --- Module-Internal State ---
+
+static adc1_channel_t _channels[ESP32WS_ACQ_MAX_CHANNELS];
+static uint8_t _numChannels = 0;
+static uint16_t _samplesPerChunk = 0;
+static uint32_t _samplePeriodUs = 0;
+static size_t _packetSize = 0;
+static AcquisitionChunkCallback _onChunk = nullptr;
+static int _streamId = -1;
+static char _channelNames[ESP32WS_ACQ_MAX_CHANNELS][8]; // "GPIO32".."GPIO39", referenced by the stream schema
+
+// Chunks travel from the sampler (producer) to the sender (consumer) through the ring.
+// Without a chunk callback the engine runs in zero-copy frame mode: the sampler fills a pooled
+// BinaryFrame in place and the ring only carries the frame pointer to the sender. With a callback,
+// the ring slots hold the chunk bytes themselves.
+// When no slot/frame is free the sampler keeps timing by filling the scratch chunk, which is discarded.
+static ChunkRingBuffer _ring;
+static bool _frameMode = false;
+static uint8_t* _scratchChunk = nullptr;
+// With a stream encoding the sender converts each raw chunk into this buffer before handing it on;
+// the encoded length varies per chunk, so it is sent as a copy rather than a fixed-size pooled frame.
+static uint8_t* _encodeBuffer = nullptr;
+static uint8_t* _fillChunk = nullptr;      // Chunk currently being filled (ring slot, frame or scratch)
+static BinaryFrame* _fillFrame = nullptr;  // Frame behind _fillChunk in frame mode
+static uint16_t _fillIndex = 0;
+static uint32_t _fillBaseSample = 0;       // Tick index of the first sample in the chunk being filled
+static uint32_t _chunkSequence = 0;        // Sequence number of the next chunk (owned by the sampler task)
+static uint16_t _fillTarget = 0;           // Size of the chunk being filled, latched when it starts
+
+// Adaptive chunk sizing (setAcquisitionChunking()). The sender task moves the target between the
+// bounds from what it observes after each delivery; the sampler picks it up at the next chunk.
+static uint16_t _minSamplesPerChunk = 0;   // 0: adaptation off
+static uint16_t _maxSamplesPerChunk = 0;   // Capacity, lowered by the latency deadline
+static volatile uint16_t _targetSamplesPerChunk = 0;
+static uint8_t _idleChunks = 0;            // Consecutive deliveries to empty queues (sender task)
+// Frame mode: chunk sizes of the pooled frame lengths, largest first. The sampler only ever asks the
+// pool for one of them, so a frame is never reallocated on the sampler task.
+static_assert(ESP32WS_ACQ_FRAME_CLASSES >= 1 && ESP32WS_ACQ_FRAME_CLASSES <= ESP32WS_BINARY_FRAME_POOL_SIZE,
+              "ESP32WS_ACQ_FRAME_CLASSES must be 1..ESP32WS_BINARY_FRAME_POOL_SIZE");
+static uint16_t _frameClassSamples[ESP32WS_ACQ_FRAME_CLASSES];
+static uint8_t _numFrameClasses = 0;
+
+static hw_timer_t* _timer = nullptr;
+static TaskHandle_t _samplerTask = nullptr;
+static TaskHandle_t _senderTask = nullptr;
+static volatile bool _running = false;
+static volatile bool _restartPending = false;
+static bool _everStarted = false;          // Frames may be in the sampler's hands from the first start on
+static uint32_t _sampleIndex = 0;          // Timer ticks since start (owned by the sampler task)
+
+// Counters (each written by a single task, reset by startAcquisition())
+static volatile uint32_t _missedSamples = 0;
+static volatile uint32_t _chunksProduced = 0;
+static volatile uint32_t _chunksDropped = 0;
+static volatile uint32_t _chunksSent = 0;
+static volatile uint16_t _ringHighWater = 0;
+static volatile uint32_t _rawBytes = 0;
+static volatile uint32_t _sentBytes = 0;
+
+// --- Internal Helpers ---
+
+/**
+ * @brief Timer ISR: wakes the sampler task. Kept minimal and in IRAM.
+ */
+static void IRAM_ATTR onAcquisitionTimer() {
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(_samplerTask, &higherPriorityTaskWoken);
+  if (higherPriorityTaskWoken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+/**
+ * @brief Sampler side: picks the buffer for a new chunk of _fillTarget samples. A pooled frame is
+ *        taken at exactly that chunk's length, since a frame always goes out whole; the target is
+ *        always one of the pool's frame lengths, so no frame is reallocated here.
+ * @return True if the chunk will be delivered, false if it goes to the scratch buffer.
+ */
+static bool beginChunkInternal() {
+  if (_frameMode) {
+    // A ring slot is needed to carry the frame pointer, so check it before taking a frame
+    size_t frameLen = sizeof(StreamFrameHeader) + (size_t)_fillTarget * _packetSize;
+    if (_ring.writeSlot() != nullptr && (_fillFrame = acquireBinaryFrame(frameLen)) != nullptr) {
+      _fillChunk = getBinaryFrameData(_fillFrame);
+      return true;
+    }
+  } else if ((_fillChunk = _ring.writeSlot()) != nullptr) {
+    return true;
+  }
+  _fillFrame = nullptr;
+  _fillChunk = _scratchChunk;
+  return false;
+}
+
+/**
+ * @brief Sampler side: publishes the completed chunk to the sender task.
+ */
+static void publishChunkInternal(size_t len) {
+  if (_frameMode) {
+    memcpy(_ring.writeSlot(), &_fillFrame, sizeof(_fillFrame));
+    _ring.commitWrite(sizeof(_fillFrame));
+    _fillFrame = nullptr;
+  } else {
+    _ring.commitWrite(len);
+  }
+}
+
+/**
+ * @brief Sampler side: writes the frame header of the chunk being filled and hands it on
+ *        (or drops it if it went to the scratch buffer). Chunks may be closed before they are
+ *        full; the header's sample count tells the client how many samples are valid.
+ */
+static void completeChunkInternal() {
+  uint64_t baseTimeUs = (uint64_t)_fillBaseSample * _samplePeriodUs;
+  writeStreamFrameHeader(_fillChunk, (uint8_t)_streamId, _chunkSequence++, _fillIndex, baseTimeUs);
+  size_t len = sizeof(StreamFrameHeader) + (size_t)_fillIndex * _packetSize;
+  _fillIndex = 0;
+  _chunksProduced++;
+  if (_fillChunk == _scratchChunk) {
+    _chunksDropped++; // Its sequence number is skipped, so clients see the gap
+    return;
+  }
+  publishChunkInternal(len);
+  uint16_t depth = _ring.depth();
+  if (depth > _ringHighWater) _ringHighWater = depth;
+  xTaskNotifyGive(_senderTask);
+}
+
+/**
+ * @brief Sender side: delivers one ring slot to the consumer.
+ */
+static void deliverChunkInternal(const uint8_t* slot, size_t len) {
+  MetricScope timing(METRIC_TIMER_SEND);
+  if (_frameMode) {
+    BinaryFrame* frame;
+    memcpy(&frame, slot, sizeof(frame));
+    const uint8_t* data = getBinaryFrameData(frame);
+    StreamFrameHeader header;
+    memcpy(&header, data, sizeof(header));
+    size_t dataLen = sizeof(StreamFrameHeader) + (size_t)header.sampleCount * _packetSize;
+    processStreamPipelines(data);
+    // Sized to the chunk's target when acquired. Only a chunk closed early by missed ticks is shorter:
+    // it still goes out by reference, and the header's sample count marks the unused tail.
+    size_t frameLen = frame->length();
+    broadcastBinaryFrame(frame);
+    _rawBytes += dataLen;
+    _sentBytes += frameLen;
+    return;
+  }
+  processStreamPipelines(slot); // Decimated views are computed from the raw samples
+  const uint8_t* data = slot;
+  size_t dataLen = len;
+  if (_encodeBuffer) {
+    dataLen = encodeStreamFrame(_streamId, slot, _encodeBuffer);
+    data = _encodeBuffer;
+  }
+  _rawBytes += len;
+  _sentBytes += dataLen;
+  if (_onChunk != nullptr) {
+    _onChunk(data, dataLen);
+  } else {
+    broadcastBinaryData(data, dataLen); // Flow-controlled per client like pooled frames
+  }
+}
+
+/**
+ * @brief Rounds a chunk size to a pooled frame length in frame mode (other modes take any size).
+ * @param roundUp True for the smallest class >= samples, false for the largest class <= samples.
+ *                Falls back to the nearest end of the class range.
+ */
+static uint16_t roundToFrameClassInternal(uint16_t samples, bool roundUp) {
+  if (_numFrameClasses == 0) return samples;
+  if (roundUp) {
+    for (int8_t i = _numFrameClasses - 1; i >= 0; i--) {
+      if (_frameClassSamples[i] >= samples) return _frameClassSamples[i];
+    }
+    return _frameClassSamples[0];
+  }
+  for (uint8_t i = 0; i < _numFrameClasses; i++) {
+    if (_frameClassSamples[i] <= samples) return _frameClassSamples[i];
+  }
+  return _frameClassSamples[_numFrameClasses - 1];
+}
+
+/**
+ * @brief Frame mode: allocates the frame pool in numClasses lengths (at most ESP32WS_ACQ_FRAME_CLASSES),
+ *        halving the chunk size per class. The frames are shared evenly (remainder to the full size),
+ *        so a chunk size capped by a latency deadline still has several frames in flight. A fixed chunk
+ *        size uses a single class: every frame at full capacity.
+ */
+static bool initFramePoolInternal(uint8_t numClasses) {
+  size_t frameSizes[ESP32WS_ACQ_FRAME_CLASSES];
+  uint8_t frameCounts[ESP32WS_ACQ_FRAME_CLASSES];
+  _numFrameClasses = 0;
+  for (uint16_t samples = _samplesPerChunk; samples > 0 && _numFrameClasses < numClasses; samples /= 2) {
+    _frameClassSamples[_numFrameClasses] = samples;
+    frameSizes[_numFrameClasses] = sizeof(StreamFrameHeader) + (size_t)samples * _packetSize;
+    frameCounts[_numFrameClasses] = ESP32WS_BINARY_FRAME_POOL_SIZE / numClasses;
+    _numFrameClasses++;
+  }
+  frameCounts[0] += ESP32WS_BINARY_FRAME_POOL_SIZE - frameCounts[0] * _numFrameClasses;
+  return initBinaryFramePool(frameSizes, frameCounts, _numFrameClasses);
+}
+
+/**
+ * @brief Frame mode: rebuilds the pool with the classes needed by the chunking mode (several for
+ *        adaptive chunking, one otherwise). Only before the first startAcquisition(): afterwards the
+ *        current pool is kept and the chunk sizes are rounded to it.
+ */
+static void matchFramePoolInternal(bool adaptive) {
+  uint8_t numClasses = adaptive ? ESP32WS_ACQ_FRAME_CLASSES : 1;
+  if (!_frameMode || _everStarted || numClasses == _numFrameClasses || !endBinaryFramePool()) return;
+  if (initFramePoolInternal(numClasses)) return;
+  endBinaryFramePool(); // Frames created so far would not match the classes
+  ESP32WS_LOGW("Acquisition: Frame pool with %u sizes failed; using one size.", numClasses);
+  if (!initFramePoolInternal(1)) ESP32WS_LOGE("Acquisition Error: Failed to rebuild the binary frame pool.");
+}
+
+/**
+ * @brief Sender side: updates the chunk size target after a delivery (see setAcquisitionChunking()).
+ */
+static void adaptChunkSizeInternal() {
+  if (_minSamplesPerChunk == 0) return;
+  size_t queueDepth = getSubscriberQueueDepth();
+  uint16_t ringDepth = _ring.depth();
+  uint16_t target = _targetSamplesPerChunk;
+  if (queueDepth >= ESP32WS_ACQ_ADAPT_QUEUE_HIGH || ringDepth > 1) {
+    target = (uint32_t)target * 2 < _maxSamplesPerChunk ? target * 2 : _maxSamplesPerChunk;
+    _idleChunks = 0;
+  } else if (queueDepth == 0 && ringDepth == 0) {
+    if (++_idleChunks >= ESP32WS_ACQ_ADAPT_IDLE_CHUNKS) {
+      uint16_t step = target >= 4 ? target / 4 : 1;
+      target = target - step > _minSamplesPerChunk ? target - step : _minSamplesPerChunk;
+      _idleChunks = 0;
+    }
+  } else {
+    _idleChunks = 0; // Some queueing but not contended: hold
+  }
+  _targetSamplesPerChunk = roundToFrameClassInternal(target, false); // Stays within the class-aligned bounds
+}
+
+// Gauges for the metrics report
+static uint32_t ringDepthGaugeInternal() { return _ring.capacity() ? _ring.depth() : 0; }
+static uint32_t ringHighWaterGaugeInternal() { return _ringHighWater; }
+static uint32_t missedSamplesGaugeInternal() { return _missedSamples; }
+static uint32_t chunksDroppedGaugeInternal() { return _chunksDropped; }
+static uint32_t samplesPerChunkGaugeInternal() { return _targetSamplesPerChunk; }
+
+/**
+ * @brief Sampler task body (core 1). Each wake-up corresponds to one or more timer ticks;
+ *        ticks beyond the first could not be sampled on time and are counted as missed.
+ *        Sample times are implied by the chunk's base time and the fixed period, so a chunk
+ *        is closed early when ticks are missed and the next one starts on the new tick.
+ */
+static void samplerTask(void* param) {
+  for (;;) {
+    uint32_t pendingTicks = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (!_running || pendingTicks == 0) continue;
+    MetricScope timing(METRIC_TIMER_SAMPLER);
+
+    if (_restartPending) {
+      _restartPending = false;
+      _sampleIndex = 0;
+      if (_fillIndex != 0 && _fillFrame != nullptr) {
+        releaseBinaryFrame(_fillFrame); // Partial chunk from the previous run
+        _fillFrame = nullptr;
+      }
+      _fillIndex = 0;
+      _chunkSequence = 0;
+      pendingTicks = 1; // Ticks queued before the restart belong to the previous run
+    }
+    if (pendingTicks > 1) {
+      _missedSamples += pendingTicks - 1;
+      if (_fillIndex != 0) completeChunkInternal(); // Keep each chunk on a uniform time grid
+    }
+    _sampleIndex += pendingTicks;
+
+    if (_fillIndex == 0) {
+      uint16_t target = _targetSamplesPerChunk;
+      _fillTarget = target > 0 && target < _samplesPerChunk ? target : _samplesPerChunk; // Never past the buffer
+      beginChunkInternal(); // Falls back to the scratch chunk when the sender can't keep up
+      _fillBaseSample = _sampleIndex - 1;
+    }
+
+    // The header is 16 bytes and samples are whole uint16 arrays, so readings stay 2-byte aligned
+    uint16_t* readings = reinterpret_cast<uint16_t*>(_fillChunk + sizeof(StreamFrameHeader) +
+                                                     (size_t)_fillIndex * _packetSize);
+    for (uint8_t c = 0; c < _numChannels; c++) {
+      readings[c] = (uint16_t)adc1_get_raw(_channels[c]);
+    }
+
+    if (++_fillIndex >= _fillTarget) {
+      completeChunkInternal();
+    }
+  }
+}
+
+/**
+ * @brief Sender task body (core 0). Drains every published chunk from the ring and hands
+ *        it to the consumer; a slow send only delays this task and never the sampler.
+ */
+static void senderTask(void* param) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    size_t len = 0;
+    const uint8_t* chunk;
+    while ((chunk = _ring.readSlot(&len)) != nullptr) {
+      deliverChunkInternal(chunk, len);
+      _ring.releaseRead();
+      _chunksSent++;
+      adaptChunkSizeInternal();
+    }
+  }
+}
+
+/**
+ * @brief Frees the chunk buffers and the ring after a failed initAcquisition(), so it can be retried.
+ */
+static void freeChunkBuffersInternal() {
+  free(_scratchChunk);
+  free(_encodeBuffer);
+  _scratchChunk = nullptr;
+  _encodeBuffer = nullptr;
+  _ring.end();
+}
+
+// --- Public Function Implementations ---
+
+bool initAcquisition(const uint8_t* pins, uint8_t numPins, uint32_t sampleRateHz,
+                     uint16_t samplesPerChunk, AcquisitionChunkCallback onChunk, StreamEncoding encoding) {
+  if (_samplerTask != nullptr) {
+    ESP32WS_LOGE("Acquisition Error: initAcquisition() already called.");
+    return false;
+  }
+  if (!pins || numPins == 0 || numPins > ESP32WS_ACQ_MAX_CHANNELS) {
+    ESP32WS_LOGE("Acquisition Error: numPins must be 1..%d.", ESP32WS_ACQ_MAX_CHANNELS);
+    return false;
+  }
+  if (sampleRateHz == 0 || sampleRateHz > ESP32WS_ACQ_MAX_SAMPLE_RATE_HZ) {
+    ESP32WS_LOGE("Acquisition Error: sampleRateHz must be 1..%d.", ESP32WS_ACQ_MAX_SAMPLE_RATE_HZ);
+    return false;
+  }
+  if (samplesPerChunk == 0) {
+    ESP32WS_LOGE("Acquisition Error: samplesPerChunk must be greater than 0.");
+    return false;
+  }
+
+  // Map GPIOs to ADC1 channels
+  adc1_config_width(ADC_WIDTH_BIT_12);
+  for (uint8_t i = 0; i < numPins; i++) {
+    int8_t channel = digitalPinToAnalogChannel(pins[i]);
+    if (channel < 0 || channel >= ADC1_CHANNEL_MAX) {
+      ESP32WS_LOGE("Acquisition Error: GPIO %u is not an ADC1 pin.", pins[i]);
+      return false;
+    }
+    _channels[i] = (adc1_channel_t)channel;
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    adc1_config_channel_atten(_channels[i], ADC_ATTEN_DB_12); // Same range; DB_11 is deprecated in IDF 5
+#else
+    adc1_config_channel_atten(_channels[i], ADC_ATTEN_DB_11);
+#endif
+  }
+  _numChannels = numPins;
+  _samplesPerChunk = samplesPerChunk;
+  _maxSamplesPerChunk = samplesPerChunk;
+  _targetSamplesPerChunk = samplesPerChunk;
+  _samplePeriodUs = 1000000UL / sampleRateHz;
+  _packetSize = (size_t)numPins * sizeof(uint16_t);
+  _onChunk = onChunk;
+  _frameMode = (onChunk == nullptr && encoding == STREAM_ENC_RAW);
+
+  // Declare the stream: one raw 12-bit channel per pin, named after its GPIO
+  StreamChannel streamChannels[ESP32WS_ACQ_MAX_CHANNELS];
+  for (uint8_t i = 0; i < numPins; i++) {
+    snprintf(_channelNames[i], sizeof(_channelNames[i]), "GPIO%u", pins[i]);
+    streamChannels[i] = { _channelNames[i], STREAM_U16, 1, 1.0f, 0.0f, "" };
+  }
+  _streamId = registerStream("adc", streamChannels, numPins, _samplePeriodUs, samplesPerChunk, encoding);
+  if (_streamId < 0) {
+    ESP32WS_LOGE("Acquisition Error: Failed to register the acquisition stream.");
+    return false;
+  }
+
+  registerMetricGauge("acq_ring_depth", ringDepthGaugeInternal);
+  registerMetricGauge("acq_ring_high_water", ringHighWaterGaugeInternal);
+  registerMetricGauge("acq_missed_samples", missedSamplesGaugeInternal);
+  registerMetricGauge("acq_chunks_dropped", chunksDroppedGaugeInternal);
+  registerMetricGauge("acq_samples_per_chunk", samplesPerChunkGaugeInternal);
+
+  size_t chunkBytes = getStreamFrameSize(_streamId);
+  size_t slotBytes = _frameMode ? sizeof(BinaryFrame*) : chunkBytes;
+  if (_frameMode && !initFramePoolInternal(1)) { // Split into sizes by setAcquisitionChunking()
+    ESP32WS_LOGE("Acquisition Error: Failed to create the binary frame pool.");
+    return false;
+  }
+  _scratchChunk = (uint8_t*)malloc(chunkBytes);
+  if (encoding != STREAM_ENC_RAW) {
+    _encodeBuffer = (uint8_t*)malloc(getStreamEncodedFrameCapacity(_streamId));
+  }
+  if (!_scratchChunk || (encoding != STREAM_ENC_RAW && !_encodeBuffer) ||
+      !_ring.begin(slotBytes, ESP32WS_ACQ_RING_SLOTS)) {
+    ESP32WS_LOGE("Acquisition Error: Failed to allocate chunk buffers.");
+    freeChunkBuffersInternal();
+    return false;
+  }
+
+  if (xTaskCreatePinnedToCore(senderTask, "ws_sender", SENDER_TASK_STACK_SIZE, nullptr,
+                              SENDER_TASK_PRIORITY, &_senderTask, SENDER_TASK_CORE) != pdPASS) {
+    ESP32WS_LOGE("Acquisition Error: Failed to create sender task.");
+    _senderTask = nullptr;
+    freeChunkBuffersInternal();
+    return false;
+  }
+  if (xTaskCreatePinnedToCore(samplerTask, "ws_sampler", SAMPLER_TASK_STACK_SIZE, nullptr,
+                              SAMPLER_TASK_PRIORITY, &_samplerTask, SAMPLER_TASK_CORE) != pdPASS) {
+    ESP32WS_LOGE("Acquisition Error: Failed to create sampler task.");
+    _samplerTask = nullptr;
+    vTaskDelete(_senderTask); // Idle: nothing was published, so it is blocked in ulTaskNotifyTake()
+    _senderTask = nullptr;
+    freeChunkBuffersInternal();
+    return false;
+  }
+
+  // 1 MHz timer tick (80 MHz APB clock / 80), alarm every sample period, auto-reload
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+  _timer = timerBegin(1000000);
+  timerAttachInterrupt(_timer, &onAcquisitionTimer);
+  timerAlarm(_timer, _samplePeriodUs, true, 0);
+  timerStop(_timer);
+#else
+  _timer = timerBegin(ACQ_TIMER_NUMBER, 80, true);
+  timerAttachInterrupt(_timer, &onAcquisitionTimer, true);
+  timerAlarmWrite(_timer, _samplePeriodUs, true);
+#endif
+
+  ESP32WS_LOGI("Acquisition ready: %u channels, %lu us period, %u samples/chunk (%u bytes), %u ring slots.",
+               _numChannels, (unsigned long)_samplePeriodUs, _samplesPerChunk, (unsigned)chunkBytes, ESP32WS_ACQ_RING_SLOTS);
+  return true;
+}
+
+bool setAcquisitionChunking(uint16_t minSamplesPerChunk, uint32_t maxLatencyUs) {
+  if (!_samplerTask) {
+    ESP32WS_LOGE("Acquisition Error: setAcquisitionChunking() before initAcquisition().");
+    return false;
+  }
+  uint16_t maxSamples = _samplesPerChunk;
+  if (maxLatencyUs > 0) {
+    uint32_t deadlineSamples = maxLatencyUs / _samplePeriodUs;
+    if (deadlineSamples < 1) deadlineSamples = 1;
+    if (deadlineSamples < maxSamples) maxSamples = (uint16_t)deadlineSamples;
+  }
+  matchFramePoolInternal(minSamplesPerChunk > 0 && minSamplesPerChunk < maxSamples);
+  maxSamples = roundToFrameClassInternal(maxSamples, false);
+  uint16_t minSamples = roundToFrameClassInternal(minSamplesPerChunk, true);
+  if (minSamplesPerChunk == 0 || minSamples >= maxSamples) minSamples = 0;
+  // Start small when adapting: the link proves it is contended before chunks grow
+  _maxSamplesPerChunk = maxSamples;
+  _minSamplesPerChunk = minSamples;
+  _targetSamplesPerChunk = minSamples ? minSamples : maxSamples;
+  _idleChunks = 0;
+  ESP32WS_LOGI("Acquisition chunking: %u..%u samples/chunk (%s).", minSamples ? minSamples : maxSamples,
+               maxSamples, minSamples ? "adaptive" : "fixed");
+  return true;
+}
+
+uint16_t getAcquisitionSamplesPerChunk() {
+  return _targetSamplesPerChunk;
+}
+
+bool startAcquisition() {
+  if (!_timer || !_samplerTask) {
+    ESP32WS_LOGE("Acquisition Error: startAcquisition() before initAcquisition().");
+    return false;
+  }
+  if (_running) return true;
+  _missedSamples = 0;
+  _chunksProduced = 0;
+  _chunksDropped = 0;
+  _chunksSent = 0;
+  _ringHighWater = 0;
+  _rawBytes = 0;
+  _sentBytes = 0;
+  _restartPending = true;
+  _everStarted = true;
+  _running = true;
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+  timerWrite(_timer, 0);
+  timerStart(_timer);
+#else
+  timerWrite(_timer, 0);
+  timerAlarmEnable(_timer);
+#endif
+  ESP32WS_LOGI("Acquisition started.");
+  return true;
+}
+
+void stopAcquisition() {
+  if (!_timer || !_running) return;
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+  timerStop(_timer);
+#else
+  timerAlarmDisable(_timer);
+#endif
+  _running = false;
+  ESP32WS_LOGI("Acquisition stopped (%lu missed samples, %lu/%lu chunks dropped).",
+               (unsigned long)_missedSamples, (unsigned long)_chunksDropped, (unsigned long)_chunksProduced);
+}
+
+bool isAcquisitionRunning() {
+  return _running;
+}
+
+uint32_t getAcquisitionMissedSamples() {
+  return _missedSamples;
+}
+
+void getAcquisitionStats(AcquisitionStats* stats) {
+  if (!stats) return;
+  stats->missedSamples = _missedSamples;
+  stats->chunksProduced = _chunksProduced;
+  stats->chunksDropped = _chunksDropped;
+  stats->chunksSent = _chunksSent;
+  stats->ringDepth = _ring.capacity() ? _ring.depth() : 0;
+  stats->ringHighWater = _ringHighWater;
+  stats->ringSlots = _ring.capacity();
+  stats->rawBytes = _rawBytes;
+  stats->sentBytes = _sentBytes;
+  stats->samplesPerChunk = _targetSamplesPerChunk;
+}
+
+int getAcquisitionStreamId() {
+  return _streamId;
+}
+
+size_t getAcquisitionPacketSize() {
+  return _packetSize;
+}
+
+uint32_t getAcquisitionSamplePeriodUs() {
+  return _samplePeriodUs;
+}
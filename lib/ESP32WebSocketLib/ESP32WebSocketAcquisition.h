@@ -0,0 +1,170 @@
+/**
+ * @file ESP32WebSocketAcquisition.h
+ * @brief Hardware-timed ADC acquisition engine for the ESP32WebSocket library.
+ *        A hardware timer fires at the configured sample rate and wakes a
+ *        high-priority sampler task (core 1) that reads the ADC1 channels and fills
+ *        self-describing stream frames (ESP32WebSocketStream.h). Full chunks are queued in a lock-free ring and
+ *        drained by a sender task (core 0) that hands them to a callback
+ *        (by default broadcastBinaryData()), so the application only has to
+ *        configure pins, rate and chunk size.
+ */
+#ifndef ESP32_WEBSOCKET_ACQUISITION_H
+#define ESP32_WEBSOCKET_ACQUISITION_H
+
+#include <Arduino.h>
+#include "ESP32WebSocketStream.h"
+
+// --- Acquisition Limits ---
+
+/// Maximum number of analog channels per acquisition (ADC1 exposes 8 channels, GPIO 32-39).
+#define ESP32WS_ACQ_MAX_CHANNELS 8
+/// Highest accepted sample rate (samples per second, per channel set).
+#define ESP32WS_ACQ_MAX_SAMPLE_RATE_HZ 20000
+/// Number of chunk slots between the sampler and the sender task (power of two; override with a build flag).
+#ifndef ESP32WS_ACQ_RING_SLOTS
+#define ESP32WS_ACQ_RING_SLOTS 8
+#endif
+/// Frame mode with adaptive chunking: number of pooled frame lengths (capacity, 1/2, 1/4, ...) the chunk
+/// size is rounded to. A fixed chunk size always keeps every pooled frame at full capacity.
+#ifndef ESP32WS_ACQ_FRAME_CLASSES
+#define ESP32WS_ACQ_FRAME_CLASSES 4
+#endif
+/// Adaptive chunking: subscriber queue depth (messages) at which the link counts as contended.
+#ifndef ESP32WS_ACQ_ADAPT_QUEUE_HIGH
+#define ESP32WS_ACQ_ADAPT_QUEUE_HIGH 2
+#endif
+/// Adaptive chunking: consecutive chunks delivered to empty queues before the chunk size shrinks.
+#ifndef ESP32WS_ACQ_ADAPT_IDLE_CHUNKS
+#define ESP32WS_ACQ_ADAPT_IDLE_CHUNKS 8
+#endif
+
+/**
+ * @struct AcquisitionStats
+ * @brief Counters describing how well the sender keeps up with the sampler.
+ *        All counters restart at startAcquisition().
+ */
+struct AcquisitionStats {
+  uint32_t missedSamples;   ///< Timer ticks that could not be sampled on time.
+  uint32_t chunksProduced;  ///< Chunks completed by the sampler.
+  uint32_t chunksDropped;   ///< Chunks discarded because the ring or frame pool was exhausted (network too slow).
+  uint32_t chunksSent;      ///< Chunks handed to the consumer by the sender task.
+  uint16_t ringDepth;       ///< Chunks currently queued in the ring.
+  uint16_t ringHighWater;   ///< Highest ring depth observed.
+  uint16_t ringSlots;       ///< Ring capacity (ESP32WS_ACQ_RING_SLOTS).
+  uint32_t rawBytes;        ///< Bytes of the chunks handed to the consumer, before encoding.
+  uint32_t sentBytes;       ///< Bytes actually handed to the consumer (after encoding).
+  uint16_t samplesPerChunk; ///< Current chunk size target (fixed unless setAcquisitionChunking() enabled adaptation).
+};
+
+/**
+ * @typedef AcquisitionChunkCallback
+ * @brief Called from the sender task (core 0) for each complete chunk (one stream frame).
+ *        The buffer is only valid for the duration of the call; a slow callback
+ *        delays the sender, and chunks are dropped (counted) once the ring fills up.
+ *
+ * Each chunk is one frame of the acquisition stream (see ESP32WebSocketStream.h), shown here
+ * raw; with an encoding, the samples are replaced by the encoded payload:
+ *   StreamFrameHeader header;              // Stream id, sequence, sample count, base time (us)
+ *   uint16_t reading[sampleCount][numPins]; // Raw 12-bit ADC1 readings, in pin order
+ * Sample i was taken at header.baseTimeUs + i * getAcquisitionSamplePeriodUs().
+ */
+typedef void (*AcquisitionChunkCallback)(const uint8_t* data, size_t len);
+
+/**
+ * @brief Configures the acquisition engine: validates the pins, sets up ADC1, registers the
+ *        "adc" stream (one u16 channel per pin, named "GPIO<n>"), allocates the chunk ring and
+ *        creates the sampler (core 1) and sender (core 0) tasks.
+ *        Must be called once, before startAcquisition().
+ *
+ * @param pins Array of GPIO numbers to sample. All must be ADC1 pins (ADC2 is unusable with WiFi).
+ * @param numPins Number of entries in pins (1..ESP32WS_ACQ_MAX_CHANNELS).
+ * @param sampleRateHz Desired sample rate in Hz (1..ESP32WS_ACQ_MAX_SAMPLE_RATE_HZ).
+ *                     The timer runs at 1 MHz, so the actual period is rounded to whole microseconds.
+ * @param samplesPerChunk Number of samples per chunk (a chunk is closed early when samples are missed).
+ *                        With setAcquisitionChunking(), the maximum chunk size (buffer capacity).
+ * @param onChunk (Optional) Chunk consumer. If nullptr, the engine creates the binary frame pool
+ *                (initBinaryFramePool()) and the sampler writes straight into pooled frames that are
+ *                broadcast with broadcastBinaryFrame(): no copy and no allocation per chunk. Every
+ *                pooled frame holds samplesPerChunk samples; setAcquisitionChunking() splits the pool
+ *                into ESP32WS_ACQ_FRAME_CLASSES fixed lengths so that adaptive sizes never reallocate.
+ *                If an encoding is set, chunks are encoded by the sender task and broadcast
+ *                with broadcastBinaryData() (encoded chunks vary in length and are copied per client).
+ * @param encoding (Optional) Stream payload encoding (see StreamEncoding). STREAM_ENC_PACK12 cuts
+ *                 25%; STREAM_ENC_DELTA typically 3-4x on slowly varying signals.
+ * @return True if the engine is ready, false on invalid configuration or allocation failure.
+ */
+bool initAcquisition(const uint8_t* pins, uint8_t numPins, uint32_t sampleRateHz,
+                     uint16_t samplesPerChunk, AcquisitionChunkCallback onChunk = nullptr,
+                     StreamEncoding encoding = STREAM_ENC_RAW);
+
+/**
+ * @brief Lets the chunk size follow the link conditions and/or bounds chunk latency.
+ *        After each delivered chunk the sender task looks at the deepest subscriber send queue
+ *        (getSubscriberQueueDepth()) and the ring depth: when either backs up, the chunk size is
+ *        doubled (fewer, larger frames amortise the WebSocket, TCP and 802.11 per-frame costs); after
+ *        ESP32WS_ACQ_ADAPT_IDLE_CHUNKS chunks delivered to empty queues it shrinks by a quarter, down to
+ *        minSamplesPerChunk, for low display latency on a quiet link. The sampler applies the new size
+ *        from the next chunk on; clients read the sample count from each frame header.
+ *        In zero-copy frame mode the bounds and the target are rounded to the pool's frame lengths
+ *        (see ESP32WS_ACQ_FRAME_CLASSES): the minimum up, the maximum and the target down. Call it
+ *        before the first startAcquisition(), which is when the pool is rebuilt for the chosen mode;
+ *        later calls round to the pool as it is.
+ *        May be called at any time after initAcquisition().
+ *
+ * @param minSamplesPerChunk Smallest chunk size. 0 (or >= the capacity) keeps the size fixed.
+ * @param maxLatencyUs (Optional) Deadline: a chunk is sent once it spans this long, even below the
+ *                     capacity given to initAcquisition(). 0 means no deadline.
+ * @return False before initAcquisition().
+ */
+bool setAcquisitionChunking(uint16_t minSamplesPerChunk, uint32_t maxLatencyUs = 0);
+
+/**
+ * @brief Returns the current chunk size target in samples.
+ */
+uint16_t getAcquisitionSamplesPerChunk();
+
+/**
+ * @brief Starts the hardware timer. Timestamps restart from zero.
+ *        Safe to call from the WebSocket stream callbacks.
+ * @return True if acquisition is running after the call.
+ */
+bool startAcquisition();
+
+/**
+ * @brief Stops the hardware timer. A partially filled chunk is discarded.
+ */
+void stopAcquisition();
+
+/**
+ * @brief Returns true while the hardware timer is driving acquisition.
+ */
+bool isAcquisitionRunning();
+
+/**
+ * @brief Returns the number of timer ticks that elapsed while the sampler was still busy
+ *        (i.e. samples that could not be taken on time) since the last startAcquisition().
+ */
+uint32_t getAcquisitionMissedSamples();
+
+/**
+ * @brief Copies the current acquisition/ring counters into stats.
+ * @param stats Destination structure.
+ */
+void getAcquisitionStats(AcquisitionStats* stats);
+
+/**
+ * @brief Returns the stream id registered by initAcquisition(), or -1 before it.
+ */
+int getAcquisitionStreamId();
+
+/**
+ * @brief Returns the size in bytes of one sample (numPins * 2), excluding the frame header.
+ */
+size_t getAcquisitionPacketSize();
+
+/**
+ * @brief Returns the actual sample period in microseconds after rounding.
+ */
+uint32_t getAcquisitionSamplePeriodUs();
+
+#endif // ESP32_WEBSOCKET_ACQUISITION_H
@@ -0,0 +1,214 @@
+/**
+ * @file ESP32WebSocketCapture.cpp
+ * @brief Capture list and ranged download routes behind ESP32WebSocketCapture.h.
+ *        The body of a download is produced by a filler callback that reads the file straight into
+ *        the TCP send buffer the web server hands it, so a transfer needs no buffer of its own and
+ *        runs as fast as the link acknowledges.
+ */
+#include "ESP32WebSocketCapture.h"
+#include "ESP32WebSocket.h"
+#include "ESP32WebSocketLog.h"
+#include "ESP32WebSocketRecorder.h"
+#include <LittleFS.h>
+
+// --- Capture-Internal Helpers ---
+
+/**
+ * @enum RangeResult
+ * @brief Outcome of parsing a Range header against a file size.
+ */
+enum RangeResult {
+  RANGE_ALL,           ///< No usable range (absent, malformed or several ranges): send the whole file.
+  RANGE_PARTIAL,       ///< Send bytes [first, last].
+  RANGE_UNSATISFIABLE  ///< The range starts beyond the end of the file (416).
+};
+
+/**
+ * @brief Parses a single "bytes=first-last", "bytes=first-" or "bytes=-suffix" range.
+ */
+static RangeResult parseRangeInternal(const char* value, size_t size, size_t* first, size_t* last) {
+  if (strncmp(value, "bytes=", 6) != 0 || strchr(value, ',')) return RANGE_ALL;
+  const char* spec = value + 6;
+  char* end;
+  if (*spec == '-') { // The last n bytes
+    unsigned long count = strtoul(spec + 1, &end, 10);
+    if (end == spec + 1 || *end) return RANGE_ALL;
+    if (count == 0 || size == 0) return RANGE_UNSATISFIABLE;
+    *first = count >= size ? 0 : size - count;
+    *last = size - 1;
+    return RANGE_PARTIAL;
+  }
+  unsigned long from = strtoul(spec, &end, 10);
+  if (end == spec || *end != '-') return RANGE_ALL;
+  const char* toSpec = end + 1;
+  unsigned long to = size > 0 ? size - 1 : 0; // "first-": to the end of the file
+  if (*toSpec) {
+    to = strtoul(toSpec, &end, 10);
+    if (end == toSpec || *end || to < from) return RANGE_ALL;
+  }
+  if (from >= size) return RANGE_UNSATISFIABLE;
+  *first = from;
+  *last = to >= size ? size - 1 : to;
+  return RANGE_PARTIAL;
+}
+
+/**
+ * @brief Accepts plain file names with the capture extension (no path separators, no "..").
+ */
+static bool isCaptureNameInternal(const char* name) {
+  size_t len = strlen(name);
+  size_t extLen = strlen(ESP32WS_CAPTURE_EXT);
+  if (len <= extLen || len > 64 || strcmp(name + len - extLen, ESP32WS_CAPTURE_EXT) != 0 || name[0] == '.') {
+    return false;
+  }
+  for (size_t i = 0; i < len; i++) {
+    char c = name[i];
+    if (!isalnum((unsigned char)c) && c != '.' && c != '_' && c != '-') return false;
+  }
+  return true;
+}
+
+static String capturePathInternal(const char* name) {
+  String path = ESP32WS_CAPTURE_DIR;
+  if (!path.endsWith("/")) path += "/";
+  path += name;
+  return path;
+}
+
+/**
+ * @brief Answers 503 while LittleFS is still mounting (or failed to mount).
+ * @return True if the request was answered.
+ */
+static bool rejectWithoutFilesystemInternal(AsyncWebServerRequest* request) {
+  if (waitForFilesystem(0)) return false;
+  AsyncWebServerResponse* response = request->beginResponse(503, "text/plain", "Filesystem unavailable");
+  response->addHeader("Retry-After", "1");
+  request->send(response);
+  return true;
+}
+
+/**
+ * @brief GET /captures: lists the capture files and their sizes.
+ */
+static void handleCaptureListInternal(AsyncWebServerRequest* request) {
+  if (rejectWithoutFilesystemInternal(request)) return;
+  File dir = LittleFS.open(ESP32WS_CAPTURE_DIR);
+  AsyncResponseStream* response = request->beginResponseStream("application/json");
+  response->print("{\"captures\":[");
+  bool first = true;
+  if (dir && dir.isDirectory()) {
+    for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+      // Names that pass the check need no JSON escaping
+      if (file.isDirectory() || !isCaptureNameInternal(file.name())) continue;
+      response->printf("%s{\"name\":\"%s\",\"size\":%u}", first ? "" : ",", file.name(), (unsigned)file.size());
+      first = false;
+    }
+  }
+  response->print("]}");
+  response->addHeader("Cache-Control", "no-store");
+  response->addHeader("Access-Control-Allow-Origin", "*");
+  request->send(response);
+}
+
+/**
+ * @brief GET /captures/<name>: streams the file, or the requested byte range of it.
+ */
+static void handleCaptureDownloadInternal(AsyncWebServerRequest* request, const char* name) {
+  if (rejectWithoutFilesystemInternal(request)) return;
+  if (!isCaptureNameInternal(name)) {
+    request->send(404, "text/plain", "Not a capture file");
+    return;
+  }
+  File file = LittleFS.open(capturePathInternal(name), FILE_READ);
+  if (!file || file.isDirectory()) {
+    request->send(404, "text/plain", "Capture not found");
+    return;
+  }
+  size_t size = file.size();
+  // Strong validator of this version of the file: a resume is only served against the same one
+  char etag[40];
+  snprintf(etag, sizeof(etag), "\"%x-%lx-%x\"", (unsigned)size, (unsigned long)file.getLastWrite(),
+           (unsigned)spillFileVersion(capturePathInternal(name).c_str()));
+  size_t first = 0;
+  size_t last = size > 0 ? size - 1 : 0;
+  RangeResult range = RANGE_ALL;
+  bool sameVersion = !request->hasHeader("If-Range") || request->getHeader("If-Range")->value() == etag;
+  if (request->hasHeader("Range") && sameVersion) {
+    range = parseRangeInternal(request->getHeader("Range")->value().c_str(), size, &first, &last);
+  }
+  char contentRange[48];
+  if (range == RANGE_UNSATISFIABLE) {
+    AsyncWebServerResponse* response = request->beginResponse(416, "text/plain", "Range not satisfiable");
+    snprintf(contentRange, sizeof(contentRange), "bytes */%u", (unsigned)size);
+    response->addHeader("Content-Range", contentRange);
+    response->addHeader("ETag", etag);
+    request->send(response);
+    return;
+  }
+  size_t length = size > 0 ? last - first + 1 : 0;
+  ESP32WS_LOGI("Capture download: %s, bytes %u-%u of %u", name, (unsigned)first, (unsigned)last, (unsigned)size);
+
+  AsyncWebServerResponse* response = request->beginResponse("application/octet-stream", length,
+      [file, first, length](uint8_t* buffer, size_t maxLen, size_t index) mutable -> size_t {
+        if (index >= length) return 0;
+        size_t pos = first + index;
+        size_t count = length - index < maxLen ? length - index : maxLen;
+        // End on a block boundary when more than a block fits, so the next read starts on one too
+        size_t toBoundary = ESP32WS_CAPTURE_READ_ALIGN - pos % ESP32WS_CAPTURE_READ_ALIGN;
+        if (count > toBoundary && count < length - index) {
+          count = toBoundary + (count - toBoundary) / ESP32WS_CAPTURE_READ_ALIGN * ESP32WS_CAPTURE_READ_ALIGN;
+        }
+        if (file.position() != pos && !file.seek(pos)) return 0;
+        return file.read(buffer, count); // A short read ends the response early; the client resumes
+      });
+  if (range == RANGE_PARTIAL) {
+    response->setCode(206);
+    snprintf(contentRange, sizeof(contentRange), "bytes %u-%u/%u", (unsigned)first, (unsigned)last, (unsigned)size);
+    response->addHeader("Content-Range", contentRange);
+  }
+  String disposition = String("attachment; filename=\"") + name + "\"";
+  response->addHeader("Content-Disposition", disposition);
+  response->addHeader("Accept-Ranges", "bytes");
+  response->addHeader("ETag", etag);
+  response->addHeader("Cache-Control", "no-store"); // The spill file changes while it is recorded
+  response->addHeader("Access-Control-Allow-Origin", "*");
+  response->addHeader("Access-Control-Expose-Headers", "Content-Range, ETag");
+  request->send(response);
+}
+
+/**
+ * @class CaptureHandler
+ * @brief HTTP handler for ESP32WS_CAPTURE_URL and the files below it.
+ */
+class CaptureHandler : public AsyncWebHandler {
+public:
+  bool canHandle(AsyncWebServerRequest* request) override {
+    if (request->method() != HTTP_GET) return false;
+    const String& url = request->url();
+    if (url != ESP32WS_CAPTURE_URL && !url.startsWith(ESP32WS_CAPTURE_URL "/")) return false;
+    request->addInterestingHeader("Range"); // Other headers are dropped before handleRequest()
+    request->addInterestingHeader("If-Range");
+    return true;
+  }
+
+  void handleRequest(AsyncWebServerRequest* request) override {
+    const char* url = request->url().c_str();
+    const char* name = url + strlen(ESP32WS_CAPTURE_URL);
+    if (*name == '/') name++;
+    if (*name == '\0') {
+      handleCaptureListInternal(request);
+    } else {
+      handleCaptureDownloadInternal(request, name);
+    }
+  }
+};
+
+static CaptureHandler _captureHandler;
+
+
+// --- Library-Internal Interface ---
+
+void addCaptureRoutes(AsyncWebServer& server) {
+  server.addHandler(&_captureHandler);
+  ESP32WS_LOGI("Capture downloads at %s (%s*%s).", ESP32WS_CAPTURE_URL, ESP32WS_CAPTURE_DIR, ESP32WS_CAPTURE_EXT);
+}
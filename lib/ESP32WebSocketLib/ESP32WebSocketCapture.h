@@ -0,0 +1,49 @@
+/**
+ * @file ESP32WebSocketCapture.h
+ * @brief HTTP download of recorded capture files for the ESP32WebSocket library.
+ *        Capture files are the LittleFS files in ESP32WS_CAPTURE_DIR whose name ends in
+ *        ESP32WS_CAPTURE_EXT, such as the stream recorder's spill file (see ESP32WebSocketRecorder.h).
+ *          GET /captures         -> {"captures":[{"name":"capture.rec","size":524288},...]}
+ *          GET /captures/<name>  -> the file, streamed from flash (never loaded into RAM)
+ *        Downloads honour a single "Range: bytes=..." request (206 Partial Content), so an interrupted
+ *        transfer resumes where it stopped (e.g. scripts/fetch_capture.py). Each download carries an ETag
+ *        (size, last write and, for the recorder's spill file, its newest block); a ranged request whose
+ *        "If-Range" no longer matches it gets the whole file, so a resume never stitches two versions.
+ *        The spill file is rewritten in place while it records: its ETag changes with every block, so a
+ *        download of it only resumes once recording stopped, and otherwise starts over. A single
+ *        download is still taken while blocks are written: each block is self-describing (it carries its
+ *        sequence number), and the blocks of the last ESP32WS_RECORDER_SYNC_BLOCKS writes may be missing.
+ */
+#ifndef ESP32_WEBSOCKET_CAPTURE_H
+#define ESP32_WEBSOCKET_CAPTURE_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+// --- Capture Download Configuration ---
+
+/// URL prefix of the capture routes.
+#ifndef ESP32WS_CAPTURE_URL
+#define ESP32WS_CAPTURE_URL "/captures"
+#endif
+/// LittleFS directory holding the capture files.
+#ifndef ESP32WS_CAPTURE_DIR
+#define ESP32WS_CAPTURE_DIR "/"
+#endif
+/// Only files with this extension are listed and served (the web app's files stay private).
+#ifndef ESP32WS_CAPTURE_EXT
+#define ESP32WS_CAPTURE_EXT ".rec"
+#endif
+/// File reads end on multiples of this (the LittleFS block size), so each read covers whole cached blocks.
+#ifndef ESP32WS_CAPTURE_READ_ALIGN
+#define ESP32WS_CAPTURE_READ_ALIGN 4096
+#endif
+
+// --- Library-Internal Interface (used by ESP32WebSocket.cpp) ---
+
+/**
+ * @brief Adds the capture list and download routes. Requests answer 503 until LittleFS is mounted.
+ */
+void addCaptureRoutes(AsyncWebServer& server);
+
+#endif // ESP32_WEBSOCKET_CAPTURE_H
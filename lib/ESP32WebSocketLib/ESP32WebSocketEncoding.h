@@ -0,0 +1,109 @@
+/**
+ * @file ESP32WebSocketEncoding.h
+ * @brief Payload encoders of the binary stream frames ("pack12" and "delta", see StreamEncoding in
+ *        ESP32WebSocketStream.h). Plain C++ without Arduino dependencies, so the native unit tests
+ *        (pio test -e native) can check the exact bytes that data/js/streamDecoder.js decodes.
+ */
+#ifndef ESP32_WEBSOCKET_ENCODING_H
+#define ESP32_WEBSOCKET_ENCODING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @class BitWriter
+ * @brief Appends fields of up to 24 bits LSB-first to a byte buffer.
+ */
+class BitWriter {
+public:
+  explicit BitWriter(uint8_t* out) : _out(out) {}
+  void write(uint32_t value, uint8_t width) {
+    _acc |= value << _bits;
+    _bits += width;
+    while (_bits >= 8) {
+      *_out++ = (uint8_t)_acc;
+      _acc >>= 8;
+      _bits -= 8;
+    }
+  }
+  /// Pads to a whole byte; returns the position after the last written byte.
+  uint8_t* flush() {
+    if (_bits > 0) *_out++ = (uint8_t)_acc;
+    _acc = 0;
+    _bits = 0;
+    return _out;
+  }
+private:
+  uint8_t* _out;
+  uint32_t _acc = 0;
+  uint8_t _bits = 0;
+};
+
+/// Reads value 'column' of sample 'sample' from a raw 16-bit payload (unaligned-safe).
+inline uint16_t streamRawValue16(const uint8_t* payload, size_t sampleSize, uint16_t sample, uint16_t column) {
+  const uint8_t* p = payload + (size_t)sample * sampleSize + (size_t)column * 2;
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/**
+ * @brief Encodes raw u16 samples as "pack12": the low 12 bits of every value, sample-major.
+ * @return Length of the encoded payload.
+ */
+inline size_t encodePack12Payload(const uint8_t* payload, size_t sampleSize, uint16_t numColumns,
+                                  uint16_t sampleCount, uint8_t* out) {
+  BitWriter writer(out);
+  for (uint16_t i = 0; i < sampleCount; i++) {
+    for (uint16_t c = 0; c < numColumns; c++) {
+      writer.write(streamRawValue16(payload, sampleSize, i, c) & 0x0FFF, 12);
+    }
+  }
+  return writer.flush() - out;
+}
+
+/**
+ * @brief Encodes raw u16/i16 samples as "delta": per column [first:u16][width:u8][zigzag deltas].
+ * @param counts Values per sample of each channel (the channels' columns follow each other).
+ * @param isSigned True for the i16 channels.
+ * @param numChannels Entries in counts and isSigned.
+ * @return Length of the encoded payload (at most 3 + ceil((sampleCount - 1) * 17 / 8) bytes per column).
+ */
+inline size_t encodeDeltaPayload(const uint8_t* payload, size_t sampleSize, uint16_t sampleCount,
+                                 const uint8_t* counts, const bool* isSigned, uint8_t numChannels, uint8_t* out) {
+  if (sampleCount == 0) return 0;
+  uint8_t* pos = out;
+  uint16_t column = 0;
+  for (uint8_t ch = 0; ch < numChannels; ch++) {
+    for (uint8_t k = 0; k < counts[ch]; k++, column++) {
+      // Pass 1: largest zigzag delta decides the column's bit width
+      uint16_t first = streamRawValue16(payload, sampleSize, 0, column);
+      int32_t previous = isSigned[ch] ? (int32_t)(int16_t)first : (int32_t)first;
+      uint32_t maxZigzag = 0;
+      for (uint16_t i = 1; i < sampleCount; i++) {
+        uint16_t raw = streamRawValue16(payload, sampleSize, i, column);
+        int32_t value = isSigned[ch] ? (int32_t)(int16_t)raw : (int32_t)raw;
+        int32_t delta = value - previous;
+        maxZigzag |= ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+        previous = value;
+      }
+      uint8_t width = maxZigzag ? (uint8_t)(32 - __builtin_clz(maxZigzag)) : 0;
+      *pos++ = (uint8_t)first;
+      *pos++ = (uint8_t)(first >> 8);
+      *pos++ = width;
+      if (width == 0) continue; // Constant column: no delta bits at all
+      // Pass 2: pack the deltas
+      BitWriter writer(pos);
+      previous = isSigned[ch] ? (int32_t)(int16_t)first : (int32_t)first;
+      for (uint16_t i = 1; i < sampleCount; i++) {
+        uint16_t raw = streamRawValue16(payload, sampleSize, i, column);
+        int32_t value = isSigned[ch] ? (int32_t)(int16_t)raw : (int32_t)raw;
+        int32_t delta = value - previous;
+        writer.write(((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31), width);
+        previous = value;
+      }
+      pos = writer.flush();
+    }
+  }
+  return pos - out;
+}
+
+#endif // ESP32_WEBSOCKET_ENCODING_H
@@ -0,0 +1,120 @@
+/**
+ * @file ESP32WebSocketLog.cpp
+ * @brief Line formatting and the optional asynchronous ring sink behind the ESP32WS_LOGx macros.
+ */
+#include "ESP32WebSocketLog.h"
+#include <stdarg.h>
+
+#if ESP32WS_LOG_RING_BYTES > 0
+
+/// Priority of the task writing the ring to Serial (just above idle, so it only uses spare time).
+#ifndef ESP32WS_LOG_TASK_PRIORITY
+#define ESP32WS_LOG_TASK_PRIORITY 1
+#endif
+
+// --- Asynchronous Sink State ---
+
+// Byte ring of whole lines. Any task may write (under the spinlock); only the log task reads,
+// so it can copy [tail, head) to Serial without holding the lock.
+static char _ring[ESP32WS_LOG_RING_BYTES];
+static size_t _head = 0;  // Next write position
+static size_t _tail = 0;  // Next read position (_head == _tail: empty)
+static uint32_t _droppedLines = 0;
+static TaskHandle_t _logTask = nullptr;
+static bool _logTaskCreating = false;
+static portMUX_TYPE _ringMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Log task body: writes everything queued, then sleeps until the next line.
+ */
+static void logTask(void* param) {
+  uint32_t reportedDrops = 0;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    for (;;) {
+      portENTER_CRITICAL(&_ringMux);
+      size_t head = _head;
+      size_t tail = _tail;
+      uint32_t dropped = _droppedLines;
+      portEXIT_CRITICAL(&_ringMux);
+      if (head == tail) {
+        if (dropped != reportedDrops) {
+          Serial.printf("[ESP32WS][W] %lu log line(s) dropped (ring full).\n", (unsigned long)(dropped - reportedDrops));
+          reportedDrops = dropped;
+        }
+        break;
+      }
+      size_t span = head > tail ? head - tail : ESP32WS_LOG_RING_BYTES - tail; // Contiguous part
+      Serial.write((const uint8_t*)&_ring[tail], span);
+      portENTER_CRITICAL(&_ringMux);
+      _tail = (tail + span) % ESP32WS_LOG_RING_BYTES;
+      portEXIT_CRITICAL(&_ringMux);
+    }
+  }
+}
+
+/**
+ * @brief Copies a line into the ring, or counts it as dropped if it does not fit.
+ */
+static void pushLineInternal(const char* line, size_t len) {
+  bool createTask = false;
+  bool stored = false;
+  portENTER_CRITICAL(&_ringMux);
+  size_t used = (_head + ESP32WS_LOG_RING_BYTES - _tail) % ESP32WS_LOG_RING_BYTES;
+  if (len < ESP32WS_LOG_RING_BYTES - used) { // One byte stays free to tell full from empty
+    size_t first = ESP32WS_LOG_RING_BYTES - _head;
+    if (first > len) first = len;
+    memcpy(&_ring[_head], line, first);
+    memcpy(&_ring[0], line + first, len - first);
+    _head = (_head + len) % ESP32WS_LOG_RING_BYTES;
+    stored = true;
+  } else {
+    _droppedLines++;
+  }
+  if (!_logTask && !_logTaskCreating) {
+    _logTaskCreating = true;
+    createTask = true;
+  }
+  portEXIT_CRITICAL(&_ringMux);
+
+  if (createTask) {
+    TaskHandle_t task = nullptr;
+    xTaskCreate(logTask, "esp32ws_log", 3072, nullptr, ESP32WS_LOG_TASK_PRIORITY, &task);
+    portENTER_CRITICAL(&_ringMux);
+    _logTask = task;
+    _logTaskCreating = false;
+    portEXIT_CRITICAL(&_ringMux);
+  }
+  if (stored && _logTask) xTaskNotifyGive(_logTask);
+}
+
+uint32_t getDroppedLogLines() {
+  return _droppedLines;
+}
+
+#else
+
+uint32_t getDroppedLogLines() {
+  return 0;
+}
+
+#endif // ESP32WS_LOG_RING_BYTES > 0
+
+void esp32wsLog(char level, const char* tag, const char* format, ...) {
+  char line[ESP32WS_LOG_LINE_MAX];
+  int prefix = snprintf(line, sizeof(line), "[%s][%c] ", tag, level);
+  if (prefix < 0) return;
+  if ((size_t)prefix > sizeof(line) - 2) prefix = sizeof(line) - 2;
+  size_t room = sizeof(line) - prefix - 1; // Keeps one byte for the newline
+  va_list args;
+  va_start(args, format);
+  int body = vsnprintf(line + prefix, room, format, args);
+  va_end(args);
+  size_t len = prefix + (body < 0 ? 0 : ((size_t)body < room ? (size_t)body : room - 1));
+  line[len++] = '\n';
+  #if ESP32WS_LOG_RING_BYTES > 0
+  pushLineInternal(line, len);
+  #else
+  Serial.write((const uint8_t*)line, len);
+  #endif
+}
@@ -0,0 +1,80 @@
+/**
+ * @file ESP32WebSocketLog.h
+ * @brief Leveled logging for the ESP32WebSocket library and the applications using it.
+ *        The level is fixed at compile time (-DESP32WS_LOG_LEVEL=ESP32WS_LOG_LEVEL_DEBUG in
+ *        platformio.ini): calls above it compile to nothing, arguments included. Lines go to
+ *        Serial directly, or, with -DESP32WS_LOG_RING_BYTES=<n>, into a ring buffer drained by a
+ *        low-priority task so a log call never waits for the UART (lines that do not fit are
+ *        dropped and counted).
+ *
+ * Usage: ESP32WS_LOGI("Client #%u connected", id);  ->  "[ESP32WS][I] Client #3 connected"
+ *        Define ESP32WS_LOG_TAG before including this header to change the tag of a file.
+ */
+#ifndef ESP32_WEBSOCKET_LOG_H
+#define ESP32_WEBSOCKET_LOG_H
+
+#include <Arduino.h>
+
+// --- Levels ---
+
+#define ESP32WS_LOG_LEVEL_NONE  0
+#define ESP32WS_LOG_LEVEL_ERROR 1  ///< Failures; the operation did not happen.
+#define ESP32WS_LOG_LEVEL_WARN  2  ///< Degraded operation (fallbacks, limits reached).
+#define ESP32WS_LOG_LEVEL_INFO  3  ///< Setup and lifecycle events (default).
+#define ESP32WS_LOG_LEVEL_DEBUG 4  ///< Per-message tracing; too slow for busy links.
+
+#ifndef ESP32WS_LOG_LEVEL
+#define ESP32WS_LOG_LEVEL ESP32WS_LOG_LEVEL_INFO
+#endif
+
+/// Size of the asynchronous log ring in bytes; 0 writes every line to Serial in the caller.
+#ifndef ESP32WS_LOG_RING_BYTES
+#define ESP32WS_LOG_RING_BYTES 0
+#endif
+
+/// Longest line (tag and level included); longer lines are truncated.
+#ifndef ESP32WS_LOG_LINE_MAX
+#define ESP32WS_LOG_LINE_MAX 192
+#endif
+
+#ifndef ESP32WS_LOG_TAG
+#define ESP32WS_LOG_TAG "ESP32WS"
+#endif
+
+/**
+ * @brief Formats and emits one line ("[tag][level] message\n"). Use the ESP32WS_LOGx macros instead.
+ */
+void esp32wsLog(char level, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+/**
+ * @brief Returns the number of lines dropped because the log ring was full (always 0 without a ring).
+ */
+uint32_t getDroppedLogLines();
+
+// --- Logging Macros ---
+
+#if ESP32WS_LOG_LEVEL >= ESP32WS_LOG_LEVEL_ERROR
+#define ESP32WS_LOGE(format, ...) esp32wsLog('E', ESP32WS_LOG_TAG, format, ##__VA_ARGS__)
+#else
+#define ESP32WS_LOGE(format, ...) do {} while (0)
+#endif
+
+#if ESP32WS_LOG_LEVEL >= ESP32WS_LOG_LEVEL_WARN
+#define ESP32WS_LOGW(format, ...) esp32wsLog('W', ESP32WS_LOG_TAG, format, ##__VA_ARGS__)
+#else
+#define ESP32WS_LOGW(format, ...) do {} while (0)
+#endif
+
+#if ESP32WS_LOG_LEVEL >= ESP32WS_LOG_LEVEL_INFO
+#define ESP32WS_LOGI(format, ...) esp32wsLog('I', ESP32WS_LOG_TAG, format, ##__VA_ARGS__)
+#else
+#define ESP32WS_LOGI(format, ...) do {} while (0)
+#endif
+
+#if ESP32WS_LOG_LEVEL >= ESP32WS_LOG_LEVEL_DEBUG
+#define ESP32WS_LOGD(format, ...) esp32wsLog('D', ESP32WS_LOG_TAG, format, ##__VA_ARGS__)
+#else
+#define ESP32WS_LOGD(format, ...) do {} while (0)
+#endif
+
+#endif // ESP32_WEBSOCKET_LOG_H
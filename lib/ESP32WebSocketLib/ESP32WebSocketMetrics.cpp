@@ -0,0 +1,225 @@
+/**
+ * @file ESP32WebSocketMetrics.cpp
+ * @brief Counters, cycle-counter timers and gauges behind "get_stats" and "/metrics".
+ */
+#include "ESP32WebSocketMetrics.h"
+#include "ESP32WebSocketLog.h"
+#include <esp_timer.h>
+
+// --- Module-Internal State ---
+
+// Names in MetricCounter order (JSON keys; Prometheus names get an "esp32ws_" prefix and "_total" suffix)
+static const char* const COUNTER_NAMES[METRIC_COUNTER_COUNT] = {
+  "ws_messages_in", "ws_bytes_in", "json_errors", "text_out", "text_bytes_out", "text_fallbacks",
+  "binary_out", "binary_bytes_out", "binary_dropped", "client_connects", "client_disconnects",
+  "ws_reassembled", "ws_oversized", "persist_writes", "persist_errors"
+};
+// Names in MetricTimer order
+static const char* const TIMER_NAMES[METRIC_TIMER_COUNT] = { "ws_text", "ws_binary", "send", "sampler" };
+
+// Names in BootPhase order
+static const char* const BOOT_PHASE_NAMES[BOOT_PHASE_COUNT] = {
+  "init_start", "network_started", "ap_ready", "sta_got_ip", "server_listening", "fs_mounted", "assets_ready"
+};
+
+static uint32_t _counters[METRIC_COUNTER_COUNT];
+static uint32_t _bootPhaseUs[BOOT_PHASE_COUNT]; // 0: not reached
+
+/**
+ * @struct TimerStats
+ * @brief Accumulated timing of one path, in CPU cycles.
+ */
+struct TimerStats {
+  uint32_t count;
+  uint64_t totalCycles;
+  uint32_t maxCycles;
+};
+static TimerStats _timers[METRIC_TIMER_COUNT];
+static portMUX_TYPE _timersMux = portMUX_INITIALIZER_UNLOCKED; // 64-bit totals are not atomic on the ESP32
+
+/**
+ * @struct GaugeEntry
+ * @brief A registered gauge.
+ */
+struct GaugeEntry {
+  const char* name;
+  MetricGaugeReader reader;
+};
+static GaugeEntry _gauges[ESP32WS_METRICS_MAX_GAUGES];
+static uint8_t _numGauges = 0;
+
+// Rates are computed over the interval since the previous report (at least RATE_MIN_INTERVAL_MS apart,
+// so two clients polling at once do not get rates over a few milliseconds).
+static const uint32_t RATE_MIN_INTERVAL_MS = 500;
+static uint32_t _rateSnapshot[METRIC_COUNTER_COUNT];
+static float _rates[METRIC_COUNTER_COUNT];
+static uint32_t _rateSnapshotMs = 0;
+static portMUX_TYPE _ratesMux = portMUX_INITIALIZER_UNLOCKED;
+
+// --- Internal Helper Functions ---
+
+/**
+ * @brief Refreshes the per-second rates if the previous snapshot is old enough.
+ */
+static void updateRatesInternal() {
+  uint32_t now = millis();
+  portENTER_CRITICAL(&_ratesMux);
+  uint32_t elapsedMs = now - _rateSnapshotMs;
+  if (elapsedMs >= RATE_MIN_INTERVAL_MS) {
+    for (uint8_t i = 0; i < METRIC_COUNTER_COUNT; i++) {
+      uint32_t value = __atomic_load_n(&_counters[i], __ATOMIC_RELAXED);
+      _rates[i] = _rateSnapshotMs == 0 ? 0.0f : (value - _rateSnapshot[i]) * 1000.0f / elapsedMs;
+      _rateSnapshot[i] = value;
+    }
+    _rateSnapshotMs = now ? now : 1; // 0 marks "no snapshot yet"
+  }
+  portEXIT_CRITICAL(&_ratesMux);
+}
+
+/**
+ * @brief Copies the timing statistics (consistent per timer).
+ */
+static void snapshotTimersInternal(TimerStats* out) {
+  portENTER_CRITICAL(&_timersMux);
+  memcpy(out, _timers, sizeof(_timers));
+  portEXIT_CRITICAL(&_timersMux);
+}
+
+// --- Public Function Implementations ---
+
+void metricCount(MetricCounter counter, uint32_t amount) {
+  if (counter < METRIC_COUNTER_COUNT) __atomic_fetch_add(&_counters[counter], amount, __ATOMIC_RELAXED);
+}
+
+uint32_t getMetricCounter(MetricCounter counter) {
+  return counter < METRIC_COUNTER_COUNT ? __atomic_load_n(&_counters[counter], __ATOMIC_RELAXED) : 0;
+}
+
+void metricRecordCycles(MetricTimer timer, uint32_t cycles) {
+  if (timer >= METRIC_TIMER_COUNT) return;
+  portENTER_CRITICAL(&_timersMux);
+  TimerStats& stats = _timers[timer];
+  stats.count++;
+  stats.totalCycles += cycles;
+  if (cycles > stats.maxCycles) stats.maxCycles = cycles;
+  portEXIT_CRITICAL(&_timersMux);
+}
+
+void resetMetricTimers() {
+  portENTER_CRITICAL(&_timersMux);
+  memset(_timers, 0, sizeof(_timers));
+  portEXIT_CRITICAL(&_timersMux);
+}
+
+void metricBootPhase(BootPhase phase) {
+  if (phase >= BOOT_PHASE_COUNT) return;
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  uint32_t expected = 0;
+  if (__atomic_compare_exchange_n(&_bootPhaseUs[phase], &expected, now ? now : 1, false, __ATOMIC_RELAXED,
+                                  __ATOMIC_RELAXED)) {
+    ESP32WS_LOGI("Boot: %s at %lu ms", BOOT_PHASE_NAMES[phase], (unsigned long)(now / 1000));
+  }
+}
+
+uint32_t getBootPhaseUs(BootPhase phase) {
+  return phase < BOOT_PHASE_COUNT ? __atomic_load_n(&_bootPhaseUs[phase], __ATOMIC_RELAXED) : 0;
+}
+
+bool registerMetricGauge(const char* name, MetricGaugeReader reader) {
+  if (!name || !reader || _numGauges >= ESP32WS_METRICS_MAX_GAUGES) {
+    ESP32WS_LOGE("Metrics Error: Cannot register gauge (max %d).", ESP32WS_METRICS_MAX_GAUGES);
+    return false;
+  }
+  _gauges[_numGauges].name = name;
+  _gauges[_numGauges].reader = reader;
+  _numGauges++;
+  return true;
+}
+
+size_t getMetricsJsonCapacity() {
+  return JSON_OBJECT_SIZE(9) + JSON_OBJECT_SIZE(3) + 2 * JSON_OBJECT_SIZE(METRIC_COUNTER_COUNT) +
+         JSON_OBJECT_SIZE(METRIC_TIMER_COUNT) + METRIC_TIMER_COUNT * JSON_OBJECT_SIZE(3) +
+         JSON_OBJECT_SIZE(ESP32WS_METRICS_MAX_GAUGES) + JSON_OBJECT_SIZE(BOOT_PHASE_COUNT);
+}
+
+void writeMetricsJson(JsonObject out) {
+  updateRatesInternal();
+  TimerStats timers[METRIC_TIMER_COUNT];
+  snapshotTimersInternal(timers);
+  float cyclesPerUs = ESP.getCpuFreqMHz();
+
+  out["uptimeMs"] = millis();
+  out["cpuMhz"] = ESP.getCpuFreqMHz();
+  JsonObject heap = out.createNestedObject("heap");
+  heap["free"] = ESP.getFreeHeap();
+  heap["minFree"] = ESP.getMinFreeHeap();   // Low-water mark since boot
+  heap["maxAlloc"] = ESP.getMaxAllocHeap(); // Largest allocatable block (fragmentation)
+
+  JsonObject counters = out.createNestedObject("counters");
+  JsonObject rates = out.createNestedObject("rates");
+  portENTER_CRITICAL(&_ratesMux);
+  float ratesCopy[METRIC_COUNTER_COUNT];
+  memcpy(ratesCopy, _rates, sizeof(_rates));
+  portEXIT_CRITICAL(&_ratesMux);
+  for (uint8_t i = 0; i < METRIC_COUNTER_COUNT; i++) {
+    counters[COUNTER_NAMES[i]] = getMetricCounter((MetricCounter)i);
+    rates[COUNTER_NAMES[i]] = ratesCopy[i];
+  }
+
+  JsonObject timersObj = out.createNestedObject("timers");
+  for (uint8_t i = 0; i < METRIC_TIMER_COUNT; i++) {
+    JsonObject timerObj = timersObj.createNestedObject(TIMER_NAMES[i]);
+    timerObj["count"] = timers[i].count;
+    timerObj["avgUs"] = timers[i].count ? timers[i].totalCycles / cyclesPerUs / timers[i].count : 0.0f;
+    timerObj["maxUs"] = timers[i].maxCycles / cyclesPerUs;
+  }
+
+  JsonObject gauges = out.createNestedObject("gauges");
+  for (uint8_t i = 0; i < _numGauges; i++) {
+    gauges[_gauges[i].name] = _gauges[i].reader();
+  }
+
+  JsonObject boot = out.createNestedObject("bootUs");
+  for (uint8_t i = 0; i < BOOT_PHASE_COUNT; i++) {
+    uint32_t us = getBootPhaseUs((BootPhase)i);
+    if (us) boot[BOOT_PHASE_NAMES[i]] = us;
+  }
+}
+
+void writeMetricsText(Print& out) {
+  updateRatesInternal();
+  TimerStats timers[METRIC_TIMER_COUNT];
+  snapshotTimersInternal(timers);
+  float cyclesPerUs = ESP.getCpuFreqMHz();
+
+  out.printf("# TYPE esp32ws_uptime_ms counter\nesp32ws_uptime_ms %lu\n", (unsigned long)millis());
+  out.printf("# TYPE esp32ws_heap_free_bytes gauge\nesp32ws_heap_free_bytes %lu\n", (unsigned long)ESP.getFreeHeap());
+  out.printf("# TYPE esp32ws_heap_min_free_bytes gauge\nesp32ws_heap_min_free_bytes %lu\n", (unsigned long)ESP.getMinFreeHeap());
+  out.printf("# TYPE esp32ws_heap_max_alloc_bytes gauge\nesp32ws_heap_max_alloc_bytes %lu\n", (unsigned long)ESP.getMaxAllocHeap());
+  for (uint8_t i = 0; i < METRIC_COUNTER_COUNT; i++) {
+    out.printf("# TYPE esp32ws_%s_total counter\nesp32ws_%s_total %lu\n", COUNTER_NAMES[i], COUNTER_NAMES[i],
+               (unsigned long)getMetricCounter((MetricCounter)i));
+  }
+  out.print("# TYPE esp32ws_timer_count counter\n");
+  for (uint8_t i = 0; i < METRIC_TIMER_COUNT; i++) {
+    out.printf("esp32ws_timer_count{path=\"%s\"} %lu\n", TIMER_NAMES[i], (unsigned long)timers[i].count);
+  }
+  out.print("# TYPE esp32ws_timer_avg_us gauge\n");
+  for (uint8_t i = 0; i < METRIC_TIMER_COUNT; i++) {
+    float avgUs = timers[i].count ? timers[i].totalCycles / cyclesPerUs / timers[i].count : 0.0f;
+    out.printf("esp32ws_timer_avg_us{path=\"%s\"} %.2f\n", TIMER_NAMES[i], avgUs);
+  }
+  out.print("# TYPE esp32ws_timer_max_us gauge\n");
+  for (uint8_t i = 0; i < METRIC_TIMER_COUNT; i++) {
+    out.printf("esp32ws_timer_max_us{path=\"%s\"} %.2f\n", TIMER_NAMES[i], timers[i].maxCycles / cyclesPerUs);
+  }
+  for (uint8_t i = 0; i < _numGauges; i++) {
+    out.printf("# TYPE esp32ws_%s gauge\nesp32ws_%s %lu\n", _gauges[i].name, _gauges[i].name,
+               (unsigned long)_gauges[i].reader());
+  }
+  out.print("# TYPE esp32ws_boot_phase_us gauge\n");
+  for (uint8_t i = 0; i < BOOT_PHASE_COUNT; i++) {
+    uint32_t us = getBootPhaseUs((BootPhase)i);
+    if (us) out.printf("esp32ws_boot_phase_us{phase=\"%s\"} %lu\n", BOOT_PHASE_NAMES[i], (unsigned long)us);
+  }
+}
@@ -0,0 +1,160 @@
+/**
+ * @file ESP32WebSocketMetrics.h
+ * @brief Always-on throughput and latency metrics for the ESP32WebSocket library.
+ *        Counters, cycle-counter timings of the hot paths and named gauges, cheap enough for
+ *        production builds (an atomic add per counter update, a short spinlock per timing).
+ *        Reported by the "get_stats" WebSocket action and the HTTP "/metrics" endpoint.
+ */
+#ifndef ESP32_WEBSOCKET_METRICS_H
+#define ESP32_WEBSOCKET_METRICS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/// Maximum number of gauges registered with registerMetricGauge().
+#ifndef ESP32WS_METRICS_MAX_GAUGES
+#define ESP32WS_METRICS_MAX_GAUGES 16
+#endif
+
+// --- Counters ---
+
+/**
+ * @enum MetricCounter
+ * @brief Monotonic event counters (since boot, wrap at 2^32).
+ */
+enum MetricCounter : uint8_t {
+  METRIC_WS_MESSAGES_IN = 0,  ///< WebSocket data messages received.
+  METRIC_WS_BYTES_IN,         ///< Bytes of the received data messages.
+  METRIC_JSON_ERRORS,         ///< Received text messages that failed to parse.
+  METRIC_TEXT_OUT,            ///< JSON replies and broadcasts queued (per client).
+  METRIC_TEXT_BYTES_OUT,      ///< Bytes of those text messages.
+  METRIC_TEXT_FALLBACKS,      ///< Replies sent through a heap String because no pooled buffer was free.
+  METRIC_BINARY_OUT,          ///< Binary frames queued to clients (per client).
+  METRIC_BINARY_BYTES_OUT,    ///< Bytes of those frames.
+  METRIC_BINARY_DROPPED,      ///< Binary frames skipped by flow control (per client).
+  METRIC_CLIENT_CONNECTS,     ///< WebSocket connections accepted.
+  METRIC_CLIENT_DISCONNECTS,  ///< WebSocket connections closed.
+  METRIC_WS_REASSEMBLED,      ///< Received messages that arrived in pieces and were reassembled.
+  METRIC_WS_OVERSIZED,        ///< Received messages discarded as larger than a receive arena (or none free).
+  METRIC_PERSIST_WRITES,      ///< Variable blobs written to NVS (see ESP32WebSocketPersist.h).
+  METRIC_PERSIST_ERRORS,      ///< Failed NVS writes of the variable blob.
+  METRIC_COUNTER_COUNT
+};
+
+/**
+ * @brief Adds to a counter. Safe from any task or core.
+ */
+void metricCount(MetricCounter counter, uint32_t amount = 1);
+
+/**
+ * @brief Returns the current value of a counter.
+ */
+uint32_t getMetricCounter(MetricCounter counter);
+
+// --- Timers ---
+
+/**
+ * @enum MetricTimer
+ * @brief Code paths timed with the CPU cycle counter.
+ */
+enum MetricTimer : uint8_t {
+  METRIC_TIMER_WS_TEXT = 0,   ///< Handling of one JSON command in the WebSocket event handler.
+  METRIC_TIMER_WS_BINARY,     ///< Handling of one binary command.
+  METRIC_TIMER_SEND,          ///< Sending one stream frame: pipelines, encoding and fan-out.
+  METRIC_TIMER_SAMPLER,       ///< One wake-up of the acquisition sampler task.
+  METRIC_TIMER_COUNT
+};
+
+/**
+ * @brief Records one execution of a timed path. Safe from any task or core.
+ * @param cycles Elapsed CPU cycles (difference of two ESP.getCycleCount() readings on the same core).
+ */
+void metricRecordCycles(MetricTimer timer, uint32_t cycles);
+
+/**
+ * @class MetricScope
+ * @brief Times the enclosing scope: { MetricScope scope(METRIC_TIMER_SEND); ... }.
+ *        The cycle counter is per core, which is fine as long as the task is not migrated
+ *        mid-scope (all library tasks are pinned; the Arduino loop task is too).
+ */
+class MetricScope {
+public:
+  explicit MetricScope(MetricTimer timer) : _timer(timer), _start(ESP.getCycleCount()) {}
+  ~MetricScope() { metricRecordCycles(_timer, ESP.getCycleCount() - _start); }
+  MetricScope(const MetricScope&) = delete;
+  MetricScope& operator=(const MetricScope&) = delete;
+
+private:
+  MetricTimer _timer;
+  uint32_t _start;
+};
+
+/**
+ * @brief Clears the timing statistics (count, average, max), e.g. to measure a maximum over a window.
+ */
+void resetMetricTimers();
+
+// --- Gauges ---
+
+/**
+ * @typedef MetricGaugeReader
+ * @brief Returns the current value of a gauge. Called from the task serving the metrics request.
+ */
+typedef uint32_t (*MetricGaugeReader)();
+
+/**
+ * @brief Registers a named gauge read on every metrics request (e.g. a queue depth).
+ * @param name Static string, snake_case (used as a Prometheus metric name suffix).
+ * @return False if ESP32WS_METRICS_MAX_GAUGES gauges are already registered.
+ */
+bool registerMetricGauge(const char* name, MetricGaugeReader reader);
+
+// --- Boot Phases ---
+
+/**
+ * @enum BootPhase
+ * @brief Milestones of the startup sequence, timestamped once (microseconds since boot).
+ *        The network and filesystem phases complete in parallel, so their order varies.
+ */
+enum BootPhase : uint8_t {
+  BOOT_INIT_START = 0,     ///< initWiFiWebSocketServer() entered.
+  BOOT_NETWORK_STARTED,    ///< WiFi driver started in the configured mode (returns before the AP/station is up).
+  BOOT_AP_READY,           ///< Access point up (WiFi event).
+  BOOT_STA_GOT_IP,         ///< Station got its address (WiFi event).
+  BOOT_SERVER_LISTENING,   ///< HTTP/WebSocket server accepting connections.
+  BOOT_FS_MOUNTED,         ///< LittleFS mounted (filesystem task).
+  BOOT_ASSETS_READY,       ///< Static files resolved and their ETags computed: the page can be served.
+  BOOT_PHASE_COUNT
+};
+
+/**
+ * @brief Records the time a boot phase was reached; later calls for the same phase are ignored.
+ *        Safe from any task or core (including WiFi event handlers).
+ */
+void metricBootPhase(BootPhase phase);
+
+/**
+ * @brief Returns the time a boot phase was reached, in microseconds since boot, or 0 if not reached.
+ */
+uint32_t getBootPhaseUs(BootPhase phase);
+
+// --- Reports ---
+
+/**
+ * @brief JSON document capacity needed by writeMetricsJson() (for the caller's document).
+ */
+size_t getMetricsJsonCapacity();
+
+/**
+ * @brief Fills 'out' with uptimeMs, cpuMhz, heap, counters, rates (per second, since the previous report),
+ *        timers ({count, avgUs, maxUs} per path), gauges and bootUs (the boot phases reached so far).
+ */
+void writeMetricsJson(JsonObject out);
+
+/**
+ * @brief Writes the same metrics in the Prometheus text exposition format ("esp32ws_" prefix),
+ *        without the rates (Prometheus derives them from the counters).
+ */
+void writeMetricsText(Print& out);
+
+#endif // ESP32_WEBSOCKET_METRICS_H
@@ -0,0 +1,260 @@
+/**
+ * @file ESP32WebSocketNetwork.cpp
+ * @brief Access point / station bring-up and the mDNS advertisement behind ESP32WebSocketNetwork.h.
+ */
+#include "ESP32WebSocketNetwork.h"
+#include "ESP32WebSocketStream.h"
+#include "ESP32WebSocketMetrics.h"
+#include "ESP32WebSocketLog.h"
+#if ESP32WS_MDNS_ENABLED
+#include <ESPmDNS.h>
+#endif
+
+// --- Network State ---
+
+static NetworkMode _requestedMode = NET_MODE_AP;
+static NetworkMode _activeMode = NET_MODE_AP;
+static const char* _staSsid = nullptr;
+static const char* _staPassword = nullptr;
+static const char* _hostnameOverride = nullptr; // nullptr: derived from the MAC address
+static char _hostname[33] = "";
+static bool _mdnsStarted = false;
+static bool _eventsRegistered = false;
+static TaskHandle_t _fallbackTask = nullptr; // Waits for the station's address in NET_MODE_STA
+static const char* _apSsid = nullptr;        // Kept for the access point fallback
+static const char* _apPassword = nullptr;
+static const uint8_t* _apStaticIp = nullptr;
+
+
+// --- Configuration ---
+
+void setNetworkMode(NetworkMode mode, const char* staSsid, const char* staPassword) {
+  _requestedMode = mode;
+  _staSsid = staSsid;
+  _staPassword = staPassword;
+}
+
+void setMdnsHostname(const char* hostname) {
+  _hostnameOverride = hostname;
+}
+
+
+// --- Status ---
+
+NetworkMode getActiveNetworkMode() {
+  return _activeMode;
+}
+
+const char* getMdnsHostname() {
+  return _hostname;
+}
+
+IPAddress getStationIP() {
+  if (_activeMode == NET_MODE_AP || WiFi.status() != WL_CONNECTED) return IPAddress(0, 0, 0, 0);
+  return WiFi.localIP();
+}
+
+
+// --- Network-Internal Helpers ---
+
+/**
+ * @brief Fills _hostname from the override, or as "esp32ws-xxxxxx" from the MAC address.
+ */
+static void resolveHostnameInternal() {
+  if (_hostnameOverride) {
+    strncpy(_hostname, _hostnameOverride, sizeof(_hostname) - 1);
+    _hostname[sizeof(_hostname) - 1] = '\0';
+    return;
+  }
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  snprintf(_hostname, sizeof(_hostname), "esp32ws-%02x%02x%02x", mac[3], mac[4], mac[5]);
+}
+
+/**
+ * @brief Configures the static IP (if given) and starts the access point. WiFi must be in an AP mode.
+ * @return True if the access point is up.
+ */
+static bool startAccessPointInternal(const char* ssid, const char* password, const uint8_t staticIpParam[4]) {
+  // Configure Static IP for the Access Point if provided
+  if (staticIpParam != nullptr) {
+    IPAddress apIP(staticIpParam[0], staticIpParam[1], staticIpParam[2], staticIpParam[3]);
+    IPAddress gatewayIP(staticIpParam[0], staticIpParam[1], staticIpParam[2], staticIpParam[3]);
+    IPAddress subnetMask(255, 255, 255, 0);
+
+    ESP32WS_LOGI("Attempting to configure static AP IP: %s", apIP.toString().c_str());
+    if (!WiFi.softAPConfig(apIP, gatewayIP, subnetMask)) {
+      ESP32WS_LOGE("ERROR: Failed to configure static AP IP address! Will use default.");
+    } else {
+      ESP32WS_LOGI("Static AP IP configuration successful.");
+    }
+  } else {
+    ESP32WS_LOGI("No static IP provided. Using default AP IP (typically 192.168.4.1).");
+  }
+
+  // Start the WiFi Access Point
+  ESP32WS_LOGI("Starting WiFi Access Point (SSID: %s)...", ssid);
+  bool apStarted = WiFi.softAP(ssid, password);
+
+  if (apStarted) {
+      ESP32WS_LOGI("Access Point started. IP Address: %s", WiFi.softAPIP().toString().c_str());
+      // Additional check if static IP was intended but not achieved
+      if (staticIpParam != nullptr && WiFi.softAPIP() != IPAddress(staticIpParam[0], staticIpParam[1], staticIpParam[2], staticIpParam[3])) {
+          if (WiFi.softAPIP() == IPAddress(0,0,0,0)) {
+             ESP32WS_LOGW("AP IP is 0.0.0.0! AP may not be fully functional.");
+          } else if (WiFi.softAPIP() == IPAddress(192,168,4,1) && (staticIpParam[0]!=192 || staticIpParam[1]!=168 || staticIpParam[2]!=4 || staticIpParam[3]!=1)) {
+             ESP32WS_LOGW("Actual AP IP is the default (192.168.4.1), not the configured static IP. softAPConfig might have failed silently or been overridden.");
+          } else {
+             ESP32WS_LOGW("Actual AP IP does not match configured static IP. Check for conflicts.");
+          }
+      }
+  } else {
+      ESP32WS_LOGE("CRITICAL ERROR: Failed to start Access Point!");
+  }
+  return apStarted;
+}
+
+/**
+ * @brief WiFi event handler (WiFi event task): timestamps the boot phases and wakes the fallback task.
+ */
+static void onWiFiEventInternal(WiFiEvent_t event, WiFiEventInfo_t info) {
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_AP_START:
+      metricBootPhase(BOOT_AP_READY);
+      break;
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      metricBootPhase(BOOT_STA_GOT_IP);
+      ESP32WS_LOGI("Station connected. IP Address: %s", WiFi.localIP().toString().c_str());
+      if (_fallbackTask) xTaskNotifyGive(_fallbackTask);
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      ESP32WS_LOGD("Station disconnected; reconnecting.");
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Falls back to the access point if the station has no address within
+ *        ESP32WS_STA_CONNECT_TIMEOUT_MS (NET_MODE_STA only). Runs once, then deletes itself.
+ */
+static void stationFallbackTask(void* param) {
+  if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ESP32WS_STA_CONNECT_TIMEOUT_MS)) == 0 && WiFi.status() != WL_CONNECTED) {
+    ESP32WS_LOGW("Could not join '%s' within %u ms. Falling back to access point mode.", _staSsid,
+                 (unsigned)ESP32WS_STA_CONNECT_TIMEOUT_MS);
+    WiFi.disconnect(true);
+    WiFi.mode(WIFI_AP);
+    _activeMode = NET_MODE_AP;
+    startAccessPointInternal(_apSsid, _apPassword, _apStaticIp);
+  }
+  _fallbackTask = nullptr;
+  vTaskDelete(nullptr);
+}
+
+/**
+ * @brief Starts joining the configured network. Returns at once: the address arrives as a WiFi
+ *        event, and the station keeps reconnecting on its own after a later loss of the link.
+ * @return False if no network SSID is configured.
+ */
+static bool beginStationInternal() {
+  if (!_staSsid || !_staSsid[0]) {
+    ESP32WS_LOGE("Station mode requested without a network SSID (see setNetworkMode()).");
+    return false;
+  }
+  ESP32WS_LOGI("Joining network '%s' as '%s'...", _staSsid, _hostname);
+  WiFi.setAutoReconnect(true);
+  WiFi.setSleep(false); // Modem sleep adds up to a beacon interval of latency to every frame
+  WiFi.begin(_staSsid, _staPassword);
+  return true;
+}
+
+
+// --- Library-Internal Interface ---
+
+bool startNetwork(const char* apSsid, const char* apPassword, const uint8_t apStaticIp[4]) {
+  _apSsid = apSsid;
+  _apPassword = apPassword;
+  _apStaticIp = apStaticIp;
+  if (!_eventsRegistered) {
+    WiFi.onEvent(onWiFiEventInternal); // Before the mode change, so AP_START is not missed
+    _eventsRegistered = true;
+  }
+
+  // The driver is off after a power cycle; only a re-init needs the reset (no settle delay:
+  // mode() waits for the driver itself)
+  WiFi.persistent(false);
+  if (WiFi.getMode() != WIFI_OFF) {
+    ESP32WS_LOGI("Resetting WiFi state...");
+    WiFi.disconnect(true);
+    WiFi.mode(WIFI_OFF);
+  }
+  resolveHostnameInternal();
+  if (_hostname[0]) WiFi.setHostname(_hostname); // DHCP host name; must precede the mode change
+
+  switch (_requestedMode) {
+    case NET_MODE_STA:
+      WiFi.mode(WIFI_STA);
+      _activeMode = NET_MODE_STA;
+      if (beginStationInternal() &&
+          xTaskCreate(stationFallbackTask, "esp32ws_sta", 3072, nullptr, 1, &_fallbackTask) == pdPASS) {
+        return true;
+      }
+      ESP32WS_LOGW("Falling back to access point mode.");
+      WiFi.mode(WIFI_AP);
+      _activeMode = NET_MODE_AP;
+      return startAccessPointInternal(apSsid, apPassword, apStaticIp);
+
+    case NET_MODE_AP_STA: {
+      WiFi.mode(WIFI_AP_STA);
+      _activeMode = NET_MODE_AP_STA;
+      bool apStarted = startAccessPointInternal(apSsid, apPassword, apStaticIp);
+      bool staStarted = beginStationInternal(); // Keeps retrying while the access point serves clients
+      return apStarted || staStarted;
+    }
+
+    case NET_MODE_AP:
+    default:
+      WiFi.mode(WIFI_AP);
+      ESP32WS_LOGI("WiFi AP mode set.");
+      _activeMode = NET_MODE_AP;
+      return startAccessPointInternal(apSsid, apPassword, apStaticIp);
+  }
+}
+
+void advertiseNetworkServices() {
+#if ESP32WS_MDNS_ENABLED
+  if (!_hostname[0]) {
+    ESP32WS_LOGI("mDNS disabled (empty host name).");
+    return;
+  }
+  if (_mdnsStarted) MDNS.end(); // Re-init: the stream list may have changed
+  if (!MDNS.begin(_hostname)) {
+    ESP32WS_LOGE("mDNS responder failed to start.");
+    _mdnsStarted = false;
+    return;
+  }
+  _mdnsStarted = true;
+  MDNS.addService("http", "tcp", 80);
+  MDNS.addService(ESP32WS_MDNS_SERVICE, "tcp", 80);
+  MDNS.addServiceTxt(ESP32WS_MDNS_SERVICE, "tcp", "path", "/ws");
+  MDNS.addServiceTxt(ESP32WS_MDNS_SERVICE, "tcp", "schema", "/schema.json");
+  MDNS.addServiceTxt(ESP32WS_MDNS_SERVICE, "tcp", "streams", "/streams.json");
+
+  // One "s<id>" record per stream ("name,periodUs,channels"), so a scanner can tell nodes apart
+  // without connecting; the full layout is in /streams.json
+  char key[8];
+  char value[64];
+  uint8_t count = getStreamCount();
+  snprintf(value, sizeof(value), "%u", (unsigned)count);
+  MDNS.addServiceTxt(ESP32WS_MDNS_SERVICE, "tcp", "nstreams", value);
+  for (uint8_t i = 0; i < count; i++) {
+    snprintf(key, sizeof(key), "s%u", (unsigned)i);
+    snprintf(value, sizeof(value), "%s,%lu,%u", getStreamName(i), (unsigned long)getStreamPeriodUs(i),
+             (unsigned)getStreamChannelCount(i));
+    MDNS.addServiceTxt(ESP32WS_MDNS_SERVICE, "tcp", key, value);
+  }
+  ESP32WS_LOGI("mDNS: http://%s.local/ advertised as _%s._tcp with %u stream(s).", _hostname, ESP32WS_MDNS_SERVICE,
+               (unsigned)count);
+#endif
+}
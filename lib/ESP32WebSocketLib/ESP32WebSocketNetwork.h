@@ -0,0 +1,89 @@
+/**
+ * @file ESP32WebSocketNetwork.h
+ * @brief WiFi bring-up and mDNS/DNS-SD advertisement for the ESP32WebSocket library.
+ *        By default initWiFiWebSocketServer() starts its own access point, as before. With
+ *        setNetworkMode() the device joins an existing network instead (station), or does both
+ *        (AP + station), so many boards can share one infrastructure network and one dashboard.
+ *        Each node advertises "_esp32ws._tcp" with TXT records pointing at its WebSocket endpoint
+ *        and schemas, and answers to "<hostname>.local".
+ */
+#ifndef ESP32_WEBSOCKET_NETWORK_H
+#define ESP32_WEBSOCKET_NETWORK_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+/// Set to 0 to build without mDNS (saves the ESPmDNS code and its task).
+#ifndef ESP32WS_MDNS_ENABLED
+#define ESP32WS_MDNS_ENABLED 1
+#endif
+
+/// How long a station-only node waits for an IP address before falling back to its access point.
+#ifndef ESP32WS_STA_CONNECT_TIMEOUT_MS
+#define ESP32WS_STA_CONNECT_TIMEOUT_MS 15000
+#endif
+
+/// DNS-SD service type advertised for the WebSocket endpoint (without the leading underscore).
+#ifndef ESP32WS_MDNS_SERVICE
+#define ESP32WS_MDNS_SERVICE "esp32ws"
+#endif
+
+/**
+ * @enum NetworkMode
+ * @brief How the device attaches to WiFi.
+ */
+enum NetworkMode {
+  NET_MODE_AP,     ///< Own access point with the static IP given to initWiFiWebSocketServer() (default).
+  NET_MODE_STA,    ///< Join an existing network (DHCP). Falls back to the access point if it cannot connect.
+  NET_MODE_AP_STA  ///< Both: the access point stays up for local maintenance while the station joins the plant network.
+};
+
+// --- Configuration (call before initWiFiWebSocketServer()) ---
+
+/**
+ * @brief Selects the network mode. The SSID/password given to initWiFiWebSocketServer() are those
+ *        of the access point; staSsid/staPassword are those of the network to join.
+ *        The strings must stay valid (string literals or globals).
+ */
+void setNetworkMode(NetworkMode mode, const char* staSsid = nullptr, const char* staPassword = nullptr);
+
+/**
+ * @brief Sets the mDNS host name (the device answers to "<hostname>.local") and DHCP host name.
+ *        Defaults to "esp32ws-" followed by the last 3 MAC bytes in hex, so boards flashed with the
+ *        same firmware stay distinct. Pass an empty string to disable mDNS.
+ */
+void setMdnsHostname(const char* hostname);
+
+// --- Status ---
+
+/**
+ * @brief Returns the mode actually running (NET_MODE_AP after a station fallback).
+ */
+NetworkMode getActiveNetworkMode();
+
+/**
+ * @brief Returns the host name used for mDNS and DHCP ("" before initWiFiWebSocketServer()).
+ */
+const char* getMdnsHostname();
+
+/**
+ * @brief Returns the station address, or 0.0.0.0 if the station is not connected.
+ */
+IPAddress getStationIP();
+
+// --- Library-Internal Interface (used by ESP32WebSocket.cpp) ---
+
+/**
+ * @brief Starts WiFi in the configured mode (access point, station, or both) and returns without
+ *        waiting for the station's address; WiFi events report the BOOT_AP_READY and BOOT_STA_GOT_IP phases.
+ * @return False if no interface could be started.
+ */
+bool startNetwork(const char* apSsid, const char* apPassword, const uint8_t apStaticIp[4]);
+
+/**
+ * @brief Starts mDNS and advertises the HTTP and WebSocket services, with the registered streams
+ *        in the TXT records. Call once the server is listening and the streams are registered.
+ */
+void advertiseNetworkServices();
+
+#endif // ESP32_WEBSOCKET_NETWORK_H
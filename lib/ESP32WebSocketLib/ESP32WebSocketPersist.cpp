@@ -0,0 +1,272 @@
+/**
+ * @file ESP32WebSocketPersist.cpp
+ * @brief NVS blob, debounce schedule and restore behind ESP32WebSocketPersist.h.
+ *        Blob layout (little-endian, every value padded to 4 bytes so restored elements stay aligned):
+ *          [magic:u32][entries:u16][reserved:u16]
+ *          entries x [nameHash:u32][type:u8][reserved:u8][len:u16][value: len bytes + padding]
+ *        A value is the variable's elements as stored in RAM, or a string without its terminator.
+ */
+#include "ESP32WebSocketPersist.h"
+#include "ESP32WebSocketVarStore.h"
+#include "ESP32WebSocketMetrics.h"
+#include "ESP32WebSocketLog.h"
+#include <Preferences.h>
+#include <freertos/semphr.h>
+
+// --- Persistence State ---
+
+static const uint32_t PERSIST_MAGIC = 0x31505357; // "WSP1"
+
+struct PersistBlobHeader {
+  uint32_t magic;
+  uint16_t entries;
+  uint16_t reserved;
+};
+
+struct PersistEntryHeader {
+  uint32_t nameHash;
+  uint8_t type;
+  uint8_t reserved;
+  uint16_t len;
+};
+
+static const WsVarDesc* _persistVariables = nullptr;
+static int _persistCount = 0;
+static Preferences _prefs;
+static SemaphoreHandle_t _persistMutex = nullptr; // Serializes blob writes (task and savePersistentVariables())
+static TaskHandle_t _persistTask = nullptr;
+
+// The buffer the blob is serialized into, and the last blob in NVS (writes of an equal blob are skipped)
+static uint8_t* _blob = nullptr;
+static uint8_t* _savedBlob = nullptr;
+static size_t _savedLen = 0;
+
+// Debounce state, written by whichever task commits a persistent variable
+static bool _dirty = false;
+static uint32_t _dirtySinceMs = 0;  // First unsaved change
+static uint32_t _lastChangeMs = 0;
+static uint32_t _lastWriteMs = 0;
+static bool _written = false;       // A blob was written since boot (the interval budget applies)
+
+
+// --- Persistence-Internal Helpers ---
+
+/**
+ * @brief 32-bit FNV-1a hash of a variable name, the key of its blob entry.
+ */
+static uint32_t hashNameInternal(const char* name) {
+  uint32_t hash = 2166136261UL;
+  while (*name) {
+    hash ^= (uint8_t)*name++;
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+static size_t paddedInternal(size_t len) {
+  return (len + 3) & ~(size_t)3;
+}
+
+/**
+ * @brief Serializes the persistent variables into _blob as one consistent snapshot.
+ * @return The blob length.
+ */
+static size_t serializeBlobInternal() {
+  size_t len;
+  uint32_t token;
+  do {
+    token = beginVariableSnapshot();
+    PersistBlobHeader header = {PERSIST_MAGIC, 0, 0};
+    len = sizeof(header);
+    for (int i = 0; i < _persistCount; i++) {
+      const WsVarDesc& var = _persistVariables[i];
+      if (!var.persist) continue;
+      PersistEntryHeader entry = {hashNameInternal(var.name), (uint8_t)var.type, 0, 0};
+      uint8_t* value = _blob + len + sizeof(entry);
+      if (var.type == TYPE_STRING) {
+        entry.len = (uint16_t)readVariableString(i, (char*)value, var.count);
+      } else {
+        entry.len = (uint16_t)variableValueBytes(i);
+        memcpy(value, var.value, entry.len);
+      }
+      memset(value + entry.len, 0, paddedInternal(entry.len) - entry.len); // Equal values give equal blobs
+      memcpy(_blob + len, &entry, sizeof(entry));
+      len += sizeof(entry) + paddedInternal(entry.len);
+      header.entries++;
+    }
+    memcpy(_blob, &header, sizeof(header));
+  } while (retryVariableSnapshot(token));
+  return len;
+}
+
+/**
+ * @brief Serializes the variables and writes the blob if it differs from the stored one.
+ * @return True if the stored blob is now up to date.
+ */
+static bool writeBlobInternal() {
+  xSemaphoreTake(_persistMutex, portMAX_DELAY);
+  __atomic_store_n(&_dirty, false, __ATOMIC_RELEASE); // Changes from here on need another write
+  size_t len = serializeBlobInternal();
+  bool ok = true;
+  if (len != _savedLen || memcmp(_blob, _savedBlob, len) != 0) {
+    ok = _prefs.putBytes(ESP32WS_PERSIST_KEY, _blob, len) == len;
+    _lastWriteMs = millis();
+    _written = true;
+    if (ok) {
+      memcpy(_savedBlob, _blob, len);
+      _savedLen = len;
+      metricCount(METRIC_PERSIST_WRITES);
+      ESP32WS_LOGD("Persist: %u bytes written.", (unsigned)len);
+    } else {
+      metricCount(METRIC_PERSIST_ERRORS);
+      ESP32WS_LOGW("Persist: NVS write of %u bytes failed; retrying later.", (unsigned)len);
+    }
+  }
+  xSemaphoreGive(_persistMutex);
+  return ok;
+}
+
+/**
+ * @brief Milliseconds until the pending changes are due (see the schedule in the header).
+ */
+static int32_t msUntilDueInternal() {
+  uint32_t now = millis();
+  int32_t quiet = ESP32WS_PERSIST_QUIET_MS - (int32_t)(now - __atomic_load_n(&_lastChangeMs, __ATOMIC_RELAXED));
+  int32_t latest = ESP32WS_PERSIST_MAX_DELAY_MS - (int32_t)(now - __atomic_load_n(&_dirtySinceMs, __ATOMIC_RELAXED));
+  int32_t wait = quiet < latest ? quiet : latest;
+  if (_written) {
+    int32_t budget = ESP32WS_PERSIST_MIN_INTERVAL_MS - (int32_t)(now - _lastWriteMs);
+    if (budget > wait) wait = budget;
+  }
+  return wait;
+}
+
+/**
+ * @brief Waits for changes and writes the blob on the debounce schedule.
+ */
+static void persistTask(void* param) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while (__atomic_load_n(&_dirty, __ATOMIC_ACQUIRE)) {
+      int32_t wait = msUntilDueInternal();
+      if (wait > 0) {
+        vTaskDelay(pdMS_TO_TICKS(wait));
+        continue; // Changes meanwhile move the quiet period
+      }
+      if (!writeBlobInternal()) notePersistentVariableChanged(); // Retry after the interval budget
+    }
+  }
+}
+
+/**
+ * @brief Applies a stored blob to the variables. Unknown and unfitting entries are skipped.
+ * @return Number of variables restored.
+ */
+static int restoreBlobInternal(const uint8_t* blob, size_t len) {
+  PersistBlobHeader header;
+  if (len < sizeof(header)) return 0;
+  memcpy(&header, blob, sizeof(header));
+  if (header.magic != PERSIST_MAGIC) {
+    ESP32WS_LOGW("Persist: stored blob has an unknown format; using the compiled-in values.");
+    return 0;
+  }
+  int restored = 0;
+  size_t pos = sizeof(header);
+  for (uint16_t e = 0; e < header.entries && pos + sizeof(PersistEntryHeader) <= len; e++) {
+    PersistEntryHeader entry;
+    memcpy(&entry, blob + pos, sizeof(entry));
+    const uint8_t* value = blob + pos + sizeof(entry);
+    pos += sizeof(entry) + paddedInternal(entry.len);
+    if (pos > len) break; // Truncated blob
+    for (int i = 0; i < _persistCount; i++) {
+      const WsVarDesc& var = _persistVariables[i];
+      if (!var.persist || entry.type != var.type || hashNameInternal(var.name) != entry.nameHash) continue;
+      if (restoreVariableValue(i, value, entry.len)) {
+        restored++;
+      } else {
+        ESP32WS_LOGW("Persist: stored value of '%s' no longer fits; keeping the default.", var.name);
+      }
+      break;
+    }
+  }
+  return restored;
+}
+
+
+// --- Library-Internal Interface ---
+
+bool initVariablePersistence(const WsVarDesc* variables, int count) {
+  if (_persistTask) return true; // Already restored at an earlier init
+  size_t capacity = sizeof(PersistBlobHeader);
+  int persistent = 0;
+  for (int i = 0; variables && i < count; i++) {
+    if (!variables[i].persist) continue;
+    capacity += sizeof(PersistEntryHeader) + paddedInternal(variableValueBytes(i));
+    persistent++;
+  }
+  if (persistent == 0) return true;
+
+  _persistVariables = variables;
+  _persistCount = count;
+  _blob = (uint8_t*)malloc(capacity);
+  _savedBlob = (uint8_t*)malloc(capacity);
+  _persistMutex = xSemaphoreCreateMutex();
+  if (!_blob || !_savedBlob || !_persistMutex || !_prefs.begin(ESP32WS_PERSIST_NAMESPACE, false)) {
+    ESP32WS_LOGE("Persist Error: NVS or buffers unavailable; variables will not be kept across reboots.");
+    free(_blob);
+    free(_savedBlob);
+    _blob = _savedBlob = nullptr;
+    return false;
+  }
+
+  // One read of the whole blob; an older, larger blob (variables removed since) is read in full too
+  size_t storedLen = _prefs.getBytesLength(ESP32WS_PERSIST_KEY);
+  if (storedLen > 0) {
+    uint8_t* stored = storedLen <= capacity ? _savedBlob : (uint8_t*)malloc(storedLen);
+    if (stored && _prefs.getBytes(ESP32WS_PERSIST_KEY, stored, storedLen) == storedLen) {
+      int restored = restoreBlobInternal(stored, storedLen);
+      ESP32WS_LOGI("Persist: %d of %d persistent variables restored.", restored, persistent);
+      if (stored == _savedBlob) _savedLen = storedLen;
+    } else {
+      ESP32WS_LOGW("Persist: stored blob of %u bytes could not be read.", (unsigned)storedLen);
+    }
+    if (stored != _savedBlob) free(stored);
+  } else {
+    ESP32WS_LOGI("Persist: no stored values yet; %d persistent variables start at their defaults.", persistent);
+  }
+
+  if (xTaskCreate(persistTask, "esp32ws_persist", 4096, nullptr, 1, &_persistTask) != pdPASS) {
+    ESP32WS_LOGE("Persist Error: task not created; only savePersistentVariables() stores values.");
+    _persistTask = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void notePersistentVariableChanged() {
+  if (!_persistTask) return;
+  uint32_t now = millis();
+  __atomic_store_n(&_lastChangeMs, now, __ATOMIC_RELAXED);
+  if (!__atomic_load_n(&_dirty, __ATOMIC_ACQUIRE)) {
+    __atomic_store_n(&_dirtySinceMs, now, __ATOMIC_RELAXED);
+    __atomic_store_n(&_dirty, true, __ATOMIC_RELEASE);
+    xTaskNotifyGive(_persistTask);
+  }
+}
+
+
+// --- Application Interface ---
+
+bool savePersistentVariables() {
+  if (!_persistMutex || !_blob) return false;
+  return writeBlobInternal();
+}
+
+bool erasePersistentVariables() {
+  if (!_persistMutex || !_blob) return false;
+  xSemaphoreTake(_persistMutex, portMAX_DELAY);
+  bool ok = _prefs.remove(ESP32WS_PERSIST_KEY) || _prefs.getBytesLength(ESP32WS_PERSIST_KEY) == 0;
+  if (ok) _savedLen = 0;
+  xSemaphoreGive(_persistMutex);
+  return ok;
+}
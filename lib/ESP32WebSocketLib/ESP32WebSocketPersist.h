@@ -0,0 +1,77 @@
+/**
+ * @file ESP32WebSocketPersist.h
+ * @brief Keeps the variables marked persistent() (see ESP32WebSocketVars.h) across reboots, as one
+ *        compact binary blob in NVS.
+ *        A set only marks the blob dirty (a flag and a timestamp), whichever task made it. The
+ *        library's persistence task writes the blob once the persistent variables have been quiet
+ *        for ESP32WS_PERSIST_QUIET_MS, at the latest ESP32WS_PERSIST_MAX_DELAY_MS after the first
+ *        unsaved change, and never sooner than ESP32WS_PERSIST_MIN_INTERVAL_MS after the previous
+ *        write. So a slider dragged for a minute costs a few flash writes, none of them on the
+ *        AsyncTCP task, and a blob equal to the stored one is not written at all. NVS itself spreads
+ *        the writes over the pages of its partition (wear levelling).
+ *
+ *        initWiFiWebSocketServer() restores the blob with a single read, before the server starts.
+ *        Entries are matched by variable name, so reordering, adding or removing variables keeps
+ *        the others; a stored value that no longer fits its variable (type, size or limits) is
+ *        ignored and the compiled-in default stays. Changes of the last quiet period are lost on a
+ *        power cut: call savePersistentVariables() before a planned restart.
+ */
+#ifndef ESP32_WEBSOCKET_PERSIST_H
+#define ESP32_WEBSOCKET_PERSIST_H
+
+#include <Arduino.h>
+#include "ESP32WebSocketVars.h"
+
+// --- Persistence Configuration ---
+
+/// NVS namespace and key of the variable blob.
+#ifndef ESP32WS_PERSIST_NAMESPACE
+#define ESP32WS_PERSIST_NAMESPACE "esp32ws"
+#endif
+#ifndef ESP32WS_PERSIST_KEY
+#define ESP32WS_PERSIST_KEY "vars"
+#endif
+/// The blob is written once no persistent variable changed for this long...
+#ifndef ESP32WS_PERSIST_QUIET_MS
+#define ESP32WS_PERSIST_QUIET_MS 2000
+#endif
+/// ...or, under continuous changes, this long after the first unsaved change...
+#ifndef ESP32WS_PERSIST_MAX_DELAY_MS
+#define ESP32WS_PERSIST_MAX_DELAY_MS 30000
+#endif
+/// ...but never sooner than this after the previous write (the flash write budget).
+#ifndef ESP32WS_PERSIST_MIN_INTERVAL_MS
+#define ESP32WS_PERSIST_MIN_INTERVAL_MS 10000
+#endif
+
+// --- Application Interface ---
+
+/**
+ * @brief Writes the persistent variables now, on the calling task (e.g. before ESP.restart()).
+ * @return True if the blob was written or already up to date; false without persistent variables
+ *         or if NVS refused the write.
+ */
+bool savePersistentVariables();
+
+/**
+ * @brief Removes the stored blob, so the next boot starts from the compiled-in values.
+ *        Later changes of persistent variables are stored again.
+ * @return False if persistence is not active or NVS refused.
+ */
+bool erasePersistentVariables();
+
+// --- Library-Internal Interface (used by ESP32WebSocket.cpp and ESP32WebSocketVarStore.cpp) ---
+
+/**
+ * @brief Restores the persistent variables of the table from NVS and starts the persistence task.
+ *        Does nothing if no entry is marked persistent().
+ * @return False if persistence was wanted but NVS, memory or the task is unavailable.
+ */
+bool initVariablePersistence(const WsVarDesc* variables, int count);
+
+/**
+ * @brief Records that a persistent variable changed (called after each commit). Any task.
+ */
+void notePersistentVariableChanged();
+
+#endif // ESP32_WEBSOCKET_PERSIST_H
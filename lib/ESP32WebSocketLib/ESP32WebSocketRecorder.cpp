@@ -0,0 +1,590 @@
+/**
+ * @file ESP32WebSocketRecorder.cpp
+ * @brief RAM ring, spill file and replay cursors behind ESP32WebSocketRecorder.h.
+ *        The ring is addressed by free-running 64-bit byte positions: _tail is the oldest record,
+ *        _head the next write, and a position maps to offset (pos % capacity). A record that does not
+ *        fit before the end of the buffer is written at offset 0 instead; the skipped bytes start
+ *        with a wrap marker when there is room for one. Frames and replays share _recorderMutex.
+ */
+#include "ESP32WebSocketRecorder.h"
+#include "ESP32WebSocket.h"
+#include "ESP32WebSocketStream.h"
+#include "ESP32WebSocketMetrics.h"
+#include "ESP32WebSocketLog.h"
+#include <LittleFS.h>
+#include <esp_heap_caps.h>
+#include <freertos/semphr.h>
+
+// --- Recorder State ---
+
+static const uint16_t RECORD_WRAP_MARKER = 0xFFFF;
+
+static uint8_t* _ring = nullptr;
+static size_t _capacity = 0;
+static bool _inPsram = false;
+static uint64_t _head = 0;          // Absolute position of the next record
+static uint64_t _tail = 0;          // Absolute position of the oldest record
+static uint32_t _newestMs = 0;
+static SemaphoreHandle_t _recorderMutex = nullptr;
+
+// Run tracking: a stream's run changes whenever its sequence goes back (the stream restarted)
+static uint16_t _runs[ESP32WS_MAX_STREAMS];
+static uint32_t _lastSequence[ESP32WS_MAX_STREAMS];
+static bool _seen[ESP32WS_MAX_STREAMS];
+
+static uint32_t _framesRecorded = 0;
+static uint32_t _framesEvicted = 0;
+static uint32_t _framesTooLarge = 0;
+
+// Spill file. Records are staged in one of two block buffers; a full block is handed to the spill
+// task, which writes it while the other buffer fills. Both indices below are guarded by _recorderMutex.
+static const char* _spillPath = nullptr;
+static uint32_t _spillBlocks = 0;
+static File _spillFile;
+static SemaphoreHandle_t _spillFileMutex = nullptr; // Spill task writes vs. replay reads
+static TaskHandle_t _spillTask = nullptr;
+static uint8_t* _spillBuffers[2] = {nullptr, nullptr};
+static uint8_t _spillFill = 0;      // Buffer being filled
+static int8_t _spillPending = -1;   // Buffer waiting for the spill task, or -1
+static int8_t _spillWriting = -1;   // Buffer being written by the spill task, or -1
+static uint16_t _spillUsed = sizeof(RecorderBlockHeader);
+static uint8_t _spillMask = 0;      // RecorderBlockHeader::streamMask of the block being filled
+static_assert(ESP32WS_MAX_STREAMS <= 8, "RecorderBlockHeader::streamMask is 8 bits wide: ESP32WS_MAX_STREAMS must be <= 8");
+static uint32_t _spillFirstMs = 0;
+static uint32_t _spillNextSeq = 1;  // Sequence of the next sealed block
+static uint32_t _spillBootSeq = 1;  // First block of this boot; replays never read older ones
+static uint32_t _spillWrittenSeq = 0; // Newest block on file (atomic: read by the replay task)
+static volatile bool _spillReady = false;
+static uint32_t _spillBlocksWritten = 0;
+static uint32_t _spillBlocksDropped = 0;
+
+/**
+ * @struct ReplaySession
+ * @brief One replay. 'busy' claims the slot until the replay task releases it; 'active' (read by
+ *        recordStreamFrame() under the mutex) withholds the stream's live frames from the client.
+ *        The cursor fields belong to the replay task.
+ */
+enum ReplayPhase : uint8_t { REPLAY_FILE, REPLAY_RAM };
+struct ReplaySession {
+  bool busy;
+  bool active;
+  uint32_t clientId;
+  uint8_t streamId;
+  uint16_t run;
+  int64_t after;          // Frames with a higher sequence are delivered
+  ReplayPhase phase;
+  uint64_t pos;           // RAM phase cursor
+  uint32_t fileSeq;       // File phase: next block to read
+  uint8_t* block;         // File phase: current block
+  uint16_t blockPos;
+  uint16_t blockUsed;
+  uint32_t frames;
+  uint32_t firstSequence;
+  uint32_t lastSequence;
+};
+static ReplaySession _replays[ESP32WS_RECORDER_MAX_REPLAYS];
+
+
+// --- Recorder-Internal Helpers ---
+
+static inline size_t ringOffsetInternal(uint64_t pos) {
+  return (size_t)(pos % _capacity);
+}
+
+/**
+ * @brief Reads the record header at pos.
+ * @return False at a wrap point (the next record starts at the following multiple of the capacity).
+ */
+static bool recordAtInternal(uint64_t pos, RecorderRecordHeader* header) {
+  size_t offset = ringOffsetInternal(pos);
+  if (_capacity - offset < sizeof(RecorderRecordHeader)) return false;
+  memcpy(header, _ring + offset, sizeof(*header));
+  return header->len != RECORD_WRAP_MARKER;
+}
+
+static inline uint64_t nextWrapInternal(uint64_t pos) {
+  return pos + (_capacity - ringOffsetInternal(pos));
+}
+
+static void evictOldestInternal() {
+  RecorderRecordHeader header;
+  if (!recordAtInternal(_tail, &header)) {
+    _tail = nextWrapInternal(_tail);
+    return;
+  }
+  _tail += sizeof(header) + header.len;
+  _framesEvicted++;
+}
+
+/**
+ * @brief Appends one record to the RAM ring, evicting the oldest records as needed. Mutex held.
+ */
+static void appendToRingInternal(const RecorderRecordHeader& header, const uint8_t* frame) {
+  size_t need = sizeof(header) + header.len;
+  size_t offset = ringOffsetInternal(_head);
+  size_t pad = _capacity - offset < need ? _capacity - offset : 0;
+  while (_head + pad + need - _tail > _capacity) evictOldestInternal();
+  if (pad > 0) {
+    if (pad >= sizeof(RecorderRecordHeader)) {
+      RecorderRecordHeader marker = {RECORD_WRAP_MARKER, 0, 0};
+      memcpy(_ring + offset, &marker, sizeof(marker));
+    }
+    _head += pad;
+    offset = 0;
+  }
+  memcpy(_ring + offset, &header, sizeof(header));
+  memcpy(_ring + offset + sizeof(header), frame, header.len);
+  _head += need;
+}
+
+/**
+ * @brief Hands the staged block to the spill task, or drops it if the other buffer is still busy. Mutex held.
+ */
+static void sealSpillBlockInternal() {
+  if (_spillUsed <= sizeof(RecorderBlockHeader)) return;
+  uint8_t* block = _spillBuffers[_spillFill];
+  if (_spillPending >= 0 || _spillWriting >= 0) {
+    _spillBlocksDropped++;
+  } else {
+    RecorderBlockHeader header = {ESP32WS_RECORDER_MAGIC, _spillNextSeq++, _spillUsed, _spillMask, 0, _spillFirstMs};
+    memcpy(block, &header, sizeof(header));
+    memset(block + _spillUsed, 0, ESP32WS_RECORDER_BLOCK_BYTES - _spillUsed);
+    _spillPending = _spillFill;
+    _spillFill ^= 1;
+    xTaskNotifyGive(_spillTask);
+  }
+  _spillUsed = sizeof(RecorderBlockHeader);
+  _spillMask = 0;
+}
+
+/**
+ * @brief Stages one record in the current spill block. Mutex held.
+ */
+static void appendToSpillInternal(const RecorderRecordHeader& header, const uint8_t* frame, uint8_t streamId) {
+  size_t need = sizeof(header) + header.len;
+  if (_spillUsed + need > ESP32WS_RECORDER_BLOCK_BYTES) sealSpillBlockInternal();
+  uint8_t* block = _spillBuffers[_spillFill];
+  if (_spillUsed == sizeof(RecorderBlockHeader)) _spillFirstMs = header.recordMs;
+  memcpy(block + _spillUsed, &header, sizeof(header));
+  memcpy(block + _spillUsed + sizeof(header), frame, header.len);
+  _spillUsed += need;
+  _spillMask |= (uint8_t)(1u << streamId);
+}
+
+/**
+ * @brief Opens the spill file, preallocating it with zero blocks unless a file of the right size
+ *        exists, in which case it continues after its newest block.
+ * @return The sequence of the newest block on file (0 if none), or -1 if the file cannot be opened.
+ */
+static int64_t openSpillFileInternal() {
+  size_t fileBytes = (size_t)_spillBlocks * ESP32WS_RECORDER_BLOCK_BYTES;
+  File file;
+  if (LittleFS.exists(_spillPath)) file = LittleFS.open(_spillPath, "r+");
+  if (file && file.size() == fileBytes) {
+    uint32_t newest = 0;
+    for (uint32_t i = 0; i < _spillBlocks; i++) {
+      RecorderBlockHeader header;
+      if (!file.seek(i * ESP32WS_RECORDER_BLOCK_BYTES) ||
+          file.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) break;
+      if (header.magic == ESP32WS_RECORDER_MAGIC && header.sequence > newest) newest = header.sequence;
+    }
+    _spillFile = file;
+    return newest;
+  }
+  if (file) file.close();
+
+  ESP32WS_LOGI("Recorder: preallocating %s (%u blocks)...", _spillPath, (unsigned)_spillBlocks);
+  file = LittleFS.open(_spillPath, FILE_WRITE);
+  if (!file) return -1;
+  memset(_spillBuffers[0], 0, ESP32WS_RECORDER_BLOCK_BYTES); // Not in use before _spillReady
+  for (uint32_t i = 0; i < _spillBlocks; i++) {
+    if (file.write(_spillBuffers[0], ESP32WS_RECORDER_BLOCK_BYTES) != ESP32WS_RECORDER_BLOCK_BYTES) {
+      ESP32WS_LOGE("Recorder: %s could not be preallocated (filesystem full?).", _spillPath);
+      file.close();
+      LittleFS.remove(_spillPath);
+      return -1;
+    }
+  }
+  file.close();
+  _spillFile = LittleFS.open(_spillPath, "r+");
+  return _spillFile ? 0 : -1;
+}
+
+/**
+ * @brief Spill task: opens the file once the filesystem is mounted, then writes every sealed block
+ *        to its slot ((sequence - 1) % blocks), one whole aligned block per write. Cycling through
+ *        the preallocated slots spreads the erases evenly over the file.
+ */
+static void spillTask(void* param) {
+  if (!waitForFilesystem(ESP32WS_RECORDER_FS_WAIT_MS)) {
+    ESP32WS_LOGE("Recorder: filesystem unavailable or not mounted in time, recording to RAM only.");
+    vTaskDelete(nullptr);
+    return;
+  }
+  int64_t newest = openSpillFileInternal();
+  if (newest < 0) {
+    ESP32WS_LOGE("Recorder: cannot open %s, recording to RAM only.", _spillPath);
+    vTaskDelete(nullptr);
+    return;
+  }
+  xSemaphoreTake(_recorderMutex, portMAX_DELAY);
+  _spillNextSeq = (uint32_t)newest + 1;
+  _spillBootSeq = _spillNextSeq;
+  __atomic_store_n(&_spillWrittenSeq, (uint32_t)newest, __ATOMIC_RELEASE);
+  _spillReady = true;
+  xSemaphoreGive(_recorderMutex);
+  ESP32WS_LOGI("Recorder: spilling to %s (%u blocks, continuing after block %lu).", _spillPath,
+               (unsigned)_spillBlocks, (unsigned long)newest);
+
+  uint8_t sinceSync = 0;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    for (;;) {
+      xSemaphoreTake(_recorderMutex, portMAX_DELAY);
+      int8_t index = _spillPending;
+      _spillPending = -1;
+      _spillWriting = index;
+      xSemaphoreGive(_recorderMutex);
+      if (index < 0) break;
+
+      const uint8_t* block = _spillBuffers[index];
+      RecorderBlockHeader header;
+      memcpy(&header, block, sizeof(header));
+      uint32_t slot = (header.sequence - 1) % _spillBlocks;
+      xSemaphoreTake(_spillFileMutex, portMAX_DELAY);
+      bool ok = _spillFile.seek(slot * ESP32WS_RECORDER_BLOCK_BYTES) &&
+                _spillFile.write(block, ESP32WS_RECORDER_BLOCK_BYTES) == ESP32WS_RECORDER_BLOCK_BYTES;
+      if (++sinceSync >= ESP32WS_RECORDER_SYNC_BLOCKS) {
+        _spillFile.flush();
+        sinceSync = 0;
+      }
+      xSemaphoreGive(_spillFileMutex);
+      if (ok) {
+        __atomic_store_n(&_spillWrittenSeq, header.sequence, __ATOMIC_RELEASE);
+        _spillBlocksWritten++;
+      } else {
+        ESP32WS_LOGW("Recorder: write of block %lu failed.", (unsigned long)header.sequence);
+      }
+
+      xSemaphoreTake(_recorderMutex, portMAX_DELAY);
+      _spillWriting = -1;
+      xSemaphoreGive(_recorderMutex);
+    }
+  }
+}
+
+/**
+ * @brief Reads spill block 'sequence' if it still holds that block and frames of the stream.
+ */
+static bool readSpillBlockInternal(uint32_t sequence, uint8_t streamId, uint8_t* out, uint16_t* used) {
+  RecorderBlockHeader header;
+  xSemaphoreTake(_spillFileMutex, portMAX_DELAY);
+  bool ok = _spillFile.seek(((sequence - 1) % _spillBlocks) * ESP32WS_RECORDER_BLOCK_BYTES) &&
+            _spillFile.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+            header.magic == ESP32WS_RECORDER_MAGIC && header.sequence == sequence &&
+            (header.streamMask & (1u << streamId)) && header.used <= ESP32WS_RECORDER_BLOCK_BYTES &&
+            header.used > sizeof(header);
+  if (ok) {
+    size_t rest = header.used - sizeof(header);
+    ok = _spillFile.read(out + sizeof(header), rest) == rest;
+  }
+  xSemaphoreGive(_spillFileMutex);
+  *used = header.used;
+  return ok;
+}
+
+/**
+ * @brief Checks whether a replay delivers a recorded frame, and records the delivery if so.
+ */
+static bool takeReplayFrameInternal(ReplaySession& r, const RecorderRecordHeader& header, const uint8_t* frame) {
+  if (header.len < sizeof(StreamFrameHeader) || frame[1] != r.streamId || header.run != r.run) return false;
+  StreamFrameHeader frameHeader;
+  memcpy(&frameHeader, frame, sizeof(frameHeader));
+  if ((int64_t)frameHeader.sequence <= r.after) return false;
+  r.after = frameHeader.sequence;
+  if (r.frames++ == 0) r.firstSequence = frameHeader.sequence;
+  r.lastSequence = frameHeader.sequence;
+  return true;
+}
+
+/**
+ * @brief File phase of a replay: the next deliverable frame of the spilled blocks of this boot.
+ * @return The frame length, or 0 once the newest block on file was read.
+ */
+static size_t nextFileFrameInternal(ReplaySession& r, uint8_t* out, size_t outSize) {
+  while (r.active) {
+    while (r.blockPos + sizeof(RecorderRecordHeader) <= r.blockUsed) {
+      RecorderRecordHeader header;
+      memcpy(&header, r.block + r.blockPos, sizeof(header));
+      const uint8_t* frame = r.block + r.blockPos + sizeof(header);
+      if (header.len == 0 || r.blockPos + sizeof(header) + header.len > r.blockUsed) break; // Damaged block
+      r.blockPos += sizeof(header) + header.len;
+      if (header.len <= outSize && takeReplayFrameInternal(r, header, frame)) {
+        memcpy(out, frame, header.len);
+        return header.len;
+      }
+    }
+    r.blockPos = r.blockUsed = 0;
+    uint32_t written = __atomic_load_n(&_spillWrittenSeq, __ATOMIC_ACQUIRE);
+    if (r.fileSeq > written) return 0;
+    if (written >= _spillBlocks && r.fileSeq < written - _spillBlocks + 1) {
+      r.fileSeq = written - _spillBlocks + 1; // Overwritten while we were behind
+    }
+    uint32_t sequence = r.fileSeq++;
+    if (readSpillBlockInternal(sequence, r.streamId, r.block, &r.blockUsed)) {
+      r.blockPos = sizeof(RecorderBlockHeader);
+    } else {
+      r.blockUsed = 0;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Checks whether the RAM ring still holds the frame after r.after of the replay's run. Mutex held.
+ */
+static bool ringCoversReplayInternal(const ReplaySession& r) {
+  uint64_t pos = _tail;
+  while (pos < _head) {
+    RecorderRecordHeader header;
+    if (!recordAtInternal(pos, &header)) {
+      pos = nextWrapInternal(pos);
+      continue;
+    }
+    const uint8_t* frame = _ring + ringOffsetInternal(pos) + sizeof(header);
+    if (header.len >= sizeof(StreamFrameHeader) && frame[1] == r.streamId && header.run == r.run) {
+      StreamFrameHeader frameHeader;
+      memcpy(&frameHeader, frame, sizeof(frameHeader));
+      return (int64_t)frameHeader.sequence <= r.after + 1;
+    }
+    pos += sizeof(header) + header.len;
+  }
+  return false;
+}
+
+// Gauges for the metrics report
+static uint32_t usedBytesGaugeInternal() { return (uint32_t)(_head - _tail); }
+static uint32_t evictedGaugeInternal() { return _framesEvicted; }
+static uint32_t spillDroppedGaugeInternal() { return _spillBlocksDropped; }
+
+
+// --- Public Interface ---
+
+bool initStreamRecorder(size_t ramBytes, const char* spillPath, size_t spillBytes) {
+  if (_ring) {
+    ESP32WS_LOGE("Recorder Error: initStreamRecorder() already called.");
+    return false;
+  }
+  uint32_t spillBlocks = spillPath ? spillBytes / ESP32WS_RECORDER_BLOCK_BYTES : 0;
+  if (ramBytes < 2 * ESP32WS_RECORDER_BLOCK_BYTES || (spillPath && spillBlocks < 2)) {
+    ESP32WS_LOGE("Recorder Error: ring or spill file below 2 blocks of %d bytes.", ESP32WS_RECORDER_BLOCK_BYTES);
+    return false;
+  }
+  _recorderMutex = xSemaphoreCreateMutex();
+  if (!_recorderMutex) return false;
+  _ring = (uint8_t*)heap_caps_malloc(ramBytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  _inPsram = _ring != nullptr;
+  if (!_ring) {
+    ESP32WS_LOGW("Recorder: no PSRAM, using %u bytes of internal RAM.", (unsigned)ramBytes);
+    _ring = (uint8_t*)malloc(ramBytes);
+  }
+  if (!_ring) {
+    ESP32WS_LOGE("Recorder Error: allocation of %u bytes failed.", (unsigned)ramBytes);
+    return false;
+  }
+  _capacity = ramBytes;
+
+  if (spillPath) {
+    // Internal RAM: the flash driver writes from these buffers directly
+    _spillBuffers[0] = (uint8_t*)malloc(ESP32WS_RECORDER_BLOCK_BYTES);
+    _spillBuffers[1] = (uint8_t*)malloc(ESP32WS_RECORDER_BLOCK_BYTES);
+    _spillFileMutex = xSemaphoreCreateMutex();
+    _spillPath = spillPath;
+    _spillBlocks = spillBlocks;
+    if (!_spillBuffers[0] || !_spillBuffers[1] || !_spillFileMutex ||
+        xTaskCreate(spillTask, "esp32ws_spill", 4096, nullptr, 1, &_spillTask) != pdPASS) {
+      ESP32WS_LOGE("Recorder Error: spill buffers or task unavailable, recording to RAM only.");
+      _spillBlocks = 0;
+    }
+  }
+  registerMetricGauge("recorder_used_bytes", usedBytesGaugeInternal);
+  registerMetricGauge("recorder_frames_evicted", evictedGaugeInternal);
+  if (_spillBlocks > 0) registerMetricGauge("recorder_spill_dropped", spillDroppedGaugeInternal);
+  ESP32WS_LOGI("Recorder ready: %u bytes in %s%s.", (unsigned)ramBytes, _inPsram ? "PSRAM" : "internal RAM",
+               _spillBlocks > 0 ? ", spilling to LittleFS" : "");
+  return true;
+}
+
+bool isStreamRecorderActive() {
+  return _ring != nullptr;
+}
+
+void getRecorderStats(RecorderStats* stats) {
+  if (!stats) return;
+  memset(stats, 0, sizeof(*stats));
+  if (!_ring) return;
+  xSemaphoreTake(_recorderMutex, portMAX_DELAY);
+  stats->capacityBytes = _capacity;
+  stats->usedBytes = (uint32_t)(_head - _tail);
+  uint64_t pos = _tail;
+  RecorderRecordHeader oldest;
+  if (pos < _head && !recordAtInternal(pos, &oldest)) pos = nextWrapInternal(pos);
+  if (pos < _head && recordAtInternal(pos, &oldest)) stats->spanMs = _newestMs - oldest.recordMs;
+  stats->framesRecorded = _framesRecorded;
+  stats->framesEvicted = _framesEvicted;
+  stats->framesTooLarge = _framesTooLarge;
+  stats->spillBlocks = _spillBlocks;
+  stats->spillBlocksWritten = _spillBlocksWritten;
+  stats->spillBlocksDropped = _spillBlocksDropped;
+  for (int i = 0; i < ESP32WS_RECORDER_MAX_REPLAYS; i++) {
+    if (_replays[i].active) stats->activeReplays++;
+  }
+  stats->inPsram = _inPsram;
+  stats->spillReady = _spillReady;
+  xSemaphoreGive(_recorderMutex);
+}
+
+
+// --- Library-Internal Interface ---
+
+uint32_t recordStreamFrame(const uint8_t* frame, size_t len) {
+  if (!_ring || !frame || len < sizeof(StreamFrameHeader) || frame[0] != ESP32WS_BIN_STREAM_FRAME ||
+      frame[1] >= ESP32WS_MAX_STREAMS) {
+    return 0;
+  }
+  if (len > ESP32WS_RECORDER_MAX_FRAME) {
+    _framesTooLarge++;
+    return 0;
+  }
+  uint8_t streamId = frame[1];
+  StreamFrameHeader frameHeader;
+  memcpy(&frameHeader, frame, sizeof(frameHeader));
+  uint32_t mask = 0;
+
+  xSemaphoreTake(_recorderMutex, portMAX_DELAY);
+  if (_seen[streamId] && frameHeader.sequence <= _lastSequence[streamId]) _runs[streamId]++;
+  _seen[streamId] = true;
+  _lastSequence[streamId] = frameHeader.sequence;
+  RecorderRecordHeader header = {(uint16_t)len, _runs[streamId], (uint32_t)millis()};
+  appendToRingInternal(header, frame);
+  if (_spillReady) appendToSpillInternal(header, frame, streamId);
+  _newestMs = header.recordMs;
+  _framesRecorded++;
+  for (int i = 0; i < ESP32WS_RECORDER_MAX_REPLAYS; i++) {
+    if (_replays[i].active && _replays[i].streamId == streamId && _replays[i].run == header.run) mask |= 1u << i;
+  }
+  xSemaphoreGive(_recorderMutex);
+  return mask;
+}
+
+bool replayWithholdsFrame(uint32_t replayMask, uint32_t clientId) {
+  for (int i = 0; i < ESP32WS_RECORDER_MAX_REPLAYS; i++) {
+    if ((replayMask & (1u << i)) && _replays[i].clientId == clientId) return true;
+  }
+  return false;
+}
+
+int beginStreamReplay(uint32_t clientId, uint8_t streamId, uint32_t afterSequence) {
+  if (!_ring || streamId >= ESP32WS_MAX_STREAMS) return -1;
+  cancelClientReplays(clientId);
+  uint8_t* block = _spillBlocks > 0 ? (uint8_t*)malloc(ESP32WS_RECORDER_BLOCK_BYTES) : nullptr;
+
+  xSemaphoreTake(_recorderMutex, portMAX_DELAY);
+  int index = -1;
+  for (int i = 0; i < ESP32WS_RECORDER_MAX_REPLAYS && index < 0; i++) {
+    if (!_replays[i].busy) index = i;
+  }
+  if (index >= 0) {
+    ReplaySession& r = _replays[index];
+    r = ReplaySession();
+    r.busy = true;
+    r.active = true;
+    r.clientId = clientId;
+    r.streamId = streamId;
+    r.run = _runs[streamId];
+    // Ahead of the stream: it restarted after the client's last frame, so the whole run is new to it
+    r.after = _seen[streamId] && afterSequence > _lastSequence[streamId] ? -1 : (int64_t)afterSequence;
+    r.phase = REPLAY_RAM;
+    r.pos = _tail;
+    if (_spillReady && block && !ringCoversReplayInternal(r)) {
+      r.phase = REPLAY_FILE;
+      r.fileSeq = _spillBootSeq;
+      r.block = block;
+      block = nullptr;
+    }
+  }
+  xSemaphoreGive(_recorderMutex);
+  free(block); // Not needed by a RAM-only replay
+  if (index >= 0) {
+    ESP32WS_LOGD("Replay #%d: client #%u, stream %u after sequence %lu, from %s.", index, clientId, streamId,
+                 (unsigned long)afterSequence, _replays[index].phase == REPLAY_FILE ? "file" : "RAM");
+  }
+  return index;
+}
+
+bool getReplayClient(int index, uint32_t* clientId, uint8_t* streamId) {
+  if (index < 0 || index >= ESP32WS_RECORDER_MAX_REPLAYS || !_replays[index].busy) return false;
+  if (clientId) *clientId = _replays[index].clientId;
+  if (streamId) *streamId = _replays[index].streamId;
+  return true;
+}
+
+size_t nextReplayFrame(int index, uint8_t* out, size_t outSize, ReplaySummary* summary) {
+  if (index < 0 || index >= ESP32WS_RECORDER_MAX_REPLAYS || !_replays[index].busy) return 0;
+  ReplaySession& r = _replays[index];
+  if (r.phase == REPLAY_FILE) {
+    size_t len = nextFileFrameInternal(r, out, outSize);
+    if (len > 0) return len;
+    free(r.block);
+    r.block = nullptr;
+    r.phase = REPLAY_RAM; // Frames newer than the file are in RAM; r.after skips those already sent
+    r.pos = 0;
+  }
+
+  xSemaphoreTake(_recorderMutex, portMAX_DELAY);
+  for (;;) {
+    if (r.pos < _tail) r.pos = _tail; // The ring overwrote frames before the replay reached them
+    if (r.pos >= _head || !r.active) {
+      // Caught up (or cancelled): under the mutex, so the next recorded frame goes out live
+      if (summary) {
+        summary->clientId = r.clientId;
+        summary->streamId = r.streamId;
+        summary->frames = r.frames;
+        summary->firstSequence = r.firstSequence;
+        summary->lastSequence = r.lastSequence;
+        summary->completed = r.active;
+      }
+      r.active = false;
+      r.busy = false;
+      break;
+    }
+    RecorderRecordHeader header;
+    if (!recordAtInternal(r.pos, &header)) {
+      r.pos = nextWrapInternal(r.pos);
+      continue;
+    }
+    const uint8_t* frame = _ring + ringOffsetInternal(r.pos) + sizeof(header);
+    r.pos += sizeof(header) + header.len;
+    if (header.len <= outSize && takeReplayFrameInternal(r, header, frame)) {
+      memcpy(out, frame, header.len);
+      xSemaphoreGive(_recorderMutex);
+      return header.len;
+    }
+  }
+  xSemaphoreGive(_recorderMutex);
+  return 0;
+}
+
+void cancelClientReplays(uint32_t clientId) {
+  if (!_ring) return;
+  xSemaphoreTake(_recorderMutex, portMAX_DELAY);
+  for (int i = 0; i < ESP32WS_RECORDER_MAX_REPLAYS; i++) {
+    if (_replays[i].busy && _replays[i].clientId == clientId) _replays[i].active = false;
+  }
+  xSemaphoreGive(_recorderMutex);
+}
+
+uint32_t spillFileVersion(const char* path) {
+  if (!_spillPath || !path || strcmp(path, _spillPath) != 0) return 0;
+  return __atomic_load_n(&_spillWrittenSeq, __ATOMIC_ACQUIRE);
+}
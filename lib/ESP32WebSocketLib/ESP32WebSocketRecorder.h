@@ -0,0 +1,188 @@
+/**
+ * @file ESP32WebSocketRecorder.h
+ * @brief Stream recorder for the ESP32WebSocket library.
+ *        Every raw stream frame broadcast by the library (broadcastBinaryData(), broadcastBinaryFrame(),
+ *        broadcastStreamFrame() and the acquisition engine) is also appended to a byte ring in PSRAM
+ *        (internal RAM on boards without it), which keeps the most recent frames. Optionally the frames
+ *        are spilled to a preallocated LittleFS file in whole, block-aligned writes.
+ *        A client that lost frames (phone asleep, AP roaming) sends
+ *        {"action":"replay_since","stream":id,"sequence":n} after reconnecting: the recorded frames of
+ *        the stream after sequence n are queued to it as fast as its link drains them, and its live
+ *        frames of that stream resume exactly where the replay ends.
+ *
+ * Spill file format (little-endian), for offline readers:
+ *   The file is a ring of ESP32WS_RECORDER_BLOCK_BYTES blocks, written in the order of their sequence
+ *   (the block with the lowest valid sequence is the oldest). Each block is a RecorderBlockHeader
+ *   followed by records up to 'used' bytes; the rest of the block is zero. A record is a
+ *   RecorderRecordHeader followed by 'len' bytes of one stream frame (see ESP32WebSocketStream.h);
+ *   records never cross a block. Blocks whose magic differs are unused.
+ */
+#ifndef ESP32_WEBSOCKET_RECORDER_H
+#define ESP32_WEBSOCKET_RECORDER_H
+
+#include <Arduino.h>
+
+// --- Recorder Configuration ---
+
+/// Size of one spill block: the unit of every file write, aligned to the LittleFS block size.
+#ifndef ESP32WS_RECORDER_BLOCK_BYTES
+#define ESP32WS_RECORDER_BLOCK_BYTES 4096
+#endif
+/// Blocks written between two file syncs (a power loss loses at most this many blocks).
+#ifndef ESP32WS_RECORDER_SYNC_BLOCKS
+#define ESP32WS_RECORDER_SYNC_BLOCKS 8
+#endif
+/// Longest wait of the spill task for the LittleFS mount of initWiFiWebSocketServer(); after it the
+/// recorder keeps recording to RAM only (e.g. when the server is never initialized).
+#ifndef ESP32WS_RECORDER_FS_WAIT_MS
+#define ESP32WS_RECORDER_FS_WAIT_MS 30000
+#endif
+/// Concurrent replays (one per client; a new request from the same client replaces its replay).
+#ifndef ESP32WS_RECORDER_MAX_REPLAYS
+#define ESP32WS_RECORDER_MAX_REPLAYS 2
+#endif
+/// Replay frames in flight per client (counted by the replay itself); it tops them up as the link drains them.
+#ifndef ESP32WS_RECORDER_REPLAY_QUEUE
+#define ESP32WS_RECORDER_REPLAY_QUEUE 4
+#endif
+/// While the recorder runs, the streams of a subscriber that disconnects (without stop_stream) keep
+/// running this long, so the gap is recorded and the frame sequence continues when it reconnects.
+#ifndef ESP32WS_RECORDER_LINGER_MS
+#define ESP32WS_RECORDER_LINGER_MS 30000
+#endif
+
+#define ESP32WS_RECORDER_MAGIC 0x31525745 // "EWR1"
+
+/**
+ * @struct RecorderBlockHeader
+ * @brief Start of each spill file block.
+ */
+struct __attribute__((packed)) RecorderBlockHeader {
+  uint32_t magic;      ///< ESP32WS_RECORDER_MAGIC in a written block.
+  uint32_t sequence;   ///< Block counter, continued across reboots (1 = first block ever written).
+  uint16_t used;       ///< Bytes used in the block, this header included.
+  uint8_t streamMask;  ///< Bit s: the block holds frames of stream s.
+  uint8_t reserved;
+  uint32_t firstMs;    ///< millis() when the block's first frame was recorded.
+};
+static_assert(sizeof(RecorderBlockHeader) == 16, "RecorderBlockHeader must stay 16 bytes");
+
+/**
+ * @struct RecorderRecordHeader
+ * @brief Precedes each recorded frame, in the RAM ring and in the spill blocks.
+ */
+struct __attribute__((packed)) RecorderRecordHeader {
+  uint16_t len;        ///< Frame length in bytes.
+  uint16_t run;        ///< Incremented each time the frame's stream restarts (its sequence goes back).
+  uint32_t recordMs;   ///< millis() when the frame was recorded.
+};
+static_assert(sizeof(RecorderRecordHeader) == 8, "RecorderRecordHeader must stay 8 bytes");
+
+/// Largest frame the recorder keeps (one record per spill block).
+#define ESP32WS_RECORDER_MAX_FRAME (ESP32WS_RECORDER_BLOCK_BYTES - sizeof(RecorderBlockHeader) - sizeof(RecorderRecordHeader))
+
+/**
+ * @struct RecorderStats
+ * @brief Recorder counters (since initStreamRecorder()).
+ */
+struct RecorderStats {
+  uint32_t capacityBytes;      ///< Size of the RAM ring.
+  uint32_t usedBytes;          ///< Bytes of recorded frames currently in the RAM ring.
+  uint32_t spanMs;             ///< Time between the oldest and the newest frame in the RAM ring.
+  uint32_t framesRecorded;     ///< Frames appended.
+  uint32_t framesEvicted;      ///< Oldest frames overwritten by newer ones.
+  uint32_t framesTooLarge;     ///< Frames above ESP32WS_RECORDER_MAX_FRAME, not recorded.
+  uint32_t spillBlocks;        ///< Blocks in the spill file (0 without a spill file).
+  uint32_t spillBlocksWritten; ///< Blocks written to the spill file.
+  uint32_t spillBlocksDropped; ///< Blocks not spilled because the previous write was still running.
+  uint8_t activeReplays;       ///< Replays in progress.
+  bool inPsram;                ///< The ring lives in PSRAM.
+  bool spillReady;             ///< The spill file is open and preallocated.
+};
+
+// --- Public Interface ---
+
+/**
+ * @brief Allocates the recorder and starts recording every raw stream frame the library broadcasts.
+ *        Size the ring for the wanted history: seconds x the stream's bytes per second (frame size x
+ *        frame rate, after encoding) + 8 bytes per frame. Call once, during setup.
+ *
+ * @param ramBytes Size of the RAM ring (at least 2 x ESP32WS_RECORDER_BLOCK_BYTES), taken from PSRAM when present.
+ * @param spillPath (Optional) LittleFS file extending the history beyond the RAM ring, e.g. "/capture.rec".
+ *                  Must remain valid. A task waits for the filesystem, then opens and preallocates it;
+ *                  an existing file of the same size is continued, so its older blocks survive a reboot.
+ * @param spillBytes Size of the spill file, rounded down to whole blocks (at least 2 blocks).
+ * @return False if already initialized, on invalid sizes or allocation failure.
+ */
+bool initStreamRecorder(size_t ramBytes, const char* spillPath = nullptr, size_t spillBytes = 0);
+
+/**
+ * @brief Returns true once initStreamRecorder() succeeded.
+ */
+bool isStreamRecorderActive();
+
+/**
+ * @brief Copies the recorder counters into stats (all zero before initStreamRecorder()).
+ */
+void getRecorderStats(RecorderStats* stats);
+
+// --- Library-Internal Interface (used by ESP32WebSocket.cpp) ---
+
+/**
+ * @struct ReplaySummary
+ * @brief Outcome of a finished replay (the "replay_done" message).
+ */
+struct ReplaySummary {
+  uint32_t clientId;
+  uint8_t streamId;
+  uint32_t frames;         ///< Frames delivered.
+  uint32_t firstSequence;  ///< Sequence of the first delivered frame (valid if frames > 0).
+  uint32_t lastSequence;   ///< Sequence of the last delivered frame (valid if frames > 0).
+  bool completed;          ///< False if the replay was cancelled.
+};
+
+/**
+ * @brief Appends a raw stream frame (other messages are ignored). Called by every broadcast path.
+ * @return Bit i set if replay i covers this frame: its client must not get the frame live.
+ */
+uint32_t recordStreamFrame(const uint8_t* frame, size_t len);
+
+/**
+ * @brief Checks a recordStreamFrame() result against a client.
+ */
+bool replayWithholdsFrame(uint32_t replayMask, uint32_t clientId);
+
+/**
+ * @brief Starts replaying the frames of a stream recorded after a sequence number to a client,
+ *        replacing the client's previous replay. Frames of the stream's current run are replayed
+ *        (a sequence ahead of the stream means it restarted, and the whole current run is replayed).
+ * @return The replay index, or -1 if the recorder is off or every replay slot is busy.
+ */
+int beginStreamReplay(uint32_t clientId, uint8_t streamId, uint32_t afterSequence);
+
+/**
+ * @brief Returns the client and stream of a replay slot. A cancelled replay keeps its slot until the
+ *        replay task's next nextReplayFrame() call on it.
+ * @return False if slot 'index' is free.
+ */
+bool getReplayClient(int index, uint32_t* clientId, uint8_t* streamId = nullptr);
+
+/**
+ * @brief Copies the next frame of a replay into out. Called by the replay task only.
+ * @return The frame length, or 0 once the replay reached the newest frame or was cancelled: the slot
+ *         is free, summary is filled in and the client's live frames resume with the next recorded frame.
+ */
+size_t nextReplayFrame(int index, uint8_t* out, size_t outSize, ReplaySummary* summary);
+
+/**
+ * @brief Cancels the replays of a client (e.g. it disconnected).
+ */
+void cancelClientReplays(uint32_t clientId);
+
+/**
+ * @brief Returns the sequence of the newest block written to the spill file if path is the spill file
+ *        (it changes with every block written), otherwise 0. Part of the capture download's ETag.
+ */
+uint32_t spillFileVersion(const char* path);
+
+#endif // ESP32_WEBSOCKET_RECORDER_H
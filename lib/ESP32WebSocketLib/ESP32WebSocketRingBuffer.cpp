@@ -0,0 +1,36 @@
+/**
+ * @file ESP32WebSocketRingBuffer.cpp
+ * @brief Storage management for ChunkRingBuffer. The hot-path methods are inline in the header.
+ */
+#include "ESP32WebSocketRingBuffer.h"
+
+ChunkRingBuffer::~ChunkRingBuffer() {
+  end();
+}
+
+void ChunkRingBuffer::end() {
+  free(_storage);
+  free(_lengths);
+  _storage = nullptr;
+  _lengths = nullptr;
+  _slotSize = 0;
+  _numSlots = 0;
+}
+
+bool ChunkRingBuffer::begin(size_t slotSize, uint16_t numSlots) {
+  if (_storage != nullptr || slotSize == 0 || numSlots < 2 || (numSlots & (numSlots - 1)) != 0) return false;
+  _storage = (uint8_t*)malloc(slotSize * numSlots);
+  _lengths = (size_t*)calloc(numSlots, sizeof(size_t));
+  if (!_storage || !_lengths) {
+    free(_storage);
+    free(_lengths);
+    _storage = nullptr;
+    _lengths = nullptr;
+    return false;
+  }
+  _slotSize = slotSize;
+  _numSlots = numSlots;
+  _head.store(0, std::memory_order_relaxed);
+  _tail.store(0, std::memory_order_relaxed);
+  return true;
+}
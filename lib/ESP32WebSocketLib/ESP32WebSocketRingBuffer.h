@@ -0,0 +1,101 @@
+/**
+ * @file ESP32WebSocketRingBuffer.h
+ * @brief Lock-free single-producer/single-consumer ring of fixed-size chunk slots.
+ *        Used by the ESP32WebSocket library to hand complete data chunks from the
+ *        sampler task (producer, core 1) to the sender task (consumer, core 0)
+ *        without a mutex on either side.
+ */
+#ifndef ESP32_WEBSOCKET_RING_BUFFER_H
+#define ESP32_WEBSOCKET_RING_BUFFER_H
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * @class ChunkRingBuffer
+ * @brief SPSC ring whose elements are byte slots of up to slotSize bytes.
+ *
+ * The producer obtains a slot with writeSlot(), fills it in place and publishes it
+ * with commitWrite(). The consumer obtains the oldest published slot with readSlot()
+ * and returns it with releaseRead(). Exactly one task may act as producer and exactly
+ * one as consumer; no other synchronisation is required.
+ */
+class ChunkRingBuffer {
+public:
+  ChunkRingBuffer() = default;
+  ~ChunkRingBuffer();
+
+  ChunkRingBuffer(const ChunkRingBuffer&) = delete;
+  ChunkRingBuffer& operator=(const ChunkRingBuffer&) = delete;
+
+  /**
+   * @brief Allocates the slot storage. Must be called before any other method.
+   * @param slotSize Maximum size in bytes of one chunk.
+   * @param numSlots Number of slots: a power of two, at least 2 (keeps the free-running
+   *                 counters consistent across 32-bit wrap-around).
+   * @return True on success, false on invalid arguments or allocation failure.
+   */
+  bool begin(size_t slotSize, uint16_t numSlots);
+
+  /**
+   * @brief Frees the slot storage; begin() may be called again afterwards. Neither side may use the ring.
+   */
+  void end();
+
+  /**
+   * @brief Producer: returns the next free slot, or nullptr if the ring is full.
+   *        Calling it again before commitWrite() returns the same slot.
+   */
+  uint8_t* writeSlot() {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) >= _numSlots) return nullptr;
+    return _storage + (size_t)(head % _numSlots) * _slotSize;
+  }
+
+  /**
+   * @brief Producer: publishes the slot returned by writeSlot().
+   * @param len Number of valid bytes in the slot (<= slotSize).
+   */
+  void commitWrite(size_t len) {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    _lengths[head % _numSlots] = len;
+    _head.store(head + 1, std::memory_order_release);
+  }
+
+  /**
+   * @brief Consumer: returns the oldest published slot, or nullptr if the ring is empty.
+   * @param len Receives the number of valid bytes in the slot.
+   */
+  const uint8_t* readSlot(size_t* len) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (_head.load(std::memory_order_acquire) == tail) return nullptr;
+    if (len) *len = _lengths[tail % _numSlots];
+    return _storage + (size_t)(tail % _numSlots) * _slotSize;
+  }
+
+  /**
+   * @brief Consumer: returns the slot obtained from readSlot() to the producer.
+   */
+  void releaseRead() {
+    _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /// Number of published slots not yet released by the consumer (safe from either side).
+  uint16_t depth() const {
+    return (uint16_t)(_head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire));
+  }
+  /// Total number of slots.
+  uint16_t capacity() const { return _numSlots; }
+  /// Maximum chunk size in bytes.
+  size_t slotSize() const { return _slotSize; }
+
+private:
+  uint8_t* _storage = nullptr;
+  size_t* _lengths = nullptr;
+  size_t _slotSize = 0;
+  uint16_t _numSlots = 0;
+  std::atomic<uint32_t> _head{0}; ///< Free-running count of committed slots (written by the producer only).
+  std::atomic<uint32_t> _tail{0}; ///< Free-running count of released slots (written by the consumer only).
+};
+
+#endif // ESP32_WEBSOCKET_RING_BUFFER_H
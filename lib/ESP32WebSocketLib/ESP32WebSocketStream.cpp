@@ -0,0 +1,467 @@
+/**
+ * @file ESP32WebSocketStream.cpp
+ * @brief Stream registry, frame header writer and the cached "stream_schema" message.
+ */
+#include "ESP32WebSocketStream.h"
+#include "ESP32WebSocketEncoding.h"
+#include <ArduinoJson.h>
+#include "ESP32WebSocketLog.h"
+#include <new> // std::nothrow for the schema buffer
+
+// --- Module-Internal State ---
+
+/**
+ * @struct StreamConfig
+ * @brief Registered stream (channel declarations are copied from the application).
+ */
+struct StreamConfig {
+  const char* name;
+  StreamChannel channels[ESP32WS_STREAM_MAX_CHANNELS];
+  uint8_t numChannels;
+  uint32_t samplePeriodUs;
+  uint16_t samplesPerFrame;
+  size_t sampleSize;
+  uint16_t numColumns;      // Scalar values per sample (sum of the channel counts)
+  StreamEncoding encoding;
+};
+
+static StreamConfig _streams[ESP32WS_MAX_STREAMS];
+static uint8_t _numStreams = 0;
+
+// Serialized schema of every registered stream. Rebuilt by registerStream() only (setup time),
+// and otherwise shared read-only between the client send queues.
+static AsyncWebSocketMessageBuffer* _streamSchemaBuffer = nullptr;
+
+// --- Internal Helpers ---
+
+static size_t streamValueSizeInternal(StreamValueType type) {
+  switch (type) {
+    case STREAM_U8:
+    case STREAM_I8:  return 1;
+    case STREAM_U16:
+    case STREAM_I16: return 2;
+    case STREAM_U32:
+    case STREAM_I32:
+    case STREAM_F32: return 4;
+    default:         return 0;
+  }
+}
+
+static const char* streamValueTypeToCharString(StreamValueType type) {
+  switch (type) {
+    case STREAM_U8:  return "u8";
+    case STREAM_I8:  return "i8";
+    case STREAM_U16: return "u16";
+    case STREAM_I16: return "i16";
+    case STREAM_U32: return "u32";
+    case STREAM_I32: return "i32";
+    case STREAM_F32: return "f32";
+    default:         return "unknown";
+  }
+}
+
+static const char* streamEncodingToCharString(StreamEncoding encoding) {
+  switch (encoding) {
+    case STREAM_ENC_RAW:    return "raw";
+    case STREAM_ENC_PACK12: return "pack12";
+    case STREAM_ENC_DELTA:  return "delta";
+    default:                return "unknown";
+  }
+}
+
+/**
+ * @brief Checks that every channel of a stream can be carried by an encoding.
+ */
+static bool isEncodingSupportedInternal(const StreamChannel* channels, uint8_t numChannels, StreamEncoding encoding) {
+  for (uint8_t c = 0; c < numChannels; c++) {
+    StreamValueType type = channels[c].type;
+    if (encoding == STREAM_ENC_PACK12 && type != STREAM_U16) return false;
+    if (encoding == STREAM_ENC_DELTA && type != STREAM_U16 && type != STREAM_I16) return false;
+  }
+  return encoding <= STREAM_ENC_DELTA;
+}
+
+/**
+ * @brief Serializes the schema of all registered streams into a new message buffer.
+ *        The whole buffer is sent as the text message, so it is sized exactly (plus one trailing space).
+ */
+static bool buildStreamSchemaInternal() {
+  DynamicJsonDocument doc(getStreamSchemaCapacity());
+  doc["status"] = "stream_schema";
+  describeStreams(doc.createNestedArray("streams"));
+  if (doc.overflowed()) {
+    ESP32WS_LOGE("Stream Error: Stream schema document overflowed.");
+    return false;
+  }
+
+  size_t len = measureJson(doc);
+  AsyncWebSocketMessageBuffer* buffer = new (std::nothrow) AsyncWebSocketMessageBuffer(len + 1);
+  if (!buffer || buffer->get() == nullptr) {
+    ESP32WS_LOGE("Stream Error: Allocation of the schema buffer failed.");
+    delete buffer;
+    return false;
+  }
+  char* out = (char*)buffer->get();
+  serializeJson(doc, out, len + 1);
+  out[len] = ' ';
+  // An old schema still referenced by a send queue is left alone (setup-time only, so bounded)
+  if (_streamSchemaBuffer && _streamSchemaBuffer->count() == 0) delete _streamSchemaBuffer;
+  _streamSchemaBuffer = buffer;
+  return true;
+}
+
+// --- Public Function Implementations ---
+
+size_t getStreamSchemaCapacity() {
+  size_t capacity = JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(_numStreams) + 128;
+  for (uint8_t s = 0; s < _numStreams; s++) {
+    capacity += JSON_OBJECT_SIZE(8) + JSON_ARRAY_SIZE(_streams[s].numChannels) +
+                _streams[s].numChannels * JSON_OBJECT_SIZE(6);
+  }
+  return capacity;
+}
+
+void describeStreams(JsonArray streamsArray) {
+  for (uint8_t s = 0; s < _numStreams; s++) {
+    const StreamConfig& stream = _streams[s];
+    JsonObject streamObj = streamsArray.createNestedObject();
+    streamObj["id"] = s;
+    streamObj["name"] = stream.name;
+    streamObj["periodUs"] = stream.samplePeriodUs;
+    streamObj["samplesPerFrame"] = stream.samplesPerFrame;
+    streamObj["headerBytes"] = sizeof(StreamFrameHeader);
+    streamObj["sampleBytes"] = stream.sampleSize;
+    streamObj["encoding"] = streamEncodingToCharString(stream.encoding);
+    JsonArray channelsArray = streamObj.createNestedArray("channels");
+    for (uint8_t c = 0; c < stream.numChannels; c++) {
+      const StreamChannel& channel = stream.channels[c];
+      JsonObject channelObj = channelsArray.createNestedObject();
+      channelObj["name"] = channel.name;
+      channelObj["type"] = streamValueTypeToCharString(channel.type);
+      channelObj["count"] = channel.count;
+      channelObj["scale"] = channel.scale;
+      channelObj["offset"] = channel.offset;
+      channelObj["unit"] = channel.unit ? channel.unit : "";
+    }
+  }
+}
+
+int registerStream(const char* name, const StreamChannel* channels, uint8_t numChannels,
+                   uint32_t samplePeriodUs, uint16_t samplesPerFrame, StreamEncoding encoding) {
+  if (_numStreams >= ESP32WS_MAX_STREAMS) {
+    ESP32WS_LOGE("Stream Error: At most %d streams can be registered.", ESP32WS_MAX_STREAMS);
+    return -1;
+  }
+  if (!name || !channels || numChannels == 0 || numChannels > ESP32WS_STREAM_MAX_CHANNELS ||
+      samplePeriodUs == 0 || samplesPerFrame == 0) {
+    ESP32WS_LOGE("Stream Error: Invalid stream declaration.");
+    return -1;
+  }
+  if (!isEncodingSupportedInternal(channels, numChannels, encoding)) {
+    ESP32WS_LOGE("Stream Error: Encoding '%s' not supported by the channels of '%s'.",
+                 streamEncodingToCharString(encoding), name);
+    return -1;
+  }
+  StreamConfig& stream = _streams[_numStreams];
+  size_t sampleSize = 0;
+  uint16_t numColumns = 0;
+  for (uint8_t c = 0; c < numChannels; c++) {
+    size_t valueSize = streamValueSizeInternal(channels[c].type);
+    if (valueSize == 0 || channels[c].count == 0 || !channels[c].name) {
+      ESP32WS_LOGE("Stream Error: Invalid channel %u in stream '%s'.", c, name);
+      return -1;
+    }
+    stream.channels[c] = channels[c];
+    sampleSize += valueSize * channels[c].count;
+    numColumns += channels[c].count;
+  }
+  stream.name = name;
+  stream.numChannels = numChannels;
+  stream.samplePeriodUs = samplePeriodUs;
+  stream.samplesPerFrame = samplesPerFrame;
+  stream.sampleSize = sampleSize;
+  stream.numColumns = numColumns;
+  stream.encoding = encoding;
+  int id = _numStreams++;
+  buildStreamSchemaInternal();
+  ESP32WS_LOGI("Stream #%d '%s' registered: %u bytes/sample, %u samples/frame, %lu us period, %s encoding.",
+               id, name, (unsigned)sampleSize, samplesPerFrame, (unsigned long)samplePeriodUs,
+               streamEncodingToCharString(encoding));
+  return id;
+}
+
+size_t getStreamSampleSize(int streamId) {
+  if (streamId < 0 || streamId >= _numStreams) return 0;
+  return _streams[streamId].sampleSize;
+}
+
+size_t getStreamFrameSize(int streamId) {
+  if (streamId < 0 || streamId >= _numStreams) return 0;
+  return sizeof(StreamFrameHeader) + (size_t)_streams[streamId].samplesPerFrame * _streams[streamId].sampleSize;
+}
+
+uint8_t getStreamCount() {
+  return _numStreams;
+}
+
+int findStreamChannel(int streamId, const char* channelName) {
+  if (streamId < 0 || streamId >= _numStreams || !channelName) return -1;
+  const StreamConfig& stream = _streams[streamId];
+  for (uint8_t c = 0; c < stream.numChannels; c++) {
+    if (strcmp(stream.channels[c].name, channelName) == 0) return c;
+  }
+  return -1;
+}
+
+uint8_t getStreamChannelCount(int streamId) {
+  if (streamId < 0 || streamId >= _numStreams) return 0;
+  return _streams[streamId].numChannels;
+}
+
+const char* getStreamName(int streamId) {
+  if (streamId < 0 || streamId >= _numStreams) return nullptr;
+  return _streams[streamId].name;
+}
+
+uint32_t getStreamPeriodUs(int streamId) {
+  if (streamId < 0 || streamId >= _numStreams) return 0;
+  return _streams[streamId].samplePeriodUs;
+}
+
+StreamEncoding getStreamEncoding(int streamId) {
+  if (streamId < 0 || streamId >= _numStreams) return STREAM_ENC_RAW;
+  return _streams[streamId].encoding;
+}
+
+size_t getStreamEncodedFrameCapacity(int streamId) {
+  if (streamId < 0 || streamId >= _numStreams) return 0;
+  const StreamConfig& stream = _streams[streamId];
+  size_t deltaBytes = (size_t)stream.numColumns * (3 + ((size_t)(stream.samplesPerFrame - 1) * 17 + 7) / 8);
+  size_t rawBytes = (size_t)stream.samplesPerFrame * stream.sampleSize;
+  return sizeof(StreamFrameHeader) + (deltaBytes > rawBytes ? deltaBytes : rawBytes);
+}
+
+size_t encodeStreamFrame(int streamId, const uint8_t* rawFrame, uint8_t* out) {
+  if (streamId < 0 || streamId >= _numStreams || !rawFrame || !out) return 0;
+  const StreamConfig& stream = _streams[streamId];
+  StreamFrameHeader header;
+  memcpy(&header, rawFrame, sizeof(header));
+  uint16_t sampleCount = header.sampleCount;
+  if (sampleCount > stream.samplesPerFrame) sampleCount = stream.samplesPerFrame;
+  const uint8_t* payload = rawFrame + sizeof(StreamFrameHeader);
+  uint8_t* encoded = out + sizeof(StreamFrameHeader);
+  memcpy(out, rawFrame, sizeof(StreamFrameHeader));
+  switch (stream.encoding) {
+    case STREAM_ENC_PACK12:
+      return sizeof(StreamFrameHeader) +
+             encodePack12Payload(payload, stream.sampleSize, stream.numColumns, sampleCount, encoded);
+    case STREAM_ENC_DELTA: {
+      uint8_t counts[ESP32WS_STREAM_MAX_CHANNELS];
+      bool isSigned[ESP32WS_STREAM_MAX_CHANNELS];
+      for (uint8_t ch = 0; ch < stream.numChannels; ch++) {
+        counts[ch] = stream.channels[ch].count;
+        isSigned[ch] = stream.channels[ch].type == STREAM_I16;
+      }
+      return sizeof(StreamFrameHeader) +
+             encodeDeltaPayload(payload, stream.sampleSize, sampleCount, counts, isSigned, stream.numChannels, encoded);
+    }
+    default:
+      memcpy(encoded, payload, (size_t)sampleCount * stream.sampleSize);
+      return sizeof(StreamFrameHeader) + (size_t)sampleCount * stream.sampleSize;
+  }
+}
+
+// --- StreamDecimator ---
+
+bool StreamDecimator::begin(int sourceStreamId, uint8_t outputStreamId, DecimationMode mode, uint16_t factor,
+                            uint8_t channelMask) {
+  end();
+  if (mode == DECIMATE_NONE) factor = 1;
+  if (sourceStreamId < 0 || sourceStreamId >= _numStreams || factor < 1 || mode > DECIMATE_MINMAX) {
+    return false;
+  }
+  const StreamConfig& stream = _streams[sourceStreamId];
+  if (!isEncodingSupportedInternal(stream.channels, stream.numChannels, STREAM_ENC_DELTA)) { // 16-bit integers only
+    ESP32WS_LOGE("Decimator Error: Stream '%s' has channels other than u16/i16.", stream.name);
+    return false;
+  }
+  channelMask &= (uint8_t)((1u << stream.numChannels) - 1);
+  uint16_t column = 0;
+  uint16_t selected = 0;
+  for (uint8_t ch = 0; ch < stream.numChannels; ch++) {
+    for (uint8_t k = 0; k < stream.channels[ch].count; k++, column++) {
+      if (!(channelMask & (1u << ch))) continue;
+      if (selected >= ESP32WS_DECIMATOR_MAX_COLUMNS) {
+        ESP32WS_LOGE("Decimator Error: At most %d values per sample.", ESP32WS_DECIMATOR_MAX_COLUMNS);
+        return false;
+      }
+      _columns[selected] = column;
+      _signed[selected++] = stream.channels[ch].type == STREAM_I16;
+    }
+  }
+  if (selected == 0) return false;
+  _numColumns = selected;
+  _channelMask = channelMask;
+  _outSampleSize = (size_t)_numColumns * 2 * (mode == DECIMATE_MINMAX ? 2 : 1);
+  if (factor == 1) {
+    _outSamplesPerFrame = stream.samplesPerFrame; // Frames map 1:1 to the source frames
+  } else {
+    uint64_t outPeriodUs = (uint64_t)stream.samplePeriodUs * factor;
+    uint64_t perFrame = ESP32WS_DECIMATOR_FRAME_INTERVAL_US / outPeriodUs;
+    _outSamplesPerFrame = perFrame < 1 ? 1 : (perFrame > stream.samplesPerFrame ? stream.samplesPerFrame : (uint16_t)perFrame);
+  }
+  _out = (uint8_t*)malloc(sizeof(StreamFrameHeader) + _outSamplesPerFrame * _outSampleSize);
+  if (!_out) return false;
+  _source = sourceStreamId;
+  _outId = outputStreamId;
+  _mode = mode;
+  _factor = factor;
+  _haveInput = false;
+  _outCount = 0;
+  _outSequence = 0;
+  resetBlock();
+  return true;
+}
+
+void StreamDecimator::end() {
+  free(_out);
+  _out = nullptr;
+  _source = -1;
+  _mode = DECIMATE_NONE;
+}
+
+void StreamDecimator::resetBlock() {
+  _blockCount = 0;
+  for (uint16_t c = 0; c < _numColumns; c++) {
+    _sum[c] = 0;
+    _min[c] = INT32_MAX;
+    _max[c] = INT32_MIN;
+  }
+}
+
+void StreamDecimator::flush(DecimatedFrameCallback emit, void* context) {
+  if (_outCount == 0) return;
+  writeStreamFrameHeader(_out, _outId, _outSequence++, _outCount, _outBaseUs);
+  emit(_out, sizeof(StreamFrameHeader) + (size_t)_outCount * _outSampleSize, context);
+  _outCount = 0;
+}
+
+void StreamDecimator::process(const uint8_t* rawFrame, DecimatedFrameCallback emit, void* context) {
+  if (!_out || !rawFrame) return;
+  StreamFrameHeader header;
+  memcpy(&header, rawFrame, sizeof(header));
+  const StreamConfig& stream = _streams[_source];
+  if (header.streamId != _source) return;
+  uint16_t sampleCount = header.sampleCount > stream.samplesPerFrame ? stream.samplesPerFrame : header.sampleCount;
+
+  // Input discontinuity: emit what we have and restart both the block and the output frame
+  if (_haveInput && header.baseTimeUs != _nextInputUs) {
+    flush(emit, context);
+    resetBlock();
+  }
+  if (header.sequence == 0) _outSequence = 0; // Source stream restarted
+  _haveInput = true;
+  _nextInputUs = header.baseTimeUs + (uint64_t)sampleCount * stream.samplePeriodUs;
+
+  const uint8_t* payload = rawFrame + sizeof(StreamFrameHeader);
+  for (uint16_t i = 0; i < sampleCount; i++) {
+    if (_blockCount == 0) {
+      _blockStartUs = header.baseTimeUs + (uint64_t)i * stream.samplePeriodUs;
+      if (_outCount == 0) _outBaseUs = _blockStartUs;
+    }
+    for (uint16_t c = 0; c < _numColumns; c++) {
+      uint16_t raw = streamRawValue16(payload, stream.sampleSize, i, _columns[c]);
+      int32_t value = _signed[c] ? (int32_t)(int16_t)raw : (int32_t)raw;
+      _sum[c] += value;
+      if (value < _min[c]) _min[c] = value;
+      if (value > _max[c]) _max[c] = value;
+    }
+    if (++_blockCount < _factor) continue;
+
+    // Block complete: append one output sample
+    uint8_t* sample = _out + sizeof(StreamFrameHeader) + (size_t)_outCount * _outSampleSize;
+    if (_mode != DECIMATE_MINMAX) {
+      for (uint16_t c = 0; c < _numColumns; c++) {
+        int64_t sum = _sum[c];
+        int64_t half = _factor / 2;
+        int32_t mean = (int32_t)(sum >= 0 ? (sum + half) / _factor : -((-sum + half) / _factor));
+        sample[c * 2] = (uint8_t)mean;
+        sample[c * 2 + 1] = (uint8_t)(mean >> 8);
+      }
+    } else {
+      // Per selected channel: its minima, then its maxima
+      size_t pos = 0;
+      uint16_t column = 0;
+      for (uint8_t ch = 0; ch < stream.numChannels; ch++) {
+        if (!(_channelMask & (1u << ch))) continue;
+        uint8_t count = stream.channels[ch].count;
+        for (uint8_t k = 0; k < count; k++, pos += 2) {
+          sample[pos] = (uint8_t)_min[column + k];
+          sample[pos + 1] = (uint8_t)(_min[column + k] >> 8);
+        }
+        for (uint8_t k = 0; k < count; k++, pos += 2) {
+          sample[pos] = (uint8_t)_max[column + k];
+          sample[pos + 1] = (uint8_t)(_max[column + k] >> 8);
+        }
+        column += count;
+      }
+    }
+    resetBlock();
+    if (++_outCount >= _outSamplesPerFrame) flush(emit, context);
+  }
+}
+
+void StreamDecimator::describe(JsonObject streamObj) const {
+  if (!_out) return;
+  const StreamConfig& stream = _streams[_source];
+  streamObj["id"] = _outId;
+  streamObj["name"] = stream.name;
+  streamObj["source"] = _source;
+  streamObj["decimation"] = _mode == DECIMATE_MINMAX ? "minmax" : (_mode == DECIMATE_AVERAGE ? "average" : "none");
+  streamObj["factor"] = _factor;
+  streamObj["periodUs"] = (uint32_t)(stream.samplePeriodUs * _factor);
+  streamObj["samplesPerFrame"] = _outSamplesPerFrame;
+  streamObj["headerBytes"] = sizeof(StreamFrameHeader);
+  streamObj["sampleBytes"] = _outSampleSize;
+  streamObj["encoding"] = "raw";
+  JsonArray channelsArray = streamObj.createNestedArray("channels");
+  for (uint8_t ch = 0; ch < stream.numChannels; ch++) {
+    if (!(_channelMask & (1u << ch))) continue;
+    const StreamChannel& channel = stream.channels[ch];
+    for (uint8_t part = 0; part < (_mode == DECIMATE_MINMAX ? 2 : 1); part++) {
+      JsonObject channelObj = channelsArray.createNestedObject();
+      if (_mode == DECIMATE_MINMAX) {
+        channelObj["name"] = String(channel.name) + (part == 0 ? "_min" : "_max");
+      } else {
+        channelObj["name"] = channel.name;
+      }
+      channelObj["type"] = streamValueTypeToCharString(channel.type);
+      channelObj["count"] = channel.count;
+      channelObj["scale"] = channel.scale;
+      channelObj["offset"] = channel.offset;
+      channelObj["unit"] = channel.unit ? channel.unit : "";
+    }
+  }
+}
+
+size_t StreamDecimator::schemaCapacity() const {
+  if (!_out) return 0;
+  size_t channels = _streams[_source].numChannels * (_mode == DECIMATE_MINMAX ? 2 : 1);
+  // Min/max channel names are copied into the document
+  return JSON_OBJECT_SIZE(11) + JSON_ARRAY_SIZE(channels) + channels * (JSON_OBJECT_SIZE(6) + 24);
+}
+
+void writeStreamFrameHeader(uint8_t* frame, uint8_t streamId, uint32_t sequence, uint16_t sampleCount,
+                            uint64_t baseTimeUs) {
+  StreamFrameHeader header;
+  header.type = ESP32WS_BIN_STREAM_FRAME;
+  header.streamId = streamId;
+  header.sampleCount = sampleCount;
+  header.sequence = sequence;
+  header.baseTimeUs = baseTimeUs;
+  memcpy(frame, &header, sizeof(header)); // Frame buffers carry no alignment guarantee
+}
+
+AsyncWebSocketMessageBuffer* getStreamSchemaMessage() {
+  return _streamSchemaBuffer;
+}
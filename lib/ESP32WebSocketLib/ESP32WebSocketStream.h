@@ -0,0 +1,315 @@
+/**
+ * @file ESP32WebSocketStream.h
+ * @brief Self-describing binary streams for the ESP32WebSocket library.
+ *        A stream declares its channels (type, count, scale) once; the library turns the
+ *        declarations into a "stream_schema" JSON message sent at start_stream, and every
+ *        binary chunk of the stream starts with a small StreamFrameHeader. Clients decode
+ *        the samples from the schema alone and detect lost chunks through sequence gaps.
+ */
+#ifndef ESP32_WEBSOCKET_STREAM_H
+#define ESP32_WEBSOCKET_STREAM_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <ArduinoJson.h>
+
+// --- Stream Limits ---
+
+/// Maximum number of registered streams (override with a build flag).
+#ifndef ESP32WS_MAX_STREAMS
+#define ESP32WS_MAX_STREAMS 4
+#endif
+/// Maximum number of channel declarations per stream.
+#ifndef ESP32WS_STREAM_MAX_CHANNELS
+#define ESP32WS_STREAM_MAX_CHANNELS 8
+#endif
+/// Maximum number of value columns (sum of the channel counts) a StreamDecimator can process.
+#ifndef ESP32WS_DECIMATOR_MAX_COLUMNS
+#define ESP32WS_DECIMATOR_MAX_COLUMNS 16
+#endif
+/// Target time covered by one decimated frame; sets the decimated frames' sample count.
+#ifndef ESP32WS_DECIMATOR_FRAME_INTERVAL_US
+#define ESP32WS_DECIMATOR_FRAME_INTERVAL_US 100000
+#endif
+
+// --- Stream Frame Format ---
+//
+// Every binary stream message (WS_BINARY, server -> client, little-endian):
+//   StreamFrameHeader (16 bytes) followed by sampleCount samples.
+//   A sample holds every channel in declaration order; a channel holds 'count' values of its type.
+//   Sample i was taken at baseTimeUs + i * periodUs (periodUs from the schema).
+// The first byte tells stream frames apart from binary command replies (ESP32WS_BIN_REPLY_MAGIC).
+// Bytes after the last sample (a chunk closed early) are padding and must be ignored.
+//
+// With an encoding other than STREAM_ENC_RAW (schema field "encoding"), the samples are replaced by
+// the encoded payload described at StreamEncoding; the header is unchanged.
+
+#define ESP32WS_BIN_STREAM_FRAME 0xD1
+
+/**
+ * @struct StreamFrameHeader
+ * @brief Header at the start of each binary stream chunk. 16 bytes, so samples start 8-byte aligned.
+ */
+struct __attribute__((packed)) StreamFrameHeader {
+  uint8_t type;          ///< Always ESP32WS_BIN_STREAM_FRAME.
+  uint8_t streamId;      ///< Id returned by registerStream().
+  uint16_t sampleCount;  ///< Number of valid samples following the header.
+  uint32_t sequence;     ///< Chunk counter since the stream started; a gap means lost chunks.
+  uint64_t baseTimeUs;   ///< Time of the first sample, in microseconds since the stream started.
+};
+static_assert(sizeof(StreamFrameHeader) == 16, "StreamFrameHeader must stay 16 bytes");
+
+/**
+ * @enum StreamValueType
+ * @brief Storage type of one channel value. Names in the schema: "u8", "i8", "u16", "i16", "u32", "i32", "f32".
+ */
+enum StreamValueType : uint8_t {
+  STREAM_U8 = 1,
+  STREAM_I8,
+  STREAM_U16,
+  STREAM_I16,
+  STREAM_U32,
+  STREAM_I32,
+  STREAM_F32
+};
+
+/**
+ * @enum StreamEncoding
+ * @brief Payload encoding of a stream's frames. Names in the schema: "raw", "pack12", "delta".
+ *        Bit fields are packed LSB-first into consecutive bytes.
+ *
+ *  - STREAM_ENC_RAW:    Samples as declared (little-endian).
+ *  - STREAM_ENC_PACK12: Every value as 12 bits, in raw order (requires u16 channels holding 12-bit
+ *                       values, e.g. ADC readings): 25% smaller than raw.
+ *  - STREAM_ENC_DELTA:  For each value column (one per channel value, in sample order):
+ *                       [first:u16][width:u8][sampleCount-1 zigzag deltas of 'width' bits], padded
+ *                       to a whole byte. Delta = value - previous value of the same column,
+ *                       zigzag = (d << 1) ^ (d >> 31). Requires u16/i16 channels; best for slowly
+ *                       varying signals.
+ */
+enum StreamEncoding : uint8_t {
+  STREAM_ENC_RAW = 0,
+  STREAM_ENC_PACK12,
+  STREAM_ENC_DELTA
+};
+
+/**
+ * @struct StreamChannel
+ * @brief Declares one channel (or a group of identical channels) of a stream.
+ *        Physical value = raw * scale + offset. Strings must remain valid while the stream exists.
+ */
+struct StreamChannel {
+  const char* name;      ///< Channel name shown by clients (a group is shown as name[0..count-1]).
+  StreamValueType type;  ///< Storage type of each value.
+  uint8_t count;         ///< Number of values of this channel in each sample.
+  float scale;           ///< Multiplier from raw to physical value.
+  float offset;          ///< Added after scaling.
+  const char* unit;      ///< Unit of the physical value (may be "").
+};
+
+/**
+ * @brief Registers a stream and rebuilds the cached "stream_schema" message.
+ *        Call during setup, before clients start streaming.
+ *
+ * @param name Stream name (must remain valid).
+ * @param channels Channel declarations, copied by the library (1..ESP32WS_STREAM_MAX_CHANNELS entries).
+ * @param numChannels Number of entries in channels.
+ * @param samplePeriodUs Nominal time between two samples, in microseconds.
+ * @param samplesPerFrame Maximum number of samples per binary chunk.
+ * @param encoding (Optional) Payload encoding announced in the schema. Frames are still produced raw
+ *                 and converted with encodeStreamFrame() before sending.
+ * @return The stream id (0..ESP32WS_MAX_STREAMS-1), or -1 on invalid arguments, an encoding the
+ *         channel types don't support, or a full registry.
+ */
+int registerStream(const char* name, const StreamChannel* channels, uint8_t numChannels,
+                   uint32_t samplePeriodUs, uint16_t samplesPerFrame,
+                   StreamEncoding encoding = STREAM_ENC_RAW);
+
+/**
+ * @brief Returns the number of registered streams (ids are 0..count-1).
+ */
+uint8_t getStreamCount();
+
+/**
+ * @brief Returns the number of channels (StreamChannel entries) of a stream, or 0 if unknown.
+ */
+uint8_t getStreamChannelCount(int streamId);
+
+/**
+ * @brief Looks up a channel of a stream by name.
+ * @return The channel index, or -1 if the stream or channel is unknown.
+ */
+int findStreamChannel(int streamId, const char* channelName);
+
+/**
+ * @brief Returns the name a stream was registered with, or nullptr if unknown.
+ */
+const char* getStreamName(int streamId);
+
+/**
+ * @brief Returns the sample period of a stream in microseconds, or 0 if unknown.
+ */
+uint32_t getStreamPeriodUs(int streamId);
+
+/**
+ * @brief Returns the encoding a stream was registered with (STREAM_ENC_RAW if unknown).
+ */
+StreamEncoding getStreamEncoding(int streamId);
+
+/**
+ * @brief Returns the size in bytes of one sample of a stream (sum of the channel sizes), or 0 if unknown.
+ */
+size_t getStreamSampleSize(int streamId);
+
+/**
+ * @brief Returns the size in bytes of a full chunk of a stream (header + samplesPerFrame samples), or 0 if unknown.
+ */
+size_t getStreamFrameSize(int streamId);
+
+/**
+ * @brief Returns the buffer size needed by encodeStreamFrame() for a full chunk of a stream
+ *        (the delta encoding can exceed the raw size on noisy data), or 0 if unknown.
+ */
+size_t getStreamEncodedFrameCapacity(int streamId);
+
+/**
+ * @brief Converts a raw frame (header + sampleCount raw samples) into the stream's encoding.
+ * @param streamId Stream id returned by registerStream().
+ * @param rawFrame Raw frame; its header supplies the sample count.
+ * @param out Destination of at least getStreamEncodedFrameCapacity() bytes (must not overlap rawFrame).
+ * @return Length of the encoded frame (header included), or 0 if the stream is unknown.
+ */
+size_t encodeStreamFrame(int streamId, const uint8_t* rawFrame, uint8_t* out);
+
+/**
+ * @brief Writes a StreamFrameHeader at the start of a chunk buffer.
+ * @param frame Chunk buffer (at least sizeof(StreamFrameHeader) bytes; no alignment required).
+ * @param streamId Stream id returned by registerStream().
+ * @param sequence Chunk counter since the stream started.
+ * @param sampleCount Number of valid samples written after the header.
+ * @param baseTimeUs Time of the first sample since the stream started.
+ */
+void writeStreamFrameHeader(uint8_t* frame, uint8_t streamId, uint32_t sequence, uint16_t sampleCount,
+                            uint64_t baseTimeUs);
+
+// --- Decimation ---
+
+/**
+ * @enum DecimationMode
+ * @brief Reduction applied to each block of 'factor' input samples. Names: "none", "average", "minmax".
+ *  - DECIMATE_NONE:    Samples are copied unchanged (factor 1); only the channel selection applies.
+ *  - DECIMATE_AVERAGE: One sample with the rounded mean of each value (boxcar / first-order CIC).
+ *  - DECIMATE_MINMAX:  One sample holding, for each channel, its minimum values followed by its
+ *                      maximum values (schema channels "<name>_min" and "<name>_max"): an envelope
+ *                      that keeps spikes visible at display rates.
+ */
+enum DecimationMode : uint8_t {
+  DECIMATE_NONE = 0,
+  DECIMATE_AVERAGE,
+  DECIMATE_MINMAX
+};
+
+/**
+ * @typedef DecimatedFrameCallback
+ * @brief Receives each completed decimated frame (header + raw samples). Valid during the call only.
+ */
+typedef void (*DecimatedFrameCallback)(const uint8_t* frame, size_t len, void* context);
+
+/**
+ * @class StreamDecimator
+ * @brief Turns the raw frames of a source stream (u16/i16 channels) into a lower-rate stream
+ *        and/or one carrying a subset of its channels.
+ *        Output frames use the standard StreamFrameHeader with their own stream id and sequence;
+ *        their layout is described by describe(). A gap in the input timeline (missed samples,
+ *        dropped or restarted chunks) closes the current output frame so output timestamps
+ *        stay exact.
+ */
+class StreamDecimator {
+public:
+  StreamDecimator() = default;
+  ~StreamDecimator() { end(); }
+  StreamDecimator(const StreamDecimator&) = delete;
+  StreamDecimator& operator=(const StreamDecimator&) = delete;
+
+  /**
+   * @brief Allocates the output frame and configures the reduction.
+   * @param sourceStreamId Registered stream whose raw frames will be fed to process().
+   * @param outputStreamId Stream id written into the output frame headers.
+   * @param mode Reduction; DECIMATE_NONE forces the factor to 1.
+   * @param factor Input samples per output sample (>= 1).
+   * @param channelMask Bit c selects channel c of the source stream (default: all channels).
+   * @return False on unknown/unsupported source stream, invalid arguments or allocation failure.
+   */
+  bool begin(int sourceStreamId, uint8_t outputStreamId, DecimationMode mode, uint16_t factor,
+             uint8_t channelMask = 0xFF);
+  /// Frees the output frame; the decimator becomes inactive.
+  void end();
+  bool active() const { return _out != nullptr; }
+  bool matches(int sourceStreamId, DecimationMode mode, uint16_t factor, uint8_t channelMask) const {
+    return active() && _source == sourceStreamId && _mode == mode && _factor == factor && _channelMask == channelMask;
+  }
+
+  /**
+   * @brief Feeds one raw frame of the source stream; calls emit for every completed output frame.
+   */
+  void process(const uint8_t* rawFrame, DecimatedFrameCallback emit, void* context);
+
+  /**
+   * @brief Fills a "streams" entry of a stream_schema message describing the output frames.
+   */
+  void describe(JsonObject streamObj) const;
+  /// JSON document capacity used by describe().
+  size_t schemaCapacity() const;
+
+  int sourceStreamId() const { return _source; }
+  uint8_t outputStreamId() const { return _outId; }
+
+private:
+  void flush(DecimatedFrameCallback emit, void* context);
+  void resetBlock();
+
+  int _source = -1;
+  uint8_t _outId = 0;
+  DecimationMode _mode = DECIMATE_NONE;
+  uint16_t _factor = 0;
+  uint8_t _channelMask = 0;       // Selected source channels (bits beyond numChannels cleared)
+  uint16_t _numColumns = 0;       // Selected columns, in source order
+  uint16_t _columns[ESP32WS_DECIMATOR_MAX_COLUMNS]; // Source column of each selected column
+  bool _signed[ESP32WS_DECIMATOR_MAX_COLUMNS];
+  int64_t _sum[ESP32WS_DECIMATOR_MAX_COLUMNS]; // Up to 65535 x 65535: beyond int32_t
+  int32_t _min[ESP32WS_DECIMATOR_MAX_COLUMNS];
+  int32_t _max[ESP32WS_DECIMATOR_MAX_COLUMNS];
+  uint16_t _blockCount = 0;       // Input samples accumulated in the current block
+  uint64_t _blockStartUs = 0;     // Time of the first input sample of the current block
+  uint64_t _nextInputUs = 0;      // Expected time of the next input sample (gap detection)
+  bool _haveInput = false;
+  uint8_t* _out = nullptr;        // Output frame: header + _outSamplesPerFrame samples
+  size_t _outSampleSize = 0;
+  uint16_t _outSamplesPerFrame = 0;
+  uint16_t _outCount = 0;
+  uint32_t _outSequence = 0;
+  uint64_t _outBaseUs = 0;
+};
+
+/**
+ * @brief Appends one "streams" entry per registered stream (the content of the stream_schema message).
+ *        Used to build per-client schemas that add decimated streams (see StreamDecimator::describe).
+ */
+void describeStreams(JsonArray streamsArray);
+
+/**
+ * @brief JSON document capacity needed for a stream_schema message of all registered streams.
+ *        Add StreamDecimator::schemaCapacity() for each derived stream appended to it.
+ */
+size_t getStreamSchemaCapacity();
+
+/**
+ * @brief Returns the cached, serialized "stream_schema" message describing every registered stream,
+ *        or nullptr if no stream is registered. Queued by reference by the server; never modify it.
+ *
+ * Format: {"status":"stream_schema","streams":[{"id","name","periodUs","samplesPerFrame","headerBytes",
+ *          "sampleBytes","encoding","channels":[{"name","type","count","scale","offset","unit"},...]},...]}
+ */
+AsyncWebSocketMessageBuffer* getStreamSchemaMessage();
+
+#endif // ESP32_WEBSOCKET_STREAM_H
@@ -0,0 +1,407 @@
+/**
+ * @file ESP32WebSocketVarStore.cpp
+ * @brief Seqlock, atomic numeric values and double-buffered strings behind ESP32WebSocketVarStore.h.
+ */
+#include "ESP32WebSocketVarStore.h"
+#include "ESP32WebSocketPersist.h"
+#include "ESP32WebSocketLog.h"
+#include <math.h>
+
+// The library finds a FixedString's buffers right behind its header, whatever its capacity
+static_assert(offsetof(FixedString<2>, buf) == sizeof(WsStringHeader), "FixedString buffers must follow the header");
+
+// --- Store State ---
+
+static const WsVarDesc* _storeVariables = nullptr;
+static int _storeCount = 0;
+
+// Snapshot sequence: odd while a commit is in progress. Writers are serialized by _storeMux, which
+// also keeps the odd window non-preemptible, so a spinning reader always sees it end promptly.
+static uint32_t _storeSeq = 0;
+static portMUX_TYPE _storeMux = portMUX_INITIALIZER_UNLOCKED;
+
+static VariableChangeCallback _changeCallback = nullptr;
+static void* _changeContext = nullptr;
+
+
+// --- Store-Internal Helpers ---
+
+/**
+ * @brief Returns the variable behind a handle, or nullptr if the handle is invalid for the store.
+ */
+static const WsVarDesc* variableForInternal(VariableHandle handle) {
+  if (!_storeVariables || !handle.isValid() || handle.index >= _storeCount) return nullptr;
+  return &_storeVariables[handle.index];
+}
+
+/**
+ * @brief True for a numeric variable holding more than one element.
+ */
+static bool isArrayInternal(const WsVarDesc& var) {
+  return var.type != TYPE_STRING && var.count > 1;
+}
+
+/**
+ * @brief Atomically loads element i of a numeric value of the given type as its 32-bit pattern.
+ */
+static uint32_t loadElementInternal(VarType type, const void* base, uint16_t i) {
+  switch (type) {
+    case TYPE_INT:  return (uint32_t)__atomic_load_n(&((const int*)base)[i], __ATOMIC_RELAXED);
+    case TYPE_UINT: return __atomic_load_n(&((const uint32_t*)base)[i], __ATOMIC_RELAXED);
+    case TYPE_BOOL: return __atomic_load_n(&((const bool*)base)[i], __ATOMIC_RELAXED) ? 1 : 0;
+    case TYPE_FLOAT: {
+      float v;
+      __atomic_load(&((const float*)base)[i], &v, __ATOMIC_RELAXED);
+      uint32_t bits;
+      memcpy(&bits, &v, sizeof(bits));
+      return bits;
+    }
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Atomically stores a 32-bit pattern (see convertVariableNumber()) into element i.
+ */
+static void storeElementInternal(VarType type, void* base, uint16_t i, uint32_t bits) {
+  switch (type) {
+    case TYPE_INT:  __atomic_store_n(&((int*)base)[i], (int)bits, __ATOMIC_RELAXED); break;
+    case TYPE_UINT: __atomic_store_n(&((uint32_t*)base)[i], bits, __ATOMIC_RELAXED); break;
+    case TYPE_BOOL: __atomic_store_n(&((bool*)base)[i], bits != 0, __ATOMIC_RELAXED); break;
+    case TYPE_FLOAT: {
+      float v;
+      memcpy(&v, &bits, sizeof(v));
+      __atomic_store(&((float*)base)[i], &v, __ATOMIC_RELAXED);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Converts the bits of a numeric element to double, for the converting getters.
+ */
+static double elementToDoubleInternal(VarType type, uint32_t bits) {
+  switch (type) {
+    case TYPE_INT:  return (double)(int32_t)bits;
+    case TYPE_UINT: return (double)bits;
+    case TYPE_BOOL: return bits ? 1.0 : 0.0;
+    case TYPE_FLOAT: {
+      float v;
+      memcpy(&v, &bits, sizeof(v));
+      return (double)v;
+    }
+    default:
+      return 0.0;
+  }
+}
+
+/**
+ * @brief Copies src into the inactive buffer of a FixedString and publishes it. Caller holds _storeMux.
+ *        A reader that began at done = d copied a stable buffer as long as started < d + 2 afterwards.
+ */
+static void writeFixedStringInternal(const WsVarDesc& var, const char* src) {
+  WsStringHeader* header = (WsStringHeader*)var.value;
+  uint32_t next = header->done + 1;
+  __atomic_store_n(&header->started, next, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST); // started is visible before the buffer changes
+  char* dst = (char*)var.value + sizeof(WsStringHeader) + (next & 1) * var.count;
+  strncpy(dst, src ? src : "", var.count - 1);
+  dst[var.count - 1] = '\0';
+  __atomic_store_n(&header->done, next, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Stores one staged value; the caller brackets this with the snapshot sequence.
+ */
+static void commitOneInternal(const StagedValue& value) {
+  const WsVarDesc& var = _storeVariables[value.index];
+  if (var.type == TYPE_STRING) {
+    writeFixedStringInternal(var, (const char*)value.data);
+  } else if (isArrayInternal(var)) {
+    for (uint16_t i = 0; i < var.count; i++) {
+      storeElementInternal(var.type, var.value, i, loadElementInternal(var.type, value.data, i));
+    }
+  } else {
+    storeElementInternal(var.type, var.value, 0, value.bits);
+  }
+}
+
+/**
+ * @brief Commits one application-side value and queues it for the clients.
+ */
+static bool commitFromAppInternal(VariableHandle handle, const StagedValue& value) {
+  commitVariableValues(&value, 1);
+  markVariableChanged(handle);
+  return true;
+}
+
+/**
+ * @brief Converts and commits a number set by the application into a numeric scalar.
+ */
+static bool setScalarInternal(VariableHandle handle, double value) {
+  const WsVarDesc* var = variableForInternal(handle);
+  if (!var || isArrayInternal(*var)) return false;
+  StagedValue staged = {handle.index, 0, nullptr};
+  if (convertVariableNumber(handle.index, value, &staged.bits) != BIN_STATUS_OK) return false;
+  return commitFromAppInternal(handle, staged);
+}
+
+/**
+ * @brief Reads a numeric scalar as double (0 for an invalid handle, a string or an array).
+ */
+static double getScalarInternal(VariableHandle handle) {
+  const WsVarDesc* var = variableForInternal(handle);
+  if (!var || var->type == TYPE_STRING || var->count != 1) return 0.0;
+  return elementToDoubleInternal(var->type, loadElementInternal(var->type, var->value, 0));
+}
+
+
+// --- Library-Internal Interface ---
+
+bool initVariableStore(const WsVarDesc* variables, int count) {
+  bool ok = true;
+  for (int i = 0; variables && i < count; i++) {
+    if (!variables[i].value || variables[i].count == 0) {
+      ESP32WS_LOGE("Variable store: '%s' has no value bound.", variables[i].name);
+      ok = false;
+    }
+  }
+
+  portENTER_CRITICAL(&_storeMux);
+  _storeVariables = ok && count > 0 ? variables : nullptr;
+  _storeCount = ok && variables ? count : 0;
+  portEXIT_CRITICAL(&_storeMux);
+  return ok;
+}
+
+uint8_t convertVariableNumber(int index, double value, uint32_t* bits) {
+  if (!_storeVariables || index < 0 || index >= _storeCount) return BIN_STATUS_UNKNOWN_VARIABLE;
+  const WsVarDesc& var = _storeVariables[index];
+  if (var.type == TYPE_STRING) return BIN_STATUS_TYPE_MISMATCH;
+  if (var.type != TYPE_FLOAT && value != floor(value)) return BIN_STATUS_TYPE_MISMATCH; // Also NaN
+  if (var.hasLimits && !(value >= var.minVal && value <= var.maxVal)) return BIN_STATUS_OUT_OF_LIMITS;
+
+  switch (var.type) {
+    case TYPE_INT:
+      if (value < (double)INT32_MIN || value > (double)INT32_MAX) return BIN_STATUS_OUT_OF_LIMITS;
+      *bits = (uint32_t)(int32_t)value;
+      break;
+    case TYPE_UINT:
+      if (value < 0.0 || value > (double)UINT32_MAX) return BIN_STATUS_OUT_OF_LIMITS;
+      *bits = (uint32_t)value;
+      break;
+    case TYPE_BOOL:
+      if (value != 0.0 && value != 1.0) return BIN_STATUS_TYPE_MISMATCH;
+      *bits = value != 0.0 ? 1 : 0;
+      break;
+    default: {
+      float v = (float)value;
+      memcpy(bits, &v, sizeof(*bits));
+      break;
+    }
+  }
+  return BIN_STATUS_OK;
+}
+
+void stageVariableElement(int index, void* staging, uint16_t element, uint32_t bits) {
+  if (!_storeVariables || index < 0 || index >= _storeCount) return;
+  storeElementInternal(_storeVariables[index].type, staging, element, bits);
+}
+
+size_t variableValueBytes(int index) {
+  if (!_storeVariables || index < 0 || index >= _storeCount) return 0;
+  const WsVarDesc& var = _storeVariables[index];
+  switch (var.type) {
+    case TYPE_STRING: return var.count;
+    case TYPE_BOOL:   return var.count * sizeof(bool);
+    default:          return var.count * sizeof(uint32_t);
+  }
+}
+
+void commitVariableValues(const StagedValue* values, uint8_t count) {
+  if (!_storeVariables || !values || count == 0) return;
+  bool persistent = false;
+  portENTER_CRITICAL(&_storeMux);
+  __atomic_store_n(&_storeSeq, _storeSeq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  for (uint8_t i = 0; i < count; i++) {
+    if (values[i].index < 0 || values[i].index >= _storeCount) continue;
+    commitOneInternal(values[i]);
+    persistent |= _storeVariables[values[i].index].persist;
+  }
+  __atomic_store_n(&_storeSeq, _storeSeq + 1, __ATOMIC_RELEASE);
+  portEXIT_CRITICAL(&_storeMux);
+  if (persistent) notePersistentVariableChanged();
+}
+
+bool restoreVariableValue(int index, const void* data, size_t len) {
+  if (!_storeVariables || index < 0 || index >= _storeCount || !data) return false;
+  const WsVarDesc& var = _storeVariables[index];
+  StagedValue staged = {(int16_t)index, 0, data};
+  char text[ESP32WS_STRING_CAPACITY_MAX];
+  if (var.type == TYPE_STRING) {
+    if (len >= var.count) return false;
+    memcpy(text, data, len);
+    text[len] = '\0';
+    staged.data = text;
+  } else {
+    if (len != variableValueBytes(index)) return false;
+    for (uint16_t i = 0; i < var.count; i++) {
+      uint32_t bits;
+      double v = elementToDoubleInternal(var.type, loadElementInternal(var.type, data, i));
+      if (convertVariableNumber(index, v, &bits) != BIN_STATUS_OK) return false;
+    }
+    staged.bits = loadElementInternal(var.type, data, 0);
+  }
+  commitVariableValues(&staged, 1);
+  return true;
+}
+
+void notifyVariableChanged(int index) {
+  VariableChangeCallback callback = _changeCallback;
+  if (callback && index >= 0 && index < _storeCount) {
+    VariableHandle handle;
+    handle.index = (int16_t)index;
+    callback(handle, _changeContext);
+  }
+}
+
+size_t readVariableString(int index, char* out, size_t outSize) {
+  if (!out || outSize == 0) return 0;
+  out[0] = '\0';
+  if (!_storeVariables || index < 0 || index >= _storeCount) return 0;
+  const WsVarDesc& var = _storeVariables[index];
+  if (var.type != TYPE_STRING) return 0;
+  return readFixedString((const WsStringHeader*)var.value, var.count, out, outSize);
+}
+
+size_t readFixedString(const WsStringHeader* header, size_t capacity, char* out, size_t outSize) {
+  if (!out || outSize == 0) return 0;
+  out[0] = '\0';
+  if (!header) return 0;
+  const char* buffers = (const char*)header + sizeof(WsStringHeader);
+  size_t limit = outSize < capacity ? outSize : capacity;
+  for (;;) {
+    uint32_t done = __atomic_load_n(&header->done, __ATOMIC_ACQUIRE);
+    const char* src = buffers + (done & 1) * capacity;
+    size_t n = 0;
+    while (n < limit - 1 && src[n]) {
+      out[n] = src[n];
+      n++;
+    }
+    out[n] = '\0';
+    __atomic_thread_fence(__ATOMIC_ACQUIRE); // The copy completes before started is checked
+    if (__atomic_load_n(&header->started, __ATOMIC_RELAXED) - done < 2) return n;
+  }
+}
+
+
+// --- Reading ---
+
+int getVariableInt(VariableHandle handle) {
+  double v = getScalarInternal(handle);
+  if (v <= (double)INT32_MIN) return INT32_MIN;
+  if (v >= (double)INT32_MAX) return INT32_MAX;
+  return (int)v;
+}
+
+uint32_t getVariableUInt(VariableHandle handle) {
+  double v = getScalarInternal(handle);
+  if (v <= 0.0) return 0;
+  if (v >= (double)UINT32_MAX) return UINT32_MAX;
+  return (uint32_t)v;
+}
+
+float getVariableFloat(VariableHandle handle) {
+  return (float)getScalarInternal(handle);
+}
+
+bool getVariableBool(VariableHandle handle) {
+  return getScalarInternal(handle) != 0.0;
+}
+
+size_t getVariableString(VariableHandle handle, char* out, size_t outSize) {
+  const WsVarDesc* var = variableForInternal(handle);
+  if (!var || var->type != TYPE_STRING) {
+    if (out && outSize > 0) out[0] = '\0';
+    return 0;
+  }
+  return readVariableString(handle.index, out, outSize);
+}
+
+size_t getVariableArray(VariableHandle handle, void* out, size_t maxCount) {
+  const WsVarDesc* var = variableForInternal(handle);
+  if (!var || var->type == TYPE_STRING || !out) return 0;
+  size_t n = var->count < maxCount ? var->count : maxCount;
+  uint32_t token;
+  do {
+    token = beginVariableSnapshot();
+    for (size_t i = 0; i < n; i++) {
+      storeElementInternal(var->type, out, (uint16_t)i, loadElementInternal(var->type, var->value, (uint16_t)i));
+    }
+  } while (retryVariableSnapshot(token));
+  return n;
+}
+
+uint32_t beginVariableSnapshot() {
+  uint32_t seq;
+  while ((seq = __atomic_load_n(&_storeSeq, __ATOMIC_ACQUIRE)) & 1) {
+    // A commit is running on the other core; it is a few stores long
+  }
+  return seq;
+}
+
+bool retryVariableSnapshot(uint32_t token) {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE); // The value reads complete before the sequence is checked
+  return __atomic_load_n(&_storeSeq, __ATOMIC_RELAXED) != token;
+}
+
+
+// --- Writing from the Application ---
+
+bool setVariableInt(VariableHandle handle, int value) {
+  return setScalarInternal(handle, (double)value);
+}
+
+bool setVariableUInt(VariableHandle handle, uint32_t value) {
+  return setScalarInternal(handle, (double)value);
+}
+
+bool setVariableFloat(VariableHandle handle, float value) {
+  return setScalarInternal(handle, (double)value);
+}
+
+bool setVariableBool(VariableHandle handle, bool value) {
+  return setScalarInternal(handle, value ? 1.0 : 0.0);
+}
+
+bool setVariableString(VariableHandle handle, const char* value) {
+  const WsVarDesc* var = variableForInternal(handle);
+  if (!var || var->type != TYPE_STRING || !value || strlen(value) >= var->count) return false;
+  StagedValue staged = {handle.index, 0, value};
+  return commitFromAppInternal(handle, staged);
+}
+
+bool setVariableArray(VariableHandle handle, const void* values, uint16_t count) {
+  const WsVarDesc* var = variableForInternal(handle);
+  if (!var || var->type == TYPE_STRING || !values || count != var->count) return false;
+  for (uint16_t i = 0; i < count; i++) {
+    uint32_t bits;
+    double v = elementToDoubleInternal(var->type, loadElementInternal(var->type, values, i));
+    if (convertVariableNumber(handle.index, v, &bits) != BIN_STATUS_OK) return false;
+  }
+  StagedValue staged = {handle.index, 0, values};
+  if (count == 1) staged.bits = loadElementInternal(var->type, values, 0);
+  return commitFromAppInternal(handle, staged);
+}
+
+
+// --- Change Notification ---
+
+void setVariableChangeCallback(VariableChangeCallback callback, void* context) {
+  _changeContext = context;
+  _changeCallback = callback;
+}
@@ -0,0 +1,167 @@
+/**
+ * @file ESP32WebSocketVarStore.h
+ * @brief Concurrent access to the application variables of the ESP32WebSocket library.
+ *        Client sets are applied on the AsyncTCP task, straight into the variables bound in the
+ *        application's WsVarDesc table (ESP32WebSocketVars.h), while loop(), the sampler or any
+ *        other task reads them. Numeric values are single atomic stores, FixedStrings are
+ *        double-buffered, and a sequence counter (seqlock) lets a reader take a consistent
+ *        snapshot of several variables, or of all elements of an array, without a lock:
+ *
+ *          uint32_t token;
+ *          do {
+ *            token = beginVariableSnapshot();
+ *            gain = wsRead(channelGain[2]);
+ *            offset = wsRead(channelOffset);
+ *          } while (retryVariableSnapshot(token));
+ *
+ *        Writes are short non-preemptible sections, so a reader never spins on a writer that was
+ *        descheduled (even at a higher priority on the same core). Readers never block.
+ *        The handle-based getters below serve code that addresses variables by name (see
+ *        getVariableHandle()); code that owns the variable reads it directly with wsRead().
+ */
+#ifndef ESP32_WEBSOCKET_VAR_STORE_H
+#define ESP32_WEBSOCKET_VAR_STORE_H
+
+#include <Arduino.h>
+#include "ESP32WebSocket.h"
+
+// --- Reading (any task or core) ---
+
+/**
+ * @brief Return the value of a numeric scalar variable converted to the requested type
+ *        (0 or false for an invalid handle, a string or an array; negative values read as 0 unsigned).
+ */
+int getVariableInt(VariableHandle handle);
+uint32_t getVariableUInt(VariableHandle handle);
+float getVariableFloat(VariableHandle handle);
+bool getVariableBool(VariableHandle handle);
+
+/**
+ * @brief Copies the value of a TYPE_STRING variable into out (always terminated, truncated to outSize).
+ * @return Length of the copied string; 0 for an invalid handle or another type.
+ */
+size_t getVariableString(VariableHandle handle, char* out, size_t outSize);
+
+/**
+ * @brief Copies a consistent snapshot of a numeric variable's elements into out, which holds
+ *        maxCount elements of the variable's own type (a scalar counts as one element).
+ * @return Number of elements copied; 0 for an invalid handle or a string.
+ */
+size_t getVariableArray(VariableHandle handle, void* out, size_t maxCount);
+
+/**
+ * @brief Starts a consistent read of several variables (see the file comment).
+ * @return Token for retryVariableSnapshot().
+ */
+uint32_t beginVariableSnapshot();
+
+/**
+ * @brief Ends a snapshot read.
+ * @return True if a write happened since beginVariableSnapshot(): read the values again.
+ */
+bool retryVariableSnapshot(uint32_t token);
+
+// --- Writing from the Application ---
+
+/**
+ * @brief Sets a variable from application code: checked like a client set (type and limits),
+ *        stored, and marked changed so the next flushVariableUpdates() sends it to the clients.
+ *        The change callback is not called (it reports client sets). Numeric setters accept any
+ *        numeric scalar variable the value converts to exactly (e.g. 3.0f into an int, 1 into a bool).
+ *        Always use these, not plain assignments, for variables clients may also set.
+ * @return False for an invalid handle, a type mismatch, a value outside the limits or a string
+ *         that does not fit the FixedString.
+ */
+bool setVariableInt(VariableHandle handle, int value);
+bool setVariableUInt(VariableHandle handle, uint32_t value);
+bool setVariableFloat(VariableHandle handle, float value);
+bool setVariableBool(VariableHandle handle, bool value);
+bool setVariableString(VariableHandle handle, const char* value);
+
+/**
+ * @brief Sets all elements of an array variable at once (readers see the old or the new array).
+ * @param values 'count' elements of the variable's own type; count must equal the array length.
+ */
+bool setVariableArray(VariableHandle handle, const void* values, uint16_t count);
+
+// --- Change Notification ---
+
+/**
+ * @typedef VariableChangeCallback
+ * @brief Called after a client changed a variable ("set", "set_many" or a binary set), once per
+ *        variable. Runs on the AsyncTCP task: keep it short and do not block. Do not broadcast from
+ *        it either; mark the variable with markVariableChanged() and call flushVariableUpdates()
+ *        (ESP32WebSocket.h) from the application's loop instead.
+ */
+typedef void (*VariableChangeCallback)(VariableHandle handle, void* context);
+
+/**
+ * @brief Registers the callback notified of client sets (nullptr disables it).
+ *        Call it before initWiFiWebSocketServer(), or while no client is connected.
+ */
+void setVariableChangeCallback(VariableChangeCallback callback, void* context = nullptr);
+
+// --- Library-Internal Interface (used by ESP32WebSocket.cpp) ---
+
+/**
+ * @struct StagedValue
+ * @brief A checked, converted value waiting to be committed to variable 'index'.
+ *        A numeric scalar travels in 'bits' (int32, uint32, float bits or 0/1, see
+ *        convertVariableNumber()); a string or array in 'data' (a terminated string, or the
+ *        elements in the variable's own type), which must stay valid until the commit.
+ */
+struct StagedValue {
+  int16_t index;
+  uint32_t bits;
+  const void* data;
+};
+
+/**
+ * @brief Takes over the application's variable table (kept by pointer, values used in place).
+ * @return False if the table is malformed (an entry without a value or a zero count).
+ */
+bool initVariableStore(const WsVarDesc* variables, int count);
+
+/**
+ * @brief Checks a number for a numeric variable (type, integral-ness, range and limits) and
+ *        converts it to the bits of one element of that variable.
+ * @return BIN_STATUS_OK, BIN_STATUS_TYPE_MISMATCH (a string variable, a fraction for an integer
+ *         type, a bool other than 0/1) or BIN_STATUS_OUT_OF_LIMITS.
+ */
+uint8_t convertVariableNumber(int index, double value, uint32_t* bits);
+
+/**
+ * @brief Writes element 'element' of an array staged for variable 'index' (bits from
+ *        convertVariableNumber()) into a buffer of variableValueBytes(index) bytes.
+ */
+void stageVariableElement(int index, void* staging, uint16_t element, uint32_t bits);
+
+/**
+ * @brief Size of a variable's value in bytes: elements times element size, or the FixedString capacity.
+ */
+size_t variableValueBytes(int index);
+
+/**
+ * @brief Checks a stored value (the variable's elements as raw bytes, or a string of len characters
+ *        without terminator) against the variable's current type, size and limits, and commits it.
+ *        Clients are not told; used to restore persisted values before the server starts.
+ * @return False if the value no longer fits the variable (it keeps its value).
+ */
+bool restoreVariableValue(int index, const void* data, size_t len);
+
+/**
+ * @brief Stores already-checked values in one snapshot section: a reader sees all of them or none.
+ */
+void commitVariableValues(const StagedValue* values, uint8_t count);
+
+/**
+ * @brief Reports a client set to the change callback.
+ */
+void notifyVariableChanged(int index);
+
+/**
+ * @brief Index-based getVariableString() for the library's own readers.
+ */
+size_t readVariableString(int index, char* out, size_t outSize);
+
+#endif // ESP32_WEBSOCKET_VAR_STORE_H
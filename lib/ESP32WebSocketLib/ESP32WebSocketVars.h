@@ -0,0 +1,165 @@
+/**
+ * @file ESP32WebSocketVars.h
+ * @brief Compile-time variable registry of the ESP32WebSocket library.
+ *        The application keeps its variables as ordinary typed globals and describes them in a
+ *        constant table, which the compiler places in flash:
+ *
+ *          int ledIntensity = 128;
+ *          float channelGain[6] = {1, 1, 1, 1, 1, 1};
+ *          FixedString<16> deviceLabel("ESP32-01");
+ *
+ *          const WsVarDesc appVariables[] = {
+ *            WsVar<int>("led_intensity", ledIntensity, 0, 255),
+ *            WsVar<float[6]>("channel_gain", channelGain, 0.0, 10.0).persistent(),
+ *            WsVar<FixedString<16>>("device_label", deviceLabel),
+ *          };
+ *
+ *        WsVar<T> only binds a variable of exactly type T, so an entry cannot disagree with the
+ *        variable it describes. Supported: int, uint32_t, float, bool, fixed-size arrays of those,
+ *        and FixedString<N>. A table entry costs no RAM: the values are the application's variables.
+ *        Clients change them from the AsyncTCP task, so read scalars with wsRead() (one atomic load,
+ *        no lookup), several values or an array inside a snapshot (ESP32WebSocketVarStore.h), and
+ *        strings with FixedString::read(). Write them through the setters of ESP32WebSocketVarStore.h.
+ *        Entries marked persistent() keep their last value across reboots (ESP32WebSocketPersist.h).
+ */
+#ifndef ESP32_WEBSOCKET_VARS_H
+#define ESP32_WEBSOCKET_VARS_H
+
+#include <Arduino.h>
+#include <stddef.h>
+
+// --- Supported Variable Types ---
+
+/**
+ * @enum VarType
+ * @brief Defines the supported data types for variables managed via WebSocket.
+ */
+enum VarType {
+  TYPE_INT,    ///< int (32-bit)
+  TYPE_FLOAT,  ///< float (32-bit)
+  TYPE_STRING, ///< FixedString<N>
+  TYPE_BOOL,   ///< bool ("true"/"false" in JSON, 0/1 in binary commands)
+  TYPE_UINT    ///< uint32_t
+};
+
+/// Longest array a WsVar may bind.
+#ifndef ESP32WS_MAX_ARRAY_LENGTH
+#define ESP32WS_MAX_ARRAY_LENGTH 1024
+#endif
+
+/// Staging space for the array values of one "set" or "set_many" (a static buffer of the library):
+/// values that do not fit together are committed in several snapshots.
+#ifndef ESP32WS_ARRAY_STAGING_BYTES
+#define ESP32WS_ARRAY_STAGING_BYTES (ESP32WS_MAX_ARRAY_LENGTH * 4)
+#endif
+
+/// Largest FixedString capacity in bytes, terminator included.
+#define ESP32WS_STRING_CAPACITY_MAX 256
+
+// --- Fixed-Capacity Strings ---
+
+/**
+ * @struct WsStringHeader
+ * @brief Publication counters of a FixedString. Write k fills buffer k & 1 and then publishes
+ *        done = k, so readers copy buffer done & 1 while the next write uses the other one;
+ *        started is bumped before a write touches its buffer (see ESP32WebSocketVarStore.cpp).
+ */
+struct WsStringHeader {
+  uint32_t started;
+  uint32_t done;
+};
+
+/**
+ * @brief Copies the current value of a FixedString (always terminated, truncated to outSize).
+ * @return Length of the copied string.
+ */
+size_t readFixedString(const WsStringHeader* header, size_t capacity, char* out, size_t outSize);
+
+/**
+ * @struct FixedString
+ * @brief A string variable of at most N - 1 characters, double-buffered so that readers on other
+ *        tasks never see a half-written value. Longer sets are rejected.
+ */
+template <size_t N>
+struct FixedString {
+  static_assert(N >= 2 && N <= ESP32WS_STRING_CAPACITY_MAX, "FixedString capacity must be 2..256 bytes (terminator included)");
+  WsStringHeader header;
+  char buf[2][N];
+
+  explicit FixedString(const char* initial = "") : header{0, 0}, buf{} {
+    strncpy(buf[0], initial ? initial : "", N - 1);
+  }
+
+  /** Copies the current value into out (see readFixedString()). */
+  size_t read(char* out, size_t outSize) const { return readFixedString(&header, N, out, outSize); }
+};
+
+// --- Variable Descriptors ---
+
+/**
+ * @struct WsVarDesc
+ * @brief Describes one variable of the application's table; built with WsVar<T>.
+ */
+struct WsVarDesc {
+  const char* name;  ///< Unique name used in JSON communication (e.g., "led_intensity").
+  void* value;       ///< The application's variable (T, T[count] or FixedString<count>).
+  VarType type;      ///< Element type.
+  uint16_t count;    ///< Array length (1 for a scalar); capacity in bytes for TYPE_STRING.
+  bool hasLimits;    ///< True if minVal/maxVal validation applies (to every element of an array).
+  bool persist;      ///< Kept across reboots (see persistent() and ESP32WebSocketPersist.h).
+  double minVal;     ///< Minimum allowed value.
+  double maxVal;     ///< Maximum allowed value.
+
+  /** The same entry, kept across reboots: WsVar<int>("gain", gain, 0, 10).persistent(). */
+  constexpr WsVarDesc persistent() const {
+    return WsVarDesc{name, value, type, count, hasLimits, true, minVal, maxVal};
+  }
+};
+
+/**
+ * @struct WsVarTraits
+ * @brief Maps a C++ type to its VarType and element count. Unsupported types do not compile.
+ */
+template <typename T> struct WsVarTraits;
+template <> struct WsVarTraits<int>      { static constexpr VarType type = TYPE_INT;   static constexpr uint16_t count = 1; };
+template <> struct WsVarTraits<uint32_t> { static constexpr VarType type = TYPE_UINT;  static constexpr uint16_t count = 1; };
+template <> struct WsVarTraits<float>    { static constexpr VarType type = TYPE_FLOAT; static constexpr uint16_t count = 1; };
+template <> struct WsVarTraits<bool>     { static constexpr VarType type = TYPE_BOOL;  static constexpr uint16_t count = 1; };
+template <size_t N> struct WsVarTraits<FixedString<N>> {
+  static constexpr VarType type = TYPE_STRING;
+  static constexpr uint16_t count = N;
+};
+template <typename T, size_t N> struct WsVarTraits<T[N]> {
+  static_assert(WsVarTraits<T>::type != TYPE_STRING && WsVarTraits<T>::count == 1,
+                "Arrays must hold int, uint32_t, float or bool");
+  static_assert(N <= ESP32WS_MAX_ARRAY_LENGTH, "Array longer than ESP32WS_MAX_ARRAY_LENGTH");
+  static constexpr VarType type = WsVarTraits<T>::type;
+  static constexpr uint16_t count = N;
+};
+
+/**
+ * @struct WsVar
+ * @brief Table entry binding the application variable 'value' of type T under 'name'.
+ *        The optional limits apply to numeric types (to every element of an array).
+ */
+template <typename T>
+struct WsVar : WsVarDesc {
+  constexpr WsVar(const char* name, T& value)
+      : WsVarDesc{name, &value, WsVarTraits<T>::type, WsVarTraits<T>::count, false, false, 0.0, 0.0} {}
+  constexpr WsVar(const char* name, T& value, double minVal, double maxVal)
+      : WsVarDesc{name, &value, WsVarTraits<T>::type, WsVarTraits<T>::count, true, false, minVal, maxVal} {}
+};
+
+// --- Direct Reads ---
+
+/// Current value of a bound scalar, from any task: one atomic load, no lookup.
+inline int wsRead(const int& value) { return __atomic_load_n(&value, __ATOMIC_RELAXED); }
+inline uint32_t wsRead(const uint32_t& value) { return __atomic_load_n(&value, __ATOMIC_RELAXED); }
+inline bool wsRead(const bool& value) { return __atomic_load_n(&value, __ATOMIC_RELAXED); }
+inline float wsRead(const float& value) {
+  float v;
+  __atomic_load(&value, &v, __ATOMIC_RELAXED);
+  return v;
+}
+
+#endif // ESP32_WEBSOCKET_VARS_H
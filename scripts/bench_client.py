@@ -0,0 +1,290 @@
+"""
+Host-side benchmark client for the bench firmware (utils/Bench/Bench.cpp, PlatformIO env "bench").
+
+Measures, against a device on the bench access point:
+  * set -> ack round trip: "set" of "bench_value" until the reply carrying the same value arrives
+    (percentiles in microseconds, JSON path of the WebSocket handler included);
+  * sustained stream throughput per client count: frames, bytes and samples per second per client,
+    lost frames from sequence gaps, and the achieved sample rate against the schema's period;
+  * delivery jitter: for every frame, host arrival time minus the device time of its last sample
+    (baseTimeUs + (sampleCount - 1) * periodUs). With the clock offset and drift fitted out, the spread
+    of that difference above its minimum is the time frames wait in queues and airtime.
+
+The device-side metrics ("get_stats") are fetched at the end, so device losses (missed samples,
+dropped chunks) can be told apart from network ones. Results can be appended to a CSV file to
+compare chunk sizes or catch regressions across firmware builds.
+
+Requires Python 3.8+ and the "websockets" package (pip install websockets).
+
+Example:
+  python scripts/bench_client.py --host 192.168.5.1 --clients 1,2,4 --duration 10 --csv bench.csv
+"""
+import argparse
+import asyncio
+import csv
+import json
+import math
+import os
+import struct
+import sys
+import time
+
+import websockets
+
+FRAME_HEADER = struct.Struct("<BBHIQ")  # StreamFrameHeader: type, streamId, sampleCount, sequence, baseTimeUs
+STREAM_FRAME = 0xD1                     # ESP32WS_BIN_STREAM_FRAME
+BENCH_VARIABLE = "bench_value"
+
+
+def percentile(values, p):
+    """Nearest-rank percentile of a non-empty list."""
+    ordered = sorted(values)
+    rank = max(1, math.ceil(p / 100.0 * len(ordered)))
+    return ordered[rank - 1]
+
+
+def summarize(values):
+    if not values:
+        return {"n": 0, "p50": float("nan"), "p90": float("nan"), "p99": float("nan"), "max": float("nan")}
+    return {"n": len(values), "p50": percentile(values, 50), "p90": percentile(values, 90),
+            "p99": percentile(values, 99), "max": max(values)}
+
+
+def now_us():
+    return time.perf_counter_ns() // 1000
+
+
+async def connect(url):
+    # No compression (the server does not negotiate it) and no keepalive pings competing with the load
+    return await websockets.connect(url, compression=None, ping_interval=None, max_size=None)
+
+
+async def recv_json(ws, predicate, timeout):
+    """Returns the first JSON message matching predicate, skipping binary frames and other replies."""
+    deadline = time.monotonic() + timeout
+    while True:
+        remaining = deadline - time.monotonic()
+        if remaining <= 0:
+            raise TimeoutError("no matching reply")
+        message = await asyncio.wait_for(ws.recv(), remaining)
+        if isinstance(message, bytes):
+            continue
+        reply = json.loads(message)
+        if predicate(reply):
+            return reply
+
+
+# --- Round Trip ---
+
+async def bench_rtt(url, count, warmup):
+    ws = await connect(url)
+    try:
+        rtts = []
+        base = int(time.time()) % 100000 * 1000  # Fresh values, so a stale reply can never match
+        for i in range(warmup + count):
+            value = base + i
+            start = now_us()
+            await ws.send(json.dumps({"action": "set", "variable": BENCH_VARIABLE, "value": value}))
+            reply = await recv_json(ws, lambda m: m.get("variable") == BENCH_VARIABLE or m.get("status") == "error", 2.0)
+            if reply.get("status") == "error":
+                raise RuntimeError("set failed: %s (is the bench firmware flashed?)" % reply.get("message"))
+            if reply.get("value") != value:
+                continue
+            if i >= warmup:
+                rtts.append(now_us() - start)
+        return rtts
+    finally:
+        await ws.close()
+
+
+# --- Streaming ---
+
+class StreamResult:
+    def __init__(self):
+        self.stream = None       # Schema entry of the acquisition stream
+        self.frames = 0
+        self.bytes = 0
+        self.samples = 0
+        self.lost_frames = 0
+        self.first_us = None
+        self.last_us = None
+        self.delivery_us = []    # (device time of the frame's last sample, arrival time minus that time)
+
+
+async def stream_client(url, duration, stream_name):
+    result = StreamResult()
+    ws = await connect(url)
+    try:
+        await ws.send(json.dumps({"action": "start_stream"}))
+        schema = await recv_json(ws, lambda m: m.get("status") == "stream_schema", 5.0)
+        streams = [s for s in schema.get("streams", []) if s.get("name") == stream_name]
+        if not streams:
+            raise RuntimeError("stream '%s' not in the schema" % stream_name)
+        result.stream = streams[0]
+        stream_id = result.stream["id"]
+        period_us = result.stream["periodUs"]
+
+        last_sequence = None
+        deadline = time.monotonic() + duration
+        while True:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                break
+            try:
+                message = await asyncio.wait_for(ws.recv(), remaining)
+            except asyncio.TimeoutError:
+                break
+            arrival = now_us()
+            if not isinstance(message, bytes) or len(message) < FRAME_HEADER.size:
+                continue
+            frame_type, frame_stream, sample_count, sequence, base_time_us = FRAME_HEADER.unpack_from(message)
+            if frame_type != STREAM_FRAME or frame_stream != stream_id:
+                continue
+            if last_sequence is not None and sequence > last_sequence + 1:
+                result.lost_frames += sequence - last_sequence - 1
+            last_sequence = sequence
+            if result.first_us is None:
+                result.first_us = arrival  # Rates are measured from the first frame on
+            else:
+                result.frames += 1
+                result.bytes += len(message)
+                result.samples += sample_count
+            result.last_us = arrival
+            sample_time_us = base_time_us + max(sample_count - 1, 0) * period_us
+            result.delivery_us.append((sample_time_us, arrival - sample_time_us))
+        await ws.send(json.dumps({"action": "stop_stream"}))
+        return result
+    finally:
+        await ws.close()
+
+
+def jitter_of(delivery_us):
+    """Delivery delays above the fastest frame, after removing the host/device clock offset and drift
+    (least-squares line through the delays against device time)."""
+    if len(delivery_us) < 2:
+        return []
+    n = len(delivery_us)
+    mean_t = sum(t for t, _ in delivery_us) / n
+    mean_d = sum(d for _, d in delivery_us) / n
+    var_t = sum((t - mean_t) ** 2 for t, _ in delivery_us)
+    slope = sum((t - mean_t) * (d - mean_d) for t, d in delivery_us) / var_t if var_t else 0.0
+    residuals = [d - slope * (t - mean_t) for t, d in delivery_us]
+    floor = min(residuals)
+    return [r - floor for r in residuals]
+
+
+async def bench_stream(url, clients, duration, stream_name):
+    return await asyncio.gather(*(stream_client(url, duration, stream_name) for _ in range(clients)))
+
+
+# --- Device Metrics ---
+
+async def fetch_stats(url):
+    ws = await connect(url)
+    try:
+        await ws.send(json.dumps({"action": "get_stats"}))
+        return await recv_json(ws, lambda m: m.get("status") == "stats", 2.0)
+    finally:
+        await ws.close()
+
+
+async def reset_stats(url):
+    ws = await connect(url)
+    try:
+        await ws.send(json.dumps({"action": "get_stats", "reset": True}))
+        await recv_json(ws, lambda m: m.get("status") == "stats", 2.0)
+    finally:
+        await ws.close()
+
+
+# --- Reporting ---
+
+def append_csv(path, row):
+    new_file = not os.path.exists(path)
+    with open(path, "a", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=list(row.keys()))
+        if new_file:
+            writer.writeheader()
+        writer.writerow(row)
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="192.168.5.1", help="device address (default: %(default)s)")
+    parser.add_argument("--rtt-count", type=int, default=500, help="measured set -> ack round trips")
+    parser.add_argument("--rtt-warmup", type=int, default=20, help="round trips discarded before measuring")
+    parser.add_argument("--clients", default="1,2,4", help="comma-separated client counts for the stream runs")
+    parser.add_argument("--duration", type=float, default=10.0, help="seconds per stream run")
+    parser.add_argument("--stream", default="adc", help="stream name to measure (default: %(default)s)")
+    parser.add_argument("--csv", help="append one result row per client count to this file")
+    parser.add_argument("--label", default="", help="free-form label stored in the CSV (e.g. the git commit)")
+    args = parser.parse_args()
+    url = "ws://%s/ws" % args.host
+    client_counts = [int(c) for c in args.clients.split(",") if c.strip()]
+
+    await reset_stats(url)
+
+    rtts = await bench_rtt(url, args.rtt_count, args.rtt_warmup)
+    rtt = summarize(rtts)
+    print("set -> ack round trip (us): n=%d p50=%.0f p90=%.0f p99=%.0f max=%.0f" %
+          (rtt["n"], rtt["p50"], rtt["p90"], rtt["p99"], rtt["max"]))
+
+    rows = []
+    for clients in client_counts:
+        results = await bench_stream(url, clients, args.duration, args.stream)
+        stream = results[0].stream
+        nominal_rate = 1e6 / stream["periodUs"]
+        print("\n%d client(s), stream '%s': up to %d samples/frame, %s encoding, nominal %.0f samples/s" %
+              (clients, args.stream, stream["samplesPerFrame"], stream["encoding"], nominal_rate))
+        total_bytes_per_s = 0.0
+        for i, r in enumerate(results):
+            elapsed_s = max((r.last_us - r.first_us) / 1e6, 1e-9) if r.first_us is not None else float("nan")
+            frames_per_s = r.frames / elapsed_s
+            bytes_per_s = r.bytes / elapsed_s
+            samples_per_s = r.samples / elapsed_s
+            total_bytes_per_s += bytes_per_s
+            jitter = summarize(jitter_of(r.delivery_us))
+            samples_per_frame = r.samples / r.frames if r.frames else float("nan")  # Varies with adaptive chunking
+            print("  client %d: %.1f frames/s (%.1f samples/frame), %.1f kB/s, %.0f samples/s (%.1f%% of nominal), "
+                  "%d lost frames, delivery jitter p50=%.0f p99=%.0f max=%.0f us" %
+                  (i, frames_per_s, samples_per_frame, bytes_per_s / 1000, samples_per_s,
+                   100.0 * samples_per_s / nominal_rate, r.lost_frames, jitter["p50"], jitter["p99"], jitter["max"]))
+            if i == 0:
+                rows.append({
+                    "time": time.strftime("%Y-%m-%dT%H:%M:%S"), "label": args.label, "clients": clients,
+                    "samples_per_frame": stream["samplesPerFrame"], "encoding": stream["encoding"],
+                    "rtt_p50_us": round(rtt["p50"]), "rtt_p99_us": round(rtt["p99"]), "rtt_max_us": round(rtt["max"]),
+                    "frames_per_s": round(frames_per_s, 1), "avg_samples_per_frame": round(samples_per_frame, 1),
+                    "client_kbytes_per_s": round(bytes_per_s / 1000, 1),
+                    "sample_rate_ratio": round(samples_per_s / nominal_rate, 4), "lost_frames": r.lost_frames,
+                    "jitter_p50_us": round(jitter["p50"]), "jitter_p99_us": round(jitter["p99"]),
+                    "jitter_max_us": round(jitter["max"]),
+                })
+        lost = sum(r.lost_frames for r in results)
+        print("  total: %.1f kB/s, %d lost frames" % (total_bytes_per_s / 1000, lost))
+        rows[-1]["total_kbytes_per_s"] = round(total_bytes_per_s / 1000, 1)
+        rows[-1]["total_lost_frames"] = lost
+
+    stats = await fetch_stats(url)
+    print("\ndevice timers (us):")
+    for name, timer in stats.get("timers", {}).items():
+        print("  %-10s count=%-8d avg=%.1f max=%.1f" % (name, timer["count"], timer["avgUs"], timer["maxUs"]))
+    gauges = stats.get("gauges", {})
+    print("device: heap min free %s, acq missed samples %s, acq chunks dropped %s, binary frames dropped %s" %
+          (stats.get("heap", {}).get("minFree"), gauges.get("acq_missed_samples"), gauges.get("acq_chunks_dropped"),
+           stats.get("counters", {}).get("binary_dropped")))
+
+    if args.csv:
+        for row in rows:
+            row["device_send_max_us"] = stats.get("timers", {}).get("send", {}).get("maxUs")
+            row["device_chunks_dropped"] = gauges.get("acq_chunks_dropped")
+            append_csv(args.csv, row)
+        print("\nappended %d row(s) to %s" % (len(rows), args.csv))
+
+
+if __name__ == "__main__":
+    try:
+        asyncio.run(main())
+    except (OSError, RuntimeError, TimeoutError, asyncio.TimeoutError, websockets.exceptions.WebSocketException) as error:
+        print("bench failed: %s" % error, file=sys.stderr)
+        sys.exit(1)
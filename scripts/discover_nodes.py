@@ -0,0 +1,82 @@
+"""
+Lists the ESP32WebSocket nodes on the local network (mDNS/DNS-SD service "_esp32ws._tcp").
+
+Browsers cannot browse DNS-SD themselves, so this script finds the nodes and prints, for each one,
+its host name, address and advertised streams (the "s<id>" TXT records: name, period in us, channels).
+It also prints a dashboard URL whose "?nodes=" parameter makes the web app connect to all of them
+and merge their streams (see data/js/nodeAggregator.js).
+
+Requires Python 3.8+ and the "zeroconf" package (pip install zeroconf).
+
+Example:
+  python scripts/discover_nodes.py --timeout 3
+"""
+import argparse
+import socket
+import sys
+import time
+
+from zeroconf import ServiceBrowser, ServiceListener, Zeroconf
+
+SERVICE_TYPE = "_esp32ws._tcp.local."  # ESP32WS_MDNS_SERVICE
+
+
+class NodeListener(ServiceListener):
+    """Collects resolved services by name."""
+
+    def __init__(self):
+        self.nodes = {}
+
+    def add_service(self, zc, type_, name):
+        info = zc.get_service_info(type_, name, timeout=2000)
+        if info:
+            self.nodes[name] = info
+
+    def update_service(self, zc, type_, name):
+        self.add_service(zc, type_, name)
+
+    def remove_service(self, zc, type_, name):
+        self.nodes.pop(name, None)
+
+
+def describe(info):
+    """Returns (host, address, txt dict) of a resolved service."""
+    txt = {k.decode(): (v.decode() if v is not None else "") for k, v in info.properties.items()}
+    host = info.server.rstrip(".")
+    address = socket.inet_ntoa(info.addresses[0]) if info.addresses else "?"
+    return host, address, txt
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Find ESP32WebSocket nodes over mDNS.")
+    parser.add_argument("--timeout", type=float, default=3.0, help="seconds to listen for announcements")
+    parser.add_argument("--use-ip", action="store_true", help="list IP addresses instead of .local names in the URL")
+    args = parser.parse_args()
+
+    zc = Zeroconf()
+    listener = NodeListener()
+    ServiceBrowser(zc, SERVICE_TYPE, listener)
+    try:
+        time.sleep(args.timeout)
+    finally:
+        zc.close()
+
+    if not listener.nodes:
+        print("No node found. Are the boards in station mode (setNetworkMode()) on this network?", file=sys.stderr)
+        return 1
+
+    targets = []
+    for name in sorted(listener.nodes):
+        host, address, txt = describe(listener.nodes[name])
+        stream_keys = sorted((k for k in txt if k.startswith("s") and k[1:].isdigit()), key=lambda k: int(k[1:]))
+        streams = [txt[k] for k in stream_keys]
+        print(f"{host:28} {address:15} streams: {'; '.join(streams) or '-'}")
+        targets.append(address if args.use_ip else host)
+
+    print()
+    print(f"Dashboard: http://{targets[0]}/?nodes={','.join(targets)}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
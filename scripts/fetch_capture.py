@@ -0,0 +1,154 @@
+"""
+Downloads a recorded capture file from a device (GET /captures/<name>, see ESP32WebSocketCapture.h).
+
+An interrupted download resumes where it stopped: the partial file is cut back to whole blocks and the
+rest is requested with a "Range" header, retrying until the file is complete. The file's ETag is kept
+next to the partial file (<out>.etag) and sent as "If-Range", so a file that changed in between (the
+spill file while it records) is downloaded again from the start instead of stitched from two versions. With --frames the stream recorder's
+spill file (ESP32WebSocketRecorder.h) is also unrolled: its blocks are sorted by sequence number and
+the recorded stream frames are written back to back in recording order, each as
+u16 length (little-endian) followed by the raw frame (a StreamFrameHeader plus its samples).
+
+Without a name the device's capture files are listed.
+
+Requires Python 3.8+ (standard library only).
+
+Example:
+  python scripts/fetch_capture.py --host 192.168.5.1 capture.rec --frames frames.bin
+"""
+import argparse
+import json
+import os
+import struct
+import sys
+import time
+import urllib.error
+import urllib.request
+
+BLOCK_BYTES = 4096                          # ESP32WS_RECORDER_BLOCK_BYTES
+BLOCK_HEADER = struct.Struct("<IIHBBI")     # RecorderBlockHeader: magic, sequence, used, streamMask, reserved, firstMs
+RECORD_HEADER = struct.Struct("<HHI")       # RecorderRecordHeader: len, run, recordMs
+RECORDER_MAGIC = 0x31525745                 # ESP32WS_RECORDER_MAGIC
+READ_BYTES = 64 * 1024
+
+
+def list_captures(base):
+    with urllib.request.urlopen(f"{base}/captures", timeout=10) as response:
+        captures = json.load(response)["captures"]
+    if not captures:
+        print("No capture file on the device.")
+    for capture in captures:
+        print(f"{capture['name']:32} {capture['size']:>10} bytes")
+
+
+def download(base, name, path, retries):
+    """Fetches the file into path, resuming a partial download. Returns the file size."""
+    etag_path = path + ".etag"
+    size = None
+    for attempt in range(retries + 1):
+        have = os.path.getsize(path) if os.path.exists(path) else 0
+        if size is not None and have >= size:
+            break
+        etag = None
+        if os.path.exists(etag_path):
+            with open(etag_path) as f:
+                etag = f.read().strip() or None
+        if etag is None:
+            have = 0  # Unknown version: a resume could stitch two files
+        have -= have % BLOCK_BYTES  # A torn last block may mix two writes of it
+        if os.path.exists(path):
+            os.truncate(path, have)
+        request = urllib.request.Request(f"{base}/captures/{name}")
+        if have > 0:
+            request.add_header("Range", f"bytes={have}-")
+            request.add_header("If-Range", etag)
+        try:
+            with urllib.request.urlopen(request, timeout=10) as response:
+                with open(etag_path, "w") as f:
+                    f.write(response.headers.get("ETag", ""))
+                if response.status == 206:
+                    size = int(response.headers["Content-Range"].rsplit("/", 1)[1])
+                    mode = "ab"
+                else:  # Whole file (no partial copy, the file changed, or the device ignored the range)
+                    size = int(response.headers["Content-Length"])
+                    have, mode = 0, "wb"
+                started = time.monotonic()
+                received = 0
+                with open(path, mode) as out:
+                    while True:
+                        data = response.read(READ_BYTES)
+                        if not data:
+                            break
+                        out.write(data)
+                        received += len(data)
+                        print(f"\r{have + received}/{size} bytes", end="", flush=True)
+                elapsed = max(time.monotonic() - started, 1e-6)
+                print(f"\r{have + received}/{size} bytes, {received / elapsed / 1024:.0f} KiB/s")
+        except urllib.error.HTTPError as e:
+            if e.code == 416 and size is None:  # Local copy already complete
+                os.remove(etag_path)
+                return have
+            raise
+        except (urllib.error.URLError, OSError) as e:
+            print(f"\nInterrupted ({e}); resuming (attempt {attempt + 1}/{retries}).", file=sys.stderr)
+            time.sleep(1)
+    have = os.path.getsize(path)
+    if size is not None and have < size:
+        raise RuntimeError(f"download incomplete: {have}/{size} bytes")
+    if os.path.exists(etag_path):
+        os.remove(etag_path)
+    return have
+
+
+def unroll_frames(path, out_path):
+    """Writes the frames of a spill file in recording order. Returns (blocks, frames)."""
+    blocks = []
+    with open(path, "rb") as f:
+        while True:
+            block = f.read(BLOCK_BYTES)
+            if len(block) < BLOCK_HEADER.size:
+                break
+            magic, sequence, used, _, _, _ = BLOCK_HEADER.unpack_from(block)
+            if magic == RECORDER_MAGIC and BLOCK_HEADER.size < used <= len(block):
+                blocks.append((sequence, block[:used]))
+    blocks.sort()
+    frames = 0
+    with open(out_path, "wb") as out:
+        for _, block in blocks:
+            pos = BLOCK_HEADER.size
+            while pos + RECORD_HEADER.size <= len(block):
+                length, _, _ = RECORD_HEADER.unpack_from(block, pos)
+                pos += RECORD_HEADER.size
+                if length == 0 or pos + length > len(block):
+                    break
+                out.write(struct.pack("<H", length))
+                out.write(block[pos:pos + length])
+                pos += length
+                frames += 1
+    return len(blocks), frames
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Download a capture file from an ESP32WebSocket device.")
+    parser.add_argument("name", nargs="?", help="capture file name (omit to list the files)")
+    parser.add_argument("--host", default="192.168.5.1", help="device address")
+    parser.add_argument("--out", help="local file (default: the capture name)")
+    parser.add_argument("--frames", help="also write the recorded frames in recording order to this file")
+    parser.add_argument("--retries", type=int, default=20, help="resume attempts after an interruption")
+    args = parser.parse_args()
+
+    base = f"http://{args.host}"
+    if not args.name:
+        list_captures(base)
+        return 0
+    path = args.out or args.name
+    size = download(base, args.name, path, args.retries)
+    print(f"Saved {path} ({size} bytes).")
+    if args.frames:
+        blocks, frames = unroll_frames(path, args.frames)
+        print(f"Wrote {frames} frames from {blocks} blocks to {args.frames}.")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
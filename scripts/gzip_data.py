@@ -0,0 +1,113 @@
+"""
+PlatformIO pre-build script: gzips the web application files before they are packed into
+the LittleFS image.
+
+A copy of data/ is written to <build_dir>/<env>/data_gz, where every compressible file is
+replaced by "<name>.gz" (already-compressed formats such as PNG are copied as-is), and
+PROJECT_DATA_DIR is pointed at that copy so "Upload Filesystem Image" uses it. The firmware
+serves "<path>.gz" with "Content-Encoding: gzip" whenever it exists (see StaticAssetHandler
+in ESP32WebSocket.cpp). The copy is only refreshed for files that changed.
+
+index.html is written last: each local reference in a src/href attribute gets "?v=<hash>", the
+firmware's ETag of that file (FNV-1a of the stored bytes). The firmware sends a request whose
+version matches the stored file as immutable, and revalidates everything else.
+"""
+import gzip
+import os
+import re
+import shutil
+
+Import("env")  # noqa: F821 (provided by PlatformIO/SCons)
+
+# Formats that gzip cannot shrink meaningfully
+SKIP_EXTENSIONS = {".png", ".jpg", ".jpeg", ".gif", ".webp", ".woff", ".woff2", ".gz", ".zip"}
+# Page whose references are versioned (relative to data/)
+PAGE = "index.html"
+REFERENCE_RE = re.compile(r'(\b(?:src|href)=")([^"?#:]+)(")')
+
+src_dir = env.subst("$PROJECT_DATA_DIR")
+dst_dir = os.path.join(env.subst("$BUILD_DIR"), "data_gz")
+
+
+def is_up_to_date(src, dst):
+    return os.path.exists(dst) and os.path.getmtime(dst) >= os.path.getmtime(src)
+
+
+def fnv1a(data):
+    """32-bit FNV-1a, as computed by the firmware for the ETag."""
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return "%08x" % h
+
+
+def write_if_changed(path, data):
+    if os.path.exists(path):
+        with open(path, "rb") as f:
+            if f.read() == data:
+                return
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def build_page(src, dst, versions):
+    """Writes the gzipped page with "?v=<ETag>" appended to references of files in versions."""
+    with open(src, "r", encoding="utf-8") as f:
+        page = f.read()
+
+    def add_version(match):
+        version = versions.get(os.path.normpath(match.group(2).lstrip("/")))
+        if version is None:
+            return match.group(0)
+        return "%s%s?v=%s%s" % (match.group(1), match.group(2), version, match.group(3))
+
+    page = REFERENCE_RE.sub(add_version, page)
+    # Rewritten on every build (the versions may change), but only touched when the bytes differ
+    write_if_changed(dst, gzip.compress(page.encode("utf-8"), compresslevel=9, mtime=0))
+
+
+def build_gzipped_data_dir():
+    expected = set()
+    versions = {}  # data-relative path -> ETag of the stored file
+    page_src = os.path.join(src_dir, PAGE)
+    for root, _dirs, files in os.walk(src_dir):
+        rel_root = os.path.relpath(root, src_dir)
+        out_root = os.path.normpath(os.path.join(dst_dir, rel_root))
+        os.makedirs(out_root, exist_ok=True)
+        for name in files:
+            src = os.path.join(root, name)
+            if os.path.normpath(src) == os.path.normpath(page_src):
+                continue  # Needs the other files' versions
+            if os.path.splitext(name)[1].lower() in SKIP_EXTENSIONS:
+                dst = os.path.join(out_root, name)
+                if not is_up_to_date(src, dst):
+                    shutil.copy2(src, dst)
+            else:
+                dst = os.path.join(out_root, name + ".gz")
+                if not is_up_to_date(src, dst):
+                    with open(src, "rb") as f_in:
+                        data = f_in.read()
+                    # mtime=0 keeps the output (and so the device-side ETag) reproducible
+                    with open(dst, "wb") as f_out:
+                        f_out.write(gzip.compress(data, compresslevel=9, mtime=0))
+            expected.add(os.path.normpath(dst))
+            with open(dst, "rb") as f:
+                versions[os.path.normpath(os.path.relpath(src, src_dir))] = fnv1a(f.read())
+
+    if os.path.exists(page_src):
+        page_dst = os.path.join(dst_dir, PAGE + ".gz")
+        build_page(page_src, page_dst, versions)
+        expected.add(os.path.normpath(page_dst))
+
+    # Remove outputs whose source was deleted or renamed
+    for root, _dirs, files in os.walk(dst_dir):
+        for name in files:
+            path = os.path.normpath(os.path.join(root, name))
+            if path not in expected:
+                os.remove(path)
+
+
+if os.path.isdir(src_dir):
+    build_gzipped_data_dir()
+    env.Replace(PROJECT_DATA_DIR=dst_dir)
+    print("gzip_data.py: LittleFS image will be built from %s" % dst_dir)
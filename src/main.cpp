@@ -1,104 +1,186 @@
 /**
  * @file main.cpp
  * @brief Example application demonstrating the use of ESP32WebSocket library.
- *        Implements both Get/Set variable control via JSON and high-frequency 
- *        binary data streaming of 6 analog inputs.
+ *        Implements both Get/Set variable control via JSON and two binary streams:
+ *        6 analog inputs at 4 kS/s and the chip temperature at 10 Hz.
  */
 
 // Include our custom WebSocket communication library
 #include "ESP32WebSocket.h" 
+#include "ESP32WebSocketAcquisition.h"
+#include "ESP32WebSocketStream.h"
+#include "ESP32WebSocketVarStore.h"
+#include "ESP32WebSocketNetwork.h"
+#include "ESP32WebSocketRecorder.h"
+#include <esp_timer.h>
+
+// Tag of this file's log lines; the level is selected with -DESP32WS_LOG_LEVEL in platformio.ini
+#define ESP32WS_LOG_TAG "APP_DEMO"
+#include "ESP32WebSocketLog.h"
 
 // --- WiFi Access Point Configuration ---
 const char *WIFI_SSID = "ESP32_Control_AP";      // Network name for clients to connect to
 const char *WIFI_PASSWORD = "password123"; // Network password (min 8 chars)
 const uint8_t DESIRED_STATIC_IP[4] = {192, 168, 5, 1}; // Desired IP
 
+// --- Plant Network (optional) ---
+// NET_MODE_STA joins an existing network instead of starting the AP (NET_MODE_AP_STA does both).
+// The board is then reachable as esp32ws-xxxxxx.local; scripts/discover_nodes.py lists all boards.
+const NetworkMode NETWORK_MODE = NET_MODE_AP;
+const char *STA_SSID = "PlantNetwork";
+const char *STA_PASSWORD = "changeme";
+
+// --- Stream Recorder ---
+// Recent frames are kept so a client that reconnects can replay what it missed ("replay_since").
+// With PSRAM the ring holds well over a minute of delta-encoded ADC data; the spill file extends it.
+const size_t RECORDER_PSRAM_BYTES = 1024 * 1024;
+const size_t RECORDER_RAM_BYTES = 48 * 1024;   // Boards without PSRAM: a few seconds
+const char *RECORDER_SPILL_PATH = "/capture.rec";
+const size_t RECORDER_SPILL_BYTES = 512 * 1024; // Fits the default LittleFS partition next to the web app
+
 // --- Get/Set Variable Configuration (JSON Communication) ---
 
-// Define the variables that can be read/written via JSON commands
-// (Uses the VariableConfig struct from ESP32WebSocket.h)
-VariableConfig configurableVariables[] = {
-  // Name             Type        Int Val  Float Val  String Val   Min     Max     Limits?
-  {"led_intensity",   TYPE_INT,   128,     0.0f,      "",          0.0,    255.0,  true},
-  {"update_interval", TYPE_INT,   500,     0.0f,      "",          50.0,   5000.0, true},
-  {"motor_enable",    TYPE_INT,   0,       0.0f,      "",          0.0,    1.0,    true}, // Example: 0=off, 1=on
-  {"device_label",    TYPE_STRING,0,       0.0f,      "ESP32-01",  0.0,    0.0,    false} 
+// The variables themselves: clients change them from the AsyncTCP task while loop() runs, so
+// read them with wsRead() (or deviceLabel.read()) and write them with the setVariable...() functions
+int ledIntensity = 128;
+int updateInterval = 500;          // ms
+bool motorEnable = false;
+FixedString<16> deviceLabel("ESP32-01");
+
+// Define the variables that can be read/written via JSON commands (see ESP32WebSocketVars.h).
+// The table is constant, so it stays in flash; WsVar<T> only accepts a variable of type T.
+// Tuning values are persistent(): they survive reboots (ESP32WebSocketPersist.h). The motor always starts off.
+const WsVarDesc configurableVariables[] = {
+  //                       Name               Variable         Min     Max
+  WsVar<int>(              "led_intensity",   ledIntensity,    0.0,    255.0).persistent(),
+  WsVar<int>(              "update_interval", updateInterval,  50.0,   5000.0).persistent(),
+  WsVar<bool>(             "motor_enable",    motorEnable),
+  WsVar<FixedString<16>>(  "device_label",    deviceLabel).persistent()
 };
 // Automatically calculate the number of configurable variables
 const int numConfigurableVariables = sizeof(configurableVariables) / sizeof(configurableVariables[0]);
 
+// Handle resolved once in setup(), to recognize the variable in the change callback
+VariableHandle ledIntensityVar;
+
 
 // --- Real Time Reading (Streaming) Configuration ---
 
 // Constants for data acquisition and buffering
-const int SAMPLES_PER_CHUNK = 25;       // How many readings to buffer before sending (N)
-const int SAMPLE_INTERVAL_US = 250;     // Time between samples in microseconds (adjust for desired rate)
+const uint16_t SAMPLES_PER_CHUNK = 100;  // Largest chunk: readings buffered before sending on a busy link
+const uint16_t MIN_SAMPLES_PER_CHUNK = 10; // Smallest chunk (2.5 ms of data), used while the link is quiet
+const uint32_t MAX_CHUNK_LATENCY_US = 20000; // No chunk waits longer than this for its samples
+const uint32_t SAMPLE_RATE_HZ = 4000;    // Hardware-timed sample rate (250 us between samples)
 
 // Define the 6 Analog Input pins to be read
-// Note: Ensure these pins are suitable for ADC use on your specific ESP32 board.
-//       ADC1 pins (GPIO 32-39) are generally safe. Avoid ADC2 pins if using WiFi.
-const int ANALOG_PIN_1 = 32; 
-const int ANALOG_PIN_2 = 33;
-const int ANALOG_PIN_3 = 34;
-const int ANALOG_PIN_4 = 35;
-const int ANALOG_PIN_5 = 36; // Often VP
-const int ANALOG_PIN_6 = 39; // Often VN
-
-// Structure for a single packet of sensor data (matches client-side expectation)
-// Use pragma pack to ensure no padding bytes are added by the compiler.
-#pragma pack(push, 1) 
-struct SensorDataPacket {
-  uint16_t reading1;    // Reading from ANALOG_PIN_1
-  uint16_t reading2;    // Reading from ANALOG_PIN_2
-  uint16_t reading3;    // Reading from ANALOG_PIN_3
-  uint16_t reading4;    // Reading from ANALOG_PIN_4
-  uint16_t reading5;    // Reading from ANALOG_PIN_5
-  uint16_t reading6;    // Reading from ANALOG_PIN_6
-  uint32_t time_ms;     // Timestamp (milliseconds) relative to stream start
-};                      // Total size = 6 * 2 + 4 = 16 bytes
-#pragma pack(pop) 
-
-// Calculate sizes based on the structure and chunk configuration
-const int PACKET_SIZE_BYTES = sizeof(SensorDataPacket);       // Size of one packet (16 bytes)
-const int CHUNK_BUFFER_SIZE_BYTES = SAMPLES_PER_CHUNK * PACKET_SIZE_BYTES; // Total size of the send buffer
-
-// Buffer to hold sensor data before sending
-SensorDataPacket sensorDataBuffer[SAMPLES_PER_CHUNK];
-// Index pointing to the next available slot in the buffer
-int currentBufferIndex = 0;
-
-// --- Application State Variables ---
-bool isAppStreaming = false;      // Flag controlled by callbacks, enables/disables streaming logic in loop()
-uint32_t streamStartTimeMs = 0;   // Records the time when streaming started (using millis())
+// Note: The acquisition engine samples ADC1 only (GPIO 32-39). ADC2 pins cannot be used with WiFi.
+const uint8_t ANALOG_PINS[] = {
+  32, // Reading 1
+  33, // Reading 2
+  34, // Reading 3
+  35, // Reading 4
+  36, // Reading 5 (Often VP)
+  39  // Reading 6 (Often VN)
+};
+const uint8_t NUM_ANALOG_PINS = sizeof(ANALOG_PINS) / sizeof(ANALOG_PINS[0]);
+
+// The acquisition engine registers an "adc" stream (one u16 channel per pin, in ANALOG_PINS order).
+// Clients receive its schema at start_stream and decode the frames from it, so changing the pin
+// list here needs no matching change in the web client.
+
+// Second, slow stream produced in loop(): the chip temperature at 10 Hz. Each stream has its own
+// rate, frame size, schema entry and callbacks, and clients choose theirs with
+// {"action":"start_stream","streams":[ids]} (all streams by default).
+const uint32_t THERMAL_PERIOD_US = 100000;      // 10 Hz
+const uint16_t THERMAL_SAMPLES_PER_FRAME = 10;  // One frame per second
+const StreamChannel THERMAL_CHANNELS[] = {
+  // Name        Type        Count  Scale   Offset  Unit
+  {"chip_temp",  STREAM_I16, 1,     0.01f,  0.0f,   "degC"}  // Raw value in hundredths of a degree
+};
+int thermalStreamId = -1;
+volatile bool thermalRunning = false;  // Set by the thermal stream callbacks
+int64_t thermalStartUs = 0;
+uint32_t thermalSampleIndex = 0;       // Samples taken since the stream started
+uint32_t thermalSequence = 0;
+uint8_t thermalFrame[sizeof(StreamFrameHeader) + THERMAL_SAMPLES_PER_FRAME * sizeof(int16_t)];
 
 
 // --- Stream Control Callback Functions (Required by the Library) ---
 
 /**
  * @brief This function is called by the ESP32WebSocketControl library 
- *        when a "start_stream" command is received from a client.
+ *        when the first client subscribes to the "adc" stream with "start_stream".
  *        It sets up the application state to begin data acquisition.
  */
 void application_onStreamStart() {
-  Serial.println("Application Callback: START STREAM requested.");
-  currentBufferIndex = 0;          // Reset buffer index
-  streamStartTimeMs = millis();    // Record the start time for relative timestamps
-  isAppStreaming = true;           // Set the flag to enable streaming logic in loop()
+  ESP32WS_LOGI("Application Callback: START STREAM requested.");
+  startAcquisition();              // Timer-driven sampling; timestamps restart from zero
   // Optional: Could add actions like enabling sensor power here.
 }
 
 /**
  * @brief This function is called by the ESP32WebSocketControl library
- *        when a "stop_stream" command is received or the last client disconnects.
+ *        when the last "adc" subscriber sends "stop_stream" or disconnects.
  *        It sets the application state to stop data acquisition.
  */
 void application_onStreamStop() {
-  Serial.println("Application Callback: STOP STREAM requested.");
-  isAppStreaming = false;          // Clear the flag to disable streaming logic in loop()
+  ESP32WS_LOGI("Application Callback: STOP STREAM requested.");
+  stopAcquisition();               // Stop the sampling timer
   // Optional: Could add actions like disabling sensor power here.
 }
 
 
+/**
+ * @brief Called when the first client subscribes to the "thermal" stream.
+ */
+void thermal_onStreamStart() {
+  ESP32WS_LOGI("Application Callback: START THERMAL STREAM requested.");
+  thermalStartUs = esp_timer_get_time(); // Timestamps restart from zero, like the "adc" stream
+  thermalSampleIndex = 0;
+  thermalSequence = 0;
+  thermalRunning = true;
+}
+
+/**
+ * @brief Called when the last subscriber of the "thermal" stream leaves.
+ */
+void thermal_onStreamStop() {
+  ESP32WS_LOGI("Application Callback: STOP THERMAL STREAM requested.");
+  thermalRunning = false;
+}
+
+/**
+ * @brief Takes the thermal samples that are due and sends every completed frame.
+ *        Sample times follow the nominal 10 Hz grid, so loop() jitter does not skew timestamps.
+ */
+void serviceThermalStream() {
+  int64_t elapsedUs = esp_timer_get_time() - thermalStartUs;
+  while (thermalRunning && (int64_t)thermalSampleIndex * THERMAL_PERIOD_US <= elapsedUs) {
+    uint16_t slot = thermalSampleIndex % THERMAL_SAMPLES_PER_FRAME;
+    int16_t centiDegrees = (int16_t)(temperatureRead() * 100.0f);
+    memcpy(thermalFrame + sizeof(StreamFrameHeader) + slot * sizeof(int16_t), &centiDegrees, sizeof(centiDegrees));
+    thermalSampleIndex++;
+    if (slot == THERMAL_SAMPLES_PER_FRAME - 1) {
+      uint64_t baseTimeUs = (uint64_t)(thermalSampleIndex - THERMAL_SAMPLES_PER_FRAME) * THERMAL_PERIOD_US;
+      writeStreamFrameHeader(thermalFrame, thermalStreamId, thermalSequence++, THERMAL_SAMPLES_PER_FRAME, baseTimeUs);
+      broadcastStreamFrame(thermalFrame, sizeof(thermalFrame));
+    }
+  }
+}
+
+
+// --- Variable Change Callback ---
+
+/**
+ * @brief Called on the AsyncTCP task after a client set a variable; only reports the change here.
+ */
+void application_onVariableChanged(VariableHandle handle, void* context) {
+  if (handle.index == ledIntensityVar.index) {
+    ESP32WS_LOGD("Application Callback: led_intensity set to %d.", wsRead(ledIntensity));
+  }
+}
+
+
 // --- Arduino Setup Function ---
 
 /**
@@ -107,21 +189,28 @@ void application_onStreamStop() {
  */
 void setup() {
   // Start Serial communication for debugging and status messages
-  Serial.begin(115200);
-  delay(500); // Pequena pausa para garantir que o Serial esteja pronto
-  Serial.println("\n\n--- [APP_DEMO] Setup: START ---"); // << NOVO LOG
-
-  // Configure the specified analog input pins
-  Serial.println("[APP_DEMO] Setup: Configuring analog pins..."); // << NOVO LOG
-  pinMode(ANALOG_PIN_1, INPUT); 
-  pinMode(ANALOG_PIN_2, INPUT); 
-  pinMode(ANALOG_PIN_3, INPUT);
-  pinMode(ANALOG_PIN_4, INPUT); 
-  pinMode(ANALOG_PIN_5, INPUT); 
-  pinMode(ANALOG_PIN_6, INPUT);
-  Serial.println("[APP_DEMO] Setup: Analog pins configured."); // << NOVO LOG
+  Serial.begin(115200); // UART0 is ready at once; no settle delay needed
+  ESP32WS_LOGI("--- Setup: START ---");
+
+  // Configure the acquisition engine (ADC1 channels, hardware timer and sampler task)
+  ESP32WS_LOGI("Setup: Configuring acquisition engine...");
+  // Delta encoding: our process signals vary slowly, so chunks shrink several-fold on the air
+  if (!initAcquisition(ANALOG_PINS, NUM_ANALOG_PINS, SAMPLE_RATE_HZ, SAMPLES_PER_CHUNK, nullptr, STREAM_ENC_DELTA)) {
+    ESP32WS_LOGE("Setup: Acquisition engine configuration failed.");
+  }
+  // Small chunks while the link is quiet, growing (up to 20 ms) when the send queues back up
+  setAcquisitionChunking(MIN_SAMPLES_PER_CHUNK, MAX_CHUNK_LATENCY_US);
+  ESP32WS_LOGI("Setup: Acquisition engine configured.");
+  thermalStreamId = registerStream("thermal", THERMAL_CHANNELS, 1, THERMAL_PERIOD_US, THERMAL_SAMPLES_PER_FRAME);
+  if (!initStreamRecorder(psramFound() ? RECORDER_PSRAM_BYTES : RECORDER_RAM_BYTES, RECORDER_SPILL_PATH,
+                          RECORDER_SPILL_BYTES)) {
+    ESP32WS_LOGW("Setup: Stream recorder unavailable; reconnecting clients cannot replay.");
+  }
   
-  Serial.println("[APP_DEMO] Setup: Calling initWiFiWebSocketServer..."); // << NOVO LOG
+  setVariableChangeCallback(application_onVariableChanged);
+  setNetworkMode(NETWORK_MODE, STA_SSID, STA_PASSWORD);
+
+  ESP32WS_LOGD("Setup: Calling initWiFiWebSocketServer...");
   // Call the init function
   initWiFiWebSocketServer(
     WIFI_SSID,
@@ -130,96 +219,56 @@ void setup() {
     configurableVariables,
     numConfigurableVariables
   ); 
-  Serial.println("[APP_DEMO] Setup: initWiFiWebSocketServer CALL RETURNED."); // << NOVO LOG
+  ESP32WS_LOGD("Setup: initWiFiWebSocketServer CALL RETURNED.");
+  ledIntensityVar = getVariableHandle("led_intensity");
 
-  Serial.println("[APP_DEMO] Setup: Calling setStreamCallbacks..."); // << NOVO LOG
-  setStreamCallbacks(application_onStreamStart, application_onStreamStop);
-  Serial.println("[APP_DEMO] Setup: setStreamCallbacks CALL RETURNED."); // << NOVO LOG
+  ESP32WS_LOGD("Setup: Calling setStreamCallbacks...");
+  // One callback pair per stream: each producer runs only while that stream has subscribers
+  setStreamCallbacks(getAcquisitionStreamId(), application_onStreamStart, application_onStreamStop);
+  setStreamCallbacks(thermalStreamId, thermal_onStreamStart, thermal_onStreamStop);
+  ESP32WS_LOGD("Setup: setStreamCallbacks CALL RETURNED.");
 
-  Serial.printf("[APP_DEMO] Streaming Config: %d samples/chunk, %d us/sample interval.\n", 
-                SAMPLES_PER_CHUNK, SAMPLE_INTERVAL_US);
-  Serial.printf("[APP_DEMO] Data Packet Size: %d bytes. Chunk Buffer Size: %d bytes.\n", 
-                PACKET_SIZE_BYTES, CHUNK_BUFFER_SIZE_BYTES);
+  // Congested clients (e.g. a phone far from the AP) get 1 of every 4 chunks instead of stalling the others
+  setDefaultFlowControl(FLOW_DECIMATE, 8, 4);
 
-  Serial.println("--- [APP_DEMO] Setup: COMPLETE ---"); // << NOVO LOG
-  Serial.println("[APP_DEMO] Waiting for client connections...");
+  ESP32WS_LOGI("Streaming Config: %u..%u samples/chunk, %lu us/sample interval.",
+               MIN_SAMPLES_PER_CHUNK, SAMPLES_PER_CHUNK, (unsigned long)getAcquisitionSamplePeriodUs());
+  ESP32WS_LOGI("Sample Size: %u bytes. Chunk Size: %u bytes (16-byte header included).",
+               (unsigned)getAcquisitionPacketSize(), (unsigned)getStreamFrameSize(getAcquisitionStreamId()));
+
+  ESP32WS_LOGI("--- Setup: COMPLETE ---");
+  ESP32WS_LOGI("Waiting for client connections...");
 }
 
 
 // --- Arduino Loop Function ---
 
 /**
- * @brief Main application loop. Handles the real-time data acquisition and buffering
- *        when streaming is active. The WebSocket communication itself is handled 
- *        asynchronously by the ESP32WebSocketControl library in the background.
+ * @brief Main application loop. Sampling and sending are handled in the background by
+ *        the acquisition engine (hardware timer + sampler task) and the ESP32WebSocketControl
+ *        library, so the loop is free for application logic.
  */
 void loop() {
 
-  // Check if the application should be actively streaming data
-  if (isAppStreaming) {
-    
-    // --- 1. Read Analog Sensors ---
-    // Read the voltage level from each configured analog pin.
-    // The raw reading is typically 0-4095 for 12-bit ADC.
-    uint16_t val1 = analogRead(ANALOG_PIN_1);
-    uint16_t val2 = analogRead(ANALOG_PIN_2);
-    uint16_t val3 = analogRead(ANALOG_PIN_3);
-    uint16_t val4 = analogRead(ANALOG_PIN_4);
-    uint16_t val5 = analogRead(ANALOG_PIN_5);
-    uint16_t val6 = analogRead(ANALOG_PIN_6);
-
-    // --- 2. Get Timestamp ---
-    // Calculate the time elapsed since the stream started.
-    uint32_t currentTimeMs = millis() - streamStartTimeMs; 
-
-    // --- 3. Fill Buffer ---
-    // Store the readings and timestamp into the current slot of the data buffer.
-    sensorDataBuffer[currentBufferIndex].reading1 = val1;
-    sensorDataBuffer[currentBufferIndex].reading2 = val2;
-    sensorDataBuffer[currentBufferIndex].reading3 = val3;
-    sensorDataBuffer[currentBufferIndex].reading4 = val4;
-    sensorDataBuffer[currentBufferIndex].reading5 = val5;
-    sensorDataBuffer[currentBufferIndex].reading6 = val6;
-    sensorDataBuffer[currentBufferIndex].time_ms = currentTimeMs;
-
-    // Move to the next position in the buffer.
-    currentBufferIndex++; 
-
-    // --- 4. Check if Buffer is Full and Send ---
-    // If the buffer has reached the configured chunk size...
-    if (currentBufferIndex >= SAMPLES_PER_CHUNK) {
-      // ...send the entire buffer as a single binary message to all connected clients
-      // using the library function.
-      broadcastBinaryData((uint8_t*)sensorDataBuffer, CHUNK_BUFFER_SIZE_BYTES);
-      
-      // Reset the buffer index to start filling the next chunk.
-      currentBufferIndex = 0; 
-    }
+  // Example: Read a configurable variable and print it periodically
+  static unsigned long lastPrintTime = 0;
+  unsigned long interval = wsRead(updateInterval);
+  if (millis() - lastPrintTime > interval) {
+     lastPrintTime = millis();
+     // ESP32WS_LOGD("Idle: LED Intensity = %d", wsRead(ledIntensity));
+  }
 
-    // --- 5. Wait for Sample Interval ---
-    // Pause execution for the configured time before taking the next sample.
-    // Using delayMicroseconds allows for higher sampling rates than delay().
-    delayMicroseconds(SAMPLE_INTERVAL_US); 
-
-  } else {
-    // --- Idle State (Not Streaming) ---
-    // If streaming is not active, the application can perform other tasks
-    // or simply wait to conserve power/CPU.
-    
-    // Example: Read a configurable variable and print it periodically
-    static unsigned long lastPrintTime = 0;
-    unsigned long interval = configurableVariables[1].intValue; // Use 'update_interval'
-    if (millis() - lastPrintTime > interval) {
-       lastPrintTime = millis();
-       // Serial.printf("Idle: LED Intensity = %d\n", configurableVariables[0].intValue);
-    }
+  // A short delay prevents the loop from running at maximum speed unnecessarily.
+  delay(50); 
 
-    // A short delay when idle prevents the loop from running at maximum speed unnecessarily.
-    delay(50); 
-  }
+  // Sample the slow stream (the fast one is sampled by the acquisition engine in the background).
+  serviceThermalStream();
+
+  // Send all variables marked with markVariableChanged() since the last pass as one message.
+  flushVariableUpdates();
 
   // Optional: Periodically clean up disconnected WebSocket clients.
   // Often not needed in the loop as the library handles much of it.
   // cleanupWebSocketClients();
 
-} // End main loop()
\ No newline at end of file
+} // End main loop()
@@ -0,0 +1,67 @@
+// test/js/streamDecoder.test.mjs
+
+/**
+ * Decodes the payload vectors of test/test_stream_encoding/test_main.cpp with data/js/streamDecoder.js
+ * and checks the values the device encoded: change both files together.
+ * Run with: node --test test/js/
+ */
+import assert from 'node:assert/strict';
+import { readFile } from 'node:fs/promises';
+import test from 'node:test';
+
+// data/ has no package.json (it is the LittleFS image), so load the module from its source
+const source = await readFile(new URL('../../data/js/streamDecoder.js', import.meta.url), 'utf8');
+const { buildStreamTable, decodeStreamFrameInto } =
+    (await import(`data:text/javascript,${encodeURIComponent(source)}`)).default;
+
+const STREAM_HEADER_BYTES = 16;
+
+/** Builds a frame of stream 0: header (type, id, sampleCount, sequence 0, baseTimeUs 0) + payload. */
+function frame(sampleCount, payload) {
+    const bytes = new Uint8Array(STREAM_HEADER_BYTES + payload.length);
+    bytes[0] = 0xD1;
+    bytes[2] = sampleCount & 0xFF;
+    bytes[3] = sampleCount >> 8;
+    bytes.set(payload, STREAM_HEADER_BYTES);
+    return bytes.buffer;
+}
+
+/** Decodes a frame of a one-stream table into arrays; returns one plain array per column. */
+function decode(encoding, channels, sampleBytes, sampleCount, payload) {
+    const streams = buildStreamTable([{ id: 0, name: 'test', periodUs: 1000, sampleBytes, encoding, channels }]);
+    const out = streams[0].columns.map(column => new column.ArrayType(sampleCount));
+    const header = decodeStreamFrameInto(streams, frame(sampleCount, payload), out, 0, -1);
+    assert.ok(header, 'frame rejected');
+    assert.equal(header.sampleCount, sampleCount);
+    return out.map(values => Array.from(values));
+}
+
+const U16x2_I16x1 = [
+    { name: 'a', type: 'u16', count: 2, scale: 1, offset: 0, unit: '' },
+    { name: 'b', type: 'i16', count: 1, scale: 1, offset: 0, unit: '' }
+];
+
+test('pack12 keeps the low 12 bits', () => {
+    const channels = [{ name: 'a', type: 'u16', count: 2, scale: 1, offset: 0, unit: '' }];
+    const payload = [0x23, 0xC1, 0xAB, 0xFF, 0x0F, 0x00, 0x00, 0x18, 0x00];
+    assert.deepEqual(decode('pack12', channels, 4, 3, payload), [[0x123, 0xFFF, 0x800], [0xABC, 0x000, 0x001]]);
+});
+
+test('pack12 ignores the padding of the last byte', () => {
+    const channels = [{ name: 'a', type: 'u16', count: 1, scale: 1, offset: 0, unit: '' }];
+    assert.deepEqual(decode('pack12', channels, 2, 1, [0xBC, 0x0A]), [[0xABC]]);
+});
+
+test('delta with width 0 and 17-bit deltas', () => {
+    const payload = [
+        0xF4, 0x01, 0x00,
+        0x00, 0x00, 0x11, 0xFE, 0xFF, 0xFB, 0xFF, 0x03,
+        0xFE, 0xFF, 0x03, 0x1E
+    ];
+    assert.deepEqual(decode('delta', U16x2_I16x1, 6, 3, payload), [[500, 500, 500], [0, 65535, 0], [-2, 1, -1]]);
+});
+
+test('delta of a single sample', () => {
+    const payload = [0x07, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0xD4, 0xFE, 0x00];
+    assert.deepEqual(decode('delta', U16x2_I16x1, 6, 1, payload), [[7], [65535], [-300]]);
+});
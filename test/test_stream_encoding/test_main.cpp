@@ -0,0 +1,85 @@
+/**
+ * @file test_main.cpp
+ * @brief Exact bytes of the "pack12" and "delta" stream payloads (ESP32WebSocketEncoding.h).
+ *        test/js/streamDecoder.test.mjs decodes the same vectors with data/js/streamDecoder.js:
+ *        change both together. Run with: pio test -e native
+ */
+#include <unity.h>
+#include "ESP32WebSocketEncoding.h"
+
+// Raw samples are little-endian u16/i16 values, sample-major
+#define LE16(v) (uint8_t)((uint16_t)(v) & 0xFF), (uint8_t)((uint16_t)(v) >> 8)
+
+void setUp() {}
+void tearDown() {}
+
+/// Two columns, three samples: only the low 12 bits of each value are kept.
+static void test_pack12_keeps_low_12_bits() {
+  const uint8_t raw[] = {LE16(0x0123), LE16(0x0ABC), LE16(0xFFFF), LE16(0x0000), LE16(0x0800), LE16(0x0001)};
+  const uint8_t expected[] = {0x23, 0xC1, 0xAB, 0xFF, 0x0F, 0x00, 0x00, 0x18, 0x00};
+  uint8_t out[sizeof(expected) + 4] = {0};
+  size_t len = encodePack12Payload(raw, 4, 2, 3, out);
+  TEST_ASSERT_EQUAL_UINT(sizeof(expected), len);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, sizeof(expected));
+}
+
+/// A single value ends mid-byte: the last byte is zero-padded.
+static void test_pack12_pads_last_byte() {
+  const uint8_t raw[] = {LE16(0xFABC)};
+  const uint8_t expected[] = {0xBC, 0x0A};
+  uint8_t out[4] = {0};
+  size_t len = encodePack12Payload(raw, 2, 1, 1, out);
+  TEST_ASSERT_EQUAL_UINT(sizeof(expected), len);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, sizeof(expected));
+}
+
+/// Channels u16[2] and i16[1], three samples: a constant column (width 0), a u16 column jumping
+/// 0 -> 65535 -> 0 (zigzag deltas of 17 bits) and a signed column (-2, 1, -1: width 3).
+static void test_delta_width_0_and_17_bits() {
+  const uint8_t raw[] = {
+    LE16(500), LE16(0),     LE16(-2),
+    LE16(500), LE16(65535), LE16(1),
+    LE16(500), LE16(0),     LE16(-1)
+  };
+  const uint8_t counts[] = {2, 1};
+  const bool isSigned[] = {false, true};
+  const uint8_t expected[] = {
+    0xF4, 0x01, 0x00,                               // 500, width 0, no deltas
+    0x00, 0x00, 0x11, 0xFE, 0xFF, 0xFB, 0xFF, 0x03, // 0, width 17, zigzag 131070 and 131069
+    0xFE, 0xFF, 0x03, 0x1E                          // -2, width 3, zigzag 6 and 3
+  };
+  uint8_t out[sizeof(expected) + 4] = {0};
+  size_t len = encodeDeltaPayload(raw, 6, 3, counts, isSigned, 2, out);
+  TEST_ASSERT_EQUAL_UINT(sizeof(expected), len);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, sizeof(expected));
+}
+
+/// A single sample has no deltas: every column is its first value with width 0.
+static void test_delta_single_sample() {
+  const uint8_t raw[] = {LE16(7), LE16(65535), LE16(-300)};
+  const uint8_t counts[] = {2, 1};
+  const bool isSigned[] = {false, true};
+  const uint8_t expected[] = {0x07, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0xD4, 0xFE, 0x00};
+  uint8_t out[sizeof(expected) + 4] = {0};
+  size_t len = encodeDeltaPayload(raw, 6, 1, counts, isSigned, 2, out);
+  TEST_ASSERT_EQUAL_UINT(sizeof(expected), len);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, sizeof(expected));
+}
+
+static void test_delta_no_samples() {
+  const uint8_t raw[2] = {0};
+  const uint8_t counts[] = {1};
+  const bool isSigned[] = {false};
+  uint8_t out[4] = {0};
+  TEST_ASSERT_EQUAL_UINT(0, encodeDeltaPayload(raw, 2, 0, counts, isSigned, 1, out));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_pack12_keeps_low_12_bits);
+  RUN_TEST(test_pack12_pads_last_byte);
+  RUN_TEST(test_delta_width_0_and_17_bits);
+  RUN_TEST(test_delta_single_sample);
+  RUN_TEST(test_delta_no_samples);
+  return UNITY_END();
+}
@@ -0,0 +1,115 @@
+/**
+ * @file Bench.cpp
+ * @brief Benchmark firmware for the ESP32WebSocket library (PlatformIO env "bench").
+ *        Runs the library with a fixed, reproducible load for scripts/bench_client.py:
+ *        an acquisition stream whose rate, chunk size, channel count and encoding are set
+ *        with build flags, and a "bench_value" variable used as the set -> ack echo target.
+ *        Nothing else runs in loop(), so measured latencies are the library's own.
+ *
+ * Example sweep over chunk sizes (each build flashes a new configuration):
+ *   PLATFORMIO_BUILD_FLAGS="-DBENCH_SAMPLES_PER_CHUNK=100" pio run -e bench -t upload
+ *   python scripts/bench_client.py --host 192.168.5.1 --csv bench.csv
+ */
+
+#include "ESP32WebSocket.h"
+#include "ESP32WebSocketAcquisition.h"
+#include "ESP32WebSocketStream.h"
+#define ESP32WS_LOG_TAG "BENCH"
+#include "ESP32WebSocketLog.h"
+
+// --- Bench Configuration (override with build flags) ---
+
+#ifndef BENCH_SAMPLES_PER_CHUNK
+#define BENCH_SAMPLES_PER_CHUNK 25
+#endif
+/// Adaptive chunking lower bound (0: fixed BENCH_SAMPLES_PER_CHUNK) and latency deadline (0: none).
+#ifndef BENCH_MIN_SAMPLES_PER_CHUNK
+#define BENCH_MIN_SAMPLES_PER_CHUNK 0
+#endif
+#ifndef BENCH_MAX_CHUNK_LATENCY_US
+#define BENCH_MAX_CHUNK_LATENCY_US 0
+#endif
+#ifndef BENCH_SAMPLE_RATE_HZ
+#define BENCH_SAMPLE_RATE_HZ 4000
+#endif
+/// Number of ADC1 channels sampled (1..6, taken from BENCH_PINS in order).
+#ifndef BENCH_NUM_CHANNELS
+#define BENCH_NUM_CHANNELS 6
+#endif
+/// StreamEncoding of the acquisition stream (STREAM_ENC_RAW, STREAM_ENC_PACK12 or STREAM_ENC_DELTA).
+#ifndef BENCH_ENCODING
+#define BENCH_ENCODING STREAM_ENC_RAW
+#endif
+/// Interval of the acquisition counter report on Serial while streaming (0 disables it).
+#ifndef BENCH_REPORT_INTERVAL_MS
+#define BENCH_REPORT_INTERVAL_MS 5000
+#endif
+
+// Same access point as the main application, so the host setup is shared
+const char *WIFI_SSID = "ESP32_Control_AP";
+const char *WIFI_PASSWORD = "password123";
+const uint8_t DESIRED_STATIC_IP[4] = {192, 168, 5, 1};
+
+const uint8_t BENCH_PINS[] = {32, 33, 34, 35, 36, 39}; // ADC1 only
+static_assert(BENCH_NUM_CHANNELS >= 1 && BENCH_NUM_CHANNELS <= sizeof(BENCH_PINS), "BENCH_NUM_CHANNELS must be 1..6");
+
+// The host sets "bench_value" to a fresh integer and times the reply carrying it back
+int benchValue = 0;
+const WsVarDesc benchVariables[] = {
+  WsVar<int>("bench_value", benchValue)
+};
+const int numBenchVariables = sizeof(benchVariables) / sizeof(benchVariables[0]);
+
+
+// --- Stream Control Callbacks ---
+
+void bench_onStreamStart() {
+  startAcquisition();
+}
+
+void bench_onStreamStop() {
+  stopAcquisition();
+}
+
+/**
+ * @brief Logs the acquisition counters, so device-side losses can be told apart from network ones.
+ *        Logged as WARN, like "Bench ready", so it survives the env's -DESP32WS_LOG_LEVEL=2.
+ */
+void reportAcquisition() {
+  AcquisitionStats stats;
+  getAcquisitionStats(&stats);
+  ESP32WS_LOGW("chunks %lu produced / %lu dropped, %lu missed samples, ring high water %u, %u samples/chunk, heap min %lu",
+               (unsigned long)stats.chunksProduced, (unsigned long)stats.chunksDropped,
+               (unsigned long)stats.missedSamples, (unsigned)stats.ringHighWater, (unsigned)stats.samplesPerChunk,
+               (unsigned long)ESP.getMinFreeHeap());
+}
+
+
+// --- Arduino Setup and Loop ---
+
+void setup() {
+  Serial.begin(115200);
+
+  if (!initAcquisition(BENCH_PINS, BENCH_NUM_CHANNELS, BENCH_SAMPLE_RATE_HZ, BENCH_SAMPLES_PER_CHUNK,
+                       nullptr, BENCH_ENCODING)) {
+    ESP32WS_LOGE("Acquisition engine configuration failed.");
+  }
+  setAcquisitionChunking(BENCH_MIN_SAMPLES_PER_CHUNK, BENCH_MAX_CHUNK_LATENCY_US);
+  initWiFiWebSocketServer(WIFI_SSID, WIFI_PASSWORD, DESIRED_STATIC_IP, benchVariables, numBenchVariables);
+  setStreamCallbacks(getAcquisitionStreamId(), bench_onStreamStart, bench_onStreamStop);
+
+  ESP32WS_LOGW("Bench ready: %u channels at %u Hz, %u samples/chunk (%u bytes), encoding %d.",
+               (unsigned)BENCH_NUM_CHANNELS, (unsigned)BENCH_SAMPLE_RATE_HZ, (unsigned)BENCH_SAMPLES_PER_CHUNK,
+               (unsigned)getStreamFrameSize(getAcquisitionStreamId()), (int)BENCH_ENCODING);
+}
+
+void loop() {
+  #if BENCH_REPORT_INTERVAL_MS > 0
+  static unsigned long lastReport = 0;
+  if (isAcquisitionRunning() && millis() - lastReport >= BENCH_REPORT_INTERVAL_MS) {
+    lastReport = millis();
+    reportAcquisition();
+  }
+  #endif
+  delay(10);
+}